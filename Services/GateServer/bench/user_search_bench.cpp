@@ -0,0 +1,113 @@
+/*
+ * user_search_bench - 用户名搜索索引的基准测试
+ * 用合成语料构建 UserSearchIndex，测量构建耗时、内存和各类查询的耗时
+ *
+ * 用法: user_search_bench [用户数=10000000] [每个查询的轮数=200]
+ * 语料一半是 2-3 个汉字的中文名，一半是两个拼音音节拼成的名字，都带数字后缀
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../../utils/user_search_index.h"
+
+namespace {
+
+// 常见姓氏和名字用字（都在 GB2312 一级字库内，能得到拼音首字母）
+const char* const SURNAMES[] = {
+    "王", "李", "张", "刘", "陈", "杨", "黄", "赵", "吴", "周",
+    "徐", "孙", "马", "朱", "胡", "郭", "何", "高", "林", "罗"
+};
+const char* const GIVEN[] = {
+    "伟", "芳", "娜", "敏", "静", "丽", "强", "磊", "军", "洋",
+    "勇", "艳", "杰", "娟", "涛", "明", "超", "秀", "霞", "平",
+    "刚", "桂", "英", "华", "文", "玉", "兰", "红", "建", "国"
+};
+const char* const SYLLABLES[] = {
+    "zhang", "wang", "li", "liu", "chen", "yang", "huang", "zhao", "wu", "zhou",
+    "xu", "sun", "ma", "zhu", "hu", "guo", "he", "gao", "lin", "luo",
+    "wei", "fang", "na", "min", "jing", "qiang", "lei", "jun", "yong", "jie",
+    "tao", "ming", "chao", "xiu", "xia", "ping", "gang", "ying", "hua", "wen"
+};
+
+template <typename T, size_t N>
+size_t countOf(const T (&)[N]) {
+    return N;
+}
+
+struct Query {
+    const char* kind;
+    std::string text;
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    size_t users = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+    size_t rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+    if (users == 0 || rounds == 0) {
+        std::fprintf(stderr, "usage: %s [users] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    std::mt19937 gen(42);
+    auto pick = [&gen](size_t n) { return static_cast<size_t>(gen() % n); };
+
+    int32_t produced = 0;
+    auto next = [&](int32_t& userId, std::string& username) {
+        if (static_cast<size_t>(produced) == users) {
+            return false;
+        }
+        userId = ++produced;
+        username.clear();
+        if (userId % 2 == 0) {
+            username += SURNAMES[pick(countOf(SURNAMES))];
+            username += GIVEN[pick(countOf(GIVEN))];
+            if (pick(2) == 0) {
+                username += GIVEN[pick(countOf(GIVEN))];
+            }
+        } else {
+            username += SYLLABLES[pick(countOf(SYLLABLES))];
+            username += SYLLABLES[pick(countOf(SYLLABLES))];
+        }
+        username += std::to_string(pick(10000));
+        return true;
+    };
+
+    UserSearchIndex& index = UserSearchIndex::getInstance();
+    auto buildStart = std::chrono::steady_clock::now();
+    index.build(next);
+    auto buildMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - buildStart).count();
+    std::printf("built %zu users in %lld ms (n-gram count and bytes are in the log line above)\n",
+                index.size(), static_cast<long long>(buildMs));
+
+    const Query queries[] = {
+        {"prefix", "zhang"},
+        {"prefix", "王伟"},
+        {"substring", "ngwe"},
+        {"substring", "伟1"},
+        {"initials prefix", "zw"},
+        {"initials substring", "wj"},
+        {"fuzzy", "zhangwie"},
+        {"fuzzy", "liuminng"},
+    };
+
+    std::vector<std::pair<int, std::string>> results;
+    for (const auto& query : queries) {
+        index.search(query.text, 20, results);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < rounds; ++i) {
+            index.search(query.text, 20, results);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        std::printf("%-20s %-12s %10.1f us  %zu results%s%s\n", query.kind, query.text.c_str(),
+                    elapsed.count() / 1000.0 / rounds, results.size(),
+                    results.empty() ? "" : ", first: ", results.empty() ? "" : results[0].second.c_str());
+    }
+    return 0;
+}
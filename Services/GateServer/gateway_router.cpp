@@ -0,0 +1,273 @@
+#include "gateway_router.h"
+#include <boost/json.hpp>
+#include "websocket_manager.h"
+#include "../utils/async_redis_client.h"
+#include "../utils/logger.h"
+
+namespace {
+
+// 登记仍属于本网关时才续期或删除，避免覆盖用户在其他网关上的新连接
+const char* const REFRESH_LOCATION_SCRIPT =
+    "if redis.call('GET', KEYS[1]) == ARGV[1] then "
+    "return redis.call('EXPIRE', KEYS[1], ARGV[2]) end return 0";
+const char* const REMOVE_LOCATION_SCRIPT =
+    "if redis.call('GET', KEYS[1]) == ARGV[1] then "
+    "return redis.call('DEL', KEYS[1]) end return 0";
+
+/**
+ * @brief 记录失败的 Redis 命令（登记类操作失败只影响跨网关实时推送）
+ */
+auto logOnError(const std::string& what, const std::string& userId) {
+    return [what, userId](boost::system::error_code ec, RedisValue reply) {
+        if (ec || reply.isError()) {
+            LOG_WARN("Gateway location {} failed for user {}: {}", what, userId, ec ? ec.message() : reply.str);
+        }
+    };
+}
+
+/**
+ * @brief 在接收者会话的 strand 上发送消息
+ * 投递来自 Redis 订阅回调或其他会话的 strand，不能直接操作接收者的 websocket 流
+ */
+void sendOnSessionStrand(const std::shared_ptr<websocket_session>& session, std::string payload) {
+    net::dispatch(session->get_executor(), [session, payload = std::move(payload)]() {
+        session->send_message(payload);
+    });
+}
+
+} // namespace
+
+/**
+ * @brief 获取GatewayRouter单例实例
+ * 使用局部静态变量实现线程安全的单例模式
+ * @return GatewayRouter实例的引用
+ */
+GatewayRouter& GatewayRouter::getInstance() {
+    static GatewayRouter instance;
+    return instance;
+}
+
+GatewayRouter::GatewayRouter() : initialized_(false), ioc_(nullptr), subscriptionId_(0), flushScheduled_(false) {
+}
+
+/**
+ * @brief 初始化路由并订阅本网关的频道
+ */
+bool GatewayRouter::initialize(net::io_context& ioc, const std::string& gatewayId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (initialized_) {
+        LOG_WARN("GatewayRouter already initialized");
+        return true;
+    }
+
+    auto& asyncRedis = AsyncRedisClient::getInstance();
+    if (!asyncRedis.isInitialized()) {
+        LOG_ERROR("GatewayRouter requires AsyncRedisClient, cross-gateway delivery disabled");
+        return false;
+    }
+
+    ioc_ = &ioc;
+    gatewayId_ = gatewayId;
+    strand_.emplace(net::make_strand(ioc));
+    flushTimer_ = std::make_unique<net::steady_timer>(*strand_);
+
+    // 收到的批次直接在 I/O 线程上解析，不经过 strand_；每条消息再转到接收者会话的 strand 上发送
+    subscriptionId_ = asyncRedis.subscribe(channelFor(gatewayId_), ioc.get_executor(),
+        [this](const std::string& /*channel*/, const std::string& message) {
+            onGatewayMessage(message);
+        });
+    if (subscriptionId_ == 0) {
+        return false;
+    }
+
+    initialized_ = true;
+    LOG_INFO("GatewayRouter initialized as {} (channel {})", gatewayId_, channelFor(gatewayId_));
+    return true;
+}
+
+/**
+ * @brief 取消订阅并丢弃未发出的批次
+ * 未发出的消息已写入数据库，接收者下次拉取历史消息时仍能看到
+ */
+void GatewayRouter::shutdown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!initialized_) {
+        return;
+    }
+    initialized_ = false;
+
+    AsyncRedisClient::getInstance().unsubscribe(subscriptionId_);
+    subscriptionId_ = 0;
+
+    flushTimer_->cancel();
+    pending_.clear();
+    flushScheduled_ = false;
+    LOG_INFO("GatewayRouter shut down");
+}
+
+void GatewayRouter::registerUser(const std::string& userId) {
+    if (!initialized_ || userId.empty()) {
+        return;
+    }
+
+    AsyncRedisClient::getInstance().asyncCommand(
+        {"SET", locationKey(userId), gatewayId_, "EX", std::to_string(LOCATION_TTL_SECONDS)},
+        logOnError("register", userId));
+}
+
+void GatewayRouter::refreshUser(const std::string& userId) {
+    if (!initialized_ || userId.empty()) {
+        return;
+    }
+
+    AsyncRedisClient::getInstance().asyncCommand(
+        {"EVAL", REFRESH_LOCATION_SCRIPT, "1", locationKey(userId), gatewayId_, std::to_string(LOCATION_TTL_SECONDS)},
+        logOnError("refresh", userId));
+}
+
+void GatewayRouter::unregisterUser(const std::string& userId) {
+    if (!initialized_ || userId.empty()) {
+        return;
+    }
+
+    AsyncRedisClient::getInstance().asyncCommand(
+        {"EVAL", REMOVE_LOCATION_SCRIPT, "1", locationKey(userId), gatewayId_},
+        logOnError("unregister", userId));
+}
+
+/**
+ * @brief 投递消息给用户
+ * 查询接收者所在网关是异步的，结果回到 strand_ 上再加入对应网关的批次
+ */
+void GatewayRouter::deliver(const std::string& userId, const std::string& payload) {
+    auto session = WebSocketManager::getInstance().getSession(userId);
+    if (session) {
+        sendOnSessionStrand(session, payload);
+        return;
+    }
+
+    if (!initialized_) {
+        return;
+    }
+
+    AsyncRedisClient::getInstance().asyncCommand({"GET", locationKey(userId)},
+        net::bind_executor(*strand_, [this, userId, payload](boost::system::error_code ec, RedisValue reply) {
+            if (ec || reply.isError()) {
+                LOG_WARN("Failed to look up gateway for user {}: {}", userId, ec ? ec.message() : reply.str);
+                return;
+            }
+            if (reply.type != REDIS_REPLY_STRING) {
+                LOG_DEBUG("User {} is not connected to any gateway, message kept for later", userId);
+                return;
+            }
+            if (reply.str == gatewayId_) {
+                // 登记指向本网关但会话已不在，说明刚刚断开
+                LOG_DEBUG("User {} disconnected from this gateway before delivery", userId);
+                return;
+            }
+            enqueue_impl(reply.str, userId, payload);
+        }));
+}
+
+/**
+ * @brief 把消息加入目标网关的批次（在 strand_ 上调用）
+ * 批次达到 MAX_BATCH_SIZE 时立即发出，否则最多等待 FLUSH_DELAY_MS
+ */
+void GatewayRouter::enqueue_impl(const std::string& gatewayId, const std::string& userId, const std::string& payload) {
+    if (!initialized_) {
+        return;
+    }
+
+    auto& batch = pending_[gatewayId];
+    batch.emplace_back(userId, payload);
+    if (batch.size() >= MAX_BATCH_SIZE) {
+        flush_impl(gatewayId);
+        return;
+    }
+
+    if (!flushScheduled_) {
+        flushScheduled_ = true;
+        flushTimer_->expires_after(std::chrono::milliseconds(FLUSH_DELAY_MS));
+        flushTimer_->async_wait(net::bind_executor(*strand_, [this](const boost::system::error_code& ec) {
+            flushScheduled_ = false;
+            if (!ec) {
+                flushAll_impl();
+            }
+        }));
+    }
+}
+
+void GatewayRouter::flushAll_impl() {
+    std::vector<std::string> gateways;
+    gateways.reserve(pending_.size());
+    for (const auto& entry : pending_) {
+        gateways.push_back(entry.first);
+    }
+    for (const auto& gatewayId : gateways) {
+        flush_impl(gatewayId);
+    }
+}
+
+/**
+ * @brief 把一个目标网关的批次作为一条消息发布（在 strand_ 上调用）
+ * 格式: {"from": 网关ID, "messages": [{"to": 用户ID, "payload": 内容}, ...]}
+ */
+void GatewayRouter::flush_impl(const std::string& gatewayId) {
+    auto it = pending_.find(gatewayId);
+    if (it == pending_.end()) {
+        return;
+    }
+    std::vector<PendingMessage> batch = std::move(it->second);
+    pending_.erase(it);
+    if (batch.empty()) {
+        return;
+    }
+
+    boost::json::array messages;
+    for (const auto& message : batch) {
+        boost::json::object entry;
+        entry["to"] = message.first;
+        entry["payload"] = message.second;
+        messages.push_back(entry);
+    }
+    boost::json::object body;
+    body["from"] = gatewayId_;
+    body["messages"] = messages;
+
+    size_t count = batch.size();
+    AsyncRedisClient::getInstance().asyncCommand({"PUBLISH", channelFor(gatewayId), boost::json::serialize(body)},
+        [gatewayId, count](boost::system::error_code ec, RedisValue reply) {
+            if (ec || reply.isError()) {
+                LOG_WARN("Failed to forward {} messages to gateway {}: {}", count, gatewayId,
+                         ec ? ec.message() : reply.str);
+            } else if (reply.type == REDIS_REPLY_INTEGER && reply.integer == 0) {
+                // 没有订阅者说明目标网关已下线，登记会在过期后消失
+                LOG_WARN("Gateway {} is not listening, {} messages not delivered live", gatewayId, count);
+            }
+        });
+}
+
+/**
+ * @brief 处理其他网关转发来的批次，投递给本地会话
+ */
+void GatewayRouter::onGatewayMessage(const std::string& message) {
+    try {
+        boost::json::value jv = boost::json::parse(message);
+        const auto& messages = jv.as_object().at("messages").as_array();
+
+        auto& sessions = WebSocketManager::getInstance();
+        for (const auto& entry : messages) {
+            const auto& object = entry.as_object();
+            std::string userId = object.at("to").as_string().c_str();
+            auto session = sessions.getSession(userId);
+            if (session) {
+                sendOnSessionStrand(session, object.at("payload").as_string().c_str());
+            } else {
+                LOG_DEBUG("User {} left this gateway before a forwarded message arrived", userId);
+            }
+        }
+    } catch (const std::exception& e) {
+        LOG_ERROR("Invalid gateway message: {}", e.what());
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef GATEWAY_ROUTER_H
+#define GATEWAY_ROUTER_H
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace net = boost::asio;
+
+/**
+ * @brief 跨网关消息路由（单例模式）
+ *
+ * 多个 GateServer 部署在负载均衡之后时，接收者的会话可能在另一个网关上：
+ * 1. 会话建立时在 Redis 中登记 user:gateway:<userId> -> 网关ID，关闭时删除，
+ *    登记带有过期时间并随心跳续期，网关崩溃后残留的登记会自动失效
+ * 2. 每个网关通过 AsyncRedisClient 的独立订阅连接订阅自己的频道 gateway:<网关ID>
+ * 3. 转发时先查本地会话，不在本地则查询接收者所在网关，
+ *    按目标网关攒批后一次 PUBLISH，由目标网关投递给本地会话
+ *
+ * 消息在转发前已经写入数据库，接收者不在线或路由失败时不会丢失，只是不再实时推送。
+ */
+class GatewayRouter {
+public:
+    /**
+     * @brief 获取GatewayRouter单例实例
+     * @return GatewayRouter实例的引用
+     */
+    static GatewayRouter& getInstance();
+
+    GatewayRouter(const GatewayRouter&) = delete;
+    GatewayRouter& operator=(const GatewayRouter&) = delete;
+
+    /**
+     * @brief 初始化路由并订阅本网关的频道（需在 AsyncRedisClient 初始化之后调用）
+     * @param ioc GateServer 的 io_context
+     * @param gatewayId 本网关的唯一ID
+     * @return 初始化成功返回true
+     */
+    bool initialize(net::io_context& ioc, const std::string& gatewayId);
+
+    /**
+     * @brief 取消订阅并丢弃未发出的批次（在 io_context::run 返回之后调用）
+     */
+    void shutdown();
+
+    bool isInitialized() const { return initialized_; }
+
+    /**
+     * @brief 登记用户连接在本网关
+     * @param userId 用户ID
+     */
+    void registerUser(const std::string& userId);
+
+    /**
+     * @brief 续期用户的网关登记（心跳时调用），登记已属于其他网关时不做修改
+     * @param userId 用户ID
+     */
+    void refreshUser(const std::string& userId);
+
+    /**
+     * @brief 删除用户的网关登记，登记已属于其他网关时不做修改
+     * @param userId 用户ID
+     */
+    void unregisterUser(const std::string& userId);
+
+    /**
+     * @brief 投递消息给用户
+     * 本地会话直接发送，否则转发到用户所在的网关
+     * @param userId 接收者用户ID
+     * @param payload 发给客户端的消息内容
+     */
+    void deliver(const std::string& userId, const std::string& payload);
+
+private:
+    GatewayRouter();
+    ~GatewayRouter() = default;
+
+    // 单条待转发消息：接收者ID和消息内容
+    using PendingMessage = std::pair<std::string, std::string>;
+
+    void enqueue_impl(const std::string& gatewayId, const std::string& userId, const std::string& payload);
+    void flush_impl(const std::string& gatewayId);
+    void flushAll_impl();
+    void onGatewayMessage(const std::string& message);
+
+    static std::string locationKey(const std::string& userId) { return "user:gateway:" + userId; }
+    static std::string channelFor(const std::string& gatewayId) { return "gateway:" + gatewayId; }
+
+    // 登记的过期时间（心跳间隔的数倍）
+    static const int LOCATION_TTL_SECONDS = 120;
+
+    // 攒批等待时间和单批上限
+    static constexpr int FLUSH_DELAY_MS = 2;
+    static const size_t MAX_BATCH_SIZE = 128;
+
+    std::mutex mutex_;
+    std::atomic<bool> initialized_;
+    std::string gatewayId_;
+    net::io_context* ioc_;
+    uint64_t subscriptionId_;
+
+    // 以下成员只在 strand_ 上访问
+    std::optional<net::strand<net::io_context::executor_type>> strand_;
+    std::unique_ptr<net::steady_timer> flushTimer_;
+    bool flushScheduled_;
+    std::unordered_map<std::string, std::vector<PendingMessage>> pending_;  // 目标网关 -> 待转发消息
+};
+
+#endif // GATEWAY_ROUTER_H
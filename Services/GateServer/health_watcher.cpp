@@ -0,0 +1,184 @@
+#include "health_watcher.h"
+#include <algorithm>
+#include "../utils/logger.h"
+
+using grpc::health::v1::Health;
+using grpc::health::v1::HealthCheckRequest;
+using grpc::health::v1::HealthCheckResponse;
+
+HealthWatcher::HealthWatcher(const std::string& serviceName, const std::string& grpcService,
+                             std::shared_ptr<StatusChannelPool> channels)
+    : serviceName_(serviceName), grpcService_(grpcService), channels_(std::move(channels)), running_(false) {}
+
+HealthWatcher::~HealthWatcher() {
+    stop();
+}
+
+void HealthWatcher::start() {
+    if (running_.exchange(true)) {
+        return;
+    }
+
+    syncTargets();
+    syncThread_ = std::thread(&HealthWatcher::syncLoop, this);
+
+    LOG_INFO("Watching health of {} instances of {}", targets_.size(), serviceName_);
+}
+
+void HealthWatcher::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    // 先结束同步线程，之后 targets_ 不再变化
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    stopCondition_.notify_all();
+    if (syncThread_.joinable()) {
+        syncThread_.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& target : targets_) {
+            if (target->context) {
+                target->context->TryCancel();
+            }
+        }
+    }
+    stopCondition_.notify_all();
+
+    for (auto& target : targets_) {
+        if (target->thread.joinable()) {
+            target->thread.join();
+        }
+    }
+    targets_.clear();
+}
+
+/**
+ * @brief 与负载均衡器中的实例列表对齐
+ * 新增的实例启动 Watch 线程；已移除的实例取消流、等待线程退出后丢弃
+ */
+void HealthWatcher::syncTargets() {
+    auto instances = LoadBalancer::getInstance().getServiceInstances(serviceName_);
+    auto listed = [&instances](const Target& target) {
+        return std::any_of(instances.begin(), instances.end(), [&target](const std::shared_ptr<ServiceInstance>& instance) {
+            return instance->host == target.host && instance->port == target.port;
+        });
+    };
+
+    std::vector<std::unique_ptr<Target>> removed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = targets_.begin(); it != targets_.end();) {
+            if (listed(**it)) {
+                ++it;
+                continue;
+            }
+            (*it)->active = false;
+            if ((*it)->context) {
+                (*it)->context->TryCancel();
+            }
+            removed.push_back(std::move(*it));
+            it = targets_.erase(it);
+        }
+    }
+    if (!removed.empty()) {
+        stopCondition_.notify_all();
+    }
+    for (auto& target : removed) {
+        if (target->thread.joinable()) {
+            target->thread.join();
+        }
+        LOG_INFO("Stopped watching health of {} at {}:{}, instance removed", serviceName_, target->host, target->port);
+    }
+
+    for (const auto& instance : instances) {
+        bool watched = std::any_of(targets_.begin(), targets_.end(), [&instance](const std::unique_ptr<Target>& target) {
+            return target->host == instance->host && target->port == instance->port;
+        });
+        if (watched) {
+            continue;
+        }
+
+        auto target = std::make_unique<Target>();
+        target->host = instance->host;
+        target->port = instance->port;
+        target->thread = std::thread(&HealthWatcher::watchLoop, this, std::ref(*target));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            targets_.push_back(std::move(target));
+        }
+        LOG_INFO("Watching health of {} at {}:{}", serviceName_, instance->host, instance->port);
+    }
+}
+
+void HealthWatcher::syncLoop() {
+    while (sleepFor(SYNC_INTERVAL)) {
+        syncTargets();
+    }
+}
+
+void HealthWatcher::watchLoop(Target& target) {
+    std::string address = target.host + ":" + std::to_string(target.port);
+    auto stub = Health::NewStub(channels_->channel(address));
+    std::chrono::milliseconds backoff = MIN_BACKOFF;
+
+    while (running_ && target.active) {
+        grpc::ClientContext context;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_ || !target.active) {
+                break;
+            }
+            target.context = &context;
+        }
+
+        HealthCheckRequest request;
+        request.set_service(grpcService_);
+        auto reader = stub->Watch(&context, request);
+
+        HealthCheckResponse response;
+        while (reader->Read(&response)) {
+            report(target, response.status() == HealthCheckResponse::SERVING);
+            backoff = MIN_BACKOFF;
+        }
+        grpc::Status status = reader->Finish();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            target.context = nullptr;
+        }
+        if (!running_ || !target.active) {
+            break;
+        }
+
+        if (status.error_code() == grpc::StatusCode::UNIMPLEMENTED) {
+            // 旧版本服务端没有健康检查服务，健康状态留给其他机制判断
+            LOG_WARN("{} at {} does not implement grpc.health.v1, stop watching", serviceName_, address);
+            break;
+        }
+
+        // 流断开说明实例已不可达，立即移出轮询，之后按退避间隔重连
+        report(target, false);
+        LOG_DEBUG("Health watch on {} ended: {}", address, status.error_message());
+        if (!sleepFor(backoff, &target)) {
+            break;
+        }
+        backoff = std::min(backoff * 2, MAX_BACKOFF);
+    }
+}
+
+void HealthWatcher::report(const Target& target, bool healthy) {
+    // 状态不变时负载均衡器不会发布新快照
+    LoadBalancer::getInstance().updateHealthStatus(serviceName_, target.host, target.port, healthy);
+}
+
+bool HealthWatcher::sleepFor(std::chrono::milliseconds duration, const Target* target) {
+    auto stopped = [this, target] { return !running_ || (target && !target->active); };
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopCondition_.wait_for(lock, duration, stopped);
+    return !stopped();
+}
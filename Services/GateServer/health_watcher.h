@@ -0,0 +1,75 @@
+#ifndef HEALTH_WATCHER_H
+#define HEALTH_WATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+#include "../generated/health.grpc.pb.h"
+#include "../utils/load_balancer.h"
+#include "status_channel_pool.h"
+
+// 通过 grpc.health.v1 Watch 流订阅后端实例的健康状态
+// 每个实例一条常驻流：服务端推送 NOT_SERVING 或流断开（进程退出、网络中断）时
+// 立即在负载均衡器中把实例标记为不健康，恢复 SERVING 后重新加入轮询，不必等到业务请求失败
+// 后台线程定期与负载均衡器中的实例列表对齐：新增的实例建立流，已移除的实例取消流并结束其线程
+class HealthWatcher {
+public:
+    // serviceName: 负载均衡器中的服务名；grpcService: Watch 请求中的服务全名
+    // channels: 各实例的共享连接，Watch 流与业务调用走同一条连接，连接断开能被流立即发现
+    HealthWatcher(const std::string& serviceName, const std::string& grpcService,
+                  std::shared_ptr<StatusChannelPool> channels);
+    ~HealthWatcher();
+
+    HealthWatcher(const HealthWatcher&) = delete;
+    HealthWatcher& operator=(const HealthWatcher&) = delete;
+
+    // 为负载均衡器中该服务的每个实例建立 Watch 流，并启动实例列表的同步线程
+    void start();
+
+    // 取消所有流并等待线程退出
+    void stop();
+
+private:
+    // 一个被订阅的实例
+    struct Target {
+        std::string host;
+        int port;
+        std::thread thread;
+        grpc::ClientContext* context = nullptr;  // 当前流的上下文，stop() 用它取消阻塞中的读取
+        std::atomic<bool> active{true};           // 实例已从负载均衡器移除时置为 false
+    };
+
+    void watchLoop(Target& target);
+    void report(const Target& target, bool healthy);
+
+    // 与负载均衡器中的实例列表对齐（只在 start() 和同步线程中调用）
+    void syncTargets();
+    void syncLoop();
+
+    // 可被 stop() 打断的等待；target 非空时它被移除也会打断
+    bool sleepFor(std::chrono::milliseconds duration, const Target* target = nullptr);
+
+    std::string serviceName_;
+    std::string grpcService_;
+    std::shared_ptr<StatusChannelPool> channels_;
+    std::vector<std::unique_ptr<Target>> targets_;  // 只由 start()、同步线程和 stop()（同步线程结束后）修改
+    std::thread syncThread_;
+
+    std::atomic<bool> running_;
+    std::mutex mutex_;                        // 保护各 Target 的 context
+    std::condition_variable stopCondition_;
+
+    // 流断开后重连的退避间隔
+    static constexpr std::chrono::milliseconds MIN_BACKOFF{100};
+    static constexpr std::chrono::milliseconds MAX_BACKOFF{5000};
+    // 与负载均衡器实例列表对齐的间隔
+    static constexpr std::chrono::milliseconds SYNC_INTERVAL{1000};
+};
+
+#endif // HEALTH_WATCHER_H
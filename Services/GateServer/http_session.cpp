@@ -10,6 +10,8 @@
 #include <cctype>
 #include <iomanip>
 #include "../utils/database_manager.h"
+#include "../utils/async_mysql_client.h"
+#include "../utils/user_search_index.h"
 #include "websocket_manager.h" 
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
@@ -323,13 +325,35 @@ void http_session::handle_login() {
     
     std::cout << "Parsed credentials - Username: " << username << ", Password: [HIDDEN]" << std::endl;
     
+    // 优先使用异步数据库客户端，查询期间不占用I/O线程
+    AsyncDatabaseManager& asyncDb = AsyncDatabaseManager::getInstance();
+    if (asyncDb.isInitialized()) {
+        auto self = shared_this();
+        asyncDb.asyncGetUserByUsername(username,
+            [self, username, password](bool found, int userId, std::string storedPasswordHash) {
+                // 回调运行在数据库连接的strand上，切回会话自己的执行器
+                net::dispatch(self->stream_.get_executor(),
+                    [self, username, password, found, userId, storedPasswordHash = std::move(storedPasswordHash)]() {
+                        self->finish_login(username, password, found, userId, storedPasswordHash);
+                    });
+            });
+        return;
+    }
+    
     // 获取数据库管理器实例
     DatabaseManager& db = DatabaseManager::getInstance();
     
     // 验证用户凭据
-    int userId;
+    int userId = 0;
     std::string storedPasswordHash;
-    if (db.getUserByUsername(username, userId, storedPasswordHash)) {
+    bool found = db.getUserByUsername(username, userId, storedPasswordHash);
+    finish_login(username, password, found, userId, storedPasswordHash);
+}
+
+// 根据查询到的用户信息校验密码并发送登录响应
+void http_session::finish_login(const std::string& username, const std::string& password,
+                                bool found, int userId, const std::string& storedPasswordHash) {
+    if (found) {
         // 对输入的密码进行哈希处理
         std::string inputPasswordHash = sha256(password); // 使用新的sha256函数
         
@@ -412,6 +436,7 @@ void http_session::handle_register() {
     LOG_DEBUG("db.createUser finished for user: {}, success: {}", username, dbSuccess);
     if (dbSuccess) {
         std::cout << "User registered successfully" << std::endl;
+        UserSearchIndex::getInstance().addUser(userId, username);
         res_.version(req_.version());
         res_.result(http::status::ok);
         res_.set(http::field::server, "GateServer");
@@ -72,6 +72,8 @@ private:
     void do_close();
     void fail(beast::error_code ec, char const* what);
     void handle_login();
+    void finish_login(const std::string& username, const std::string& password,
+                      bool found, int userId, const std::string& storedPasswordHash);
     void handle_register();
     void handle_health_check();  // 新增健康检查处理
     bool verify_websocket_handshake();
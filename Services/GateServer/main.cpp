@@ -7,16 +7,21 @@
 #include <boost/asio.hpp>
 #include <signal.h>
 #include <thread>
+#include <cstdlib>
 #include "listener.h"
 #include "../utils/database_manager.h"
+#include "../utils/async_mysql_client.h"
+#include "../utils/async_redis_client.h"
 #include "../utils/crypto_utils.h"
 #include "websocket_manager.h"
 #include "connection_manager.h"
+#include "gateway_router.h"
 #include "status_client_manager.h"
 #include "../utils/logger.h"
 #include "../utils/load_balancer.h"
 #include "../utils/service_registry.h"
 #include "../utils/redis_manager.h"
+#include "../utils/user_search_index.h"
 
 namespace net = boost::asio;            // from <boost/asio.hpp>
 using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
@@ -74,6 +79,9 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[])
         loadBalancer.addServiceInstance("DatabaseService", "localhost", 3307, 2);
         LOG_INFO("Registered database instance: localhost:3307 with weight 2");
         
+        // 注册只读副本后，读请求（登录查询、用户搜索、历史消息）会自动路由到副本
+        // DatabaseManager::getInstance().addReplicaInstance("localhost", 3308, "im_user", "password", "im_database", 1);
+        
         // 初始化数据库连接
         DatabaseManager& db = DatabaseManager::getInstance();
         if (!db.connect()) {
@@ -81,10 +89,18 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[])
             return EXIT_FAILURE;
         }
         LOG_INFO("Database connected successfully");
+        
+        // 用户名前缀索引，搜索不再逐次查询数据库
+        UserSearchIndex::getInstance().start();
 
         // 初始化Redis连接
+        // REDIS_NODES 为逗号分隔的 host:port 列表，键按槽位分布到各节点；
+        // 设置 REDIS_CLUSTER=1 时按 Redis Cluster 协议路由
+        const char* redisNodes = std::getenv("REDIS_NODES");
+        const char* redisCluster = std::getenv("REDIS_CLUSTER");
         RedisManager& redis = RedisManager::getInstance();
-        if (!redis.initialize("localhost", 6379, 10)) {
+        if (!redis.initialize(parseRedisNodes(redisNodes ? redisNodes : "localhost:6379"), 10,
+                              redisCluster && std::string(redisCluster) == "1")) {
             LOG_WARN("Failed to connect to Redis, continuing without Redis support");
         } else {
             LOG_INFO("Redis connected successfully");
@@ -102,6 +118,17 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[])
         // 设置全局变量用于信号处理
         g_ioc = &ioc;
         
+        // 初始化异步数据库客户端，登录查询不再阻塞I/O线程
+        AsyncDatabaseManager::getInstance().initialize(ioc, "im_user", "password", "im_database", 8);
+        
+        // 初始化异步Redis客户端，缓存读写和订阅都在I/O线程上非阻塞完成
+        AsyncRedisClient::getInstance().initialize(ioc);
+        
+        // 订阅本网关的转发频道，接收其他网关转来的消息；GATEWAY_ID 未设置时使用 主机名:端口
+        const char* gatewayIdEnv = std::getenv("GATEWAY_ID");
+        std::string gatewayId = gatewayIdEnv ? gatewayIdEnv : net::ip::host_name() + ":" + std::to_string(port);
+        GatewayRouter::getInstance().initialize(ioc, gatewayId);
+        
         // 创建并启动监听器，接受连接
         g_listener = std::make_shared<listener>(
             ioc,
@@ -118,6 +145,13 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[])
         // 运行I/O服务
         ioc.run();
         
+        // 异步连接依赖io_context，必须在其销毁前关闭；此时io_context已停止，投递的任务不会再执行，
+        // 两个异步客户端都在当前线程直接关闭连接（未完成的查询以失败回调）
+        AsyncDatabaseManager::getInstance().shutdown();
+        GatewayRouter::getInstance().shutdown();
+        AsyncRedisClient::getInstance().shutdown();
+        UserSearchIndex::getInstance().stop();
+        
         LOG_INFO("GateServer stopped");
     }
     catch (const std::exception& e)
@@ -0,0 +1,145 @@
+#include "status_channel_pool.h"
+#include <algorithm>
+#include "../utils/logger.h"
+
+StatusChannelPool::Lease::Lease(status::StatusService::Stub* stub, std::atomic<int>* inFlight)
+    : stub_(stub), inFlight_(inFlight) {}
+
+StatusChannelPool::Lease::Lease(Lease&& other) noexcept
+    : stub_(other.stub_), inFlight_(other.inFlight_) {
+    other.stub_ = nullptr;
+    other.inFlight_ = nullptr;
+}
+
+StatusChannelPool::Lease& StatusChannelPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        stub_ = other.stub_;
+        inFlight_ = other.inFlight_;
+        other.stub_ = nullptr;
+        other.inFlight_ = nullptr;
+    }
+    return *this;
+}
+
+StatusChannelPool::Lease::~Lease() {
+    release();
+}
+
+void StatusChannelPool::Lease::release() {
+    if (inFlight_) {
+        inFlight_->fetch_sub(1);
+        inFlight_ = nullptr;
+    }
+    stub_ = nullptr;
+}
+
+StatusChannelPool::StatusChannelPool(size_t channelsPerEndpoint, int maxInFlightPerChannel)
+    : channelsPerEndpoint_(std::max<size_t>(channelsPerEndpoint, 1)),
+      maxInFlightPerChannel_(std::max(maxInFlightPerChannel, 1)) {}
+
+size_t StatusChannelPool::warmUp(const std::vector<std::string>& addresses, std::chrono::milliseconds timeout) {
+    std::vector<std::pair<std::string, std::shared_ptr<grpc::Channel>>> channels;
+    for (const auto& address : addresses) {
+        for (auto& pooled : endpoint(address).channels) {
+            // 先让所有通道同时开始连接，再统一等待，总耗时不超过一个超时
+            pooled->channel->GetState(true);
+            channels.emplace_back(address, pooled->channel);
+        }
+    }
+
+    auto deadline = std::chrono::system_clock::now() + timeout;
+    size_t ready = 0;
+    for (const auto& entry : channels) {
+        if (entry.second->WaitForConnected(deadline)) {
+            ++ready;
+        } else {
+            LOG_WARN("gRPC channel to {} not ready after warm-up, will keep reconnecting", entry.first);
+        }
+    }
+
+    LOG_INFO("Warmed up {}/{} gRPC channels to {} endpoints", ready, channels.size(), addresses.size());
+    return ready;
+}
+
+StatusChannelPool::Lease StatusChannelPool::acquire(const std::string& address) {
+    Endpoint& target = endpoint(address);
+    size_t count = target.channels.size();
+    size_t start = target.next.fetch_add(1);
+
+    // 从轮转起点开始找在途请求最少的通道，在途数相同时各通道轮流承担
+    PooledChannel* best = nullptr;
+    int bestInFlight = 0;
+    for (size_t i = 0; i < count; ++i) {
+        PooledChannel* candidate = target.channels[(start + i) % count].get();
+        int inFlight = candidate->inFlight.load();
+        if (!best || inFlight < bestInFlight) {
+            best = candidate;
+            bestInFlight = inFlight;
+        }
+    }
+
+    // 并发调用可能同时看到同一个空位，以自增后的值为准
+    int inFlight = best->inFlight.fetch_add(1) + 1;
+    if (inFlight > maxInFlightPerChannel_) {
+        best->inFlight.fetch_sub(1);
+        target.channels.front()->rejected.fetch_add(1);
+        LOG_WARN("All gRPC channels to {} are at the in-flight limit ({}), rejecting call",
+                 address, maxInFlightPerChannel_);
+        return Lease();
+    }
+
+    best->calls.fetch_add(1);
+    int peak = best->peakInFlight.load();
+    while (inFlight > peak && !best->peakInFlight.compare_exchange_weak(peak, inFlight)) {
+    }
+    return Lease(best->stub.get(), &best->inFlight);
+}
+
+std::shared_ptr<grpc::Channel> StatusChannelPool::channel(const std::string& address) {
+    return endpoint(address).channels.front()->channel;
+}
+
+std::vector<StatusChannelPool::ChannelStats> StatusChannelPool::stats() const {
+    std::vector<ChannelStats> result;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : endpoints_) {
+        const Endpoint& target = *entry.second;
+        for (size_t i = 0; i < target.channels.size(); ++i) {
+            const PooledChannel& pooled = *target.channels[i];
+            result.push_back(ChannelStats{
+                target.address, i, pooled.channel->GetState(false),
+                pooled.inFlight.load(), pooled.peakInFlight.load(),
+                pooled.calls.load(), pooled.rejected.load()});
+        }
+    }
+    return result;
+}
+
+StatusChannelPool::Endpoint& StatusChannelPool::endpoint(const std::string& address) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& target = endpoints_[address];
+    if (!target) {
+        target = std::make_unique<Endpoint>();
+        target->address = address;
+        for (size_t i = 0; i < channelsPerEndpoint_; ++i) {
+            auto pooled = std::make_unique<PooledChannel>();
+            pooled->channel = createChannel(address, i);
+            pooled->stub = status::StatusService::NewStub(pooled->channel);
+            target->channels.push_back(std::move(pooled));
+        }
+    }
+    return *target;
+}
+
+std::shared_ptr<grpc::Channel> StatusChannelPool::createChannel(const std::string& address, size_t index) const {
+    grpc::ChannelArguments args;
+    args.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, KEEPALIVE_TIME_MS);
+    args.SetInt(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, KEEPALIVE_TIMEOUT_MS);
+    args.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+    args.SetInt(GRPC_ARG_HTTP2_MAX_PINGS_WITHOUT_DATA, 0);
+    // 参数相同的通道会共用全局子通道（同一条连接），用独立的子通道池和序号保证每个通道各自建连
+    args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    args.SetInt("grpc.gateway.channel_index", static_cast<int>(index));
+    return grpc::CreateCustomChannel(address, grpc::InsecureChannelCredentials(), args);
+}
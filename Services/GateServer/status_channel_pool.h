@@ -0,0 +1,109 @@
+#ifndef STATUS_CHANNEL_POOL_H
+#define STATUS_CHANNEL_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+#include "../generated/status.grpc.pb.h"
+
+// 每个 StatusServer 实例固定数量的 gRPC 通道，所有会话共享
+// 一个通道就是一条 HTTP/2 连接，调用以流的形式复用连接，不再按会话新建连接。
+// 通道在启动时预先建立并配置 keepalive，空闲连接不会被中间设备悄悄断开；
+// 每次调用选在途请求最少的通道，所有通道都达到在途上限时直接拒绝，避免请求在单条连接上排队
+class StatusChannelPool {
+public:
+    // 一次调用占用的通道，析构时归还在途计数
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        ~Lease();
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        // 没有可用通道（所有通道都达到在途上限）时为空
+        explicit operator bool() const { return stub_ != nullptr; }
+        status::StatusService::Stub* stub() const { return stub_; }
+
+    private:
+        friend class StatusChannelPool;
+        Lease(status::StatusService::Stub* stub, std::atomic<int>* inFlight);
+        void release();
+
+        status::StatusService::Stub* stub_ = nullptr;
+        std::atomic<int>* inFlight_ = nullptr;
+    };
+
+    // 一个通道的运行指标
+    struct ChannelStats {
+        std::string address;
+        size_t index;
+        grpc_connectivity_state state;
+        int inFlight;
+        int peakInFlight;
+        uint64_t calls;
+        uint64_t rejected;      // 该地址所有通道都满时被拒绝的调用，记在第一个通道上
+    };
+
+    // channelsPerEndpoint: 每个实例的连接数；maxInFlightPerChannel: 每个通道的在途调用上限
+    StatusChannelPool(size_t channelsPerEndpoint, int maxInFlightPerChannel);
+
+    StatusChannelPool(const StatusChannelPool&) = delete;
+    StatusChannelPool& operator=(const StatusChannelPool&) = delete;
+
+    // 为地址建立通道并等待连接就绪，超时的通道留在后台继续重连
+    // 返回在截止时间内就绪的通道数
+    size_t warmUp(const std::vector<std::string>& addresses, std::chrono::milliseconds timeout);
+
+    // 为一次调用选择地址上在途请求最少的通道；地址第一次出现时创建通道
+    Lease acquire(const std::string& address);
+
+    // 地址的第一个通道，供健康检查等常驻流复用同一组连接
+    std::shared_ptr<grpc::Channel> channel(const std::string& address);
+
+    // 所有通道的当前指标
+    std::vector<ChannelStats> stats() const;
+
+private:
+    struct PooledChannel {
+        std::shared_ptr<grpc::Channel> channel;
+        std::unique_ptr<status::StatusService::Stub> stub;
+        std::atomic<int> inFlight{0};
+        std::atomic<int> peakInFlight{0};
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> rejected{0};
+    };
+
+    struct Endpoint {
+        std::string address;
+        std::vector<std::unique_ptr<PooledChannel>> channels;
+        std::atomic<size_t> next{0};        // 在途数相同时轮流选择的起点
+    };
+
+    // 地址对应的通道组，不存在时创建
+    Endpoint& endpoint(const std::string& address);
+
+    std::shared_ptr<grpc::Channel> createChannel(const std::string& address, size_t index) const;
+
+    size_t channelsPerEndpoint_;
+    int maxInFlightPerChannel_;
+
+    // 通道组创建后不再删除，acquire 拿到的引用在池的生命周期内有效
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<Endpoint>> endpoints_;
+
+    // 连接空闲多久后发送 keepalive ping
+    static constexpr int KEEPALIVE_TIME_MS = 30000;
+    // ping 多久没有回应视为连接已断开
+    static constexpr int KEEPALIVE_TIMEOUT_MS = 10000;
+};
+
+#endif // STATUS_CHANNEL_POOL_H
@@ -1,82 +1,386 @@
 #include "status_client.h"
+#include <algorithm>
+#include <condition_variable>
 #include <iostream>
+#include "../utils/logger.h"
+
+// ==================== RetryBudget ====================
+
+// 实例有意不析构，进程退出时仍未完成的异步回调可以安全访问
+RetryBudget& RetryBudget::getInstance() {
+    static RetryBudget* instance = new RetryBudget();
+    return *instance;
+}
+
+RetryBudget::RetryBudget() : milliTokens_(MAX_MILLI_TOKENS) {}
+
+bool RetryBudget::allowRetry() const {
+    return milliTokens_.load(std::memory_order_relaxed) > MAX_MILLI_TOKENS / 2;
+}
+
+void RetryBudget::recordSuccess() {
+    int tokens = milliTokens_.load(std::memory_order_relaxed);
+    while (tokens < MAX_MILLI_TOKENS &&
+           !milliTokens_.compare_exchange_weak(tokens, std::min(tokens + SUCCESS_MILLI_TOKENS, MAX_MILLI_TOKENS),
+                                               std::memory_order_relaxed)) {
+    }
+}
+
+void RetryBudget::recordFailure() {
+    int tokens = milliTokens_.load(std::memory_order_relaxed);
+    while (tokens > 0 &&
+           !milliTokens_.compare_exchange_weak(tokens, std::max(tokens - FAILURE_MILLI_TOKENS, 0),
+                                               std::memory_order_relaxed)) {
+    }
+}
+
+// ==================== StatusClient ====================
+
+void StatusClient::LatencyTracker::record(std::chrono::steady_clock::duration latency) {
+    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    std::lock_guard<std::mutex> lock(mutex_);
+    samples_[count_ % WINDOW] = us;
+    ++count_;
+
+    // 每隔若干个样本重新计算一次，选择分位数只在样本副本上进行
+    if (count_ >= MIN_SAMPLES && count_ % RECOMPUTE_EVERY == 0) {
+        size_t n = std::min(count_, WINDOW);
+        std::array<int64_t, WINDOW> sorted = samples_;
+        auto p95 = sorted.begin() + n * 95 / 100;
+        std::nth_element(sorted.begin(), p95, sorted.begin() + n);
+        p95Us_.store(*p95);
+    }
+}
 
 StatusClient::StatusClient(std::shared_ptr<Channel> channel)
-    : stub_(StatusService::NewStub(channel)) {}
+    : stub_(StatusService::NewStub(channel)), service_(nullptr), hedging_(true) {}
+
+StatusClient::StatusClient(LoadBalancer::ServiceHandle service, std::shared_ptr<StatusChannelPool> channels)
+    : service_(service), channels_(std::move(channels)), hedging_(true) {}
+
+// 选择本次调用的实例：负载均衡模式下按键或按 P2C 选择，再从该实例的共享连接中取在途最少的一条
+StatusClient::Route StatusClient::route(int64_t affinity, const std::shared_ptr<ServiceInstance>& avoid) {
+    Route target{stub_.get(), nullptr, StatusChannelPool::Lease(), nullptr};
+    if (!service_) {
+        return target;
+    }
+
+    LoadBalancer& balancer = LoadBalancer::getInstance();
+    target.instance = affinity >= 0
+        ? balancer.getInstanceForKey(service_, static_cast<uint64_t>(affinity), avoid)
+        : balancer.getNextHealthyInstance(service_, LoadBalanceAlgorithm::PowerOfTwoChoices);
+    if (!target.instance) {
+        target.stub = nullptr;
+        target.error = "No healthy StatusServer instance available";
+        return target;
+    }
+
+    target.lease = channels_->acquire(target.instance->host + ":" + std::to_string(target.instance->port));
+    target.stub = target.lease.stub();
+    if (!target.stub) {
+        target.error = "StatusServer connections are saturated";
+    }
+    return target;
+}
+
+// 实例不可用或过载：请求没有被处理，换一个实例可能成功
+bool StatusClient::retryable(const Status& status) {
+    return status.error_code() == grpc::StatusCode::UNAVAILABLE ||
+           status.error_code() == grpc::StatusCode::RESOURCE_EXHAUSTED;
+}
+
+// 健康状态变化时实例对象会被替换，按地址判断是否同一个实例
+bool StatusClient::sameInstance(const std::shared_ptr<ServiceInstance>& a, const std::shared_ptr<ServiceInstance>& b) {
+    return a && b && a->host == b->host && a->port == b->port;
+}
+
+template <typename Rpc>
+Status StatusClient::invoke(const CallPolicy& policy, Rpc rpc) {
+    auto deadline = std::chrono::system_clock::now() + policy.deadline;
+    RetryBudget& budget = RetryBudget::getInstance();
+    std::shared_ptr<ServiceInstance> previous;
+    Status status;
+
+    for (int attempt = 1; attempt <= MAX_ATTEMPTS; ++attempt) {
+        // 重试时避开刚失败的实例：按键路由的调用改发该键排名下一位的实例，
+        // 其余调用重新按 P2C 选择
+        Route target = route(policy.affinity, previous);
+        for (int i = 0; policy.affinity < 0 && i < MAX_REPICKS && sameInstance(target.instance, previous); ++i) {
+            target = route();
+        }
+        if (!target.stub) {
+            return attempt == 1 ? Status(grpc::StatusCode::UNAVAILABLE, target.error) : status;
+        }
+
+        ClientContext context;
+        context.set_deadline(deadline);
+        {
+            // 在途请求数和耗时回报给负载均衡器
+            InstanceCall call(target.instance);
+            status = rpc(target.stub, &context);
+            if (!status.ok()) {
+                call.fail();
+            }
+        }
+
+        if (status.ok()) {
+            budget.recordSuccess();
+            return status;
+        }
+        if (!retryable(status)) {
+            return status;
+        }
+        budget.recordFailure();
+        if (!policy.idempotent || attempt == MAX_ATTEMPTS ||
+            std::chrono::system_clock::now() >= deadline || !budget.allowRetry()) {
+            return status;
+        }
+        LOG_DEBUG("Retrying StatusServer call after error: {}", status.error_message());
+        previous = target.instance;
+    }
+    return status;
+}
+
+template <typename Request, typename Response, typename AsyncRpc>
+Status StatusClient::invokeHedged(const CallPolicy& policy, LatencyTracker& latency,
+                                  const Request& request, Response* response, AsyncRpc rpc) {
+    // 一次尝试，先返回的尝试胜出，其余被取消；回调可能晚于本函数返回，所需状态都由 shared_ptr 持有
+    struct Attempt {
+        ClientContext context;
+        Response response;
+        std::shared_ptr<ServiceInstance> instance;
+        StatusChannelPool::Lease lease;
+        std::unique_ptr<InstanceCall> call;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point end;
+        bool done = false;
+    };
+    struct State {
+        Request request;                   // 异步调用期间请求必须存活
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::vector<std::unique_ptr<Attempt>> attempts;
+        int pending = 0;
+        Attempt* winner = nullptr;
+        Status lastError;
+    };
+
+    auto state = std::make_shared<State>();
+    state->request = request;
+    auto deadline = std::chrono::system_clock::now() + policy.deadline;
+    RetryBudget& budget = RetryBudget::getInstance();
+
+    // 发出一次尝试；avoid 非空时尽量避开该实例，requireOther 时选不到其他实例就放弃
+    // 首次尝试按策略的路由键选择实例，对冲和重试的目的就是换一个实例，按 P2C 选择
+    auto launch = [&](const std::shared_ptr<ServiceInstance>& avoid, bool requireOther, int64_t affinity) -> Status {
+        Route target = route(affinity);
+        for (int i = 0; i < MAX_REPICKS && sameInstance(target.instance, avoid); ++i) {
+            target = route();
+        }
+        if (!target.stub) {
+            return Status(grpc::StatusCode::UNAVAILABLE, target.error);
+        }
+        if (requireOther && (!target.instance || sameInstance(target.instance, avoid))) {
+            return Status(grpc::StatusCode::UNAVAILABLE, "No other StatusServer instance available");
+        }
+
+        auto owned = std::make_unique<Attempt>();
+        Attempt* attempt = owned.get();
+        attempt->context.set_deadline(deadline);
+        attempt->instance = target.instance;
+        attempt->lease = std::move(target.lease);
+        attempt->call = std::make_unique<InstanceCall>(target.instance);
+        attempt->start = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->attempts.push_back(std::move(owned));
+            ++state->pending;
+        }
+
+        rpc(target.stub, &attempt->context, &state->request, &attempt->response, [state, attempt](Status status) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            attempt->end = std::chrono::steady_clock::now();
+            if (status.ok()) {
+                if (!state->winner) {
+                    state->winner = attempt;
+                }
+            } else {
+                if (state->winner && status.error_code() == grpc::StatusCode::CANCELLED) {
+                    // 被胜出的尝试取消，不代表实例有问题
+                    attempt->call->cancel();
+                } else {
+                    attempt->call->fail();
+                    if (retryable(status)) {
+                        RetryBudget::getInstance().recordFailure();
+                    }
+                }
+                state->lastError = status;
+            }
+            attempt->call.reset();
+            attempt->lease = StatusChannelPool::Lease();
+            attempt->done = true;
+            --state->pending;
+            state->finished.notify_all();
+        });
+        return Status::OK;
+    };
 
-bool StatusClient::UpdateUserStatus(int32_t user_id, status::UserStatus status, 
+    Status launched = launch(nullptr, false, policy.affinity);
+    if (!launched.ok()) {
+        return launched;
+    }
+    int attempts = 1;
+    bool hedged = !hedging_ || !service_;
+    auto delay = std::max(std::chrono::duration_cast<std::chrono::milliseconds>(latency.p95()), MIN_HEDGE_DELAY);
+    auto hedgeAt = std::chrono::steady_clock::now() + (latency.p95().count() > 0 ? delay : DEFAULT_HEDGE_DELAY);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (!state->winner) {
+        if (state->pending == 0) {
+            // 所有尝试都失败了：幂等调用在预算内换实例重试
+            if (!policy.idempotent || !retryable(state->lastError) || attempts >= MAX_ATTEMPTS ||
+                std::chrono::system_clock::now() >= deadline || !budget.allowRetry()) {
+                break;
+            }
+            LOG_DEBUG("Retrying StatusServer call after error: {}", state->lastError.error_message());
+            auto previous = state->attempts.back()->instance;
+            lock.unlock();
+            launched = launch(previous, false, NO_AFFINITY);
+            lock.lock();
+            if (!launched.ok()) {
+                break;
+            }
+            ++attempts;
+            continue;
+        }
+
+        if (!hedged && attempts < MAX_ATTEMPTS) {
+            if (state->finished.wait_until(lock, hedgeAt) != std::cv_status::timeout ||
+                state->winner || state->pending == 0) {
+                continue;
+            }
+            // 超过 p95 仍未返回：在预算内向另一个实例发出同样的请求
+            hedged = true;
+            if (budget.allowRetry()) {
+                auto slow = state->attempts.back()->instance;
+                lock.unlock();
+                launched = launch(slow, true, NO_AFFINITY);
+                lock.lock();
+                if (launched.ok()) {
+                    ++attempts;
+                }
+            }
+            continue;
+        }
+
+        // 截止时间由 gRPC 保证，超时的尝试会以 DEADLINE_EXCEEDED 结束
+        state->finished.wait(lock);
+    }
+
+    if (!state->winner) {
+        return state->lastError;
+    }
+
+    latency.record(state->winner->end - state->winner->start);
+    response->Swap(&state->winner->response);
+    budget.recordSuccess();
+
+    // 取消仍在进行的其他尝试，回调里只归还在途计数
+    std::vector<ClientContext*> losers;
+    for (auto& attempt : state->attempts) {
+        if (!attempt->done) {
+            losers.push_back(&attempt->context);
+        }
+    }
+    lock.unlock();
+    for (ClientContext* context : losers) {
+        context->TryCancel();
+    }
+    return Status::OK;
+}
+
+bool StatusClient::UpdateUserStatus(int32_t user_id, status::UserStatus status,
                                    const std::string& session_token, std::string& message) {
     UserStatusRequest request;
     UserStatusResponse response;
-    ClientContext context;
-    
+
     request.set_user_id(user_id);
     request.set_status(status);
     request.set_session_token(session_token);
-    
-    Status status_grpc = stub_->UpdateUserStatus(&context, request, &response);
-    
+
+    // 设置的是绝对状态，重复执行结果相同；按用户ID发往持有该用户状态的实例
+    Status status_grpc = invoke(CallPolicy{WRITE_DEADLINE, true, user_id}, [&](StatusService::Stub* stub, ClientContext* context) {
+        return stub->UpdateUserStatus(context, request, &response);
+    });
+
     if (!status_grpc.ok()) {
         message = "gRPC error: " + status_grpc.error_message();
         return false;
     }
-    
+
     message = response.message();
     return response.success();
 }
 
-bool StatusClient::GetUserStatus(int32_t user_id, status::UserStatus& status, 
+bool StatusClient::GetUserStatus(int32_t user_id, status::UserStatus& status,
                                 int64_t& last_seen, std::string& message) {
     GetUserStatusRequest request;
     GetUserStatusResponse response;
-    ClientContext context;
-    
+
     request.set_user_id(user_id);
-    
-    Status status_grpc = stub_->GetUserStatus(&context, request, &response);
-    
+
+    // 首次尝试发往持有该用户状态的实例，对冲请求由其他实例从 Redis 读取
+    Status status_grpc = invokeHedged(CallPolicy{READ_DEADLINE, true, user_id}, user_status_latency_, request, &response,
+        [](StatusService::Stub* stub, ClientContext* context, const GetUserStatusRequest* req,
+           GetUserStatusResponse* resp, std::function<void(Status)> done) {
+            stub->async()->GetUserStatus(context, req, resp, std::move(done));
+        });
+
     if (!status_grpc.ok()) {
         message = "gRPC error: " + status_grpc.error_message();
         return false;
     }
-    
+
     if (!response.success()) {
         message = response.message();
         return false;
     }
-    
+
     status = response.status();
     last_seen = response.last_seen();
     message = response.message();
     return true;
 }
 
-bool StatusClient::GetFriendsStatus(int32_t user_id, 
-                                   std::vector<status::FriendStatus>& friends_status, 
+bool StatusClient::GetFriendsStatus(int32_t user_id,
+                                   std::vector<status::FriendStatus>& friends_status,
                                    std::string& message) {
     GetFriendsStatusRequest request;
     GetFriendsStatusResponse response;
-    ClientContext context;
-    
+
     request.set_user_id(user_id);
-    
-    Status status_grpc = stub_->GetFriendsStatus(&context, request, &response);
-    
+
+    Status status_grpc = invokeHedged(CallPolicy{FRIENDS_DEADLINE, true}, friends_status_latency_, request, &response,
+        [](StatusService::Stub* stub, ClientContext* context, const GetFriendsStatusRequest* req,
+           GetFriendsStatusResponse* resp, std::function<void(Status)> done) {
+            stub->async()->GetFriendsStatus(context, req, resp, std::move(done));
+        });
+
     if (!status_grpc.ok()) {
         message = "gRPC error: " + status_grpc.error_message();
         return false;
     }
-    
+
     if (!response.success()) {
         message = response.message();
         return false;
     }
-    
+
     // 复制好友状态信息
     for (const auto& friend_status : response.friends()) {
         friends_status.push_back(friend_status);
     }
-    
+
     message = response.message();
     return true;
 }
@@ -84,18 +388,20 @@ bool StatusClient::GetFriendsStatus(int32_t user_id,
 bool StatusClient::AddFriend(int32_t user_id, int32_t friend_id, std::string& message) {
     AddFriendRequest request;
     AddFriendResponse response;
-    ClientContext context;
-    
+
     request.set_user_id(user_id);
     request.set_friend_id(friend_id);
-    
-    Status status_grpc = stub_->AddFriend(&context, request, &response);
-    
+
+    // 重复执行会得到"已是好友"的错误，不重试
+    Status status_grpc = invoke(CallPolicy{WRITE_DEADLINE, false}, [&](StatusService::Stub* stub, ClientContext* context) {
+        return stub->AddFriend(context, request, &response);
+    });
+
     if (!status_grpc.ok()) {
         message = "gRPC error: " + status_grpc.error_message();
         return false;
     }
-    
+
     message = response.message();
     return response.success();
 }
@@ -103,27 +409,28 @@ bool StatusClient::AddFriend(int32_t user_id, int32_t friend_id, std::string& me
 bool StatusClient::GetFriendsList(int32_t user_id, std::vector<status::FriendInfo>& friends, std::string& message) {
     GetFriendsListRequest request;
     GetFriendsListResponse response;
-    ClientContext context;
-    
+
     request.set_user_id(user_id);
-    
-    Status status_grpc = stub_->GetFriendsList(&context, request, &response);
-    
+
+    Status status_grpc = invoke(CallPolicy{FRIENDS_DEADLINE, true}, [&](StatusService::Stub* stub, ClientContext* context) {
+        return stub->GetFriendsList(context, request, &response);
+    });
+
     if (!status_grpc.ok()) {
         message = "gRPC error: " + status_grpc.error_message();
         return false;
     }
-    
+
     if (!response.success()) {
         message = response.message();
         return false;
     }
-    
+
     // 复制好友信息
     for (const auto& friend_info : response.friends()) {
         friends.push_back(friend_info);
     }
-    
+
     message = response.message();
     return true;
-}
\ No newline at end of file
+}
@@ -1,11 +1,17 @@
 #ifndef STATUS_CLIENT_H
 #define STATUS_CLIENT_H
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <grpcpp/grpcpp.h>
 #include "../generated/status.grpc.pb.h"
+#include "../utils/load_balancer.h"
+#include "status_channel_pool.h"
 
 using status::StatusService;
 using status::UserStatusRequest;
@@ -23,10 +29,42 @@ using grpc::Channel;
 using grpc::ClientContext;
 using grpc::Status;
 
+// 全局重试预算，所有 StatusClient 共享，规则与 gRPC 的 retryThrottling 相同：
+// 令牌初始为上限，每次可重试的失败扣一个令牌，每次成功的调用加回 0.1 个；
+// 令牌不超过上限的一半时停止重试和对冲，后端整体故障时重试流量不会把故障放大
+class RetryBudget {
+public:
+    static RetryBudget& getInstance();
+
+    // 是否还允许重试或对冲
+    bool allowRetry() const;
+
+    void recordSuccess();
+    void recordFailure();
+
+private:
+    RetryBudget();
+
+    std::atomic<int> milliTokens_;          // 令牌数 * 1000
+
+    static constexpr int MAX_MILLI_TOKENS = 100 * 1000;
+    static constexpr int SUCCESS_MILLI_TOKENS = 100;
+    static constexpr int FAILURE_MILLI_TOKENS = 1000;
+};
+
+// 每个调用有截止时间（含重试和对冲），后端卡住时调用方最多等到截止时间。
+// 幂等的调用在 UNAVAILABLE/RESOURCE_EXHAUSTED 时换实例重试，受全局重试预算限制；
+// 读请求在最近的 p95 延迟后仍未返回时向另一个实例发出对冲请求，取先到的结果，另一个被取消。
+// 用户状态的读写按用户ID固定发往同一个实例（该实例的内存状态表是这个用户的权威状态）
 class StatusClient {
 public:
+    // 固定连接到一个地址
     StatusClient(std::shared_ptr<Channel> channel);
     
+    // 每次调用经负载均衡器选择实例，并回报在途请求数和延迟；可被多个会话共享
+    // 调用走 channels 中该实例的共享连接，不自行建连
+    StatusClient(LoadBalancer::ServiceHandle service, std::shared_ptr<StatusChannelPool> channels);
+    
     // 更新用户状态
     bool UpdateUserStatus(int32_t user_id, status::UserStatus status, 
                          const std::string& session_token, std::string& message);
@@ -45,9 +83,84 @@ public:
     
     // 获取好友列表
     bool GetFriendsList(int32_t user_id, std::vector<status::FriendInfo>& friends, std::string& message);
+    
+    // 是否对读请求发出对冲请求（默认开启）
+    void setHedging(bool enabled) { hedging_ = enabled; }
 
 private:
-    std::unique_ptr<StatusService::Stub> stub_;
+    // 一个 RPC 的调用策略
+    struct CallPolicy {
+        std::chrono::milliseconds deadline;    // 整个调用（含重试和对冲）的截止时间
+        bool idempotent;                        // 重复执行没有副作用，失败后可以重试
+        int64_t affinity = NO_AFFINITY;         // 路由键：非负时首次尝试按键固定选择实例
+    };
+    
+    // 最近若干次调用延迟的 p95，作为对冲前的等待时间
+    class LatencyTracker {
+    public:
+        void record(std::chrono::steady_clock::duration latency);
+        
+        // 样本不足时返回 0
+        std::chrono::microseconds p95() const { return std::chrono::microseconds(p95Us_.load()); }
+        
+    private:
+        static constexpr size_t WINDOW = 512;
+        static constexpr size_t MIN_SAMPLES = 50;
+        static constexpr size_t RECOMPUTE_EVERY = 16;
+        
+        std::mutex mutex_;
+        std::array<int64_t, WINDOW> samples_{};
+        size_t count_ = 0;
+        std::atomic<int64_t> p95Us_{0};
+    };
+    
+    // 同步调用，可重试的失败在截止时间和重试预算内换实例重试
+    // rpc(stub, context) 发出一次调用
+    template <typename Rpc>
+    Status invoke(const CallPolicy& policy, Rpc rpc);
+    
+    // 异步发出调用，超过 p95 延迟仍未返回时向另一个实例对冲，失败时与 invoke 一样重试
+    // rpc(stub, context, request, response, callback) 发出一次异步调用
+    template <typename Request, typename Response, typename AsyncRpc>
+    Status invokeHedged(const CallPolicy& policy, LatencyTracker& latency,
+                        const Request& request, Response* response, AsyncRpc rpc);
+    
+    static bool retryable(const Status& status);
+    static bool sameInstance(const std::shared_ptr<ServiceInstance>& a, const std::shared_ptr<ServiceInstance>& b);
+    
+
+    // 一次调用使用的存根和对应的实例，lease 在调用结束前占用通道的在途名额
+    struct Route {
+        StatusService::Stub* stub;
+        std::shared_ptr<ServiceInstance> instance;
+        StatusChannelPool::Lease lease;
+        const char* error;                         // stub 为空时的原因
+    };
+    
+    // affinity 非负时按键选择实例（跳过 avoid，即排名下一位的实例），否则按 P2C 选择
+    Route route(int64_t affinity = NO_AFFINITY, const std::shared_ptr<ServiceInstance>& avoid = nullptr);
+    
+    std::unique_ptr<StatusService::Stub> stub_;    // 固定地址模式的存根
+    LoadBalancer::ServiceHandle service_;          // 负载均衡模式的服务句柄
+    std::shared_ptr<StatusChannelPool> channels_;  // 负载均衡模式下各实例的共享连接
+    
+    std::atomic<bool> hedging_;
+    LatencyTracker user_status_latency_;
+    LatencyTracker friends_status_latency_;
+    
+    // 不按键路由
+    static constexpr int64_t NO_AFFINITY = -1;
+    // 各 RPC 的截止时间
+    static constexpr std::chrono::milliseconds READ_DEADLINE{1000};
+    static constexpr std::chrono::milliseconds FRIENDS_DEADLINE{1500};
+    static constexpr std::chrono::milliseconds WRITE_DEADLINE{2000};
+    // 一次调用最多的尝试次数（首次 + 重试 + 对冲）
+    static constexpr int MAX_ATTEMPTS = 3;
+    // 对冲或重试时为避开上一个实例最多重新选择的次数
+    static constexpr int MAX_REPICKS = 3;
+    // 延迟样本不足时的对冲等待时间，以及等待时间的下限
+    static constexpr std::chrono::milliseconds DEFAULT_HEDGE_DELAY{100};
+    static constexpr std::chrono::milliseconds MIN_HEDGE_DELAY{5};
 };
 
 #endif // STATUS_CLIENT_H
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "status_client_manager.h"
+#include <algorithm>
 #include <iostream>
 #include <grpcpp/grpcpp.h>
 #include "../utils/load_balancer.h"  // 添加这一行以包含LoadBalancer
@@ -16,12 +17,16 @@ StatusClientManager::StatusClientManager()
 
 // 析构函数
 StatusClientManager::~StatusClientManager() {
+    if (health_watcher_) {
+        health_watcher_->stop();
+    }
     std::lock_guard<std::mutex> lock(pool_mutex_);
-    client_pool_.clear();
+    client_.reset();
+    fallback_client_.reset();
 }
 
 // 初始化管理器
-void StatusClientManager::initialize(size_t pool_size, const std::string& serviceName) {
+void StatusClientManager::initialize(size_t pool_size, const std::string& serviceName, int max_in_flight) {
     if (initialized_) {
         return; // 已经初始化过了
     }
@@ -29,67 +34,53 @@ void StatusClientManager::initialize(size_t pool_size, const std::string& servic
     service_name_ = serviceName;  // 保存服务名称
     std::lock_guard<std::mutex> lock(pool_mutex_);
     
-    // 使用负载均衡器获取服务实例
-    auto& loadBalancer = LoadBalancer::getInstance();
-    
-    // 创建指定数量的StatusClient实例
-    for (size_t i = 0; i < pool_size; ++i) {
-        // 通过负载均衡器获取服务实例
-        auto instance = loadBalancer.getNextHealthyInstance(serviceName);
-        if (instance) {
-            std::string address = instance->host + ":" + std::to_string(instance->port);
-            auto channel = grpc::CreateChannel(address, grpc::InsecureChannelCredentials());
-            auto client = std::make_shared<StatusClient>(channel);
-            client_pool_.push_back(client);
-        }
+    // 每个实例 pool_size 条连接，启动时建好，第一批请求不必等待建连
+    channels_ = std::make_shared<StatusChannelPool>(pool_size, max_in_flight);
+    std::vector<std::string> addresses;
+    for (const auto& instance : LoadBalancer::getInstance().getServiceInstances(serviceName)) {
+        addresses.push_back(instance->host + ":" + std::to_string(instance->port));
     }
+    channels_->warmUp(addresses, WARM_UP_TIMEOUT);
+    
+    auto service = LoadBalancer::getInstance().getServiceHandle(serviceName);
+    client_ = std::make_shared<StatusClient>(service, channels_);
+    
+    // 实例的健康状态由 Watch 流推送，变化在毫秒级生效；Watch 流与业务调用走同一组连接
+    health_watcher_ = std::make_unique<HealthWatcher>(serviceName, StatusService::service_full_name(), channels_);
+    health_watcher_->start();
     
     initialized_ = true;
-    std::cout << "StatusClientManager initialized with pool size: " << pool_size << std::endl;
+    std::cout << "StatusClientManager initialized with " << pool_size << " channels per instance" << std::endl;
 }
 
 // 获取一个StatusClient实例
 std::shared_ptr<StatusClient> StatusClientManager::acquireClient() {
-    if (!initialized_) {
-        // 如果未初始化，创建一个临时实例
-        auto channel = grpc::CreateChannel(server_address_, grpc::InsecureChannelCredentials());
-        return std::make_shared<StatusClient>(channel);
-    }
-    
     std::lock_guard<std::mutex> lock(pool_mutex_);
-    
-    if (!client_pool_.empty()) {
-        // 从池中取出一个实例
-        auto client = client_pool_.back();
-        client_pool_.pop_back();
-        return client;
-    } else {
-        // 如果池为空，尝试通过负载均衡器创建新实例
-        auto& loadBalancer = LoadBalancer::getInstance();
-        auto instance = loadBalancer.getNextHealthyInstance(service_name_);
-        if (instance) {
-            std::string address = instance->host + ":" + std::to_string(instance->port);
-            auto channel = grpc::CreateChannel(address, grpc::InsecureChannelCredentials());
-            return std::make_shared<StatusClient>(channel);
-        } else {
-            // 如果无法通过负载均衡器获取实例，使用默认地址
+    if (!initialized_) {
+        // 如果未初始化，所有会话共用一个连接到备用地址的实例
+        if (!fallback_client_) {
             auto channel = grpc::CreateChannel(server_address_, grpc::InsecureChannelCredentials());
-            return std::make_shared<StatusClient>(channel);
+            fallback_client_ = std::make_shared<StatusClient>(channel);
         }
+        return fallback_client_;
     }
+    
+    // 客户端由所有会话共享
+    return client_;
 }
 
 // 归还StatusClient实例到池中
 void StatusClientManager::releaseClient(std::shared_ptr<StatusClient> client) {
-    if (!client) {
-        return; // 客户端为空，直接返回
-    }
-    
-    if (!initialized_) {
-        // 未初始化，不需要归还到池中
-        return;
-    }
-    
+    // 池中的客户端是共享的，没有被取出，无需归还
+    (void)client;
+}
+
+
+// 各连接的运行指标
+std::vector<StatusChannelPool::ChannelStats> StatusClientManager::channelStats() const {
     std::lock_guard<std::mutex> lock(pool_mutex_);
-    client_pool_.push_back(client);
-}
\ No newline at end of file
+    if (!channels_) {
+        return {};
+    }
+    return channels_->stats();
+}
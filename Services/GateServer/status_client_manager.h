@@ -1,31 +1,39 @@
 #ifndef STATUS_CLIENT_MANAGER_H
 #define STATUS_CLIENT_MANAGER_H
 
+#include <chrono>
 #include <memory>
 #include <vector>
 #include <mutex>
 #include <string>
 #include "status_client.h"
+#include "status_channel_pool.h"
+#include "health_watcher.h"
 #include "../utils/load_balancer.h"  // 添加这一行以包含LoadBalancer
 
 // StatusClient单例管理器
-// 用于创建和管理全局共享的StatusClient实例池
+// 所有会话共享同一个StatusClient，每次调用经负载均衡器选择实例，
+// 再复用该实例预先建立的少量连接（HTTP/2 多路复用），会话数增长不会带来新的连接
 class StatusClientManager {
 public:
     // 获取单例实例
     static StatusClientManager& getInstance();
     
-    // 初始化管理器，创建指定数量的StatusClient实例
-    void initialize(size_t pool_size = 4, const std::string& serviceName = "StatusServer");  // 修改参数名为serviceName
+    // 初始化管理器，为每个实例预先建立 pool_size 条连接，每条连接最多 max_in_flight 个在途调用
+    void initialize(size_t pool_size = 4, const std::string& serviceName = "StatusServer",
+                    int max_in_flight = 100);
     
-    // 获取一个StatusClient实例（从池中获取）
+    // 获取共享的StatusClient实例（不独占）；未初始化时返回连接到备用地址的共享实例
     std::shared_ptr<StatusClient> acquireClient();
     
-    // 归还StatusClient实例到池中
+    // 归还StatusClient实例（共享客户端无需归还，保留以兼容调用方）
     void releaseClient(std::shared_ptr<StatusClient> client);
     
     // 检查管理器是否已初始化
     bool isInitialized() const { return initialized_; }
+    
+    // 各连接的在途调用数、调用数和拒绝数
+    std::vector<StatusChannelPool::ChannelStats> channelStats() const;
 
 private:
     StatusClientManager();
@@ -44,11 +52,23 @@ private:
     // 服务名称（用于负载均衡）
     std::string service_name_;  // 添加这一行
     
-    // 状态客户端池
-    std::vector<std::shared_ptr<StatusClient>> client_pool_;
+    // 各实例的共享连接
+    std::shared_ptr<StatusChannelPool> channels_;
+    
+    // 所有会话共享的客户端
+    std::shared_ptr<StatusClient> client_;
+    
+    // 未初始化时使用的备用客户端，首次使用时创建
+    std::shared_ptr<StatusClient> fallback_client_;
+    
+    // 订阅各实例的健康状态，不健康的实例不再被客户端选中
+    std::unique_ptr<HealthWatcher> health_watcher_;
     
     // 用于线程安全的互斥锁
     mutable std::mutex pool_mutex_;
+    
+    // 启动时等待连接就绪的最长时间
+    static constexpr std::chrono::milliseconds WARM_UP_TIMEOUT{3000};
 };
 
 #endif // STATUS_CLIENT_MANAGER_H
\ No newline at end of file
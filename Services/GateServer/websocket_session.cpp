@@ -8,32 +8,29 @@
 #include <memory>
 #include <ctime>
 #include <boost/json.hpp>
+#include "gateway_router.h"
+#include "../utils/user_search_index.h"
+
+namespace {
+
+// 用户搜索最多返回的条数
+const int SEARCH_RESULT_LIMIT = 20;
+
+} // namespace
 
 websocket_session::websocket_session(tcp::socket&& socket)
     : ws_(std::move(socket))
     , userId_("")
     , sessionId_("")
     , client_acquired_(false)
-    , redis_(RedisManager::getInstance())
     , db_(DatabaseManager::getInstance())
 {
     // 初始化心跳时间
     last_heartbeat_ = std::chrono::steady_clock::now();
     
-    // 从池中获取StatusClient实例
-    auto& manager = StatusClientManager::getInstance();
-    if (manager.isInitialized()) {
-        status_client_ = manager.acquireClient();
-        client_acquired_ = true;
-    } else {
-        // 如果管理器未初始化，创建临时实例
-        auto channel = grpc::CreateChannel("localhost:50051", grpc::InsecureChannelCredentials());
-        status_client_ = std::make_shared<StatusClient>(channel);
-        client_acquired_ = false;
-    }
-    
-    // 初始化Redis连接
-    redis_.initialize("localhost", 6379, 5);  // 5个连接的连接池
+    // 获取共享的StatusClient实例，管理器未初始化时也由它提供共享的备用实例，会话不自行建连
+    status_client_ = StatusClientManager::getInstance().acquireClient();
+    client_acquired_ = true;
 }
 
 
@@ -72,6 +69,9 @@ void websocket_session::do_accept(http::request<http::string_body>&& req, beast:
                 self->buffer_.commit(buffer2.size());
             }
 
+            // 登记用户所在网关，其他网关据此转发消息
+            GatewayRouter::getInstance().registerUser(self->userId_);
+            
             // 启动心跳机制
             self->start_heartbeat();
             
@@ -159,15 +159,11 @@ void websocket_session::handle_text_message(const std::string& message) {
                         if (db_.storeMessage(sender_id, receiver_id, content)) {
                             std::cout << "Message stored successfully from user " << sender_id << " to user " << receiver_id << std::endl;
                             
-                            // 转发消息给接收者（如果在线）
-                            auto receiver_session = WebSocketManager::getInstance().getSession(receiver_id_str);
-                            if (receiver_session) {
-                                // 构造转发消息
-                                std::string forward_message = "{\"type\":\"text_message\",\"sender_id\":\"" + userId_ + 
-                                                              "\",\"content\":\"" + content + "\",\"timestamp\":" + 
-                                                              std::to_string(std::time(nullptr)) + "}";
-                                receiver_session->send_message(forward_message);
-                            }
+                            // 转发消息给接收者（如果在线），接收者可能连接在其他网关上
+                            std::string forward_message = "{\"type\":\"text_message\",\"sender_id\":\"" + userId_ + 
+                                                          "\",\"content\":\"" + content + "\",\"timestamp\":" + 
+                                                          std::to_string(std::time(nullptr)) + "}";
+                            GatewayRouter::getInstance().deliver(receiver_id_str, forward_message);
                         } else {
                             std::cerr << "Failed to store message to database" << std::endl;
                         }
@@ -180,8 +176,11 @@ void websocket_session::handle_text_message(const std::string& message) {
                     std::string query = jv.as_object().at("query").as_string().c_str();
                     LOG_INFO("Processing search_user request with query: {}", query);
 
-                    // 调用 DatabaseManager
-                    auto users = db_.searchUsers(query);
+                    // 优先查内存索引（前缀、子串、拼音首字母、错字），索引尚未构建时回退到数据库前缀查询
+                    std::vector<std::pair<int, std::string>> users;
+                    if (!UserSearchIndex::getInstance().search(query, SEARCH_RESULT_LIMIT, users)) {
+                        users = db_.searchUsers(query, SEARCH_RESULT_LIMIT);
+                    }
 
                     // 构建JSON响应
                     boost::json::object response;
@@ -288,6 +287,7 @@ void websocket_session::fail(beast::error_code ec, char const* what)
             // 更新用户状态为离线
             updateUserStatus(status::OFFLINE);
             WebSocketManager::getInstance().removeSession(userId_);
+            GatewayRouter::getInstance().unregisterUser(userId_);
         }
         
         // 归还StatusClient到池中
@@ -306,6 +306,7 @@ void websocket_session::fail(beast::error_code ec, char const* what)
         // 更新用户状态为离线
         updateUserStatus(status::OFFLINE);
         WebSocketManager::getInstance().removeSession(userId_);
+        GatewayRouter::getInstance().unregisterUser(userId_);
     }
     
     // 归还StatusClient到池中
@@ -348,6 +349,9 @@ void websocket_session::start_heartbeat() {
             return;
         }
         
+        // 续期网关登记
+        GatewayRouter::getInstance().refreshUser(self->userId_);
+        
         // 发送心跳消息
         std::string heartbeat_msg = "{\"type\":\"heartbeat\",\"timestamp\":" + std::to_string(std::time(nullptr)) + "}";
         self->send_message(heartbeat_msg);
@@ -380,21 +384,7 @@ void websocket_session::updateUserStatus(status::UserStatus status) {
             std::cerr << "Failed to update user status for user ID " << userId_ << ": " << message << std::endl;
         } else {
             std::cout << "Successfully updated user status for user ID " << userId_ << " to " << status << std::endl;
-            
-            // 同时更新Redis缓存
-            std::string key = "user:status:" + userId_;
-            std::string status_str;
-            switch (status) {
-                case status::UserStatus::OFFLINE: status_str = "OFFLINE"; break;
-                case status::UserStatus::ONLINE: status_str = "ONLINE"; break;
-                case status::UserStatus::AWAY: status_str = "AWAY"; break;
-                case status::UserStatus::BUSY: status_str = "BUSY"; break;
-                default: status_str = "OFFLINE"; break;
-            }
-            
-            // 更新Redis中的用户状态
-            redis_.hset(key, "status", status_str);
-            redis_.hset(key, "last_updated", std::to_string(std::time(nullptr)));
+            // Redis 中的状态只由持有该用户的 StatusServer 同步写入
         }
     } catch (const std::exception& e) {
         std::cerr << "Exception while updating user status for user ID " << userId_ << ": " << e.what() << std::endl;
@@ -10,7 +10,6 @@
 #include <mutex>
 #include <chrono>
 #include "status_client.h"
-#include "../utils/redis_manager.h"
 #include "../utils/database_manager.h"  // 添加这一行
 
 namespace beast = boost::beast;         // from <boost/beast.hpp>
@@ -35,9 +34,6 @@ class websocket_session : public std::enable_shared_from_this<websocket_session>
     std::shared_ptr<StatusClient> status_client_;
     bool client_acquired_;
     
-    // Redis管理器引用
-    RedisManager& redis_;
-    
     // 数据库管理器引用
     DatabaseManager& db_;  // 添加这一行
 
@@ -51,6 +47,9 @@ public:
     // 发送消息
     void send_message(const std::string& message);
     
+    // 会话的执行器（接受连接时创建的 strand），会话的读写都在这个 strand 上进行
+    net::any_io_executor get_executor() { return ws_.get_executor(); }
+    
     // 获取共享指针
     std::shared_ptr<websocket_session> shared_this();
     
@@ -0,0 +1,38 @@
+#ifndef ARENA_MESSAGE_ALLOCATOR_H
+#define ARENA_MESSAGE_ALLOCATOR_H
+
+#include <cstddef>
+#include <google/protobuf/arena.h>
+#include <grpcpp/support/message_allocator.h>
+
+// 回调 API 的消息分配器：每个 RPC 的请求和响应分配在它独占的 protobuf arena 上
+// arena 的第一块内存与持有者一起分配，小消息整个 RPC 只有一次堆分配；
+// 响应中的重复字段（好友列表）也在 arena 上增长，RPC 结束时整体释放，不逐个析构
+template <typename Request, typename Response>
+class ArenaMessageAllocator : public grpc::MessageAllocator<Request, Response> {
+public:
+    grpc::MessageHolder<Request, Response>* AllocateMessages() override {
+        return new Holder();
+    }
+
+private:
+    // 单个用户的请求和响应都在 1KB 以内，好友列表超出后由 arena 追加内存块
+    static constexpr size_t INITIAL_BLOCK_SIZE = 1024;
+
+    class Holder : public grpc::MessageHolder<Request, Response> {
+    public:
+        Holder() : arena_(initialBlock_, sizeof(initialBlock_)) {
+            this->set_request(google::protobuf::Arena::CreateMessage<Request>(&arena_));
+            this->set_response(google::protobuf::Arena::CreateMessage<Response>(&arena_));
+        }
+
+        void Release() override { delete this; }
+
+    private:
+        // 初始块必须在 arena 之前构造
+        alignas(std::max_align_t) char initialBlock_[INITIAL_BLOCK_SIZE];
+        google::protobuf::Arena arena_;
+    };
+};
+
+#endif // ARENA_MESSAGE_ALLOCATOR_H
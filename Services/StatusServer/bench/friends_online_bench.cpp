@@ -0,0 +1,106 @@
+/*
+ * friends_online_bench - 好友在线求交的基准测试
+ * 测量 GetFriendsStatus(online_only) 的内存路径：好友 CSR 邻接数组与在线位图求交，
+ * 以及求交后逐个从 PresenceTable 读取在线好友状态（由本实例负责的好友不再访问 Redis）
+ * 由其他实例负责的好友仍需一次流水线读取 Redis，不在测量范围内
+ *
+ * 用法: friends_online_bench [好友数=1000] [ID范围=200000] [在线比例=0.5] [轮数=100000]
+ * 在线用户在 [1, ID范围] 内随机生成，好友ID从同一范围随机抽取并升序排列（与 CSR 邻接数组一致）
+ * 状态表的变更日志写在当前目录，结束时删除
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unistd.h>
+#include <vector>
+#include "../../utils/online_users.h"
+#include "../../utils/presence_table.h"
+
+int main(int argc, char* argv[]) {
+    size_t friends = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    uint32_t range = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 200000;
+    double onlineRatio = argc > 3 ? std::atof(argv[3]) : 0.5;
+    size_t rounds = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 100000;
+    if (friends == 0 || range == 0 || rounds == 0) {
+        std::fprintf(stderr, "usage: %s [friends] [id-range] [online-ratio] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<uint32_t> pick(1, range);
+    std::bernoulli_distribution online(onlineRatio);
+
+    OnlineBitmap bitmap;
+    for (uint32_t id = 1; id <= range; ++id) {
+        if (online(gen)) {
+            bitmap.add(id);
+        }
+    }
+
+    std::vector<int32_t> ids;
+    ids.reserve(friends);
+    while (ids.size() < friends) {
+        ids.push_back(static_cast<int32_t>(pick(gen)));
+        if (ids.size() == friends) {
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        }
+    }
+
+    // 预热，同时得到结果规模
+    std::vector<int32_t> out;
+    bitmap.intersect(ids.data(), ids.data() + ids.size(), out);
+    size_t matched = out.size();
+
+    auto start = std::chrono::steady_clock::now();
+    size_t checksum = 0;
+    for (size_t i = 0; i < rounds; ++i) {
+        bitmap.intersect(ids.data(), ids.data() + ids.size(), out);
+        checksum += out.size();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+    std::printf("online users: %zu in [1, %u], bitmap %zu bytes\n", bitmap.cardinality(), range, bitmap.bytes());
+    std::printf("friends: %zu, online friends: %zu\n", ids.size(), matched);
+    std::printf("intersect: %.3f us per call over %zu rounds (checksum %zu)\n",
+                elapsed.count() / 1000.0 / rounds, rounds, checksum);
+
+    // 在线好友都由本实例写入状态表，同步回调什么都不做
+    const char* logPath = "friends_online_bench.presence.log";
+    ::unlink(logPath);
+    PresenceTable& presence = PresenceTable::getInstance();
+    if (!presence.start(logPath, [](const std::vector<PresenceChange>&, uint64_t&) { return true; })) {
+        std::fprintf(stderr, "failed to open %s\n", logPath);
+        return 1;
+    }
+    for (int32_t id : out) {
+        presence.update(id, 1, "bench");
+    }
+
+    // 与 handleGetFriendsStatus 相同：求交后逐个读取状态，只使用可信的条目
+    size_t unverified = 0;
+    PresenceEntry entry;
+    start = std::chrono::steady_clock::now();
+    checksum = 0;
+    for (size_t i = 0; i < rounds; ++i) {
+        bitmap.intersect(ids.data(), ids.data() + ids.size(), out);
+        for (int32_t id : out) {
+            if (presence.get(id, entry) && entry.verified) {
+                checksum += entry.status;
+            } else {
+                ++unverified;
+            }
+        }
+    }
+    elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    presence.stop();
+    ::unlink(logPath);
+
+    // 运行时间超过状态表的可信窗口时条目会过期，实际服务中这些好友要先与 Redis 核对
+    std::printf("intersect + presence read: %.3f us per call over %zu rounds (checksum %zu, %zu unverified reads)\n",
+                elapsed.count() / 1000.0 / rounds, rounds, checksum, unverified);
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include "health_service_impl.h"
+#include <algorithm>
+#include "../utils/database_manager.h"
+#include "../utils/redis_manager.h"
+#include "../utils/logger.h"
+
+namespace {
+
+int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+HealthServiceImpl::HealthServiceImpl(const StatusServiceImpl& statusService, int maxConcurrentRequests,
+                                     bool redisRequired)
+    : statusService_(statusService), maxConcurrentRequests_(std::max(maxConcurrentRequests, 1)),
+      redisRequired_(redisRequired), probeOk_(false), probeStartedNs_(0),
+      serving_(false), saturated_(false), shuttingDown_(false), version_(0), running_(false) {}
+
+HealthServiceImpl::~HealthServiceImpl() {
+    stop();
+}
+
+void HealthServiceImpl::start() {
+    if (running_.exchange(true)) {
+        return;
+    }
+
+    probe();
+    evaluate();
+
+    probeThread_ = std::thread(&HealthServiceImpl::probeLoop, this);
+    monitorThread_ = std::thread(&HealthServiceImpl::monitorLoop, this);
+    LOG_INFO("Health service started");
+}
+
+void HealthServiceImpl::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+    }
+    stopCondition_.notify_all();
+
+    if (monitorThread_.joinable()) {
+        monitorThread_.join();
+    }
+    if (probeThread_.joinable()) {
+        probeThread_.join();
+    }
+}
+
+void HealthServiceImpl::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (shuttingDown_) {
+            return;
+        }
+        shuttingDown_ = true;
+        serving_ = false;
+        ++version_;
+    }
+    changed_.notify_all();
+    LOG_INFO("Health service entering shutdown, reporting NOT_SERVING");
+}
+
+Status HealthServiceImpl::Check(ServerContext* context, const HealthCheckRequest* request,
+                                HealthCheckResponse* response) {
+    (void)context;
+    std::lock_guard<std::mutex> lock(mutex_);
+    HealthCheckResponse::ServingStatus status = statusOf_impl(request->service());
+    if (status == HealthCheckResponse::SERVICE_UNKNOWN) {
+        return Status(grpc::StatusCode::NOT_FOUND, "unknown service");
+    }
+    response->set_status(status);
+    return Status::OK;
+}
+
+Status HealthServiceImpl::Watch(ServerContext* context, const HealthCheckRequest* request,
+                                ServerWriter<HealthCheckResponse>* writer) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool sent = false;
+    uint64_t sentVersion = 0;
+
+    while (!context->IsCancelled()) {
+        if (!sent || sentVersion != version_) {
+            HealthCheckResponse response;
+            response.set_status(statusOf_impl(request->service()));
+            sentVersion = version_;
+            sent = true;
+            bool closing = shuttingDown_;
+
+            lock.unlock();
+            if (!writer->Write(response)) {
+                return Status::OK;  // 客户端已断开
+            }
+            if (closing) {
+                return Status(grpc::StatusCode::UNAVAILABLE, "server is shutting down");
+            }
+            lock.lock();
+            continue;
+        }
+        changed_.wait_for(lock, WATCH_POLL_INTERVAL);
+    }
+    return Status::CANCELLED;
+}
+
+HealthCheckResponse::ServingStatus HealthServiceImpl::statusOf_impl(const std::string& service) const {
+    if (!service.empty() && service != StatusService::service_full_name()) {
+        return HealthCheckResponse::SERVICE_UNKNOWN;
+    }
+    return serving_ ? HealthCheckResponse::SERVING : HealthCheckResponse::NOT_SERVING;
+}
+
+void HealthServiceImpl::probe() {
+    probeStartedNs_.store(steadyNowNs());
+
+    bool ok;
+    {
+        // 和请求处理走同一把锁：请求被锁卡住时探测也会卡住，由监控线程按超时判定
+        DatabaseManager& db = DatabaseManager::getInstance();
+        std::lock_guard<std::mutex> lock(db.mutex());
+        ok = db.isConnected_impl() || db.connect_impl();
+    }
+    if (!ok) {
+        LOG_WARN("Health probe: database unavailable");
+    } else if (redisRequired_ && !RedisManager::getInstance().isConnected()) {
+        LOG_WARN("Health probe: Redis unavailable");
+        ok = false;
+    }
+
+    probeOk_.store(ok);
+    probeStartedNs_.store(0);
+}
+
+void HealthServiceImpl::probeLoop() {
+    while (sleepFor(PROBE_INTERVAL)) {
+        probe();
+    }
+}
+
+void HealthServiceImpl::evaluate() {
+    int64_t startedNs = probeStartedNs_.load();
+    bool stalled = startedNs != 0 &&
+        steadyNowNs() - startedNs > std::chrono::duration_cast<std::chrono::nanoseconds>(STALL_TIMEOUT).count();
+
+    int inFlight = statusService_.inFlightRequests();
+
+    bool changed = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (shuttingDown_) {
+            return;
+        }
+
+        if (!saturated_ && inFlight >= maxConcurrentRequests_ * SATURATED_RATIO) {
+            saturated_ = true;
+            LOG_WARN("Health: {} requests in flight, reporting saturated", inFlight);
+        } else if (saturated_ && inFlight < maxConcurrentRequests_ * RECOVERED_RATIO) {
+            saturated_ = false;
+            LOG_INFO("Health: load recovered ({} requests in flight)", inFlight);
+        }
+
+        bool serving = probeOk_.load() && !stalled && !saturated_;
+        if (serving != serving_) {
+            serving_ = serving;
+            ++version_;
+            changed = true;
+            if (serving) {
+                LOG_INFO("Health status changed to SERVING");
+            } else {
+                LOG_WARN("Health status changed to NOT_SERVING (probe {}, stalled {}, saturated {})",
+                         probeOk_.load() ? "ok" : "failed", stalled, saturated_);
+            }
+        }
+    }
+    if (changed) {
+        changed_.notify_all();
+    }
+}
+
+void HealthServiceImpl::monitorLoop() {
+    while (sleepFor(EVALUATE_INTERVAL)) {
+        evaluate();
+    }
+}
+
+bool HealthServiceImpl::sleepFor(std::chrono::milliseconds duration) {
+    std::unique_lock<std::mutex> lock(stopMutex_);
+    stopCondition_.wait_for(lock, duration, [this] { return !running_; });
+    return running_;
+}
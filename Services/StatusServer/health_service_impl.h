@@ -0,0 +1,97 @@
+#ifndef HEALTH_SERVICE_IMPL_H
+#define HEALTH_SERVICE_IMPL_H
+
+#include <grpcpp/grpcpp.h>
+#include "health.grpc.pb.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "status_service_impl.h"
+
+using grpc::ServerWriter;
+using grpc::health::v1::Health;
+using grpc::health::v1::HealthCheckRequest;
+using grpc::health::v1::HealthCheckResponse;
+
+// 标准 grpc.health.v1 健康检查服务
+// TCP 连接成功不代表服务可用：请求可能全部卡在数据库锁上。这里的状态综合了
+// 1. 探测线程定期在数据库锁下检查主库连接、检查 Redis 节点，探测本身卡住超过 STALL_TIMEOUT 也算失败
+// 2. 在途请求数达到上限的 90% 视为饱和，降到 70% 以下才恢复，让负载均衡器先把流量转给其他实例
+// 状态变化时立即推送给所有 Watch 流，客户端不必等到请求失败才把实例移出轮询
+class HealthServiceImpl final : public Health::Service {
+public:
+    // maxConcurrentRequests: 在途请求数的上限；redisRequired: Redis 不可用时是否视为不健康
+    HealthServiceImpl(const StatusServiceImpl& statusService, int maxConcurrentRequests, bool redisRequired);
+    ~HealthServiceImpl();
+
+    // 执行首次探测并启动后台线程
+    void start();
+
+    // 停止后台线程
+    void stop();
+
+    // 进入关闭流程：状态置为 NOT_SERVING 并结束所有 Watch 流，之后才能调用 Server::Shutdown
+    void shutdown();
+
+    // 查询一次健康状态，服务名为空表示整个服务器
+    Status Check(ServerContext* context, const HealthCheckRequest* request,
+                 HealthCheckResponse* response) override;
+
+    // 推送当前状态，之后每次变化推送一次，直到客户端取消或服务器关闭
+    Status Watch(ServerContext* context, const HealthCheckRequest* request,
+                 ServerWriter<HealthCheckResponse>* writer) override;
+
+private:
+    // 服务名对应的状态（调用者需持有 mutex_），未知服务返回 SERVICE_UNKNOWN
+    HealthCheckResponse::ServingStatus statusOf_impl(const std::string& service) const;
+
+    // 检查数据库和 Redis，结果写入 probeOk_
+    void probe();
+    void probeLoop();
+
+    // 综合探测结果和负载计算状态，变化时通知 Watch 流
+    void evaluate();
+    void monitorLoop();
+
+    bool sleepFor(std::chrono::milliseconds duration);
+
+    const StatusServiceImpl& statusService_;
+    int maxConcurrentRequests_;
+    bool redisRequired_;
+
+    // 探测线程写、监控线程读
+    std::atomic<bool> probeOk_;
+    std::atomic<int64_t> probeStartedNs_;    // 正在进行的探测的开始时间，0 表示没有进行中的探测
+
+    // 以下由 mutex_ 保护
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    bool serving_;
+    bool saturated_;
+    bool shuttingDown_;
+    uint64_t version_;                       // 每次状态变化加一
+
+    std::atomic<bool> running_;
+    std::thread probeThread_;
+    std::thread monitorThread_;
+    std::mutex stopMutex_;
+    std::condition_variable stopCondition_;
+
+    // 探测间隔
+    static constexpr std::chrono::milliseconds PROBE_INTERVAL{1000};
+    // 状态计算间隔，决定饱和和探测卡住能被多快发现
+    static constexpr std::chrono::milliseconds EVALUATE_INTERVAL{100};
+    // 一次探测超过这个时间没有结束视为数据库锁或连接被卡住
+    static constexpr std::chrono::milliseconds STALL_TIMEOUT{2000};
+    // Watch 流检查客户端是否已取消的间隔
+    static constexpr std::chrono::milliseconds WATCH_POLL_INTERVAL{1000};
+    // 饱和与恢复的在途请求比例
+    static constexpr double SATURATED_RATIO = 0.9;
+    static constexpr double RECOVERED_RATIO = 0.7;
+};
+
+#endif // HEALTH_SERVICE_IMPL_H
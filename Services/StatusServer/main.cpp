@@ -3,13 +3,23 @@
  * 负责维护用户在线状态、好友关系和群组信息
  */
 
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <thread>
+#include <cstdlib>
+#include <pthread.h>
 #include <grpcpp/grpcpp.h>
 #include "status_service_impl.h"
+#include "health_service_impl.h"
 #include "../utils/logger.h"
 #include "../utils/redis_manager.h"
+#include "../utils/presence_cache.h"
+#include "../utils/friend_graph.h"
+#include "../utils/online_users.h"
 
 std::string get_cmd_option(int argc, char* argv[], const std::string& option, const std::string& default_val) {
     std::string cmd;
@@ -23,44 +33,123 @@ std::string get_cmd_option(int argc, char* argv[], const std::string& option, co
     return default_val; // 未找到，返回默认值
 }
 
-void RunServer(const std::string& port) {
+// 触发优雅关闭的信号
+sigset_t shutdown_signals() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    return signals;
+}
+
+void RunServer(const std::string& port, int maxConcurrentRequests, size_t workerThreads, bool redisRequired,
+               const std::string& presenceLogPath) {
     std::string server_address("0.0.0.0:" + port);
     
-    StatusServiceImpl service;
+    // 回调 API：阻塞的数据库和 Redis 调用在 workerThreads 个工作线程上执行，不占用 gRPC 的线程
+    StatusServiceImpl service(workerThreads, maxConcurrentRequests, presenceLogPath);
+    
+    // grpc.health.v1：状态反映数据库/Redis 可用性和请求饱和度，网关通过 Watch 订阅
+    HealthServiceImpl health(service, maxConcurrentRequests, redisRequired);
+    health.start();
     
     grpc::ServerBuilder builder;
     builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
+    // 网关的长连接空闲时每 30 秒发一次 keepalive ping，默认策略会把它当作滥用而断开连接
+    builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+    builder.AddChannelArgument(GRPC_ARG_HTTP2_MIN_RECV_PING_INTERVAL_WITHOUT_DATA_MS, 10000);
+    // 单条连接上的并发流不超过在途上限，超出的由 HTTP/2 流控挡在客户端
+    builder.AddChannelArgument(GRPC_ARG_MAX_CONCURRENT_STREAMS, maxConcurrentRequests);
+    // 只有健康检查服务仍是同步实现（每个 Watch 流占一个线程），同步部分只需一个完成队列和少量轮询线程
+    builder.SetSyncServerOption(grpc::ServerBuilder::SyncServerOption::NUM_CQS, 1);
+    builder.SetSyncServerOption(grpc::ServerBuilder::SyncServerOption::MIN_POLLERS, 1);
+    builder.SetSyncServerOption(grpc::ServerBuilder::SyncServerOption::MAX_POLLERS, 2);
     builder.RegisterService(&service);
+    builder.RegisterService(&health);
     
     std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
+    if (!server) {
+        LOG_ERROR("Failed to start StatusServer on {}", server_address);
+        health.stop();
+        service.stop();
+        return;
+    }
     
     // 确保日志输出的是实际监听的端口
     LOG_INFO("StatusServer listening on {}", server_address);
     
+    // 关闭信号在 main 中已对所有线程屏蔽，由这个线程同步等待：
+    // 先让健康检查报告 NOT_SERVING 并结束 Watch 流（否则 Shutdown 会一直等这些流），再关闭服务器，
+    // 在途请求最多等待 5 秒
+    std::thread signal_thread([&server, &health] {
+        sigset_t signals = shutdown_signals();
+        int signal = 0;
+        sigwait(&signals, &signal);
+        LOG_INFO("Received signal {}, shutting down gracefully...", signal);
+        health.shutdown();
+        server->Shutdown(std::chrono::system_clock::now() + std::chrono::seconds(5));
+    });
+    
     // 等待服务器关闭
     server->Wait();
+    signal_thread.join();
+    
+    health.stop();
+    service.stop();
 }
 
 int main(int argc, char* argv[]) {
     try {
+        // 在创建任何线程之前屏蔽关闭信号，之后创建的线程继承该屏蔽字，信号只由 RunServer 的等待线程接收
+        sigset_t signals = shutdown_signals();
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        
         LOG_INFO("Starting StatusServer...");
 
         // 解析 "--port=" 参数
         // 如果在命令行中找不到 "--port="，则默认为 "50051"
         std::string port = get_cmd_option(argc, argv, "--port=", "50051");
         
+        // 在途请求（含排队）的上限，超过时直接拒绝；达到 90% 时健康检查报告饱和
+        int maxConcurrentRequests = std::atoi(get_cmd_option(argc, argv, "--max-requests=", "256").c_str());
+        
+        // 执行数据库和 Redis 调用的工作线程数
+        int workerThreads = std::atoi(get_cmd_option(argc, argv, "--workers=", "16").c_str());
+        
+        // 内存状态表的变更日志，"--presence-log=" 留空时不启用状态表
+        // 默认路径带端口号，同一台机器上的多个实例互不干扰
+        std::string presenceLogPath = get_cmd_option(argc, argv, "--presence-log=", "presence_" + port + ".log");
+        
         // 初始化Redis连接
+        // REDIS_NODES 为逗号分隔的 host:port 列表，键按槽位分布到各节点；
+        // 设置 REDIS_CLUSTER=1 时按 Redis Cluster 协议路由
+        const char* redisNodes = std::getenv("REDIS_NODES");
+        const char* redisCluster = std::getenv("REDIS_CLUSTER");
         RedisManager& redis = RedisManager::getInstance();
-        if (!redis.initialize("localhost", 6379, 10)) {
+        bool redisConnected = false;
+        if (!redis.initialize(parseRedisNodes(redisNodes ? redisNodes : "localhost:6379"), 10,
+                              redisCluster && std::string(redisCluster) == "1")) {
             LOG_WARN("Failed to connect to Redis, continuing without Redis support");
         } else {
             LOG_INFO("Redis connected successfully");
+            redisConnected = true;
+            
+            // 用户状态的进程内缓存，依赖 Redis 6 的 CLIENT TRACKING 失效
+            PresenceCache::getInstance().start();
+            
+            // users:online 的本地位图，用于好友在线求交
+            OnlineUsers::getInstance().start();
         }
         
         // 运行gRPC服务器并传入解析到的端口
-        RunServer(port);
+        RunServer(port, maxConcurrentRequests, static_cast<size_t>(std::max(workerThreads, 1)), redisConnected,
+                  presenceLogPath);
+        
+        FriendGraph::getInstance().stop();
         
         // 断开Redis连接
+        OnlineUsers::getInstance().stop();
+        PresenceCache::getInstance().stop();
         redis.disconnect();
         
         LOG_INFO("StatusServer stopped");
@@ -3,11 +3,73 @@
 #include <chrono>
 #include <algorithm>
 #include <mysql/mysql.h>
+#include <boost/asio/post.hpp>
 #include "../utils/database_manager.h"
 #include "../utils/redis_manager.h"
+#include "../utils/presence_cache.h"
+#include "../utils/friend_graph.h"
+#include "../utils/online_users.h"
+#include "../utils/user_profile_cache.h"
+#include "../utils/user_status_flusher.h"
 #include "../utils/logger.h"
 
-StatusServiceImpl::StatusServiceImpl() : db_(DatabaseManager::getInstance()), redis_(RedisManager::getInstance()) {
+namespace {
+
+// 状态字符串与枚举互转（与缓存和 user_status 表中的取值一致）
+const char* userStatusToString(status::UserStatus status) {
+    switch (status) {
+        case status::UserStatus::ONLINE: return "ONLINE";
+        case status::UserStatus::AWAY: return "AWAY";
+        case status::UserStatus::BUSY: return "BUSY";
+        default: return "OFFLINE";
+    }
+}
+
+status::UserStatus parseUserStatus(const std::string& status_str) {
+    if (status_str == "ONLINE") {
+        return status::UserStatus::ONLINE;
+    } else if (status_str == "AWAY") {
+        return status::UserStatus::AWAY;
+    } else if (status_str == "BUSY") {
+        return status::UserStatus::BUSY;
+    }
+    return status::UserStatus::OFFLINE;
+}
+
+// 状态哈希中的 last_updated（秒）换算为毫秒，没有该字段或无法解析时返回false，last_updated_ms 保持不变
+bool parseLastUpdated(const std::unordered_map<std::string, std::string>& hash, int64_t& last_updated_ms) {
+    auto updated_it = hash.find("last_updated");
+    if (updated_it == hash.end()) {
+        return false;
+    }
+    try {
+        last_updated_ms = std::stoll(updated_it->second) * 1000;
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// 原子更新用户状态哈希并维护在线用户集合
+// KEYS[1] = user:status:<id>, KEYS[2] = users:online
+// ARGV = status, session_token, last_updated, user_id, only_if_newer
+// only_if_newer 为 '1' 时哈希中已有更新的 last_updated 则不写入（返回 0）
+const char* const PRESENCE_SCRIPT_NAME = "presence_update";
+const char* const PRESENCE_SCRIPT =
+    "if ARGV[5] == '1' then "
+    "local current = redis.call('HGET', KEYS[1], 'last_updated') "
+    "if current and tonumber(current) > tonumber(ARGV[3]) then return 0 end end "
+    "redis.call('HSET', KEYS[1], 'status', ARGV[1], 'session_token', ARGV[2], 'last_updated', ARGV[3]) "
+    "if ARGV[1] == 'OFFLINE' then redis.call('SREM', KEYS[2], ARGV[4]) "
+    "else redis.call('SADD', KEYS[2], ARGV[4]) end "
+    "return 1";
+
+} // namespace
+
+StatusServiceImpl::StatusServiceImpl(size_t workerThreads, int maxConcurrentRequests,
+                                     const std::string& presenceLogPath)
+    : db_(DatabaseManager::getInstance()), redis_(RedisManager::getInstance()), inFlight_(0),
+      maxConcurrentRequests_(std::max(maxConcurrentRequests, 1)), workers_(std::max<size_t>(workerThreads, 1)) {
     // 构造函数现在只负责初始化引用
     // 实际连接将在第一次调用时按需建立
     
@@ -15,40 +77,180 @@ StatusServiceImpl::StatusServiceImpl() : db_(DatabaseManager::getInstance()), re
     // 使用Docker中运行的MySQL服务地址和端口
     db_.addDatabaseInstance("localhost", 3307, "im_user", "password", "im_database", 2);  // 权重为2
     
-    // 初始化Redis连接
-    redis_.initialize("localhost", 6379, 10);  // 10个连接的连接池
+    // 好友关系图常驻内存，好友查询不再经过数据库锁
+    FriendGraph::getInstance().start();
+    
+    // Redis连接由 main 按 REDIS_NODES 配置初始化
+    
+    // 预加载状态更新脚本，每次状态变更只需一次往返
+    if (!redis_.loadScript(PRESENCE_SCRIPT_NAME, PRESENCE_SCRIPT)) {
+        LOG_WARN("Presence script not loaded, falling back to multi-field HSET");
+    }
+    
+    // user_status 表的写入按用户合并后定期批量执行，落库后状态表的检查点才前进
+    UserStatusFlusher::getInstance().setFlushedCallback([](uint64_t seq) {
+        PresenceTable::getInstance().markDurable(seq);
+    });
+    UserStatusFlusher::getInstance().start();
+    
+    // 内存状态表：重放变更日志恢复状态，之后作为用户状态的权威来源
+    if (!presenceLogPath.empty() &&
+        !PresenceTable::getInstance().start(presenceLogPath,
+                                            [this](const std::vector<PresenceChange>& changes, uint64_t& ticket) {
+            return syncPresence(changes, ticket);
+        })) {
+        LOG_WARN("Presence table disabled, user status goes directly to Redis and MySQL");
+    }
+    
+    // 请求和响应分配在每个 RPC 的 arena 上
+    SetMessageAllocatorFor_UpdateUserStatus(&updateUserStatusAllocator_);
+    SetMessageAllocatorFor_GetUserStatus(&getUserStatusAllocator_);
+    SetMessageAllocatorFor_GetFriendsStatus(&getFriendsStatusAllocator_);
+    SetMessageAllocatorFor_AddFriend(&addFriendAllocator_);
+    SetMessageAllocatorFor_GetFriendsList(&getFriendsListAllocator_);
+    
+    LOG_INFO("StatusServiceImpl initialized with {} worker threads, at most {} requests in flight",
+             std::max<size_t>(workerThreads, 1), maxConcurrentRequests_);
+}
+
+StatusServiceImpl::~StatusServiceImpl() {
+    stop();
+}
+
+void StatusServiceImpl::stop() {
+    workers_.join();
+    // 工作线程退出后不再有状态写入，状态表同步剩余的变化后停止，最后写入尚未落库的 user_status
+    PresenceTable::getInstance().stop();
+    UserStatusFlusher::getInstance().stop();
+}
+
+template <typename Handler>
+ServerUnaryReactor* StatusServiceImpl::dispatch(CallbackServerContext* context, Handler handler) {
+    ServerUnaryReactor* reactor = context->DefaultReactor();
+    
+    // 超过上限时立即拒绝：排队只会让所有请求一起超时，客户端换实例重试更快
+    if (inFlight_.fetch_add(1, std::memory_order_relaxed) >= maxConcurrentRequests_) {
+        inFlight_.fetch_sub(1, std::memory_order_relaxed);
+        reactor->Finish(Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "StatusServer is overloaded"));
+        return reactor;
+    }
     
-    LOG_INFO("StatusServiceImpl initialized with integrated load balancing and Redis support");
+    boost::asio::post(workers_, [this, context, reactor, handler]() mutable {
+        // 排队期间客户端已取消或超时，结果没人接收，不再访问后端
+        Status status = context->IsCancelled() ? Status::CANCELLED : handler();
+        inFlight_.fetch_sub(1, std::memory_order_relaxed);
+        reactor->Finish(status);
+    });
+    return reactor;
 }
 
-Status StatusServiceImpl::UpdateUserStatus(ServerContext* context, 
-                                          const UserStatusRequest* request, 
-                                          UserStatusResponse* response) {
+ServerUnaryReactor* StatusServiceImpl::UpdateUserStatus(CallbackServerContext* context,
+                                                       const UserStatusRequest* request,
+                                                       UserStatusResponse* response) {
+    // 状态表中的条目可信（或还没有该用户）时直接写入状态表，Redis 和 MySQL 由同步线程随后更新
+    PresenceTable& presence = PresenceTable::getInstance();
+    PresenceEntry entry;
+    if (presence.isEnabled() && (!presence.get(request->user_id(), entry) || entry.verified)) {
+        presence.update(request->user_id(), request->status(), request->session_token());
+        response->set_success(true);
+        response->set_message("User status updated successfully");
+        ServerUnaryReactor* reactor = context->DefaultReactor();
+        reactor->Finish(Status::OK);
+        return reactor;
+    }
     
+    return dispatch(context, [this, request, response] { return handleUpdateUserStatus(request, response); });
+}
+
+Status StatusServiceImpl::handleUpdateUserStatus(const UserStatusRequest* request, UserStatusResponse* response) {
     // 现在DatabaseManager内部会自动处理负载均衡
     // 我们只需要调用数据库操作方法即可
     
     LOG_DEBUG("Updating user status for user ID: {}", request->user_id());
     
-    // 更新用户状态到数据库和Redis缓存
-    bool dbSuccess = updateUserStatusInDB(request->user_id(), request->status(), request->session_token());
-    bool cacheSuccess = updateUserStatusInCache(request->user_id(), request->status(), request->session_token());
-    
-    if (dbSuccess) {
+    PresenceTable& presence = PresenceTable::getInstance();
+    if (presence.isEnabled()) {
+        // 条目不可信：先与 Redis 核对，再在核对后的状态上应用这次变化
+        verifyPresence(request->user_id());
+        presence.update(request->user_id(), request->status(), request->session_token());
         response->set_success(true);
         response->set_message("User status updated successfully");
-        
-        LOG_INFO("[StatusServer] Updated status for user {} to {}", request->user_id(), request->status());
-    } else {
-        response->set_success(false);
-        response->set_message("Failed to update user status in database");
-        LOG_ERROR("[StatusServer] Failed to update status for user {}", request->user_id());
+        return Status::OK;
+    }
+    
+    // 更新Redis缓存，数据库由 UserStatusFlusher 合并后批量写入
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    bool cacheSuccess = updateUserStatusInCache(request->user_id(), request->status(), request->session_token(), now_ms);
+    if (cacheSuccess) {
+        // 在线位图镜像 users:online，与 Redis 保持一致
+        OnlineUsers::getInstance().setOnline(request->user_id(), request->status() != status::UserStatus::OFFLINE);
     }
+    UserStatusFlusher::getInstance().enqueue(request->user_id(), userStatusToString(request->status()), now_ms,
+                                             request->session_token());
+    
+    response->set_success(true);
+    response->set_message("User status updated successfully");
+    LOG_INFO("[StatusServer] Updated status for user {} to {}", request->user_id(), request->status());
     
     return Status::OK;
 }
 
-bool StatusServiceImpl::updateUserStatusInCache(int32_t user_id, status::UserStatus status, const std::string& session_token) {
+bool StatusServiceImpl::syncPresence(const std::vector<PresenceChange>& changes, uint64_t& ticket) {
+    // MySQL 交给 UserStatusFlusher 合并后批量写入，失败由它重试，写入后才通知状态表推进检查点；
+    // Redis 写入失败时返回false，整批由状态表退避后重新同步（脚本只跳过更旧的写入，重复写入无害）
+    UserStatusFlusher& flusher = UserStatusFlusher::getInstance();
+    size_t failed = 0;
+    for (const auto& change : changes) {
+        auto user_status = static_cast<status::UserStatus>(change.status);
+        if (updateUserStatusInCache(change.userId, user_status, change.sessionToken, change.lastSeenMs, true)) {
+            OnlineUsers::getInstance().setOnline(change.userId, user_status != status::UserStatus::OFFLINE);
+        } else {
+            ++failed;
+        }
+        ticket = flusher.enqueue(change.userId, userStatusToString(user_status), change.lastSeenMs,
+                                 change.sessionToken);
+    }
+    if (failed != 0) {
+        LOG_WARN("Failed to sync {} of {} presence changes to Redis", failed, changes.size());
+        return false;
+    }
+    LOG_DEBUG("Synced {} presence changes", changes.size());
+    return true;
+}
+
+PresenceEntry StatusServiceImpl::verifyPresence(int32_t user_id) {
+    PresenceTable& presence = PresenceTable::getInstance();
+    std::unordered_map<std::string, std::string> fields;
+    if (!PresenceCache::getInstance().hgetall("user:status:" + std::to_string(user_id), fields)) {
+        // Redis 不可用时无法核对，沿用状态表中的条目
+        PresenceEntry entry;
+        presence.get(user_id, entry);
+        return entry;
+    }
+    
+    status::UserStatus user_status = status::UserStatus::OFFLINE;
+    auto status_it = fields.find("status");
+    if (status_it != fields.end()) {
+        user_status = parseUserStatus(status_it->second);
+    }
+    
+    // 没有 last_updated 或无法解析时视为没有记录
+    int64_t last_updated_ms = 0;
+    parseLastUpdated(fields, last_updated_ms);
+    
+    return presence.reconcile(user_id, user_status, last_updated_ms);
+}
+
+void StatusServiceImpl::fillUserStatus(const PresenceEntry& entry, GetUserStatusResponse* response) {
+    response->set_success(true);
+    response->set_message("User status retrieved successfully");
+    response->set_status(static_cast<status::UserStatus>(entry.status));
+    response->set_last_seen(entry.lastSeenMs);
+}
+
+bool StatusServiceImpl::updateUserStatusInCache(int32_t user_id, status::UserStatus status, const std::string& session_token,
+                                                int64_t last_seen_ms, bool onlyIfNewer) {
     try {
         // 使用哈希存储用户状态信息
         std::string key = "user:status:" + std::to_string(user_id);
@@ -63,11 +265,27 @@ bool StatusServiceImpl::updateUserStatusInCache(int32_t user_id, status::UserSta
             default: status_str = "OFFLINE"; break;
         }
         
-        // 存储到Redis哈希中
-        bool result = true;
-        result &= redis_.hset(key, "status", status_str);
-        result &= redis_.hset(key, "session_token", session_token);
-        result &= redis_.hset(key, "last_updated", std::to_string(std::time(nullptr)));
+        std::string last_updated = std::to_string(last_seen_ms / 1000);
+        
+        // 优先使用预加载的脚本：状态哈希和在线集合在一次往返内原子更新
+        bool result;
+        if (redis_.hasScript(PRESENCE_SCRIPT_NAME) && redis_.sameShard({key, "users:online"})) {
+            result = redis_.evalScript(PRESENCE_SCRIPT_NAME, {key, "users:online"},
+                                       {status_str, session_token, last_updated, std::to_string(user_id),
+                                        onlyIfNewer ? "1" : "0"});
+        } else {
+            // 分片后两个键可能位于不同节点，分成两条命令并行发出（不再是原子的，也不检查 onlyIfNewer）
+            RedisPipeline pipeline;
+            pipeline.add({"HSET", key, "status", status_str, "session_token", session_token,
+                          "last_updated", last_updated});
+            pipeline.add({status_str == "OFFLINE" ? "SREM" : "SADD", "users:online", std::to_string(user_id)});
+            
+            std::vector<RedisValue> replies;
+            result = redis_.execute(pipeline, replies) && !replies[0].isError() && !replies[1].isError();
+        }
+        
+        // 不等服务端的失效通知，保证本进程随后的读取能看到这次写入
+        PresenceCache::getInstance().invalidate(key);
         
         // 设置过期时间（例如5分钟）
         // 注意：这里需要直接使用hiredis API来设置过期时间
@@ -80,30 +298,25 @@ bool StatusServiceImpl::updateUserStatusInCache(int32_t user_id, status::UserSta
     }
 }
 
-bool StatusServiceImpl::getUserStatusFromCache(int32_t user_id, status::UserStatus& status, std::string& session_token) {
+bool StatusServiceImpl::getUserStatusFromCache(int32_t user_id, status::UserStatus& status, std::string& session_token,
+                                               int64_t& last_seen_ms, bool memoryOnly) {
     try {
         std::string key = "user:status:" + std::to_string(user_id);
         std::unordered_map<std::string, std::string> result;
         
-        if (!redis_.hgetall(key, result)) {
+        PresenceCache& presence = PresenceCache::getInstance();
+        if (memoryOnly ? !presence.peek(key, result) : !presence.hgetall(key, result)) {
+            return false;
+        }
+        
+        // last_updated（秒）即最近一次状态变化的时间；没有该字段的记录不完整（或是负缓存），回退到数据库
+        if (!parseLastUpdated(result, last_seen_ms)) {
             return false;
         }
         
         // 解析状态
         auto status_it = result.find("status");
-        if (status_it != result.end()) {
-            if (status_it->second == "ONLINE") {
-                status = status::UserStatus::ONLINE;
-            } else if (status_it->second == "AWAY") {
-                status = status::UserStatus::AWAY;
-            } else if (status_it->second == "BUSY") {
-                status = status::UserStatus::BUSY;
-            } else {
-                status = status::UserStatus::OFFLINE;
-            }
-        } else {
-            status = status::UserStatus::OFFLINE;
-        }
+        status = status_it != result.end() ? parseUserStatus(status_it->second) : status::UserStatus::OFFLINE;
         
         // 获取会话令牌
         auto token_it = result.find("session_token");
@@ -122,12 +335,27 @@ bool StatusServiceImpl::cacheFriendsList(int32_t user_id, const std::vector<int3
     try {
         std::string key = "user:friends:" + std::to_string(user_id);
         
-        // 先清空旧的好友列表
-        redis_.del(key);
-        
-        // 将好友ID添加到有序集合中
+        // 清空旧列表并写入新列表：MULTI/EXEC 保证读者不会看到空集合，
+        // 整批命令通过流水线一次发送
+        std::vector<std::string> zadd_args{"ZADD", key};
+        zadd_args.reserve(2 + friend_ids.size() * 2);
         for (size_t i = 0; i < friend_ids.size(); ++i) {
-            redis_.zadd(key, static_cast<double>(i), std::to_string(friend_ids[i]));
+            zadd_args.push_back(std::to_string(i));
+            zadd_args.push_back(std::to_string(friend_ids[i]));
+        }
+        
+        RedisPipeline pipeline;
+        pipeline.add({"MULTI"});
+        pipeline.add({"DEL", key});
+        if (!friend_ids.empty()) {
+            pipeline.add(std::move(zadd_args));
+        }
+        pipeline.add({"EXEC"});
+        
+        std::vector<RedisValue> replies;
+        if (!redis_.execute(pipeline, replies) || replies.back().type != REDIS_REPLY_ARRAY) {
+            LOG_ERROR("Failed to cache friends list for user {}", user_id);
+            return false;
         }
         
         // 设置过期时间（例如30分钟）
@@ -168,20 +396,56 @@ bool StatusServiceImpl::getCachedFriendsList(int32_t user_id, std::vector<int32_
     }
 }
 
-Status StatusServiceImpl::GetUserStatus(ServerContext* context, 
-                                       const GetUserStatusRequest* request, 
-                                       GetUserStatusResponse* response) {
+ServerUnaryReactor* StatusServiceImpl::GetUserStatus(CallbackServerContext* context,
+                                                    const GetUserStatusRequest* request,
+                                                    GetUserStatusResponse* response) {
+    // 状态表中的可信条目或进程内缓存命中时直接在回调里完成，不进入工作线程池
+    PresenceTable& presence = PresenceTable::getInstance();
+    PresenceEntry entry;
+    bool inTable = presence.isEnabled() && presence.get(request->user_id(), entry);
+    if (inTable && entry.verified) {
+        fillUserStatus(entry, response);
+        ServerUnaryReactor* reactor = context->DefaultReactor();
+        reactor->Finish(Status::OK);
+        return reactor;
+    }
     
+    status::UserStatus status;
+    std::string session_token;
+    int64_t last_seen_ms;
+    if (!inTable && getUserStatusFromCache(request->user_id(), status, session_token, last_seen_ms, true)) {
+        response->set_success(true);
+        response->set_message("User status retrieved from cache");
+        response->set_status(status);
+        response->set_last_seen(last_seen_ms);
+        ServerUnaryReactor* reactor = context->DefaultReactor();
+        reactor->Finish(Status::OK);
+        return reactor;
+    }
+    
+    return dispatch(context, [this, request, response] { return handleGetUserStatus(request, response); });
+}
+
+Status StatusServiceImpl::handleGetUserStatus(const GetUserStatusRequest* request, GetUserStatusResponse* response) {
     LOG_DEBUG("Getting user status for user ID: {}", request->user_id());
     
+    // 状态表中有该用户时以状态表为准，条目不可信时先与 Redis 核对
+    PresenceTable& presence = PresenceTable::getInstance();
+    PresenceEntry entry;
+    if (presence.isEnabled() && presence.get(request->user_id(), entry)) {
+        fillUserStatus(entry.verified ? entry : verifyPresence(request->user_id()), response);
+        return Status::OK;
+    }
+    
     // 首先尝试从缓存获取
     status::UserStatus status;
     std::string session_token;
-    if (getUserStatusFromCache(request->user_id(), status, session_token)) {
+    int64_t last_seen_ms;
+    if (getUserStatusFromCache(request->user_id(), status, session_token, last_seen_ms)) {
         response->set_success(true);
         response->set_message("User status retrieved from cache");
         response->set_status(status);
-        response->set_last_seen(std::time(nullptr) * 1000); // 简化处理
+        response->set_last_seen(last_seen_ms);
         LOG_DEBUG("Retrieved user status from cache for user ID: {}", request->user_id());
         return Status::OK;
     }
@@ -204,15 +468,20 @@ Status StatusServiceImpl::GetUserStatus(ServerContext* context,
     return Status::OK;
 }
 
-Status StatusServiceImpl::GetFriendsStatus(ServerContext* context, 
-                                          const GetFriendsStatusRequest* request, 
-                                          GetFriendsStatusResponse* response) {
-    
+ServerUnaryReactor* StatusServiceImpl::GetFriendsStatus(CallbackServerContext* context,
+                                                       const GetFriendsStatusRequest* request,
+                                                       GetFriendsStatusResponse* response) {
+    return dispatch(context, [this, request, response] { return handleGetFriendsStatus(request, response); });
+}
+
+Status StatusServiceImpl::handleGetFriendsStatus(const GetFriendsStatusRequest* request,
+                                                 GetFriendsStatusResponse* response) {
     LOG_DEBUG("Getting friends status for user ID: {}", request->user_id());
     
-    // 首先尝试从缓存获取好友列表
+    // 优先从内存中的好友关系图获取，未加载时依次尝试缓存和数据库
     std::vector<int32_t> friend_ids;
-    if (!getCachedFriendsList(request->user_id(), friend_ids)) {
+    if (!FriendGraph::getInstance().getFriends(request->user_id(), friend_ids) &&
+        !getCachedFriendsList(request->user_id(), friend_ids)) {
         // 缓存未命中，从数据库获取
         friend_ids = getFriendsIds(request->user_id());
         // 将好友列表缓存起来
@@ -222,40 +491,149 @@ Status StatusServiceImpl::GetFriendsStatus(ServerContext* context,
     response->set_success(true);
     response->set_message("Friends status retrieved successfully");
     
-    for (int32_t friend_id : friend_ids) {
-        status::UserStatus status;
-        std::string session_token;
+    if (friend_ids.empty()) {
+        return Status::OK;
+    }
+    
+    // 只要在线好友时，先用好友列表与在线位图求交，只为在线好友读取状态
+    if (request->online_only()) {
+        std::vector<int32_t> online;
+        if (OnlineUsers::getInstance().filterOnline(friend_ids, online)) {
+            friend_ids.swap(online);
+            if (friend_ids.empty()) {
+                return Status::OK;
+            }
+        }
+    }
+    
+    // 状态表中有可信条目的好友直接读内存；其余好友（由其他实例负责，或条目待核对）才读状态缓存
+    PresenceTable& table = PresenceTable::getInstance();
+    std::vector<PresenceEntry> entries(friend_ids.size());
+    std::vector<char> local(friend_ids.size(), 0);
+    std::vector<size_t> remote;
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < friend_ids.size(); ++i) {
+        if (table.isEnabled() && table.get(friend_ids[i], entries[i]) && entries[i].verified) {
+            local[i] = 1;
+        } else {
+            remote.push_back(i);
+            keys.push_back("user:status:" + std::to_string(friend_ids[i]));
+        }
+    }
+    
+    // 热点好友的状态直接命中进程内缓存，未命中的一次流水线读 Redis
+    std::vector<std::unordered_map<std::string, std::string>> cached(friend_ids.size());
+    PresenceCache& presence = PresenceCache::getInstance();
+    std::vector<std::unordered_map<std::string, std::string>> fetched;
+    if (!keys.empty() && presence.hgetall(keys, fetched)) {
+        for (size_t j = 0; j < remote.size(); ++j) {
+            cached[remote[j]] = std::move(fetched[j]);
+        }
+    }
+    
+    // 用户名优先取自进程内资料缓存，这里不单独查库，缺失的随下面的查询一起补齐
+    std::unordered_map<int32_t, std::string> names;
+    UserProfileCache::getInstance().getUsernames(friend_ids, names, false);
+    
+    // 缺少状态或用户名的好友（Redis 不可用时是全部非本地好友），用一条 IN 查询补齐
+    std::vector<int32_t> misses;
+    for (size_t i = 0; i < friend_ids.size(); ++i) {
+        if ((!local[i] && !cached[i].count("status")) || (!cached[i].count("username") && !names.count(friend_ids[i]))) {
+            misses.push_back(friend_ids[i]);
+        }
+    }
+    
+    std::unordered_map<int32_t, FriendRecord> records;
+    if (!misses.empty()) {
+        getFriendRecordsFromDB(request->user_id(), misses, records);
+    }
+    
+    // 需要回填到缓存的字段，最后一次流水线写入；只回填数据库中的真实值
+    std::vector<std::pair<std::string, std::vector<std::pair<std::string, std::string>>>> write_back;
+    
+    for (size_t i = 0; i < friend_ids.size(); ++i) {
+        int32_t friend_id = friend_ids[i];
+        const auto& hash = cached[i];
+        auto status_it = hash.find("status");
+        auto name_it = hash.find("username");
+        auto profile_it = names.find(friend_id);
+        auto record_it = records.find(friend_id);
+        const FriendRecord* record = record_it != records.end() ? &record_it->second : nullptr;
         
-        // 尝试从缓存获取好友状态
-        if (!getUserStatusFromCache(friend_id, status, session_token)) {
-            // 缓存未命中，从数据库获取
-            std::chrono::time_point<std::chrono::system_clock> last_seen;
-            if (getUserStatusFromDB(friend_id, status, last_seen)) {
-                // 更新缓存
-                updateUserStatusInCache(friend_id, status, session_token);
-            } else {
-                continue; // 跳过无效用户
+        // 状态依次取自状态表、状态缓存、数据库；都没有时跳过该好友。last_seen 未知时为 0
+        status::UserStatus status = status::UserStatus::OFFLINE;
+        int64_t last_seen = 0;
+        std::vector<std::pair<std::string, std::string>> fields;
+        if (local[i]) {
+            status = static_cast<status::UserStatus>(entries[i].status);
+            last_seen = entries[i].lastSeenMs;
+        } else if (status_it != hash.end()) {
+            status = parseUserStatus(status_it->second);
+            parseLastUpdated(hash, last_seen);
+        } else if (record && record->hasStatus) {
+            status = record->status;
+            last_seen = record->lastSeenMs;
+            fields.emplace_back("status", userStatusToString(record->status));
+            if (record->lastSeenMs > 0) {
+                fields.emplace_back("last_updated", std::to_string(record->lastSeenMs / 1000));
             }
+        } else {
+            continue; // 跳过无效用户
+        }
+        
+        std::string username;
+        if (profile_it != names.end()) {
+            username = profile_it->second;
+        } else if (name_it != hash.end()) {
+            username = name_it->second;
+        } else if (record) {
+            username = record->username;
+            fields.emplace_back("username", record->username);
+        } else {
+            continue;
+        }
+        
+        if (!fields.empty()) {
+            write_back.emplace_back("user:status:" + std::to_string(friend_id), std::move(fields));
+        }
+        
+        // 位图未加载或与状态短暂不一致时，按状态再过滤一次
+        if (request->online_only() && status == status::UserStatus::OFFLINE) {
+            continue;
         }
         
         auto* friend_status = response->add_friends();
         friend_status->set_user_id(friend_id);
-        friend_status->set_username("user_" + std::to_string(friend_id));
+        friend_status->set_username(username);
         friend_status->set_status(status);
-        friend_status->set_last_seen(std::time(nullptr) * 1000); // 简化处理
+        friend_status->set_last_seen(last_seen);
     }
     
+    if (!write_back.empty()) {
+        redis_.hsetMulti(write_back);
+        for (const auto& entry : write_back) {
+            presence.invalidate(entry.first);
+        }
+    }
+    
+    LOG_DEBUG("Friends status for user {}: {} friends, {} from presence table, {} cache misses", request->user_id(),
+              friend_ids.size(), friend_ids.size() - remote.size(), misses.size());
     return Status::OK;
 }
 
-Status StatusServiceImpl::AddFriend(ServerContext* context, 
-                                   const AddFriendRequest* request, 
-                                   AddFriendResponse* response) {
-    
+ServerUnaryReactor* StatusServiceImpl::AddFriend(CallbackServerContext* context,
+                                                const AddFriendRequest* request,
+                                                AddFriendResponse* response) {
+    return dispatch(context, [this, request, response] { return handleAddFriend(request, response); });
+}
+
+Status StatusServiceImpl::handleAddFriend(const AddFriendRequest* request, AddFriendResponse* response) {
     LOG_DEBUG("Adding friend relationship between user {} and user {}", 
               request->user_id(), request->friend_id());
     
-    if (friendExistsInDB(request->user_id(), request->friend_id())) {
+    FriendGraph& graph = FriendGraph::getInstance();
+    if (graph.isFriend(request->user_id(), request->friend_id()) ||
+        friendExistsInDB(request->user_id(), request->friend_id())) {
         response->set_success(false);
         response->set_message("Friend relationship already exists");
         return Status::OK;
@@ -263,6 +641,8 @@ Status StatusServiceImpl::AddFriend(ServerContext* context,
     
     if (addFriendToDB(request->user_id(), request->friend_id()) && 
         addFriendToDB(request->friend_id(), request->user_id())) {
+        graph.addEdge(request->user_id(), request->friend_id());
+        graph.addEdge(request->friend_id(), request->user_id());
         response->set_success(true);
         response->set_message("Friend added successfully");
     } else {
@@ -273,33 +653,64 @@ Status StatusServiceImpl::AddFriend(ServerContext* context,
     return Status::OK;
 }
 
-Status StatusServiceImpl::GetFriendsList(ServerContext* context, 
-                                        const GetFriendsListRequest* request, 
-                                        GetFriendsListResponse* response) {
+ServerUnaryReactor* StatusServiceImpl::GetFriendsList(CallbackServerContext* context,
+                                                     const GetFriendsListRequest* request,
+                                                     GetFriendsListResponse* response) {
+    // 好友图已加载且所有用户名都在资料缓存中时，只读内存，直接在回调里完成
+    std::vector<int32_t> friend_ids;
+    if (FriendGraph::getInstance().getFriends(request->user_id(), friend_ids)) {
+        std::unordered_map<int32_t, std::string> names;
+        UserProfileCache::getInstance().getUsernames(friend_ids, names, false);
+        if (names.size() == friend_ids.size()) {
+            fillFriendsList(friend_ids, names, true, response);
+            ServerUnaryReactor* reactor = context->DefaultReactor();
+            reactor->Finish(Status::OK);
+            return reactor;
+        }
+    }
     
+    return dispatch(context, [this, request, response] { return handleGetFriendsList(request, response); });
+}
+
+Status StatusServiceImpl::handleGetFriendsList(const GetFriendsListRequest* request, GetFriendsListResponse* response) {
     LOG_DEBUG("Getting friends list for user ID: {}", request->user_id());
     
-    auto friend_ids = getFriendsIds(request->user_id());
+    std::vector<int32_t> friend_ids;
+    if (!FriendGraph::getInstance().getFriends(request->user_id(), friend_ids)) {
+        friend_ids = getFriendsIds(request->user_id());
+    }
     
+    // 一次批量解析所有好友的用户名，命中的不访问数据库
+    std::unordered_map<int32_t, std::string> names;
+    bool namesLoaded = UserProfileCache::getInstance().getUsernames(friend_ids, names);
+    
+    fillFriendsList(friend_ids, names, namesLoaded, response);
+    return Status::OK;
+}
+
+void StatusServiceImpl::fillFriendsList(const std::vector<int32_t>& friend_ids,
+                                        const std::unordered_map<int32_t, std::string>& names,
+                                        bool namesLoaded, GetFriendsListResponse* response) {
     response->set_success(true);
     response->set_message("Friends list retrieved successfully");
     
     for (int32_t friend_id : friend_ids) {
+        auto name_it = names.find(friend_id);
+        if (name_it == names.end() && namesLoaded) {
+            continue; // 跳过无效用户
+        }
+        
         auto* friend_info = response->add_friends();
         friend_info->set_user_id(friend_id);
-        friend_info->set_username("user_" + std::to_string(friend_id));
+        // 数据库不可用时保留占位名
+        friend_info->set_username(name_it != names.end() ? name_it->second : "user_" + std::to_string(friend_id));
     }
-    
-    return Status::OK;
 }
 
 bool StatusServiceImpl::validateSessionToken(int32_t user_id, const std::string& token) {
-    std::lock_guard<std::mutex> lock(db_.mutex());
-    if (!db_.isConnected_impl() && !db_.connect_impl()) {
-        return false;
-    }
-    
-    MYSQL* connection = static_cast<MYSQL*>(db_.getConnection());
+    // 只读查询：优先走副本，刚更新过状态的用户固定走主库
+    DatabaseManager::ReadConnection read = db_.acquireReadConnection(DatabaseManager::userSessionKey(user_id));
+    MYSQL* connection = static_cast<MYSQL*>(read.get());
     if (!connection) return false;
     
     std::string query = "SELECT session_token FROM user_status WHERE user_id = " + std::to_string(user_id);
@@ -321,13 +732,10 @@ bool StatusServiceImpl::validateSessionToken(int32_t user_id, const std::string&
 
 std::vector<int32_t> StatusServiceImpl::getFriendsIds(int32_t user_id) {
     std::vector<int32_t> friend_ids;
-    std::lock_guard<std::mutex> lock(db_.mutex());
     
-    if (!db_.isConnected_impl() && !db_.connect_impl()) {
-        return friend_ids;
-    }
-    
-    MYSQL* connection = static_cast<MYSQL*>(db_.getConnection());
+    // 只读查询：优先走副本，刚添加过好友的用户固定走主库
+    DatabaseManager::ReadConnection read = db_.acquireReadConnection(DatabaseManager::userSessionKey(user_id));
+    MYSQL* connection = static_cast<MYSQL*>(read.get());
     if (!connection) return friend_ids;
     
     std::string query = "SELECT friend_id FROM user_friends WHERE user_id = " + std::to_string(user_id);
@@ -350,48 +758,13 @@ std::vector<int32_t> StatusServiceImpl::getFriendsIds(int32_t user_id) {
     return friend_ids;
 }
 
-bool StatusServiceImpl::updateUserStatusInDB(int32_t user_id, status::UserStatus status, const std::string& session_token) {
-    std::lock_guard<std::mutex> lock(db_.mutex());
-    
-    if (!db_.isConnected_impl() && !db_.connect_impl()) {
-        return false;
-    }
-    
-    MYSQL* connection = static_cast<MYSQL*>(db_.getConnection());
-    if (!connection) return false;
-    
-    std::string status_str;
-    switch (status) {
-        case status::UserStatus::OFFLINE: status_str = "OFFLINE"; break;
-        case status::UserStatus::ONLINE: status_str = "ONLINE"; break;
-        case status::UserStatus::AWAY: status_str = "AWAY"; break;
-        case status::UserStatus::BUSY: status_str = "BUSY"; break;
-        default: status_str = "OFFLINE"; break;
-    }
-    
-    std::string query = "INSERT INTO user_status (user_id, status, last_seen, session_token) VALUES (" + 
-                        std::to_string(user_id) + ", '" + status_str + "', NOW(), '" + session_token + 
-                        "') ON DUPLICATE KEY UPDATE status = '" + status_str + "', last_seen = NOW(), session_token = '" + session_token + "'";
-    
-    if (mysql_query(connection, query.c_str())) {
-        LOG_ERROR("MySQL query error: {}", mysql_error(connection));
-        return false;
-    }
-    
-    return true;
-}
-
 bool StatusServiceImpl::getUserStatusFromDB(int32_t user_id, status::UserStatus& status, std::chrono::time_point<std::chrono::system_clock>& last_seen) {
-    std::lock_guard<std::mutex> lock(db_.mutex());
-    
-    if (!db_.isConnected_impl() && !db_.connect_impl()) {
-        return false;
-    }
-    
-    MYSQL* connection = static_cast<MYSQL*>(db_.getConnection());
+    // 只读查询：优先走副本，刚更新过状态的用户固定走主库
+    DatabaseManager::ReadConnection read = db_.acquireReadConnection(DatabaseManager::userSessionKey(user_id));
+    MYSQL* connection = static_cast<MYSQL*>(read.get());
     if (!connection) return false;
     
-    std::string query = "SELECT status, last_seen FROM user_status WHERE user_id = " + std::to_string(user_id);
+    std::string query = "SELECT status, UNIX_TIMESTAMP(last_seen) FROM user_status WHERE user_id = " + std::to_string(user_id);
     if (mysql_query(connection, query.c_str())) {
         LOG_ERROR("MySQL query error: {}", mysql_error(connection));
         return false;
@@ -407,27 +780,12 @@ bool StatusServiceImpl::getUserStatusFromDB(int32_t user_id, status::UserStatus&
     }
     
     // 解析状态
-    if (row[0]) {
-        std::string status_str(row[0]);
-        if (status_str == "ONLINE") {
-            status = status::UserStatus::ONLINE;
-        } else if (status_str == "AWAY") {
-            status = status::UserStatus::AWAY;
-        } else if (status_str == "BUSY") {
-            status = status::UserStatus::BUSY;
-        } else {
-            status = status::UserStatus::OFFLINE;
-        }
-    } else {
-        status = status::UserStatus::OFFLINE;
-    }
+    status = row[0] ? parseUserStatus(row[0]) : status::UserStatus::OFFLINE;
     
-    // 解析最后在线时间
+    // 最后在线时间（秒），为空时返回 epoch，表示未知
+    last_seen = std::chrono::system_clock::time_point();
     if (row[1]) {
-        // 这里简化处理，实际应用中需要正确解析时间戳
-        last_seen = std::chrono::system_clock::now();
-    } else {
-        last_seen = std::chrono::system_clock::now();
+        last_seen += std::chrono::seconds(std::stoll(row[1]));
     }
     
     mysql_free_result(result);
@@ -452,6 +810,8 @@ bool StatusServiceImpl::addFriendToDB(int32_t user_id, int32_t friend_id) {
         return false;
     }
     
+    // 写后读：该用户的好友列表查询在固定窗口内走主库
+    db_.pinSessionToPrimary(DatabaseManager::userSessionKey(user_id));
     return true;
 }
 
@@ -481,4 +841,54 @@ bool StatusServiceImpl::friendExistsInDB(int32_t user_id, int32_t friend_id) {
     
     mysql_free_result(result);
     return exists;
+}
+
+bool StatusServiceImpl::getFriendRecordsFromDB(int32_t user_id, const std::vector<int32_t>& friend_ids,
+                                               std::unordered_map<int32_t, FriendRecord>& records) {
+    if (friend_ids.empty()) return true;
+    
+    // 只读查询：优先走副本，刚写入过的用户固定走主库
+    DatabaseManager::ReadConnection read = db_.acquireReadConnection(DatabaseManager::userSessionKey(user_id));
+    MYSQL* connection = static_cast<MYSQL*>(read.get());
+    if (!connection) return false;
+    
+    // 一次查询取回所有好友的用户名和状态，代替逐个好友的 SELECT
+    std::string query = "SELECT u.id, u.username, s.status, UNIX_TIMESTAMP(s.last_seen) FROM users u "
+                        "LEFT JOIN user_status s ON s.user_id = u.id WHERE u.id IN (";
+    for (size_t i = 0; i < friend_ids.size(); ++i) {
+        if (i > 0) query += ",";
+        query += std::to_string(friend_ids[i]);
+    }
+    query += ")";
+    
+    if (mysql_query(connection, query.c_str())) {
+        LOG_ERROR("MySQL query error: {}", mysql_error(connection));
+        return false;
+    }
+    
+    MYSQL_RES* result = mysql_store_result(connection);
+    if (!result) return false;
+    
+    // 顺带取到的用户名写入资料缓存
+    UserProfileCache& profiles = UserProfileCache::getInstance();
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        if (!row[0]) continue;
+        
+        FriendRecord record;
+        record.username = row[1] ? row[1] : "";
+        if (row[2]) {
+            record.hasStatus = true;
+            record.status = parseUserStatus(row[2]);
+        }
+        if (row[3]) {
+            record.lastSeenMs = std::stoll(row[3]) * 1000;
+        }
+        int32_t friend_id = std::stoi(row[0]);
+        profiles.put(friend_id, record.username);
+        records[friend_id] = std::move(record);
+    }
+    
+    mysql_free_result(result);
+    return true;
 }
\ No newline at end of file
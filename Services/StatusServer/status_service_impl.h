@@ -6,11 +6,17 @@
 #include <memory>
 #include <unordered_map>
 #include <mutex>
+#include <atomic>
 #include <chrono>
+#include <boost/asio/thread_pool.hpp>
+#include "arena_message_allocator.h"
 #include "../utils/database_manager.h"
 #include "../utils/redis_manager.h"
+#include "../utils/presence_table.h"
 
+using grpc::CallbackServerContext;
 using grpc::ServerContext;
+using grpc::ServerUnaryReactor;
 using grpc::Status;
 using status::StatusService;
 using status::UserStatusRequest;
@@ -24,50 +30,117 @@ using status::AddFriendResponse;
 using status::GetFriendsListRequest;
 using status::GetFriendsListResponse;
 
-class StatusServiceImpl final : public StatusService::Service {
+// 状态服务（gRPC 回调 API）
+// 处理函数不占用 gRPC 的线程：只需读内存的请求（进程内缓存命中的用户状态、好友图和资料缓存命中的好友列表）
+// 在回调里直接完成，需要访问 MySQL/Redis 的请求投递到固定大小的工作线程池，阻塞只发生在池内。
+// 在途请求（含排队）达到上限时立即返回 RESOURCE_EXHAUSTED，由客户端换实例重试，而不是无限排队；
+// 排队期间客户端已取消或超时的请求不再执行。请求和响应消息分配在每个 RPC 独占的 arena 上。
+// 启用内存状态表时，用户状态的读写以状态表为准并在回调里完成，Redis 和 MySQL 由状态表的同步线程异步更新
+class StatusServiceImpl final : public StatusService::CallbackService {
 public:
-    StatusServiceImpl();
+    // workerThreads: 执行数据库和 Redis 调用的线程数；maxConcurrentRequests: 在途请求上限
+    // presenceLogPath: 内存状态表的变更日志，为空时不启用状态表
+    StatusServiceImpl(size_t workerThreads, int maxConcurrentRequests, const std::string& presenceLogPath);
+    ~StatusServiceImpl();
     
     // 更新用户在线状态
-    Status UpdateUserStatus(ServerContext* context, const UserStatusRequest* request, 
-                           UserStatusResponse* response) override;
+    ServerUnaryReactor* UpdateUserStatus(CallbackServerContext* context, const UserStatusRequest* request,
+                                         UserStatusResponse* response) override;
     
     // 获取用户状态
-    Status GetUserStatus(ServerContext* context, const GetUserStatusRequest* request, 
-                        GetUserStatusResponse* response) override;
+    ServerUnaryReactor* GetUserStatus(CallbackServerContext* context, const GetUserStatusRequest* request,
+                                      GetUserStatusResponse* response) override;
     
     // 获取好友列表状态
-    Status GetFriendsStatus(ServerContext* context, const GetFriendsStatusRequest* request, 
-                           GetFriendsStatusResponse* response) override;
+    ServerUnaryReactor* GetFriendsStatus(CallbackServerContext* context, const GetFriendsStatusRequest* request,
+                                         GetFriendsStatusResponse* response) override;
     
     // 添加好友
-    Status AddFriend(ServerContext* context, const AddFriendRequest* request, 
-                    AddFriendResponse* response) override;
+    ServerUnaryReactor* AddFriend(CallbackServerContext* context, const AddFriendRequest* request,
+                                  AddFriendResponse* response) override;
     
     // 获取好友列表
-    Status GetFriendsList(ServerContext* context, const GetFriendsListRequest* request, 
-                         GetFriendsListResponse* response) override;
+    ServerUnaryReactor* GetFriendsList(CallbackServerContext* context, const GetFriendsListRequest* request,
+                                       GetFriendsListResponse* response) override;
+    
+    // 正在处理和排队的请求数（健康检查据此判断是否饱和）
+    int inFlightRequests() const { return inFlight_.load(std::memory_order_relaxed); }
+    
+    // 执行完已排队的请求后停止工作线程和内存状态表，在 Server::Shutdown 之后调用
+    void stop();
 
 private:
+    // 投递到工作线程池执行 handler，超过在途上限时直接拒绝
+    template <typename Handler>
+    ServerUnaryReactor* dispatch(CallbackServerContext* context, Handler handler);
+    
+    // 在工作线程上执行的处理逻辑（会阻塞在数据库和 Redis 上）
+    Status handleUpdateUserStatus(const UserStatusRequest* request, UserStatusResponse* response);
+    Status handleGetUserStatus(const GetUserStatusRequest* request, GetUserStatusResponse* response);
+    Status handleGetFriendsStatus(const GetFriendsStatusRequest* request, GetFriendsStatusResponse* response);
+    Status handleAddFriend(const AddFriendRequest* request, AddFriendResponse* response);
+    Status handleGetFriendsList(const GetFriendsListRequest* request, GetFriendsListResponse* response);
+    
+    // 状态表的同步回调：把合并后的状态变化写入 Redis 并交给 UserStatusFlusher，Redis 写入失败时返回false；
+    // ticket 为最后一条变化在 UserStatusFlusher 中的序号，落库后由它的回调通知状态表
+    bool syncPresence(const std::vector<PresenceChange>& changes, uint64_t& ticket);
+    
+    // 与 Redis 核对状态表中不可信的条目（其他实例可能在本实例不可用期间处理过该用户）
+    PresenceEntry verifyPresence(int32_t user_id);
+    
+    // 按状态表的条目填充用户状态响应
+    static void fillUserStatus(const PresenceEntry& entry, GetUserStatusResponse* response);
+    
+    // 按已解析的用户名填充好友列表响应
+    void fillFriendsList(const std::vector<int32_t>& friend_ids, const std::unordered_map<int32_t, std::string>& names,
+                         bool namesLoaded, GetFriendsListResponse* response);
+    
+    // 批量查询得到的好友信息
+    struct FriendRecord {
+        std::string username;
+        bool hasStatus = false;                                  // user_status 表中是否有记录
+        status::UserStatus status = status::UserStatus::OFFLINE;
+        int64_t lastSeenMs = 0;
+    };
+    
     // 数据库管理器引用
     DatabaseManager& db_;
     
     // Redis管理器引用
     RedisManager& redis_;
     
+    // 在途请求数（含排队）及上限
+    std::atomic<int> inFlight_;
+    int maxConcurrentRequests_;
+    
+    // 执行阻塞调用的工作线程
+    boost::asio::thread_pool workers_;
+    
+    // 各 RPC 的 arena 消息分配器
+    ArenaMessageAllocator<UserStatusRequest, UserStatusResponse> updateUserStatusAllocator_;
+    ArenaMessageAllocator<GetUserStatusRequest, GetUserStatusResponse> getUserStatusAllocator_;
+    ArenaMessageAllocator<GetFriendsStatusRequest, GetFriendsStatusResponse> getFriendsStatusAllocator_;
+    ArenaMessageAllocator<AddFriendRequest, AddFriendResponse> addFriendAllocator_;
+    ArenaMessageAllocator<GetFriendsListRequest, GetFriendsListResponse> getFriendsListAllocator_;
+    
     // 内部辅助方法
     bool validateSessionToken(int32_t user_id, const std::string& token);
     std::vector<int32_t> getFriendsIds(int32_t user_id);
     
     // 数据库操作方法
-    bool updateUserStatusInDB(int32_t user_id, status::UserStatus status, const std::string& session_token);
     bool getUserStatusFromDB(int32_t user_id, status::UserStatus& status, std::chrono::time_point<std::chrono::system_clock>& last_seen);
     bool addFriendToDB(int32_t user_id, int32_t friend_id);
     bool friendExistsInDB(int32_t user_id, int32_t friend_id);
+    bool getFriendRecordsFromDB(int32_t user_id, const std::vector<int32_t>& friend_ids,
+                                std::unordered_map<int32_t, FriendRecord>& records);
     
     // Redis缓存操作方法
-    bool updateUserStatusInCache(int32_t user_id, status::UserStatus status, const std::string& session_token);
-    bool getUserStatusFromCache(int32_t user_id, status::UserStatus& status, std::string& session_token);
+    // onlyIfNewer 为 true 时 Redis 中已有更新的记录则不覆盖（异步同步的变化可能晚于其他实例的写入）
+    bool updateUserStatusInCache(int32_t user_id, status::UserStatus status, const std::string& session_token,
+                                 int64_t last_seen_ms, bool onlyIfNewer = false);
+    // last_seen_ms 为缓存记录的 last_updated；memoryOnly 为 true 时只查进程内缓存，不访问 Redis
+    bool getUserStatusFromCache(int32_t user_id, status::UserStatus& status, std::string& session_token,
+                                int64_t& last_seen_ms, bool memoryOnly = false);
     bool cacheFriendsList(int32_t user_id, const std::vector<int32_t>& friend_ids);
     bool getCachedFriendsList(int32_t user_id, std::vector<int32_t>& friend_ids);
 };
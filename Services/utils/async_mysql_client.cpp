@@ -0,0 +1,539 @@
+#include "async_mysql_client.h"
+#include <poll.h>
+#include <mysql/errmsg.h>
+#include "load_balancer.h"
+
+// 与 DatabaseManager 使用同一个服务名称
+const std::string AsyncDatabaseManager::SERVICE_NAME = "DatabaseService";
+
+// ==========================================================
+// AsyncMySQLConnection
+// ==========================================================
+
+AsyncMySQLConnection::AsyncMySQLConnection(net::io_context& ioc, std::chrono::milliseconds timeout)
+    : strand_(net::make_strand(ioc)),
+      timer_(strand_),
+      timeout_(timeout),
+      mysql_(nullptr),
+      connected_(false),
+      connectWaited_(false),
+      querySent_(false),
+      timedOut_(false),
+      port_(0) {
+}
+
+AsyncMySQLConnection::~AsyncMySQLConnection() {
+    closeNow();
+}
+
+/**
+ * @brief 异步连接到数据库实例
+ * 操作被投递到连接的 strand 上执行
+ */
+void AsyncMySQLConnection::asyncConnect(const std::string& host, int port, const std::string& user,
+                                        const std::string& password, const std::string& database,
+                                        ConnectHandler handler) {
+    net::post(strand_, [self = shared_from_this(), host, port, user, password, database,
+                        handler = std::move(handler)]() mutable {
+        self->host_ = host;
+        self->port_ = port;
+        self->user_ = user;
+        self->password_ = password;
+        self->database_ = database;
+        self->connectHandler_ = std::move(handler);
+        self->startConnect();
+    });
+}
+
+/**
+ * @brief 异步执行查询
+ * 操作被投递到连接的 strand 上执行
+ */
+void AsyncMySQLConnection::asyncQuery(std::string sql, std::vector<AsyncQueryParam> params, QueryHandler handler) {
+    net::post(strand_, [self = shared_from_this(), sql = std::move(sql), params = std::move(params),
+                        handler = std::move(handler)]() mutable {
+        self->queryHandler_ = std::move(handler);
+        self->result_ = AsyncQueryResult();
+
+        if (!self->connected_) {
+            self->fail("query issued on a closed connection");
+            return;
+        }
+
+        if (!self->formatQuery(sql, params, self->sql_)) {
+            // 参数错误不影响连接本身
+            self->finishQuery(false);
+            return;
+        }
+
+        self->startQuery();
+    });
+}
+
+/**
+ * @brief 关闭连接
+ * 进行中的操作会以失败结束
+ */
+void AsyncMySQLConnection::close() {
+    // io_context 已停止（进程退出时）投递的任务不会再执行，直接在调用线程关闭
+    if (strand_.get_inner_executor().context().stopped()) {
+        closeNow();
+        return;
+    }
+    net::post(strand_, [self = shared_from_this()]() {
+        self->closeNow();
+    });
+}
+
+void AsyncMySQLConnection::startConnect() {
+    closeNow();
+
+    mysql_ = mysql_init(nullptr);
+    if (!mysql_) {
+        fail("mysql_init() failed");
+        return;
+    }
+
+    // 强制使用TCP协议
+    enum mysql_protocol_type protocol = MYSQL_PROTOCOL_TCP;
+    mysql_options(mysql_, MYSQL_OPT_PROTOCOL, (void*)&protocol);
+
+    connectWaited_ = false;
+    armTimer();
+    stepConnect();
+}
+
+void AsyncMySQLConnection::stepConnect() {
+    net_async_status status = mysql_real_connect_nonblocking(mysql_, host_.c_str(), user_.c_str(),
+                                                             password_.c_str(), database_.c_str(),
+                                                             port_, nullptr, 0);
+    if (status == NET_ASYNC_NOT_READY) {
+        // 第一次等待 TCP 握手完成（可写），之后等待服务端的握手和认证报文（可读）
+        WaitType type = connectWaited_ ? WaitType::wait_read : WaitType::wait_write;
+        connectWaited_ = true;
+        waitSocket(type, &AsyncMySQLConnection::stepConnect);
+        return;
+    }
+
+    if (status == NET_ASYNC_ERROR) {
+        fail(std::string("mysql_real_connect_nonblocking() failed: ") + mysql_error(mysql_));
+        return;
+    }
+
+    timer_.cancel();
+    connected_ = true;
+    LOG_INFO("Async MySQL connection to {}:{} established", host_, port_);
+
+    ConnectHandler handler = std::move(connectHandler_);
+    connectHandler_ = nullptr;
+    handler(true);
+}
+
+void AsyncMySQLConnection::startQuery() {
+    querySent_ = false;
+    armTimer();
+    stepQuery();
+}
+
+void AsyncMySQLConnection::stepQuery() {
+    net_async_status status = mysql_real_query_nonblocking(mysql_, sql_.data(), sql_.size());
+    if (status == NET_ASYNC_NOT_READY) {
+        // 报文较大时发送缓冲区会写满，libmysqlclient 在写出剩余部分前返回：此时要等可写，
+        // 等可读会一直等到超时（服务端还在等报文的剩余部分）。
+        // libmysqlclient 只在发送缓冲区写满时停在发送阶段，返回后套接字仍可写说明报文已全部写出，之后等待结果（可读）
+        if (!querySent_ && socketWritable()) {
+            querySent_ = true;
+        }
+        waitSocket(querySent_ ? WaitType::wait_read : WaitType::wait_write, &AsyncMySQLConnection::stepQuery);
+        return;
+    }
+
+    if (status == NET_ASYNC_ERROR) {
+        unsigned int err = mysql_errno(mysql_);
+        if (err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST) {
+            fail(std::string("mysql_real_query_nonblocking() failed: ") + mysql_error(mysql_));
+            return;
+        }
+        // 语句级错误（例如唯一键冲突），连接仍然可用
+        LOG_ERROR("mysql_real_query_nonblocking() failed: {}", mysql_error(mysql_));
+        finishQuery(false);
+        return;
+    }
+
+    stepStoreResult();
+}
+
+void AsyncMySQLConnection::stepStoreResult() {
+    MYSQL_RES* res = nullptr;
+    net_async_status status = mysql_store_result_nonblocking(mysql_, &res);
+    if (status == NET_ASYNC_NOT_READY) {
+        waitSocket(WaitType::wait_read, &AsyncMySQLConnection::stepStoreResult);
+        return;
+    }
+
+    if (status == NET_ASYNC_ERROR || (!res && mysql_field_count(mysql_) != 0)) {
+        fail(std::string("mysql_store_result_nonblocking() failed: ") + mysql_error(mysql_));
+        return;
+    }
+
+    if (res) {
+        // 结果集已完整读入内存，逐行读取不会再有网络I/O
+        unsigned int fieldCount = mysql_num_fields(res);
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(res))) {
+            unsigned long* lengths = mysql_fetch_lengths(res);
+            std::vector<std::string> columns;
+            columns.reserve(fieldCount);
+            for (unsigned int i = 0; i < fieldCount; ++i) {
+                columns.emplace_back(row[i] ? std::string(row[i], lengths[i]) : std::string());
+            }
+            result_.rows.push_back(std::move(columns));
+        }
+        mysql_free_result(res);
+    } else {
+        result_.affectedRows = mysql_affected_rows(mysql_);
+        result_.insertId = mysql_insert_id(mysql_);
+    }
+
+    finishQuery(true);
+}
+
+/**
+ * @brief 等待套接字就绪后继续执行下一步
+ * 等待期间不占用线程；超时由 armTimer 取消等待
+ */
+void AsyncMySQLConnection::waitSocket(WaitType type, Step next) {
+    if (!socket_) {
+        int fd = mysql_get_socket(mysql_);
+        if (fd < 0) {
+            fail("connection has no socket");
+            return;
+        }
+        // 套接字归 libmysqlclient 所有，关闭前必须先 release()
+        socket_ = std::make_unique<net::posix::stream_descriptor>(strand_, fd);
+    }
+
+    auto self = shared_from_this();
+    socket_->async_wait(type, net::bind_executor(strand_,
+        [self, next](const boost::system::error_code& ec) {
+            if (ec) {
+                self->fail(self->timedOut_ ? std::string("operation timed out")
+                                           : "wait failed: " + ec.message());
+                return;
+            }
+            (self.get()->*next)();
+        }));
+}
+
+/**
+ * @brief 套接字当前是否可写（不等待）
+ */
+bool AsyncMySQLConnection::socketWritable() const {
+    pollfd pfd{};
+    pfd.fd = mysql_get_socket(mysql_);
+    pfd.events = POLLOUT;
+    return pfd.fd >= 0 && ::poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLOUT);
+}
+
+/**
+ * @brief 为当前操作启动超时定时器
+ */
+void AsyncMySQLConnection::armTimer() {
+    timedOut_ = false;
+    timer_.expires_after(timeout_);
+
+    std::weak_ptr<AsyncMySQLConnection> weak = shared_from_this();
+    timer_.async_wait(net::bind_executor(strand_, [weak](const boost::system::error_code& ec) {
+        auto self = weak.lock();
+        if (ec || !self) {
+            return;
+        }
+        self->timedOut_ = true;
+        // 取消套接字等待，由等待回调统一走失败路径
+        if (self->socket_) {
+            self->socket_->cancel();
+        }
+    }));
+}
+
+/**
+ * @brief 当前操作失败：关闭连接（协议状态未知）并通知调用方
+ */
+void AsyncMySQLConnection::fail(const std::string& reason) {
+    LOG_ERROR("Async MySQL {}:{} {}", host_, port_, reason);
+    closeNow();
+
+    if (connectHandler_) {
+        ConnectHandler handler = std::move(connectHandler_);
+        connectHandler_ = nullptr;
+        handler(false);
+    } else if (queryHandler_) {
+        finishQuery(false);
+    }
+}
+
+void AsyncMySQLConnection::finishQuery(bool success) {
+    timer_.cancel();
+
+    QueryHandler handler = std::move(queryHandler_);
+    queryHandler_ = nullptr;
+    AsyncQueryResult result = std::move(result_);
+    result_ = AsyncQueryResult();
+
+    if (handler) {
+        handler(success, std::move(result));
+    }
+}
+
+void AsyncMySQLConnection::closeNow() {
+    timer_.cancel();
+
+    if (socket_) {
+        // 只解除关联，文件描述符由 mysql_close 关闭
+        socket_->release();
+        socket_.reset();
+    }
+
+    if (mysql_) {
+        mysql_close(mysql_);
+        mysql_ = nullptr;
+    }
+
+    connected_ = false;
+}
+
+/**
+ * @brief 用转义后的参数替换SQL中的 ? 占位符
+ * 注意：SQL文本本身不能包含字面量 ?
+ */
+bool AsyncMySQLConnection::formatQuery(const std::string& sql, const std::vector<AsyncQueryParam>& params,
+                                       std::string& out) {
+    out.clear();
+    out.reserve(sql.size() + 32);
+
+    size_t next = 0;
+    for (char c : sql) {
+        if (c != '?') {
+            out.push_back(c);
+            continue;
+        }
+
+        if (next >= params.size()) {
+            LOG_ERROR("Async query has more placeholders than parameters: {}", sql);
+            return false;
+        }
+
+        const AsyncQueryParam& param = params[next++];
+        if (const long long* value = std::get_if<long long>(&param)) {
+            out += std::to_string(*value);
+        } else {
+            const std::string& text = std::get<std::string>(param);
+            std::string escaped(text.size() * 2 + 1, '\0');
+            unsigned long length = mysql_real_escape_string(mysql_, &escaped[0], text.data(), text.size());
+            out.push_back('\'');
+            out.append(escaped.data(), length);
+            out.push_back('\'');
+        }
+    }
+
+    if (next != params.size()) {
+        LOG_ERROR("Async query has fewer placeholders than parameters: {}", sql);
+        return false;
+    }
+    return true;
+}
+
+// ==========================================================
+// AsyncDatabaseManager
+// ==========================================================
+
+/**
+ * @brief 获取AsyncDatabaseManager单例实例
+ * 使用局部静态变量实现线程安全的单例模式
+ * @return AsyncDatabaseManager实例的引用
+ */
+AsyncDatabaseManager& AsyncDatabaseManager::getInstance() {
+    static AsyncDatabaseManager instance;
+    return instance;
+}
+
+AsyncDatabaseManager::AsyncDatabaseManager()
+    : initialized_(false), service_(LoadBalancer::getInstance().getServiceHandle(SERVICE_NAME)) {
+}
+
+/**
+ * @brief 析构函数
+ * 连接依赖 io_context，必须在 io_context 销毁前调用 shutdown()
+ */
+AsyncDatabaseManager::~AsyncDatabaseManager() {
+}
+
+/**
+ * @brief 初始化连接池（连接在首次使用时异步建立）
+ */
+bool AsyncDatabaseManager::initialize(net::io_context& ioc, const std::string& user, const std::string& password,
+                                      const std::string& database, size_t poolSize) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (initialized_) {
+        LOG_WARN("AsyncDatabaseManager already initialized");
+        return true;
+    }
+
+    user_ = user;
+    password_ = password;
+    database_ = database;
+
+    for (size_t i = 0; i < poolSize; ++i) {
+        auto conn = std::make_shared<AsyncMySQLConnection>(ioc, QUERY_TIMEOUT);
+        connections_.push_back(conn);
+        idle_.push_back(conn);
+    }
+
+    initialized_ = true;
+    LOG_INFO("AsyncDatabaseManager initialized with {} connections", poolSize);
+    return true;
+}
+
+/**
+ * @brief 关闭所有连接并丢弃等待中的查询
+ */
+void AsyncDatabaseManager::shutdown() {
+    std::vector<std::shared_ptr<AsyncMySQLConnection>> connections;
+    std::deque<PendingQuery> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!initialized_) {
+            return;
+        }
+        initialized_ = false;
+        connections.swap(connections_);
+        pending.swap(pending_);
+        idle_.clear();
+    }
+
+    for (auto& conn : connections) {
+        conn->close();
+    }
+    for (auto& query : pending) {
+        query.handler(false, AsyncQueryResult());
+    }
+    LOG_INFO("AsyncDatabaseManager shut down");
+}
+
+/**
+ * @brief 异步执行查询
+ * 有空闲连接时立即执行，否则进入等待队列
+ */
+void AsyncDatabaseManager::asyncQuery(const std::string& sql, std::vector<AsyncQueryParam> params,
+                                      QueryHandler handler) {
+    PendingQuery query{sql, std::move(params), std::move(handler)};
+    std::shared_ptr<AsyncMySQLConnection> conn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!initialized_) {
+            LOG_ERROR("AsyncDatabaseManager is not initialized");
+        } else if (!idle_.empty()) {
+            conn = idle_.back();
+            idle_.pop_back();
+        } else if (pending_.size() < MAX_PENDING_QUERIES) {
+            pending_.push_back(std::move(query));
+            return;
+        } else {
+            LOG_ERROR("Async query queue is full ({} pending)", pending_.size());
+        }
+    }
+
+    if (!conn) {
+        query.handler(false, AsyncQueryResult());
+        return;
+    }
+    run(std::move(conn), std::move(query));
+}
+
+/**
+ * @brief 异步根据用户名获取用户信息
+ */
+void AsyncDatabaseManager::asyncGetUserByUsername(const std::string& username, UserLookupHandler handler) {
+    asyncQuery("SELECT id, password FROM users WHERE username = ? LIMIT 1", {username},
+        [handler = std::move(handler)](bool success, AsyncQueryResult result) {
+            if (!success || result.rows.empty() || result.rows[0].size() < 2) {
+                handler(false, 0, std::string());
+                return;
+            }
+
+            int userId = 0;
+            try {
+                userId = std::stoi(result.rows[0][0]);
+            } catch (const std::exception& e) {
+                LOG_ERROR("Invalid user id '{}' for {}", result.rows[0][0], e.what());
+                handler(false, 0, std::string());
+                return;
+            }
+            handler(true, userId, std::move(result.rows[0][1]));
+        });
+}
+
+/**
+ * @brief 在指定连接上执行查询，必要时先通过负载均衡器选择实例并建立连接
+ */
+void AsyncDatabaseManager::run(std::shared_ptr<AsyncMySQLConnection> conn, PendingQuery query) {
+    auto execute = [this, conn](PendingQuery query) {
+        conn->asyncQuery(std::move(query.sql), std::move(query.params),
+            [this, conn, handler = std::move(query.handler)](bool success, AsyncQueryResult result) {
+                // 先归还连接让等待中的查询继续，再通知调用方
+                release(conn);
+                handler(success, std::move(result));
+            });
+    };
+
+    if (conn->isConnected()) {
+        execute(std::move(query));
+        return;
+    }
+
+    auto instance = LoadBalancer::getInstance().getNextHealthyInstance(service_);
+    if (!instance) {
+        LOG_ERROR("No healthy database instance available for async query");
+        release(conn);
+        query.handler(false, AsyncQueryResult());
+        return;
+    }
+
+    // 连接结果计入实例的熔断器，连续失败后该实例不再被选中
+    auto call = std::make_shared<InstanceCall>(instance);
+    conn->asyncConnect(instance->host, instance->port, user_, password_, database_,
+        [this, conn, call, execute, query = std::move(query)](bool success) mutable {
+            if (!success) {
+                call->fail();
+                call.reset();
+                release(conn);
+                query.handler(false, AsyncQueryResult());
+                return;
+            }
+            call.reset();
+            execute(std::move(query));
+        });
+}
+
+/**
+ * @brief 查询完成后归还连接，若有等待中的查询则直接复用
+ */
+void AsyncDatabaseManager::release(std::shared_ptr<AsyncMySQLConnection> conn) {
+    PendingQuery next;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!initialized_) {
+            // 已关闭，连接随最后一个引用释放
+            return;
+        }
+        if (pending_.empty()) {
+            idle_.push_back(std::move(conn));
+            return;
+        }
+        next = std::move(pending_.front());
+        pending_.pop_front();
+    }
+    run(std::move(conn), std::move(next));
+}
@@ -0,0 +1,238 @@
+#ifndef ASYNC_MYSQL_CLIENT_H
+#define ASYNC_MYSQL_CLIENT_H
+
+#include <mysql/mysql.h>
+#include <boost/asio.hpp>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <variant>
+#include <functional>
+#include "logger.h"
+#include "load_balancer.h"
+
+namespace net = boost::asio;
+
+/**
+ * @brief 异步查询参数（整数或字符串）
+ * 字符串参数在发送前使用连接的字符集转义并加引号
+ */
+using AsyncQueryParam = std::variant<long long, std::string>;
+
+/**
+ * @brief 异步查询结果
+ * NULL 列以空字符串表示
+ */
+struct AsyncQueryResult {
+    std::vector<std::vector<std::string>> rows;  // 结果集（SELECT）
+    unsigned long long affectedRows = 0;         // 影响行数（INSERT/UPDATE/DELETE）
+    unsigned long long insertId = 0;             // 自增ID（INSERT）
+};
+
+/**
+ * @brief 基于 libmysqlclient *_nonblocking 接口的异步连接
+ *
+ * 通过 asio::posix::stream_descriptor 监听套接字可读/可写事件推进协议状态机，
+ * 等待期间不占用任何线程。所有状态只在连接自己的 strand 上访问，
+ * 同一时刻只能执行一个操作（由 AsyncDatabaseManager 保证）。
+ *
+ * 注意：libmysqlclient 没有非阻塞的预处理语句接口，
+ * 因此这里使用文本协议，参数由 formatQuery 转义后拼接。
+ */
+class AsyncMySQLConnection : public std::enable_shared_from_this<AsyncMySQLConnection> {
+public:
+    using ConnectHandler = std::function<void(bool success)>;
+    using QueryHandler = std::function<void(bool success, AsyncQueryResult result)>;
+
+    /**
+     * @brief 构造函数
+     * @param ioc 驱动该连接的 io_context
+     * @param timeout 单次连接或查询的超时时间
+     */
+    AsyncMySQLConnection(net::io_context& ioc, std::chrono::milliseconds timeout);
+    ~AsyncMySQLConnection();
+
+    AsyncMySQLConnection(const AsyncMySQLConnection&) = delete;
+    AsyncMySQLConnection& operator=(const AsyncMySQLConnection&) = delete;
+
+    /**
+     * @brief 异步连接到数据库实例
+     * @param handler 完成回调，在连接的 strand 上调用
+     */
+    void asyncConnect(const std::string& host, int port, const std::string& user,
+                      const std::string& password, const std::string& database,
+                      ConnectHandler handler);
+
+    /**
+     * @brief 异步执行查询
+     * @param sql 含 ? 占位符的SQL文本
+     * @param params 按顺序替换占位符的参数
+     * @param handler 完成回调，在连接的 strand 上调用
+     */
+    void asyncQuery(std::string sql, std::vector<AsyncQueryParam> params, QueryHandler handler);
+
+    /**
+     * @brief 关闭连接（在 strand 上执行；io_context 已停止时在调用线程直接关闭）
+     */
+    void close();
+
+    bool isConnected() const { return connected_; }
+    const std::string& host() const { return host_; }
+    int port() const { return port_; }
+
+private:
+    using WaitType = net::posix::stream_descriptor::wait_type;
+    using Step = void (AsyncMySQLConnection::*)();
+
+    void startConnect();
+    void stepConnect();
+    void startQuery();
+    void stepQuery();
+    void stepStoreResult();
+
+    /**
+     * @brief 等待套接字就绪后继续执行下一步
+     */
+    void waitSocket(WaitType type, Step next);
+
+    /**
+     * @brief 套接字当前是否可写（不等待）
+     */
+    bool socketWritable() const;
+    void armTimer();
+    void fail(const std::string& reason);
+    void finishQuery(bool success);
+    void closeNow();
+    bool formatQuery(const std::string& sql, const std::vector<AsyncQueryParam>& params, std::string& out);
+
+    net::strand<net::io_context::executor_type> strand_;
+    net::steady_timer timer_;
+    std::unique_ptr<net::posix::stream_descriptor> socket_;
+    std::chrono::milliseconds timeout_;
+
+    MYSQL* mysql_;
+    std::atomic<bool> connected_;
+    bool connectWaited_;    // 第一次等待的是 TCP 握手完成（可写）
+    bool querySent_;        // 查询报文已全部写出，之后等待结果（可读）；之前等待发送缓冲区腾出空间（可写）
+    bool timedOut_;
+
+    std::string host_;
+    int port_;
+    std::string user_;
+    std::string password_;
+    std::string database_;
+
+    // 当前操作的状态
+    std::string sql_;
+    AsyncQueryResult result_;
+    ConnectHandler connectHandler_;
+    QueryHandler queryHandler_;
+};
+
+/**
+ * @brief 异步数据库管理器（单例模式）
+ *
+ * 维护一组绑定到 io_context 的 AsyncMySQLConnection，
+ * 连接全部忙碌时查询进入等待队列。少量线程即可承载大量并发查询，
+ * 查询期间不会阻塞 I/O 线程。实例通过负载均衡器的 DatabaseService 选择。
+ */
+class AsyncDatabaseManager {
+public:
+    using QueryHandler = AsyncMySQLConnection::QueryHandler;
+    using UserLookupHandler = std::function<void(bool found, int userId, std::string passwordHash)>;
+
+    /**
+     * @brief 获取AsyncDatabaseManager单例实例
+     * @return AsyncDatabaseManager实例的引用
+     */
+    static AsyncDatabaseManager& getInstance();
+
+    AsyncDatabaseManager(const AsyncDatabaseManager&) = delete;
+    AsyncDatabaseManager& operator=(const AsyncDatabaseManager&) = delete;
+
+    /**
+     * @brief 初始化连接池（连接在首次使用时异步建立）
+     * @param ioc 驱动所有连接的 io_context
+     * @param user 用户名
+     * @param password 密码
+     * @param database 数据库名称
+     * @param poolSize 连接数
+     * @return 初始化成功返回true
+     */
+    bool initialize(net::io_context& ioc, const std::string& user, const std::string& password,
+                    const std::string& database, size_t poolSize = 8);
+
+    /**
+     * @brief 关闭所有连接并丢弃等待中的查询
+     */
+    void shutdown();
+
+    /**
+     * @brief 是否已初始化
+     */
+    bool isInitialized() const { return initialized_; }
+
+    /**
+     * @brief 异步执行查询
+     * 回调在执行查询的连接的 strand 上调用，调用方需要自行切回自己的执行器
+     * @param sql 含 ? 占位符的SQL文本
+     * @param params 占位符参数
+     * @param handler 完成回调
+     */
+    void asyncQuery(const std::string& sql, std::vector<AsyncQueryParam> params, QueryHandler handler);
+
+    /**
+     * @brief 异步根据用户名获取用户信息
+     * @param username 用户名
+     * @param handler 完成回调(是否找到, 用户ID, 密码哈希)
+     */
+    void asyncGetUserByUsername(const std::string& username, UserLookupHandler handler);
+
+private:
+    AsyncDatabaseManager();
+    ~AsyncDatabaseManager();
+
+    struct PendingQuery {
+        std::string sql;
+        std::vector<AsyncQueryParam> params;
+        QueryHandler handler;
+    };
+
+    /**
+     * @brief 在指定连接上执行查询，必要时先建立连接
+     */
+    void run(std::shared_ptr<AsyncMySQLConnection> conn, PendingQuery query);
+
+    /**
+     * @brief 查询完成后归还连接，若有等待中的查询则直接复用
+     */
+    void release(std::shared_ptr<AsyncMySQLConnection> conn);
+
+    std::mutex mutex_;
+    std::atomic<bool> initialized_;
+    std::vector<std::shared_ptr<AsyncMySQLConnection>> connections_;
+    std::vector<std::shared_ptr<AsyncMySQLConnection>> idle_;
+    std::deque<PendingQuery> pending_;
+
+    std::string user_;
+    std::string password_;
+    std::string database_;
+
+    // 数据库服务在负载均衡器中的句柄
+    LoadBalancer::ServiceHandle service_;
+
+    // 与 DatabaseManager 使用同一个服务名称
+    static const std::string SERVICE_NAME;
+
+    // 单次连接或查询的超时时间
+    static constexpr std::chrono::milliseconds QUERY_TIMEOUT{10000};
+
+    // 等待队列上限，超出时直接失败以免无限堆积
+    static const size_t MAX_PENDING_QUERIES = 10000;
+};
+
+#endif // ASYNC_MYSQL_CLIENT_H
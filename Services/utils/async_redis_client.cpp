@@ -0,0 +1,592 @@
+#include "async_redis_client.h"
+#include <algorithm>
+
+namespace {
+
+// 重连退避范围
+constexpr std::chrono::milliseconds RECONNECT_BACKOFF_MIN{100};
+constexpr std::chrono::milliseconds RECONNECT_BACKOFF_MAX{5000};
+
+} // namespace
+
+// ==========================================================
+// AsyncRedisConnection
+// ==========================================================
+
+AsyncRedisConnection::AsyncRedisConnection(net::io_context& ioc, const std::string& name)
+    : strand_(net::make_strand(ioc)),
+      reconnectTimer_(strand_),
+      name_(name),
+      port_(0),
+      ctx_(nullptr),
+      connected_(false),
+      stopped_(true),
+      wantRead_(false),
+      wantWrite_(false),
+      readPending_(false),
+      writePending_(false),
+      socketGeneration_(0),
+      backoff_(RECONNECT_BACKOFF_MIN) {
+}
+
+AsyncRedisConnection::~AsyncRedisConnection() {
+    stopped_ = true;
+    if (ctx_) {
+        redisAsyncFree(ctx_);
+        ctx_ = nullptr;
+    }
+}
+
+/**
+ * @brief 开始连接（以及之后的自动重连）
+ */
+void AsyncRedisConnection::start(const std::string& host, int port, std::function<void()> onConnected) {
+    net::post(strand_, [self = shared_from_this(), host, port, onConnected = std::move(onConnected)]() mutable {
+        self->host_ = host;
+        self->port_ = port;
+        self->onConnected_ = std::move(onConnected);
+        self->stopped_ = false;
+        self->connect();
+    });
+}
+
+/**
+ * @brief 停止并关闭连接
+ * 直接在调用线程上释放上下文，调用时 io_context 不能再运行
+ */
+void AsyncRedisConnection::stop() {
+    stopped_ = true;
+    reconnectTimer_.cancel();
+    if (ctx_) {
+        // 未完成命令的回调会收到空回复
+        redisAsyncContext* ctx = ctx_;
+        ctx_ = nullptr;
+        redisAsyncFree(ctx);
+    }
+    connected_ = false;
+}
+
+void AsyncRedisConnection::connect() {
+    ctx_ = redisAsyncConnect(host_.c_str(), port_);
+    if (!ctx_ || ctx_->err) {
+        LOG_ERROR("Async Redis {} connection error: {}", name_, ctx_ ? ctx_->errstr : "can't allocate context");
+        if (ctx_) {
+            redisAsyncFree(ctx_);
+            ctx_ = nullptr;
+        }
+        scheduleReconnect();
+        return;
+    }
+
+    // 适配器必须在设置连接回调之前挂好：hiredis 通过第一次可写事件判断连接建立
+    socket_ = std::make_unique<net::posix::stream_descriptor>(strand_, ctx_->c.fd);
+    ctx_->data = this;
+    ctx_->ev.data = this;
+    ctx_->ev.addRead = &AsyncRedisConnection::onAddRead;
+    ctx_->ev.delRead = &AsyncRedisConnection::onDelRead;
+    ctx_->ev.addWrite = &AsyncRedisConnection::onAddWrite;
+    ctx_->ev.delWrite = &AsyncRedisConnection::onDelWrite;
+    ctx_->ev.cleanup = &AsyncRedisConnection::onCleanup;
+
+    redisAsyncSetConnectCallback(ctx_, &AsyncRedisConnection::onConnect);
+    redisAsyncSetDisconnectCallback(ctx_, &AsyncRedisConnection::onDisconnect);
+}
+
+void AsyncRedisConnection::scheduleReconnect() {
+    if (stopped_) {
+        return;
+    }
+
+    LOG_WARN("Async Redis {} reconnecting to {}:{} in {} ms", name_, host_, port_, backoff_.count());
+    reconnectTimer_.expires_after(backoff_);
+    backoff_ = std::min(backoff_ * 2, RECONNECT_BACKOFF_MAX);
+
+    reconnectTimer_.async_wait(net::bind_executor(strand_,
+        [self = shared_from_this()](const boost::system::error_code& ec) {
+            if (ec || self->stopped_) {
+                return;
+            }
+            self->connect();
+        }));
+}
+
+void AsyncRedisConnection::waitRead() {
+    if (readPending_ || !socket_) {
+        return;
+    }
+
+    readPending_ = true;
+    uint64_t generation = socketGeneration_;
+    socket_->async_wait(net::posix::stream_descriptor::wait_read, net::bind_executor(strand_,
+        [self = shared_from_this(), generation](const boost::system::error_code& ec) {
+            if (generation != self->socketGeneration_) {
+                return;
+            }
+            self->readPending_ = false;
+            if (ec || !self->ctx_ || !self->wantRead_) {
+                return;
+            }
+            redisAsyncHandleRead(self->ctx_);
+            // 回调中连接可能已经断开，ctx_ 会被置空
+            if (self->ctx_ && self->wantRead_) {
+                self->waitRead();
+            }
+        }));
+}
+
+void AsyncRedisConnection::waitWrite() {
+    if (writePending_ || !socket_) {
+        return;
+    }
+
+    writePending_ = true;
+    uint64_t generation = socketGeneration_;
+    socket_->async_wait(net::posix::stream_descriptor::wait_write, net::bind_executor(strand_,
+        [self = shared_from_this(), generation](const boost::system::error_code& ec) {
+            if (generation != self->socketGeneration_) {
+                return;
+            }
+            self->writePending_ = false;
+            if (ec || !self->ctx_ || !self->wantWrite_) {
+                return;
+            }
+            redisAsyncHandleWrite(self->ctx_);
+            if (self->ctx_ && self->wantWrite_) {
+                self->waitWrite();
+            }
+        }));
+}
+
+void AsyncRedisConnection::onAddRead(void* privdata) {
+    auto* self = static_cast<AsyncRedisConnection*>(privdata);
+    self->wantRead_ = true;
+    self->waitRead();
+}
+
+void AsyncRedisConnection::onDelRead(void* privdata) {
+    static_cast<AsyncRedisConnection*>(privdata)->wantRead_ = false;
+}
+
+void AsyncRedisConnection::onAddWrite(void* privdata) {
+    auto* self = static_cast<AsyncRedisConnection*>(privdata);
+    self->wantWrite_ = true;
+    self->waitWrite();
+}
+
+void AsyncRedisConnection::onDelWrite(void* privdata) {
+    static_cast<AsyncRedisConnection*>(privdata)->wantWrite_ = false;
+}
+
+/**
+ * @brief hiredis 释放上下文时调用
+ * 套接字归 hiredis 所有，这里只解除关联
+ */
+void AsyncRedisConnection::onCleanup(void* privdata) {
+    auto* self = static_cast<AsyncRedisConnection*>(privdata);
+    self->wantRead_ = false;
+    self->wantWrite_ = false;
+    self->readPending_ = false;
+    self->writePending_ = false;
+    ++self->socketGeneration_;
+    if (self->socket_) {
+        self->socket_->release();
+        self->socket_.reset();
+    }
+}
+
+void AsyncRedisConnection::onConnect(const redisAsyncContext* ctx, int status) {
+    auto* self = static_cast<AsyncRedisConnection*>(ctx->data);
+    if (status != REDIS_OK) {
+        // 回调返回后 hiredis 会释放上下文
+        LOG_ERROR("Async Redis {} failed to connect to {}:{}: {}", self->name_, self->host_, self->port_, ctx->errstr);
+        self->ctx_ = nullptr;
+        self->connected_ = false;
+        self->scheduleReconnect();
+        return;
+    }
+
+    self->connected_ = true;
+    self->backoff_ = RECONNECT_BACKOFF_MIN;
+    LOG_INFO("Async Redis {} connected to {}:{}", self->name_, self->host_, self->port_);
+
+    if (self->onConnected_) {
+        self->onConnected_();
+    }
+}
+
+void AsyncRedisConnection::onDisconnect(const redisAsyncContext* ctx, int status) {
+    auto* self = static_cast<AsyncRedisConnection*>(ctx->data);
+    self->ctx_ = nullptr;
+    self->connected_ = false;
+
+    if (!self->stopped_) {
+        LOG_WARN("Async Redis {} disconnected from {}:{} (status {})", self->name_, self->host_, self->port_, status);
+        self->scheduleReconnect();
+    }
+}
+
+void AsyncRedisConnection::onCommandReply(redisAsyncContext* /*ctx*/, void* reply, void* privdata) {
+    std::unique_ptr<CommandHandler> handler(static_cast<CommandHandler*>(privdata));
+    if (!reply) {
+        // 连接断开或上下文被释放
+        (*handler)(net::error::operation_aborted, RedisValue());
+        return;
+    }
+    (*handler)(boost::system::error_code(), toRedisValue(static_cast<redisReply*>(reply)));
+}
+
+void AsyncRedisConnection::onSubscribeReply(redisAsyncContext* /*ctx*/, void* reply, void* privdata) {
+    if (reply && privdata) {
+        (*static_cast<ReplyCallback*>(privdata))(static_cast<redisReply*>(reply));
+    }
+}
+
+/**
+ * @brief 发送一条命令（必须在 strand 上调用）
+ * 连接建立过程中发送的命令由 hiredis 缓冲，连接建立后自动发出
+ */
+void AsyncRedisConnection::command_impl(const std::vector<std::string>& args, CommandHandler handler) {
+    if (!ctx_) {
+        handler(net::error::not_connected, RedisValue());
+        return;
+    }
+
+    std::vector<const char*> argv;
+    std::vector<size_t> argvlen;
+    argv.reserve(args.size());
+    argvlen.reserve(args.size());
+    for (const auto& arg : args) {
+        argv.push_back(arg.data());
+        argvlen.push_back(arg.size());
+    }
+
+    auto* pending = new CommandHandler(std::move(handler));
+    if (redisAsyncCommandArgv(ctx_, &AsyncRedisConnection::onCommandReply, pending,
+                              (int)argv.size(), argv.data(), argvlen.data()) != REDIS_OK) {
+        std::unique_ptr<CommandHandler> failed(pending);
+        (*failed)(net::error::not_connected, RedisValue());
+    }
+}
+
+/**
+ * @brief 发送一条订阅类命令（必须在 strand 上调用）
+ */
+void AsyncRedisConnection::subscribe_impl(const std::vector<std::string>& args, ReplyCallback* callback) {
+    if (!ctx_) {
+        return;
+    }
+
+    std::vector<const char*> argv;
+    std::vector<size_t> argvlen;
+    for (const auto& arg : args) {
+        argv.push_back(arg.data());
+        argvlen.push_back(arg.size());
+    }
+
+    if (redisAsyncCommandArgv(ctx_, &AsyncRedisConnection::onSubscribeReply, callback,
+                              (int)argv.size(), argv.data(), argvlen.data()) != REDIS_OK) {
+        LOG_ERROR("Async Redis {} failed to send {}", name_, args.empty() ? "" : args[0]);
+    }
+}
+
+// ==========================================================
+// AsyncRedisClient
+// ==========================================================
+
+/**
+ * @brief 获取AsyncRedisClient单例实例
+ * 使用局部静态变量实现线程安全的单例模式
+ * @return AsyncRedisClient实例的引用
+ */
+AsyncRedisClient& AsyncRedisClient::getInstance() {
+    static AsyncRedisClient instance;
+    return instance;
+}
+
+AsyncRedisClient::AsyncRedisClient() : initialized_(false), ioc_(nullptr), nextSubscriptionId_(1) {
+    messageCallback_ = [this](const redisReply* reply) {
+        onMessage(reply);
+    };
+}
+
+/**
+ * @brief 初始化异步客户端
+ * 到各节点的连接在第一次使用时建立，建立前发出的命令由 hiredis 缓冲
+ */
+bool AsyncRedisClient::initialize(net::io_context& ioc) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (initialized_) {
+        LOG_WARN("AsyncRedisClient already initialized");
+        return true;
+    }
+
+    ioc_ = &ioc;
+    initialized_ = true;
+    LOG_INFO("AsyncRedisClient initialized, routing keys through RedisManager topology");
+    return true;
+}
+
+/**
+ * @brief 关闭所有连接
+ */
+void AsyncRedisClient::shutdown() {
+    std::vector<std::shared_ptr<AsyncRedisConnection>> connections;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!initialized_) {
+            return;
+        }
+        initialized_ = false;
+        for (auto& entry : commandConnections_) {
+            connections.push_back(std::move(entry.second));
+        }
+        for (auto& entry : subscriberConnections_) {
+            connections.push_back(std::move(entry.second));
+        }
+        commandConnections_.clear();
+        subscriberConnections_.clear();
+        channels_.clear();
+        subscriptionChannels_.clear();
+    }
+
+    for (auto& connection : connections) {
+        connection->stop();
+    }
+    LOG_INFO("AsyncRedisClient shut down");
+}
+
+net::any_io_executor AsyncRedisClient::defaultExecutor() const {
+    if (ioc_) {
+        return ioc_->get_executor();
+    }
+    return net::system_executor();
+}
+
+/**
+ * @brief 获取到指定节点的连接，不存在时创建并开始连接（调用方需持有 mutex_）
+ */
+std::shared_ptr<AsyncRedisConnection> AsyncRedisClient::connectionFor_impl(const RedisNodeAddress& address,
+                                                                          bool subscriber) {
+    if (!initialized_) {
+        return nullptr;
+    }
+
+    auto& connections = subscriber ? subscriberConnections_ : commandConnections_;
+    std::string name = address.toString();
+    auto it = connections.find(name);
+    if (it != connections.end()) {
+        return it->second;
+    }
+
+    auto connection = std::make_shared<AsyncRedisConnection>(*ioc_, (subscriber ? "subscriber " : "command ") + name);
+    if (subscriber) {
+        // 订阅连接每次（重新）建立后恢复该节点上的订阅
+        connection->start(address.host, address.port, [this, address]() {
+            resubscribe(address);
+        });
+    } else {
+        connection->start(address.host, address.port);
+    }
+    connections.emplace(name, connection);
+    return connection;
+}
+
+void AsyncRedisClient::sendCommand(std::vector<std::string> args, AsyncRedisConnection::CommandHandler handler) {
+    // 没有键的命令按空键路由，总是落在同一个节点
+    const std::string* key = redisCommandKey(args);
+    RedisNodeAddress address;
+    if (!RedisManager::getInstance().nodeAddressForKey(key ? *key : std::string(), address)) {
+        handler(net::error::not_connected, RedisValue());
+        return;
+    }
+    sendToNode(address, std::move(args), std::move(handler), false, 0);
+}
+
+/**
+ * @brief 向指定节点发送命令
+ * 集群模式下收到 MOVED/ASK 时转到目标节点重新发送
+ */
+void AsyncRedisClient::sendToNode(const RedisNodeAddress& address, std::vector<std::string> args,
+                                  AsyncRedisConnection::CommandHandler handler, bool asking, int redirects) {
+    std::shared_ptr<AsyncRedisConnection> connection;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection = connectionFor_impl(address, false);
+    }
+
+    if (!connection) {
+        handler(net::error::not_connected, RedisValue());
+        return;
+    }
+
+    net::post(connection->strand(), [this, connection, asking, redirects,
+                                     args = std::move(args), handler = std::move(handler)]() mutable {
+        // ASKING 只对同一连接上的下一条命令生效，hiredis 保证发送顺序
+        if (asking) {
+            connection->command_impl({"ASKING"}, [](boost::system::error_code, RedisValue) {});
+        }
+
+        auto retryArgs = args;
+        connection->command_impl(args, [this, redirects, retryArgs = std::move(retryArgs),
+                                        handler = std::move(handler)](boost::system::error_code ec,
+                                                                      RedisValue reply) mutable {
+            bool moved = false;
+            RedisNodeAddress target;
+            if (!ec && reply.isError() && redirects < MAX_REDIRECTS &&
+                parseRedisRedirect(reply.str, moved, target)) {
+                sendToNode(target, std::move(retryArgs), std::move(handler), !moved, redirects + 1);
+                return;
+            }
+            handler(ec, std::move(reply));
+        });
+    });
+}
+
+void AsyncRedisClient::sendSubscribeCommand(const std::string& command, const std::string& channel) {
+    // 发布按频道名路由，订阅必须连到同一个节点
+    RedisNodeAddress address;
+    if (!RedisManager::getInstance().nodeAddressForKey(channel, address)) {
+        LOG_ERROR("Cannot route Redis channel {}: RedisManager is not initialized", channel);
+        return;
+    }
+
+    std::shared_ptr<AsyncRedisConnection> connection;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection = connectionFor_impl(address, true);
+    }
+
+    if (!connection) {
+        return;
+    }
+
+    // 未连接时不发送，连接建立后 resubscribe 会补上
+    net::post(connection->strand(), [this, connection, command, channel]() {
+        if (connection->isConnected()) {
+            connection->subscribe_impl({command, channel}, &messageCallback_);
+        }
+    });
+}
+
+/**
+ * @brief 订阅频道
+ * 同一频道的多个订阅者共用一次 SUBSCRIBE
+ */
+uint64_t AsyncRedisClient::subscribe(const std::string& channel, net::any_io_executor executor, MessageHandler handler) {
+    uint64_t id;
+    bool firstSubscriber;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!initialized_) {
+            LOG_ERROR("AsyncRedisClient is not initialized, cannot subscribe to {}", channel);
+            return 0;
+        }
+
+        id = nextSubscriptionId_++;
+        auto& subscribers = channels_[channel];
+        firstSubscriber = subscribers.empty();
+        subscribers.emplace(id, Subscription{std::move(executor), std::move(handler)});
+        subscriptionChannels_[id] = channel;
+    }
+
+    if (firstSubscriber) {
+        sendSubscribeCommand("SUBSCRIBE", channel);
+    }
+    return id;
+}
+
+/**
+ * @brief 取消订阅
+ * 频道的最后一个订阅者离开时发送 UNSUBSCRIBE
+ */
+void AsyncRedisClient::unsubscribe(uint64_t id) {
+    std::string channel;
+    bool lastSubscriber = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = subscriptionChannels_.find(id);
+        if (it == subscriptionChannels_.end()) {
+            return;
+        }
+        channel = it->second;
+        subscriptionChannels_.erase(it);
+
+        auto channelIt = channels_.find(channel);
+        if (channelIt != channels_.end()) {
+            channelIt->second.erase(id);
+            if (channelIt->second.empty()) {
+                channels_.erase(channelIt);
+                lastSubscriber = true;
+            }
+        }
+    }
+
+    if (lastSubscriber) {
+        sendSubscribeCommand("UNSUBSCRIBE", channel);
+    }
+}
+
+/**
+ * @brief 重新订阅路由到该节点的所有频道（在订阅连接的 strand 上调用）
+ */
+void AsyncRedisClient::resubscribe(const RedisNodeAddress& address) {
+    RedisManager& redis = RedisManager::getInstance();
+    std::shared_ptr<AsyncRedisConnection> connection;
+    std::vector<std::string> args{"SUBSCRIBE"};
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = subscriberConnections_.find(address.toString());
+        if (it == subscriberConnections_.end()) {
+            return;
+        }
+        connection = it->second;
+
+        RedisNodeAddress channelAddress;
+        for (const auto& entry : channels_) {
+            if (redis.nodeAddressForKey(entry.first, channelAddress) && channelAddress == address) {
+                args.push_back(entry.first);
+            }
+        }
+    }
+
+    if (args.size() > 1) {
+        connection->subscribe_impl(args, &messageCallback_);
+        LOG_INFO("AsyncRedisClient resubscribed to {} channels on {}", args.size() - 1, address.toString());
+    }
+}
+
+/**
+ * @brief 处理订阅连接上收到的消息
+ * 消息被投递到每个订阅者自己的执行器上，不在订阅连接的 strand 上执行业务逻辑
+ */
+void AsyncRedisClient::onMessage(const redisReply* reply) {
+    // 消息格式: ["message", channel, payload]，订阅确认等其他类型忽略
+    if (reply->type != REDIS_REPLY_ARRAY || reply->elements < 3 ||
+        reply->element[0]->type != REDIS_REPLY_STRING ||
+        std::string(reply->element[0]->str, reply->element[0]->len) != "message") {
+        return;
+    }
+
+    std::string channel(reply->element[1]->str, reply->element[1]->len);
+    std::string message(reply->element[2]->str, reply->element[2]->len);
+
+    std::vector<Subscription> targets;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = channels_.find(channel);
+        if (it == channels_.end()) {
+            return;
+        }
+        targets.reserve(it->second.size());
+        for (const auto& entry : it->second) {
+            targets.push_back(entry.second);
+        }
+    }
+
+    for (auto& target : targets) {
+        net::post(target.executor, [handler = std::move(target.handler), channel, message]() {
+            handler(channel, message);
+        });
+    }
+}
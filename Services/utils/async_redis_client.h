@@ -0,0 +1,214 @@
+#ifndef ASYNC_REDIS_CLIENT_H
+#define ASYNC_REDIS_CLIENT_H
+
+#include <hiredis/hiredis.h>
+#include <hiredis/async.h>
+#include <boost/asio.hpp>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include "redis_manager.h"
+#include "logger.h"
+
+namespace net = boost::asio;
+
+/**
+ * @brief 基于 hiredis redisAsyncContext 的单条异步连接
+ *
+ * 通过 asio 适配器把 hiredis 的读写事件挂到 stream_descriptor 上，
+ * 所有 hiredis 调用都在连接自己的 strand 上执行。断线后按退避间隔自动重连。
+ * 由 AsyncRedisClient 持有，不直接对外使用。
+ */
+class AsyncRedisConnection : public std::enable_shared_from_this<AsyncRedisConnection> {
+public:
+    using CommandHandler = std::function<void(boost::system::error_code, RedisValue)>;
+    using ReplyCallback = std::function<void(const redisReply*)>;
+
+    AsyncRedisConnection(net::io_context& ioc, const std::string& name);
+    ~AsyncRedisConnection();
+
+    AsyncRedisConnection(const AsyncRedisConnection&) = delete;
+    AsyncRedisConnection& operator=(const AsyncRedisConnection&) = delete;
+
+    /**
+     * @brief 开始连接（以及之后的自动重连）
+     * @param onConnected 每次连接建立后在 strand 上调用，例如重新订阅频道
+     */
+    void start(const std::string& host, int port, std::function<void()> onConnected = nullptr);
+
+    /**
+     * @brief 停止并关闭连接，未完成的命令以 operation_aborted 结束
+     * 必须在 io_context 停止运行后调用
+     */
+    void stop();
+
+    /**
+     * @brief 发送一条命令（必须在 strand 上调用）
+     * @param args 命令及参数
+     * @param handler 完成回调，在 strand 上调用
+     */
+    void command_impl(const std::vector<std::string>& args, CommandHandler handler);
+
+    /**
+     * @brief 发送一条订阅类命令（必须在 strand 上调用）
+     * 回调在每条订阅消息到达时都会被调用
+     */
+    void subscribe_impl(const std::vector<std::string>& args, ReplyCallback* callback);
+
+    net::strand<net::io_context::executor_type>& strand() { return strand_; }
+    bool isConnected() const { return connected_; }
+
+private:
+    // hiredis 事件适配器回调
+    static void onAddRead(void* privdata);
+    static void onDelRead(void* privdata);
+    static void onAddWrite(void* privdata);
+    static void onDelWrite(void* privdata);
+    static void onCleanup(void* privdata);
+    static void onConnect(const redisAsyncContext* ctx, int status);
+    static void onDisconnect(const redisAsyncContext* ctx, int status);
+    static void onCommandReply(redisAsyncContext* ctx, void* reply, void* privdata);
+    static void onSubscribeReply(redisAsyncContext* ctx, void* reply, void* privdata);
+
+    void connect();
+    void scheduleReconnect();
+    void waitRead();
+    void waitWrite();
+
+    net::strand<net::io_context::executor_type> strand_;
+    net::steady_timer reconnectTimer_;
+    std::unique_ptr<net::posix::stream_descriptor> socket_;
+    std::string name_;
+    std::string host_;
+    int port_;
+    std::function<void()> onConnected_;
+
+    redisAsyncContext* ctx_;
+    std::atomic<bool> connected_;
+    bool stopped_;
+    bool wantRead_;
+    bool wantWrite_;
+    bool readPending_;
+    bool writePending_;
+    uint64_t socketGeneration_;   // 每次释放套接字递增，忽略旧套接字上的等待回调
+    std::chrono::milliseconds backoff_;
+};
+
+/**
+ * @brief 异步Redis客户端（单例模式）
+ *
+ * 运行在 GateServer 的 io_context 上，缓存读写不会阻塞I/O线程：
+ * 1. asyncCommand 支持 asio 完成令牌（回调、use_future、协程等）
+ * 2. 订阅使用独立连接，消息投递到订阅者指定的执行器（例如会话的strand）
+ * 3. 命令和频道按 RedisManager 的拓扑路由到各节点，每个节点一条命令连接和一条订阅连接；
+ *    集群模式下跟随 MOVED/ASK 重定向
+ *
+ * 命令回复中的 Redis 错误（-ERR ...）以 RedisValue::isError() 表示，
+ * error_code 只表示连接层面的失败。
+ */
+class AsyncRedisClient {
+public:
+    using MessageHandler = std::function<void(const std::string& channel, const std::string& message)>;
+
+    /**
+     * @brief 获取AsyncRedisClient单例实例
+     * @return AsyncRedisClient实例的引用
+     */
+    static AsyncRedisClient& getInstance();
+
+    AsyncRedisClient(const AsyncRedisClient&) = delete;
+    AsyncRedisClient& operator=(const AsyncRedisClient&) = delete;
+
+    /**
+     * @brief 初始化异步客户端（需在 RedisManager 初始化之后调用，沿用其节点拓扑）
+     * @param ioc GateServer 的 io_context
+     * @return 初始化成功返回true
+     */
+    bool initialize(net::io_context& ioc);
+
+    /**
+     * @brief 关闭所有连接（在 io_context::run 返回之后、io_context 销毁之前调用）
+     */
+    void shutdown();
+
+    bool isInitialized() const { return initialized_; }
+
+    /**
+     * @brief 异步执行命令
+     * @param args 命令及参数，例如 {"HSET", key, "status", "ONLINE"}
+     * @param token 完成令牌，签名为 void(boost::system::error_code, RedisValue)
+     */
+    template <typename CompletionToken>
+    auto asyncCommand(std::vector<std::string> args, CompletionToken&& token) {
+        return net::async_initiate<CompletionToken, void(boost::system::error_code, RedisValue)>(
+            [this](auto handler, std::vector<std::string> args) {
+                // 完成处理器可能只能移动，包一层 shared_ptr 以便放入 std::function
+                auto executor = net::get_associated_executor(handler, defaultExecutor());
+                auto shared = std::make_shared<decltype(handler)>(std::move(handler));
+                sendCommand(std::move(args), [shared, executor](boost::system::error_code ec, RedisValue value) {
+                    net::post(executor, [shared, ec, value = std::move(value)]() mutable {
+                        (*shared)(ec, std::move(value));
+                    });
+                });
+            },
+            token, std::move(args));
+    }
+
+    /**
+     * @brief 订阅频道
+     * @param channel 频道名
+     * @param executor 消息投递的执行器（例如会话的strand）
+     * @param handler 消息回调
+     * @return 订阅ID，用于取消订阅
+     */
+    uint64_t subscribe(const std::string& channel, net::any_io_executor executor, MessageHandler handler);
+
+    /**
+     * @brief 取消订阅
+     * @param id subscribe 返回的订阅ID
+     */
+    void unsubscribe(uint64_t id);
+
+private:
+    AsyncRedisClient();
+    ~AsyncRedisClient() = default;
+
+    struct Subscription {
+        net::any_io_executor executor;
+        MessageHandler handler;
+    };
+
+    net::any_io_executor defaultExecutor() const;
+    std::shared_ptr<AsyncRedisConnection> connectionFor_impl(const RedisNodeAddress& address, bool subscriber);
+    void sendCommand(std::vector<std::string> args, AsyncRedisConnection::CommandHandler handler);
+    void sendToNode(const RedisNodeAddress& address, std::vector<std::string> args,
+                    AsyncRedisConnection::CommandHandler handler, bool asking, int redirects);
+    void sendSubscribeCommand(const std::string& command, const std::string& channel);
+    void onMessage(const redisReply* reply);
+    void resubscribe(const RedisNodeAddress& address);
+
+    // 单条命令最多跟随的重定向次数
+    static const int MAX_REDIRECTS = 5;
+
+    std::mutex mutex_;
+    std::atomic<bool> initialized_;
+    net::io_context* ioc_;
+
+    // 节点地址 -> 连接
+    std::unordered_map<std::string, std::shared_ptr<AsyncRedisConnection>> commandConnections_;
+    std::unordered_map<std::string, std::shared_ptr<AsyncRedisConnection>> subscriberConnections_;
+
+    // 频道 -> (订阅ID -> 订阅信息)，以及订阅ID -> 频道
+    std::unordered_map<std::string, std::unordered_map<uint64_t, Subscription>> channels_;
+    std::unordered_map<uint64_t, std::string> subscriptionChannels_;
+    uint64_t nextSubscriptionId_;
+
+    // 订阅连接上所有消息共用的回调
+    AsyncRedisConnection::ReplyCallback messageCallback_;
+};
+
+#endif // ASYNC_REDIS_CLIENT_H
@@ -11,6 +11,9 @@
 // 服务名称常量，用于在负载均衡器中标识数据库服务
 const std::string DatabaseManager::SERVICE_NAME = "DatabaseService";
 
+// 只读副本服务名称
+const std::string DatabaseManager::REPLICA_SERVICE_NAME = "DatabaseReplicaService";
+
 /**
  * @brief 获取DatabaseManager单例实例
  * 使用局部静态变量实现线程安全的单例模式
@@ -25,11 +28,23 @@ DatabaseManager& DatabaseManager::getInstance() {
  * @brief DatabaseManager构造函数
  * 初始化MySQL库并获取负载均衡器实例引用
  */
-DatabaseManager::DatabaseManager() : connection_(nullptr), connected_(false),
-                                   loadBalancer_(LoadBalancer::getInstance()) {
+DatabaseManager::DatabaseManager() : primary_(SERVICE_NAME, MAX_CACHED_STATEMENTS),
+                                   replica_(REPLICA_SERVICE_NAME, MAX_CACHED_STATEMENTS),
+                                   replicasConfigured_(false),
+                                   maxReplicaLagSeconds_(5),
+                                   pinWindow_(std::chrono::milliseconds(5000)),
+                                   loadBalancer_(LoadBalancer::getInstance()),
+                                   primaryService_(loadBalancer_.getServiceHandle(SERVICE_NAME)),
+                                   replicaService_(loadBalancer_.getServiceHandle(REPLICA_SERVICE_NAME)) {
     // 初始化MySQL客户端库
     mysql_library_init(0, nullptr, nullptr);
     
+    // 注意：在实际应用中，您可能需要存储每个实例的用户和密码信息
+    // 这里为了简化，主库使用默认值，副本使用登记时给出的认证信息
+    currentUser_ = "im_user";
+    currentPassword_ = "password";
+    currentDatabase_ = "im_database";
+    
     // 可以在这里添加默认的数据库实例
     // addDatabaseInstance("127.0.0.1", 3307, "im_user", "password", "im_database", 1);
 }
@@ -54,14 +69,49 @@ DatabaseManager::~DatabaseManager() {
  * @param database 数据库名称
  * @param weight 负载均衡权重
  */
-void DatabaseManager::addDatabaseInstance(const std::string& host, int port, 
-                                         const std::string& user, const std::string& password, 
+void DatabaseManager::addDatabaseInstance(const std::string& host, int port,
+                                         const std::string& user, const std::string& password,
                                          const std::string& database, int weight) {
     // 将数据库实例添加到负载均衡器中
     loadBalancer_.addServiceInstance(SERVICE_NAME, host, port, weight);
     LOG_INFO("Added database instance: {}:{} with weight {}", host, port, weight);
 }
 
+/**
+ * @brief 添加只读副本实例到负载均衡器
+ * @param host 副本主机地址
+ * @param port 副本端口
+ * @param user 用户名
+ * @param password 密码
+ * @param database 数据库名称
+ * @param weight 负载均衡权重
+ */
+void DatabaseManager::addReplicaInstance(const std::string& host, int port,
+                                        const std::string& user, const std::string& password,
+                                        const std::string& database, int weight) {
+    loadBalancer_.addServiceInstance(REPLICA_SERVICE_NAME, host, port, weight);
+    
+    std::lock_guard<std::mutex> lock(replicaMutex_);
+    replicaCredentials_[host + ":" + std::to_string(port)] = Credentials{user, password, database};
+    replicasConfigured_ = true;
+    LOG_INFO("Added read-only database replica: {}:{} with weight {}", host, port, weight);
+}
+
+/**
+ * @brief 设置读写分离参数
+ * @param pinWindow 写入后同一会话的读请求固定走主库的时长
+ * @param maxReplicaLagSeconds 允许的最大复制延迟（秒）
+ */
+void DatabaseManager::setReadWriteSplitOptions(std::chrono::milliseconds pinWindow, int maxReplicaLagSeconds) {
+    std::lock(pinsMutex_, replicaMutex_);
+    std::lock_guard<std::mutex> pinsLock(pinsMutex_, std::adopt_lock);
+    std::lock_guard<std::mutex> replicaLock(replicaMutex_, std::adopt_lock);
+    pinWindow_ = pinWindow;
+    maxReplicaLagSeconds_ = maxReplicaLagSeconds;
+    LOG_INFO("Read/write split options: pin window {} ms, max replica lag {} s",
+             pinWindow_.count(), maxReplicaLagSeconds_);
+}
+
 /**
  * @brief 更新数据库实例的健康状态
  * @param host 数据库主机地址
@@ -71,23 +121,39 @@ void DatabaseManager::addDatabaseInstance(const std::string& host, int port,
 void DatabaseManager::updateInstanceHealth(const std::string& host, int port, bool isHealthy) {
     // 更新负载均衡器中对应实例的健康状态
     loadBalancer_.updateHealthStatus(SERVICE_NAME, host, port, isHealthy);
-    LOG_INFO("Updated database instance health status: {}:{} to {}", host, port, 
+    LOG_INFO("Updated database instance health status: {}:{} to {}", host, port,
              isHealthy ? "healthy" : "unhealthy");
 }
 
+/**
+ * @brief 将连接对应的实例标记为不健康
+ * @param conn 出错的连接
+ */
+void DatabaseManager::markUnhealthy(const DatabaseConnection& conn) {
+    loadBalancer_.updateHealthStatus(conn.serviceName, conn.host, conn.port, false);
+    LOG_INFO("Updated {} instance health status: {}:{} to unhealthy", conn.serviceName, conn.host, conn.port);
+}
+
+/**
+ * @brief 连接对应实例的熔断器是否放行
+ * @param conn 数据库连接
+ * @return 熔断打开时返回false，调用方应断开并改选其他实例
+ */
+bool DatabaseManager::isAdmitted(const DatabaseConnection& conn) {
+    return !conn.instance || conn.instance->breaker->isAvailable();
+}
+
 /**
  * @brief 断开当前数据库连接
- * 线程安全地断开当前数据库连接并释放资源
+ * 线程安全地断开主库和副本连接并释放资源
  */
 void DatabaseManager::disconnect() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (connection_) {
-        LOG_INFO("Disconnecting from database {}:{}", currentHost_, currentPort_);
-        mysql_close(connection_);
-        connection_ = nullptr;
-        connected_ = false;
-        LOG_INFO("Disconnected from database {}:{}", currentHost_, currentPort_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closeConnection_impl(primary_);
     }
+    std::lock_guard<std::mutex> lock(replicaMutex_);
+    closeConnection_impl(replica_);
 }
 
 // ==========================================================
@@ -95,86 +161,281 @@ void DatabaseManager::disconnect() {
 // ==========================================================
 
 /**
- * @brief 私有的、无锁的连接实现
- * 假设调用者已经持有了 mutex_
- * 使用负载均衡器选择一个健康的数据库实例进行连接
+ * @brief 关闭连接并释放其上的预处理语句
+ * 假设调用者已经持有了该连接的锁（主库 mutex_，副本 replicaMutex_）
  */
-bool DatabaseManager::connect_impl() {
-    if (connected_) {
-        return true;
-    }
-    
-    // 使用负载均衡器选择一个健康的数据库实例
-    auto dbInstance = loadBalancer_.getNextHealthyInstance(SERVICE_NAME);
-    if (!dbInstance) {
-        LOG_ERROR("No healthy database instances available");
-        return false;
-    }
-    
+void DatabaseManager::closeConnection_impl(DatabaseConnection& conn) {
+    if (!conn.mysql) {
+        return;
+    }
+    
+    LOG_INFO("Disconnecting from database {}:{}", conn.host, conn.port);
+    // 预处理语句必须在连接关闭之前释放
+    conn.stmtCache.reset(nullptr);
+    mysql_close(conn.mysql);
+    conn.mysql = nullptr;
+    conn.connected = false;
+    LOG_INFO("Disconnected from database {}:{}", conn.host, conn.port);
+}
+
+/**
+ * @brief 建立到指定实例的连接
+ * 假设调用者已经持有了该连接的锁（主库 mutex_，副本 replicaMutex_）
+ */
+bool DatabaseManager::openConnection_impl(DatabaseConnection& conn, const std::shared_ptr<ServiceInstance>& instance) {
     // 更新当前连接信息
-    currentHost_ = dbInstance->host;
-    currentPort_ = dbInstance->port;
-    
-    // 注意：在实际应用中，您可能需要存储每个实例的用户和密码信息
-    // 这里为了简化，使用默认值
-    currentUser_ = "im_user";
-    currentPassword_ = "password";
-    currentDatabase_ = "im_database";
-    
-    connection_ = mysql_init(nullptr);
-    if (!connection_) {
+    conn.host = instance->host;
+    conn.port = instance->port;
+    conn.instance = instance;
+    conn.legacyReplicaStatus = false;
+    
+    const std::string* user = &currentUser_;
+    const std::string* password = &currentPassword_;
+    const std::string* database = &currentDatabase_;
+    if (conn.serviceName == REPLICA_SERVICE_NAME) {
+        auto it = replicaCredentials_.find(conn.host + ":" + std::to_string(conn.port));
+        if (it != replicaCredentials_.end()) {
+            user = &it->second.user;
+            password = &it->second.password;
+            database = &it->second.database;
+        }
+    }
+    
+    conn.mysql = mysql_init(nullptr);
+    if (!conn.mysql) {
         LOG_ERROR("mysql_init() failed");
-        // 标记实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
         return false;
     }
     
     // 设置连接选项
-    mysql_options(connection_, MYSQL_OPT_CONNECT_TIMEOUT, "10");
-    mysql_options(connection_, MYSQL_OPT_READ_TIMEOUT, "10");
-    mysql_options(connection_, MYSQL_OPT_WRITE_TIMEOUT, "10");
+    mysql_options(conn.mysql, MYSQL_OPT_CONNECT_TIMEOUT, "10");
+    mysql_options(conn.mysql, MYSQL_OPT_READ_TIMEOUT, "10");
+    mysql_options(conn.mysql, MYSQL_OPT_WRITE_TIMEOUT, "10");
     
     // 强制使用TCP协议
     enum mysql_protocol_type protocol = MYSQL_PROTOCOL_TCP;
-    mysql_options(connection_, MYSQL_OPT_PROTOCOL, (void*)&protocol);
-
+    mysql_options(conn.mysql, MYSQL_OPT_PROTOCOL, (void*)&protocol);
+    
     // 打印调试信息
     LOG_INFO("--- MySQL Client Debug Info ---");
     LOG_INFO("  Client Version: {}", mysql_get_client_info());
     LOG_INFO("  Connecting with:");
-    LOG_INFO("    Host: {}", currentHost_.c_str());
-    LOG_INFO("    User: {}", currentUser_.c_str());
-    LOG_INFO("    DB:   {}", currentDatabase_.c_str());
-    LOG_INFO("    Port: {}", currentPort_);
+    LOG_INFO("    Role: {}", conn.serviceName);
+    LOG_INFO("    Host: {}", conn.host.c_str());
+    LOG_INFO("    User: {}", user->c_str());
+    LOG_INFO("    DB:   {}", database->c_str());
+    LOG_INFO("    Port: {}", conn.port);
     LOG_INFO("    Protocol: TCP");
     LOG_INFO("-----------------------------------");
     
     // 连接到数据库
     LOG_INFO("Attempting to connect to database...");
     
-    MYSQL* result = mysql_real_connect(connection_, currentHost_.c_str(), currentUser_.c_str(), 
-                           currentPassword_.c_str(), currentDatabase_.c_str(), currentPort_, nullptr, 0);
+    // 连接失败和超时计入实例的熔断器，连续失败后不再选中该实例
+    InstanceCall call(instance);
+    MYSQL* result = mysql_real_connect(conn.mysql, conn.host.c_str(), user->c_str(),
+                           password->c_str(), database->c_str(), conn.port, nullptr, 0);
     
     if (!result) {
-        LOG_ERROR("mysql_real_connect() failed: {}", mysql_error(connection_));
-        mysql_close(connection_);
-        connection_ = nullptr;
-        // 标记实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
+        call.fail();
+        LOG_ERROR("mysql_real_connect() failed: {}", mysql_error(conn.mysql));
+        mysql_close(conn.mysql);
+        conn.mysql = nullptr;
         return false;
     }
     
-    connected_ = true;
-    LOG_INFO("Connected to database {}:{} successfully", currentHost_, currentPort_);
+    conn.connected = true;
+    
+    // 语句缓存绑定到新连接，旧语句在下次使用时重新准备
+    conn.stmtCache.reset(conn.mysql);
+    LOG_INFO("Connected to database {}:{} successfully", conn.host, conn.port);
     return true;
 }
 
+/**
+ * @brief 私有的、无锁的连接实现
+ * 假设调用者已经持有了 mutex_
+ * 使用负载均衡器选择一个健康的数据库实例进行连接
+ */
+bool DatabaseManager::connect_impl() {
+    if (isConnected_impl()) {
+        return true;
+    }
+    
+    // 旧连接已失效或实例已被熔断：先丢弃其上的预处理语句，再释放连接句柄
+    if (primary_.mysql) {
+        LOG_WARN("Database connection to {}:{} lost or circuit open, reconnecting", primary_.host, primary_.port);
+        closeConnection_impl(primary_);
+    }
+    
+    // 使用负载均衡器选择一个健康的数据库实例，优先选延迟低、在途请求少的
+    auto dbInstance = loadBalancer_.getNextHealthyInstance(primaryService_, LoadBalanceAlgorithm::PowerOfTwoChoices);
+    if (!dbInstance) {
+        LOG_ERROR("No healthy database instances available");
+        return false;
+    }
+    
+    return openConnection_impl(primary_, dbInstance);
+}
+
 /**
  * @brief 私有的、无锁的连接状态检查实现
  * 假设调用者已经持有了 mutex_
  */
 bool DatabaseManager::isConnected_impl() const {
-    return connected_ && mysql_ping(connection_) == 0;
+    // 熔断打开的实例视为不可用，调用方随后的 connect_impl() 会改选其他实例
+    return primary_.connected && isAdmitted(primary_) && mysql_ping(primary_.mysql) == 0;
+}
+
+/**
+ * @brief 记录一次写入，使该会话在固定窗口内的读请求走主库
+ */
+void DatabaseManager::pinSessionToPrimary(const std::string& sessionKey) {
+    if (!replicasConfigured_ || sessionKey.empty()) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(pinsMutex_);
+    auto now = std::chrono::steady_clock::now();
+    
+    // 固定表过大时清理已过期的条目
+    if (primaryPins_.size() >= MAX_PRIMARY_PINS) {
+        for (auto it = primaryPins_.begin(); it != primaryPins_.end(); ) {
+            if (it->second <= now) {
+                it = primaryPins_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    
+    primaryPins_[sessionKey] = now + pinWindow_;
+}
+
+/**
+ * @brief 检查会话是否仍处于写后固定主库的窗口内
+ */
+bool DatabaseManager::isPinnedToPrimary(const std::string& sessionKey) {
+    if (sessionKey.empty()) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(pinsMutex_);
+    auto it = primaryPins_.find(sessionKey);
+    if (it == primaryPins_.end()) {
+        return false;
+    }
+    
+    if (it->second <= std::chrono::steady_clock::now()) {
+        primaryPins_.erase(it);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 查询副本的复制延迟
+ * 假设调用者已经持有了 replicaMutex_
+ * @return 延迟秒数；复制未运行或查询失败返回-1；非复制节点返回0
+ */
+long long DatabaseManager::queryReplicaLag_impl(DatabaseConnection& conn) {
+    if (mysql_query(conn.mysql, conn.legacyReplicaStatus ? "SHOW SLAVE STATUS" : "SHOW REPLICA STATUS")) {
+        // 8.0.22 之前的版本不认识 SHOW REPLICA STATUS（ER_PARSE_ERROR），改用旧语句重试
+        if (!conn.legacyReplicaStatus && mysql_errno(conn.mysql) == 1064) {
+            LOG_INFO("{}:{} does not support SHOW REPLICA STATUS, using SHOW SLAVE STATUS", conn.host, conn.port);
+            conn.legacyReplicaStatus = true;
+            return queryReplicaLag_impl(conn);
+        }
+        LOG_WARN("Failed to query replication status on {}:{}: {}", conn.host, conn.port, mysql_error(conn.mysql));
+        return -1;
+    }
+    
+    MYSQL_RES* result = mysql_store_result(conn.mysql);
+    if (!result) {
+        return -1;
+    }
+    
+    MYSQL_ROW row = mysql_fetch_row(result);
+    if (!row) {
+        // 没有复制状态：该实例不是复制节点（例如开发环境直接把主库登记为副本）
+        mysql_free_result(result);
+        LOG_DEBUG("{}:{} reports no replication status, treating lag as 0", conn.host, conn.port);
+        return 0;
+    }
+    
+    long long lag = -1;
+    unsigned int numFields = mysql_num_fields(result);
+    MYSQL_FIELD* fields = mysql_fetch_fields(result);
+    for (unsigned int i = 0; i < numFields; ++i) {
+        // 旧语句中该列名为 Seconds_Behind_Master
+        if (std::strcmp(fields[i].name, "Seconds_Behind_Source") == 0 ||
+            std::strcmp(fields[i].name, "Seconds_Behind_Master") == 0) {
+            // NULL 表示复制线程未运行
+            if (row[i]) {
+                lag = std::atoll(row[i]);
+            }
+            break;
+        }
+    }
+    
+    mysql_free_result(result);
+    return lag;
+}
+
+/**
+ * @brief 确保副本连接可用且复制延迟在允许范围内
+ * 假设调用者已经持有了 replicaMutex_
+ */
+bool DatabaseManager::ensureReplica_impl() {
+    auto now = std::chrono::steady_clock::now();
+    
+    // 冷却期结束后，让之前因延迟被剔除的副本重新参与选择
+    if (!laggingReplicas_.empty() && now >= laggingRetryAt_) {
+        for (const auto& replica : laggingReplicas_) {
+            loadBalancer_.updateHealthStatus(REPLICA_SERVICE_NAME, replica.first, replica.second, true);
+        }
+        laggingReplicas_.clear();
+    }
+    
+    // 当前副本被熔断时放弃连接，改选其他副本（都不可用时读请求回退到主库）
+    if (replica_.connected && !isAdmitted(replica_)) {
+        LOG_WARN("Replica {}:{} circuit open, switching replicas", replica_.host, replica_.port);
+        closeConnection_impl(replica_);
+    }
+    
+    if (replica_.connected && now - replica_.lastLagCheck < LAG_CHECK_INTERVAL) {
+        return true;
+    }
+    
+    // 当前副本可能已断开：尝试重新选择，最多尝试副本数量次
+    size_t attempts = loadBalancer_.getServiceInstances(REPLICA_SERVICE_NAME).size();
+    for (size_t i = 0; i < attempts; ++i) {
+        if (!replica_.connected) {
+            auto instance = loadBalancer_.getNextHealthyInstance(replicaService_, LoadBalanceAlgorithm::PowerOfTwoChoices);
+            if (!instance) {
+                return false;
+            }
+            if (!openConnection_impl(replica_, instance)) {
+                continue;
+            }
+        }
+    
+        long long lag = queryReplicaLag_impl(replica_);
+        replica_.lastLagCheck = now;
+        if (lag >= 0 && lag <= maxReplicaLagSeconds_) {
+            return true;
+        }
+    
+        // 复制延迟超限（或复制已停止）：剔除该副本，冷却期后再试
+        LOG_WARN("Replica {}:{} excluded, replication lag {} s exceeds {} s",
+                 replica_.host, replica_.port, lag, maxReplicaLagSeconds_);
+        laggingReplicas_.emplace_back(replica_.host, replica_.port);
+        laggingRetryAt_ = now + LAG_CHECK_INTERVAL;
+        markUnhealthy(replica_);
+        closeConnection_impl(replica_);
+    }
+    
+    return false;
 }
 
 // ==========================================================
@@ -201,6 +462,28 @@ bool DatabaseManager::isConnected() const {
     return isConnected_impl();
 }
 
+/**
+ * @brief 获取用于只读查询的连接
+ * 副本可用时只持有 replicaMutex_，否则回退到主库并持有 mutex_
+ * @param sessionKey 会话标识，为空表示不要求读己之写
+ * @return 连接租约，主库也不可用时 get() 返回nullptr
+ */
+DatabaseManager::ReadConnection DatabaseManager::acquireReadConnection(const std::string& sessionKey) {
+    if (replicasConfigured_ && !isPinnedToPrimary(sessionKey)) {
+        std::unique_lock<std::mutex> lock(replicaMutex_);
+        if (ensureReplica_impl()) {
+            return ReadConnection(std::move(lock), &replica_);
+        }
+    }
+    
+    // 回退到主库
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!isConnected_impl() && !connect_impl()) {
+        return ReadConnection();
+    }
+    return ReadConnection(std::move(lock), &primary_);
+}
+
 // ==========================================================
 // 依赖其他调用的公有函数
 // ==========================================================
@@ -221,7 +504,7 @@ bool DatabaseManager::createUser(const std::string& username, const std::string&
         return false;
     }
     
-    // 检查用户是否已存在 (调用无锁版本)
+    // 检查用户是否已存在 (调用无锁版本，走主库以避免副本延迟导致重复注册)
     if (userExistsNoLock(username)) {
         LOG_ERROR("User already exists: {}", username);
         return false;
@@ -231,23 +514,88 @@ bool DatabaseManager::createUser(const std::string& username, const std::string&
     std::string passwordHash = sha256(password);
     
     // 准备SQL语句，包含邮箱字段
-    std::string query = "INSERT INTO users (username, password, email) VALUES ('" + 
+    std::string query = "INSERT INTO users (username, password, email) VALUES ('" +
                         username + "', '" + passwordHash + "', '" + email + "')";
     
     // 执行查询
-    if (mysql_query(connection_, query.c_str())) {
-        LOG_ERROR("Failed to execute query: {}", mysql_error(connection_));
+    if (mysql_query(primary_.mysql, query.c_str())) {
+        LOG_ERROR("Failed to execute query: {}", mysql_error(primary_.mysql));
         // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
+        markUnhealthy(primary_);
         return false;
     }
     
     // 获取插入的用户ID
-    userId = (int)mysql_insert_id(connection_);
+    userId = (int)mysql_insert_id(primary_.mysql);
+    
+    // 注册后立即登录时应能读到刚写入的用户
+    pinSessionToPrimary("name:" + username);
     LOG_INFO("User created successfully with ID: {}", userId);
     return true;
 }
 
+/**
+ * @brief 从语句缓存获取预处理语句
+ * 假设调用者已经持有了该连接的锁
+ * @param conn 执行语句的连接
+ * @param sql SQL文本
+ * @return 语句指针，失败返回nullptr
+ */
+PreparedStatement* DatabaseManager::acquireStatement_impl(DatabaseConnection& conn, const std::string& sql) {
+    PreparedStatement* stmt = conn.stmtCache.acquire(sql);
+    if (!stmt) {
+        // 标记当前实例为不健康
+        markUnhealthy(conn);
+    }
+    return stmt;
+}
+
+/**
+ * @brief 绑定参数并执行缓存的预处理语句
+ * 假设调用者已经持有了该连接的锁
+ * @param conn 执行语句的连接
+ * @param stmt 预处理语句
+ * @return 成功返回true，否则返回false
+ */
+bool DatabaseManager::executeStatement_impl(DatabaseConnection& conn, PreparedStatement* stmt) {
+    const char* step = nullptr;
+    
+    if (!stmt->params.empty() && mysql_stmt_bind_param(stmt->stmt, stmt->params.data())) {
+        step = "mysql_stmt_bind_param()";
+    } else if (!stmt->results.empty() && !stmt->resultsBound) {
+        // 结果缓冲区归语句所有，只需绑定一次
+        if (mysql_stmt_bind_result(stmt->stmt, stmt->results.data())) {
+            step = "mysql_stmt_bind_result()";
+        } else {
+            stmt->resultsBound = true;
+        }
+    }
+    
+    if (!step) {
+        // 执行耗时和失败回报给负载均衡器，重连时据此选择实例
+        InstanceCall call(conn.instance);
+        if (mysql_stmt_execute(stmt->stmt)) {
+            step = "mysql_stmt_execute()";
+            call.fail();
+        }
+    }
+    
+    if (!step) {
+        return true;
+    }
+    
+    LOG_ERROR("{} failed: {}", step, mysql_stmt_error(stmt->stmt));
+    // 句柄可能已损坏（例如连接断开或表结构变更），移出缓存以便下次重新准备
+    std::string sql = stmt->sql;
+    conn.stmtCache.invalidate(sql);
+    // 失败已经计入实例的熔断器，失败率超限后实例才会被剔除，不因单次错误永久下线
+    // 副本不做每次ping检测，出错后直接断开，下次读请求重新选择副本
+    if (&conn == &replica_) {
+        closeConnection_impl(replica_);
+    }
+    return false;
+}
+
 /**
  * @brief 根据用户名获取用户信息
  * @param username 用户名
@@ -256,105 +604,54 @@ bool DatabaseManager::createUser(const std::string& username, const std::string&
  * @return 成功返回true，否则返回false
  */
 bool DatabaseManager::getUserByUsername(const std::string& username, int& userId, std::string& passwordHash) {
-    std::lock_guard<std::mutex> lock(mutex_); // 加锁保护整个操作
-    
-    // 调用无锁的 _impl 版本
-    if (!isConnected_impl() && !connect_impl()) {
+    // 读请求：优先路由到副本，刚注册的用户固定走主库；租约持有所选连接的锁
+    ReadConnection read = acquireReadConnection("name:" + username);
+    DatabaseConnection* conn = read.conn_;
+    if (!conn) {
         return false;
     }
     
-    // 使用预处理语句防止SQL注入
-    const char* query = "SELECT id, password FROM users WHERE username = ?";
-    MYSQL_STMT* stmt = mysql_stmt_init(connection_);
+    // 使用缓存的预处理语句防止SQL注入
+    static const std::string query = "SELECT id, password FROM users WHERE username = ?";
+    PreparedStatement* stmt = acquireStatement_impl(*conn, query);
     if (!stmt) {
-        LOG_ERROR("mysql_stmt_init() failed: {}", mysql_error(connection_));
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
         return false;
     }
     
-    if (mysql_stmt_prepare(stmt, query, strlen(query))) {
-        LOG_ERROR("mysql_stmt_prepare() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
-        return false;
+    // 绑定结果（仅首次）
+    if (!stmt->resultsBound) {
+        stmt->bindIntResult(0);
+        stmt->bindStringResult(1, 256);
     }
     
     // 绑定参数
-    MYSQL_BIND param_bind[1];
-    memset(param_bind, 0, sizeof(param_bind));
-    
-    param_bind[0].buffer_type = MYSQL_TYPE_STRING;
-    param_bind[0].buffer = (char*)username.c_str();
-    param_bind[0].buffer_length = username.length();
-    
-    if (mysql_stmt_bind_param(stmt, param_bind)) {
-        LOG_ERROR("mysql_stmt_bind_param() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
-        return false;
-    }
-    
-    // 绑定结果
-    MYSQL_BIND result_bind[2];
-    memset(result_bind, 0, sizeof(result_bind));
-    
-    int id;
-    char hash[256];
-    unsigned long hash_length;
-    
-    result_bind[0].buffer_type = MYSQL_TYPE_LONG;
-    result_bind[0].buffer = (char*)&id;
-    result_bind[0].is_null = 0;
-    result_bind[0].length = 0;
-    result_bind[0].error = 0;
-    
-    result_bind[1].buffer_type = MYSQL_TYPE_STRING;
-    result_bind[1].buffer = hash;
-    result_bind[1].buffer_length = sizeof(hash);
-    result_bind[1].length = &hash_length;
-    result_bind[1].is_null = 0;
-    result_bind[1].error = 0;
-    
-    if (mysql_stmt_bind_result(stmt, result_bind)) {
-        LOG_ERROR("mysql_stmt_bind_result() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
-        return false;
-    }
+    stmt->setStringParam(0, username);
     
     // 执行查询
-    if (mysql_stmt_execute(stmt)) {
-        LOG_ERROR("mysql_stmt_execute() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
+    if (!executeStatement_impl(*conn, stmt)) {
         return false;
     }
     
     // 获取结果
-    int fetch_result = mysql_stmt_fetch(stmt);
+    int fetch_result = mysql_stmt_fetch(stmt->stmt);
     if (fetch_result == MYSQL_NO_DATA) {
-        mysql_stmt_close(stmt);
+        mysql_stmt_free_result(stmt->stmt);
         return false;
     } else if (fetch_result == MYSQL_DATA_TRUNCATED) {
         LOG_WARN("Data truncated when fetching user data");
     } else if (fetch_result != 0) {
-        LOG_ERROR("mysql_stmt_fetch() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
+        LOG_ERROR("mysql_stmt_fetch() failed: {}", mysql_stmt_error(stmt->stmt));
+        conn->stmtCache.invalidate(query);
         // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
+        markUnhealthy(*conn);
         return false;
     }
     
     // 获取用户信息
-    userId = id;
-    passwordHash = std::string(hash, hash_length);
+    userId = stmt->intResult(0);
+    passwordHash = stmt->stringResult(1);
     
-    mysql_stmt_close(stmt);
+    mysql_stmt_free_result(stmt->stmt);
     return true;
 }
 
@@ -366,7 +663,7 @@ bool DatabaseManager::getUserByUsername(const std::string& username, int& userId
 bool DatabaseManager::userExists(const std::string& username) {
     std::lock_guard<std::mutex> lock(mutex_);
     // 这个调用是正确的，因为 userExistsNoLock 会在同一个锁的保护下运行
-    return userExistsNoLock(username); 
+    return userExistsNoLock(username);
 }
 
 /**
@@ -382,53 +679,30 @@ bool DatabaseManager::userExistsNoLock(const std::string& username) {
         return false;
     }
     
-    // 使用预处理语句防止SQL注入
-    const char* query = "SELECT id FROM users WHERE username = ? LIMIT 1";
-    MYSQL_STMT* stmt = mysql_stmt_init(connection_);
+    // 使用缓存的预处理语句防止SQL注入
+    // 注册前的查重必须读主库，避免副本延迟导致重复注册
+    static const std::string query = "SELECT id FROM users WHERE username = ? LIMIT 1";
+    PreparedStatement* stmt = acquireStatement_impl(primary_, query);
     if (!stmt) {
-        LOG_ERROR("mysql_stmt_init() failed: {}", mysql_error(connection_));
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
         return false;
     }
     
-    if (mysql_stmt_prepare(stmt, query, strlen(query))) {
-        LOG_ERROR("mysql_stmt_prepare() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
-        return false;
+    if (!stmt->resultsBound) {
+        stmt->bindIntResult(0);
     }
     
     // 绑定参数
-    MYSQL_BIND param_bind[1];
-    memset(param_bind, 0, sizeof(param_bind));
-    
-    param_bind[0].buffer_type = MYSQL_TYPE_STRING;
-    param_bind[0].buffer = (char*)username.c_str();
-    param_bind[0].buffer_length = username.length();
-    
-    if (mysql_stmt_bind_param(stmt, param_bind)) {
-        LOG_ERROR("mysql_stmt_bind_param() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
-        return false;
-    }
+    stmt->setStringParam(0, username);
     
     // 执行查询
-    if (mysql_stmt_execute(stmt)) {
-        LOG_ERROR("mysql_stmt_execute() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
+    if (!executeStatement_impl(primary_, stmt)) {
         return false;
     }
     
     // 检查是否有结果
-    bool exists = mysql_stmt_fetch(stmt) == 0;
+    bool exists = mysql_stmt_fetch(stmt->stmt) == 0;
     
-    mysql_stmt_close(stmt);
+    mysql_stmt_free_result(stmt->stmt);
     return exists;
 }
 
@@ -447,59 +721,27 @@ bool DatabaseManager::storeMessage(int senderId, int receiverId, const std::stri
         return false;
     }
     
-    // 使用预处理语句防止SQL注入
-    const char* query = "INSERT INTO messages (sender_id, receiver_id, content) VALUES (?, ?, ?)";
-    MYSQL_STMT* stmt = mysql_stmt_init(connection_);
+    // 使用缓存的预处理语句防止SQL注入
+    static const std::string query = "INSERT INTO messages (sender_id, receiver_id, content) VALUES (?, ?, ?)";
+    PreparedStatement* stmt = acquireStatement_impl(primary_, query);
     if (!stmt) {
-        LOG_ERROR("mysql_stmt_init() failed: {}", mysql_error(connection_));
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
-        return false;
-    }
-    
-    if (mysql_stmt_prepare(stmt, query, strlen(query))) {
-        LOG_ERROR("mysql_stmt_prepare() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
         return false;
     }
     
     // 绑定参数
-    MYSQL_BIND param_bind[3];
-    memset(param_bind, 0, sizeof(param_bind));
-    
-    // sender_id
-    param_bind[0].buffer_type = MYSQL_TYPE_LONG;
-    param_bind[0].buffer = &senderId;
-    
-    // receiver_id
-    param_bind[1].buffer_type = MYSQL_TYPE_LONG;
-    param_bind[1].buffer = &receiverId;
-    
-    // content
-    param_bind[2].buffer_type = MYSQL_TYPE_STRING;
-    param_bind[2].buffer = (char*)content.c_str();
-    param_bind[2].buffer_length = content.length();
-    
-    if (mysql_stmt_bind_param(stmt, param_bind)) {
-        LOG_ERROR("mysql_stmt_bind_param() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
-        return false;
-    }
+    stmt->setIntParam(0, &senderId);    // sender_id
+    stmt->setIntParam(1, &receiverId);  // receiver_id
+    stmt->setStringParam(2, content);   // content
     
     // 执行查询
-    if (mysql_stmt_execute(stmt)) {
-        LOG_ERROR("mysql_stmt_execute() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
+    if (!executeStatement_impl(primary_, stmt)) {
         return false;
     }
     
-    mysql_stmt_close(stmt);
+    // 双方随后拉取历史消息时都应能读到这条消息
+    pinSessionToPrimary(userSessionKey(senderId));
+    pinSessionToPrimary(userSessionKey(receiverId));
+    
     LOG_INFO("Message stored successfully from user {} to user {}", senderId, receiverId);
     return true;
 }
@@ -513,118 +755,52 @@ bool DatabaseManager::storeMessage(int senderId, int receiverId, const std::stri
  */
 std::vector<std::tuple<int, int, std::string, std::string>> DatabaseManager::getMessageHistory(int userId, int friendId, int limit) {
     std::vector<std::tuple<int, int, std::string, std::string>> messages;
-    std::lock_guard<std::mutex> lock(mutex_); // 加锁保护整个操作
-    
-    // 调用无锁的 _impl 版本
-    if (!isConnected_impl() && !connect_impl()) {
+    // 读请求：优先路由到副本，刚发送过消息的会话固定走主库；租约持有所选连接的锁
+    ReadConnection read = acquireReadConnection(userSessionKey(userId));
+    DatabaseConnection* conn = read.conn_;
+    if (!conn) {
         return messages;
     }
     
-    // 使用预处理语句防止SQL注入
-    const char* query = "SELECT sender_id, receiver_id, content, timestamp FROM messages "
-                        "WHERE (sender_id = ? AND receiver_id = ?) OR (sender_id = ? AND receiver_id = ?) "
-                        "ORDER BY timestamp DESC LIMIT ?";
-    MYSQL_STMT* stmt = mysql_stmt_init(connection_);
+    // 使用缓存的预处理语句防止SQL注入
+    static const std::string query = "SELECT sender_id, receiver_id, content, timestamp FROM messages "
+                                     "WHERE (sender_id = ? AND receiver_id = ?) OR (sender_id = ? AND receiver_id = ?) "
+                                     "ORDER BY timestamp DESC LIMIT ?";
+    PreparedStatement* stmt = acquireStatement_impl(*conn, query);
     if (!stmt) {
-        LOG_ERROR("mysql_stmt_init() failed: {}", mysql_error(connection_));
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
         return messages;
     }
     
-    if (mysql_stmt_prepare(stmt, query, strlen(query))) {
-        LOG_ERROR("mysql_stmt_prepare() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
-        return messages;
+    // 绑定结果（仅首次）
+    if (!stmt->resultsBound) {
+        stmt->bindIntResult(0);             // sender_id
+        stmt->bindIntResult(1);             // receiver_id
+        stmt->bindStringResult(2, 1024);    // content
+        stmt->bindStringResult(3, 32);      // timestamp
     }
     
     // 绑定参数
-    MYSQL_BIND param_bind[5];
-    memset(param_bind, 0, sizeof(param_bind));
-    
     // sender_id = userId, receiver_id = friendId
-    param_bind[0].buffer_type = MYSQL_TYPE_LONG;
-    param_bind[0].buffer = &userId;
-    
-    param_bind[1].buffer_type = MYSQL_TYPE_LONG;
-    param_bind[1].buffer = &friendId;
-    
+    stmt->setIntParam(0, &userId);
+    stmt->setIntParam(1, &friendId);
     // sender_id = friendId, receiver_id = userId
-    param_bind[2].buffer_type = MYSQL_TYPE_LONG;
-    param_bind[2].buffer = &friendId;
-    
-    param_bind[3].buffer_type = MYSQL_TYPE_LONG;
-    param_bind[3].buffer = &userId;
-    
+    stmt->setIntParam(2, &friendId);
+    stmt->setIntParam(3, &userId);
     // limit
-    param_bind[4].buffer_type = MYSQL_TYPE_LONG;
-    param_bind[4].buffer = &limit;
-    
-    if (mysql_stmt_bind_param(stmt, param_bind)) {
-        LOG_ERROR("mysql_stmt_bind_param() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
-        return messages;
-    }
-    
-    // 绑定结果
-    MYSQL_BIND result_bind[4];
-    memset(result_bind, 0, sizeof(result_bind));
-    
-    int sender_id, receiver_id;
-    char content[1024];
-    unsigned long content_length;
-    char timestamp[32];
-    unsigned long timestamp_length;
-    
-    // sender_id
-    result_bind[0].buffer_type = MYSQL_TYPE_LONG;
-    result_bind[0].buffer = &sender_id;
-    
-    // receiver_id
-    result_bind[1].buffer_type = MYSQL_TYPE_LONG;
-    result_bind[1].buffer = &receiver_id;
-    
-    // content
-    result_bind[2].buffer_type = MYSQL_TYPE_STRING;
-    result_bind[2].buffer = content;
-    result_bind[2].buffer_length = sizeof(content);
-    result_bind[2].length = &content_length;
-    
-    // timestamp
-    result_bind[3].buffer_type = MYSQL_TYPE_STRING;
-    result_bind[3].buffer = timestamp;
-    result_bind[3].buffer_length = sizeof(timestamp);
-    result_bind[3].length = &timestamp_length;
-    
-    if (mysql_stmt_bind_result(stmt, result_bind)) {
-        LOG_ERROR("mysql_stmt_bind_result() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
-        return messages;
-    }
+    stmt->setIntParam(4, &limit);
     
     // 执行查询
-    if (mysql_stmt_execute(stmt)) {
-        LOG_ERROR("mysql_stmt_execute() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        // 标记当前实例为不健康
-        updateInstanceHealth(currentHost_, currentPort_, false);
+    if (!executeStatement_impl(*conn, stmt)) {
         return messages;
     }
     
     // 获取结果
-    while (mysql_stmt_fetch(stmt) == 0) {
-        std::string content_str(content, content_length);
-        std::string timestamp_str(timestamp, timestamp_length);
-        messages.emplace_back(sender_id, receiver_id, content_str, timestamp_str);
+    while (mysql_stmt_fetch(stmt->stmt) == 0) {
+        messages.emplace_back(stmt->intResult(0), stmt->intResult(1),
+                              stmt->stringResult(2), stmt->stringResult(3));
     }
     
-    mysql_stmt_close(stmt);
+    mysql_stmt_free_result(stmt->stmt);
     LOG_INFO("Retrieved {} messages between user {} and user {}", messages.size(), userId, friendId);
     return messages;
 }
@@ -637,91 +813,44 @@ std::vector<std::tuple<int, int, std::string, std::string>> DatabaseManager::get
  */
 std::vector<std::pair<int, std::string>> DatabaseManager::searchUsers(const std::string& query, int limit) {
     std::vector<std::pair<int, std::string>> users;
-    std::lock_guard<std::mutex> lock(mutex_); // 加锁保护整个操作
-    
-    // 调用无锁的 _impl 版本
-    if (!isConnected_impl() && !connect_impl()) {
+    // 读请求：搜索不要求读己之写，优先路由到副本；租约持有所选连接的锁
+    ReadConnection read = acquireReadConnection();
+    DatabaseConnection* conn = read.conn_;
+    if (!conn) {
         return users;
     }
-
+    
     // 构造模糊查询字符串
     std::string searchQuery = query + "%";
-
-    // 使用预处理语句防止SQL注入
-    const char* sql = "SELECT id, username FROM users WHERE username LIKE ? LIMIT ?";
-    MYSQL_STMT* stmt = mysql_stmt_init(connection_);
+    
+    // 使用缓存的预处理语句防止SQL注入
+    static const std::string sql = "SELECT id, username FROM users WHERE username LIKE ? LIMIT ?";
+    PreparedStatement* stmt = acquireStatement_impl(*conn, sql);
     if (!stmt) {
-        LOG_ERROR("mysql_stmt_init() failed: {}", mysql_error(connection_));
-        updateInstanceHealth(currentHost_, currentPort_, false);
         return users;
     }
-
-    if (mysql_stmt_prepare(stmt, sql, strlen(sql))) {
-        LOG_ERROR("mysql_stmt_prepare() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        updateInstanceHealth(currentHost_, currentPort_, false);
-        return users;
+    
+    // 绑定结果（仅首次）
+    if (!stmt->resultsBound) {
+        stmt->bindIntResult(0);             // id
+        stmt->bindStringResult(1, 256);     // username
     }
-
+    
     // 绑定参数
-    MYSQL_BIND param_bind[2];
-    memset(param_bind, 0, sizeof(param_bind));
-
-    // 参数1: searchQuery (LIKE ?)
-    param_bind[0].buffer_type = MYSQL_TYPE_STRING;
-    param_bind[0].buffer = (char*)searchQuery.c_str();
-    param_bind[0].buffer_length = searchQuery.length();
-
-    // 参数2: limit (LIMIT ?)
-    param_bind[1].buffer_type = MYSQL_TYPE_LONG;
-    param_bind[1].buffer = &limit;
-
-    if (mysql_stmt_bind_param(stmt, param_bind)) {
-        LOG_ERROR("mysql_stmt_bind_param() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        updateInstanceHealth(currentHost_, currentPort_, false);
-        return users;
-    }
-
-    // 绑定结果
-    MYSQL_BIND result_bind[2];
-    memset(result_bind, 0, sizeof(result_bind));
-
-    int user_id;
-    char username[256];
-    unsigned long username_length;
-
-    // 结果1: id
-    result_bind[0].buffer_type = MYSQL_TYPE_LONG;
-    result_bind[0].buffer = &user_id;
-
-    // 结果2: username
-    result_bind[1].buffer_type = MYSQL_TYPE_STRING;
-    result_bind[1].buffer = username;
-    result_bind[1].buffer_length = sizeof(username);
-    result_bind[1].length = &username_length;
-
-    if (mysql_stmt_bind_result(stmt, result_bind)) {
-        LOG_ERROR("mysql_stmt_bind_result() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        updateInstanceHealth(currentHost_, currentPort_, false);
-        return users;
-    }
-
+    stmt->setStringParam(0, searchQuery);   // LIKE ?
+    stmt->setIntParam(1, &limit);           // LIMIT ?
+    
     // 执行查询
-    if (mysql_stmt_execute(stmt)) {
-        LOG_ERROR("mysql_stmt_execute() failed: {}", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        updateInstanceHealth(currentHost_, currentPort_, false);
+    if (!executeStatement_impl(*conn, stmt)) {
         return users;
     }
-
+    
     // 获取结果
-    while (mysql_stmt_fetch(stmt) == 0) {
-        users.emplace_back(user_id, std::string(username, username_length));
+    while (mysql_stmt_fetch(stmt->stmt) == 0) {
+        users.emplace_back(stmt->intResult(0), stmt->stringResult(1));
     }
-
-    mysql_stmt_close(stmt);
+    
+    mysql_stmt_free_result(stmt->stmt);
     LOG_INFO("Search for '{}' found {} users", query, users.size());
     return users;
 }
\ No newline at end of file
@@ -3,10 +3,14 @@
 
 #include <mysql/mysql.h>
 #include <string>
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <vector>
+#include <chrono>
+#include <unordered_map>
 #include "crypto_utils.h"
+#include "prepared_statement_cache.h"
 #include "load_balancer.h"  // 包含负载均衡器头文件以支持分布式数据库连接
 
 // 数据库实例信息结构体
@@ -25,6 +29,24 @@ struct DatabaseInstance {
         : host(h), port(p), user(u), password(pwd), database(db), isHealthy(true) {}
 };
 
+// 单条MySQL连接及其附属状态
+// 主库连接与只读副本连接各持有一份，预处理语句缓存随连接一起重建
+struct DatabaseConnection {
+    MYSQL* mysql;                       // MySQL连接指针
+    bool connected;                     // 连接状态标志
+    std::string serviceName;            // 所属负载均衡服务名（主库或副本）
+    std::string host;                   // 当前连接的主机地址
+    int port;                           // 当前连接的端口号
+    std::shared_ptr<ServiceInstance> instance;  // 当前连接的负载均衡实例，用于回报在途请求和延迟
+    PreparedStatementCache stmtCache;   // 该连接上的预处理语句缓存
+    std::chrono::steady_clock::time_point lastLagCheck;  // 最近一次复制延迟检查时间（仅副本）
+    bool legacyReplicaStatus;           // 实例早于 MySQL 8.0.22，复制状态改用 SHOW SLAVE STATUS 查询（仅副本）
+    
+    DatabaseConnection(const std::string& service, size_t maxStatements)
+        : mysql(nullptr), connected(false), serviceName(service), port(0), stmtCache(maxStatements),
+          legacyReplicaStatus(false) {}
+};
+
 /**
  * @brief 数据库管理器类（单例模式）
  * 
@@ -38,9 +60,40 @@ struct DatabaseInstance {
  * 4. 健康检查和故障转移机制
  * 5. 密码加密存储（SHA256）
  * 6. SQL注入防护（使用预处理语句）
+ * 7. 预处理语句缓存（按连接缓存，重连后自动重新准备）
+ * 8. 读写分离：读请求路由到只读副本，写后短时间内同一会话的读固定走主库，
+ *    复制延迟超限的副本会被剔除
+ *
+ * 锁：主库连接由 mutex_ 保护，副本连接由 replicaMutex_ 保护，读写固定表由 pinsMutex_ 保护。
+ * 走副本的读请求不占用主库的锁，批量写入或长查询期间读请求仍可在副本上执行。
  */
 class DatabaseManager {
 public:
+    /**
+     * @brief 只读查询的连接租约
+     * 持有所选连接（副本或主库）的锁，析构时释放；连接不可用时 get() 返回nullptr
+     */
+    class ReadConnection {
+    public:
+        ReadConnection() : conn_(nullptr) {}
+        
+        /**
+         * @brief 原始连接（MYSQL* 的void指针形式），在租约析构前有效
+         */
+        void* get() const { return conn_ ? static_cast<void*>(conn_->mysql) : nullptr; }
+        
+        explicit operator bool() const { return conn_ != nullptr; }
+        
+    private:
+        friend class DatabaseManager;
+        
+        ReadConnection(std::unique_lock<std::mutex> lock, DatabaseConnection* conn)
+            : lock_(std::move(lock)), conn_(conn) {}
+        
+        std::unique_lock<std::mutex> lock_;
+        DatabaseConnection* conn_;
+    };
+    
     /**
      * @brief 获取DatabaseManager单例实例
      * @return DatabaseManager实例的引用
@@ -68,6 +121,27 @@ public:
      */
     void updateInstanceHealth(const std::string& host, int port, bool isHealthy);
     
+    /**
+     * @brief 添加只读副本实例到负载均衡器
+     * 读请求（用户查询、搜索、历史消息、状态查询）会优先路由到副本，连接副本时使用这里给出的认证信息
+     * @param host 副本主机地址
+     * @param port 副本端口
+     * @param user 用户名
+     * @param password 密码
+     * @param database 数据库名称
+     * @param weight 负载均衡权重（默认为1）
+     */
+    void addReplicaInstance(const std::string& host, int port, 
+                            const std::string& user, const std::string& password, 
+                            const std::string& database, int weight = 1);
+    
+    /**
+     * @brief 设置读写分离参数
+     * @param pinWindow 写入后同一会话的读请求固定走主库的时长
+     * @param maxReplicaLagSeconds 允许的最大复制延迟（秒），超过则剔除该副本
+     */
+    void setReadWriteSplitOptions(std::chrono::milliseconds pinWindow, int maxReplicaLagSeconds);
+    
     /**
      * @brief 连接到下一个健康的数据库实例
      * 使用负载均衡器选择最优的数据库实例进行连接
@@ -102,7 +176,26 @@ public:
      * @brief 获取原始数据库连接（用于直接执行查询）
      * @return MYSQL连接指针的void指针形式
      */
-    void* getConnection() const { return static_cast<void*>(connection_); }
+    void* getConnection() const { return static_cast<void*>(primary_.mysql); }
+    
+    /**
+     * @brief 获取用于只读查询的连接（调用者不能持有 mutex_）
+     * 会话在读写固定窗口内、未配置副本或副本不可用时返回主库连接，并持有对应连接的锁
+     * @param sessionKey 会话标识（例如 userSessionKey(userId)），为空表示不要求读己之写
+     * @return 连接租约，主库也不可用时 get() 返回nullptr
+     */
+    ReadConnection acquireReadConnection(const std::string& sessionKey = "");
+    
+    /**
+     * @brief 记录一次写入，使该会话在固定窗口内的读请求走主库
+     * @param sessionKey 会话标识
+     */
+    void pinSessionToPrimary(const std::string& sessionKey);
+    
+    /**
+     * @brief 生成按用户ID划分的会话标识
+     */
+    static std::string userSessionKey(int userId) { return "user:" + std::to_string(userId); }
 
     /**
     * @brief 根据用户名模糊搜索用户
@@ -160,7 +253,7 @@ public:
      * @brief 获取当前连接的数据库主机地址
      * @return 当前主机地址字符串
      */
-    std::string getHost() const { return currentHost_; }
+    std::string getHost() const { return primary_.host; }
     
     /**
      * @brief 获取当前连接的数据库用户名
@@ -178,10 +271,10 @@ public:
      * @brief 获取当前连接的数据库端口
      * @return 当前端口号
      */
-    int getPort() const { return currentPort_; }
+    int getPort() const { return primary_.port; }
     
     /**
-     * @brief 获取互斥锁（用于线程安全）
+     * @brief 获取主库连接的互斥锁（用于线程安全），只读查询改用 acquireReadConnection
      * @return 互斥锁引用
      */
     std::mutex& mutex() const { return mutex_; }
@@ -204,22 +297,115 @@ private:
      */
     bool userExistsNoLock(const std::string& username);
     
-    MYSQL* connection_;         // MySQL连接指针
-    bool connected_;            // 连接状态标志
-    mutable std::mutex mutex_;  // 用于线程安全的互斥锁
+    /**
+     * @brief 从语句缓存获取预处理语句（无锁，调用者需持有该连接的锁）
+     * 准备失败时会标记该连接对应的实例为不健康
+     * @param conn 执行语句的连接
+     * @param sql SQL文本
+     * @return 语句指针，失败返回nullptr
+     */
+    PreparedStatement* acquireStatement_impl(DatabaseConnection& conn, const std::string& sql);
+    
+    /**
+     * @brief 绑定参数并执行缓存的预处理语句（无锁，调用者需持有该连接的锁）
+     * 结果缓冲区只在首次执行时绑定；失败时将该语句移出缓存，失败计入实例的熔断器（副本连接随即断开）
+     * @param conn 执行语句的连接
+     * @param stmt 由 acquireStatement_impl 返回的语句
+     * @return 成功返回true，否则返回false
+     */
+    bool executeStatement_impl(DatabaseConnection& conn, PreparedStatement* stmt);
     
-    // 当前连接的数据库信息
-    std::string currentHost_;       // 当前主机地址
+    /**
+     * @brief 建立到指定实例的连接（无锁，调用者需持有该连接的锁）
+     */
+    bool openConnection_impl(DatabaseConnection& conn, const std::shared_ptr<ServiceInstance>& instance);
+    
+    /**
+     * @brief 关闭连接并释放其上的预处理语句（无锁，调用者需持有该连接的锁）
+     */
+    void closeConnection_impl(DatabaseConnection& conn);
+    
+    /**
+     * @brief 确保副本连接可用且复制延迟在允许范围内（无锁，调用者需持有replicaMutex_）
+     * @return 副本可用返回true，否则返回false（调用者回退到主库）
+     */
+    bool ensureReplica_impl();
+    
+    /**
+     * @brief 查询副本的复制延迟（无锁，调用者需持有replicaMutex_）
+     * @return 延迟秒数；复制未运行或查询失败返回-1
+     */
+    long long queryReplicaLag_impl(DatabaseConnection& conn);
+    
+    /**
+     * @brief 检查会话是否仍处于写后固定主库的窗口内
+     */
+    bool isPinnedToPrimary(const std::string& sessionKey);
+    
+    /**
+     * @brief 将连接对应的实例标记为不健康
+     */
+    void markUnhealthy(const DatabaseConnection& conn);
+    
+    /**
+     * @brief 连接对应实例的熔断器是否放行
+     */
+    static bool isAdmitted(const DatabaseConnection& conn);
+    
+    mutable std::mutex mutex_;  // 用于线程安全的互斥锁（主库连接）
+    std::mutex replicaMutex_;   // 副本连接及复制延迟剔除状态
+    std::mutex pinsMutex_;      // 读写固定表
+    
+    // 主库连接认证信息（构造后不再修改）
     std::string currentUser_;       // 当前用户名
     std::string currentPassword_;   // 当前密码
     std::string currentDatabase_;   // 当前数据库名称
-    int currentPort_;               // 当前端口号
+    
+    // 副本连接认证信息，按 "host:port" 登记（replicaMutex_ 保护）
+    struct Credentials {
+        std::string user;
+        std::string password;
+        std::string database;
+    };
+    std::unordered_map<std::string, Credentials> replicaCredentials_;
+    
+    // 主库连接（读写）与只读副本连接
+    DatabaseConnection primary_;
+    DatabaseConnection replica_;
+    
+    // 是否注册过副本实例；未注册时读请求直接走主库
+    std::atomic<bool> replicasConfigured_;
+    
+    // 因复制延迟被剔除的副本，冷却期后恢复健康状态重新参与选择（replicaMutex_ 保护）
+    std::vector<std::pair<std::string, int>> laggingReplicas_;
+    std::chrono::steady_clock::time_point laggingRetryAt_;
+    int maxReplicaLagSeconds_;
+    
+    // 读己之写：会话标识 -> 固定走主库的截止时间（pinsMutex_ 保护）
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> primaryPins_;
+    std::chrono::milliseconds pinWindow_;
     
     // 负载均衡器引用
     LoadBalancer& loadBalancer_;
     
+    // 主库和副本在负载均衡器中的服务句柄，选择实例时不再按服务名查找
+    LoadBalancer::ServiceHandle primaryService_;
+    LoadBalancer::ServiceHandle replicaService_;
+    
     // 服务名称（用于负载均衡器标识）
     static const std::string SERVICE_NAME;
+    
+    // 只读副本服务名称
+    static const std::string REPLICA_SERVICE_NAME;
+    
+    // 每个连接最多缓存的预处理语句数
+    static const size_t MAX_CACHED_STATEMENTS = 32;
+    
+    // 副本复制延迟的检查间隔
+    static constexpr std::chrono::seconds LAG_CHECK_INTERVAL{5};
+    
+    // 读写固定表的清理阈值
+    static const size_t MAX_PRIMARY_PINS = 4096;
 };
 
 #endif // DATABASE_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,452 @@
+#include "friend_graph.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <mysql/mysql.h>
+#include "database_manager.h"
+#include "logger.h"
+
+namespace {
+
+struct FriendRow {
+    int64_t id;
+    int32_t userId;
+    int32_t friendId;
+};
+
+bool parseFriendRow(MYSQL_ROW row, FriendRow& parsed) {
+    if (!row[0] || !row[1] || !row[2]) {
+        return false;
+    }
+    parsed.id = std::strtoll(row[0], nullptr, 10);
+    parsed.userId = static_cast<int32_t>(std::strtol(row[1], nullptr, 10));
+    parsed.friendId = static_cast<int32_t>(std::strtol(row[2], nullptr, 10));
+    return true;
+}
+
+} // namespace
+
+bool FriendGraph::Csr::find(int32_t userId, const int32_t*& begin, const int32_t*& end) const {
+    auto it = std::lower_bound(users.begin(), users.end(), userId);
+    if (it == users.end() || *it != userId) {
+        return false;
+    }
+    size_t index = it - users.begin();
+    begin = neighbors.data() + offsets[index];
+    end = neighbors.data() + offsets[index + 1];
+    return true;
+}
+
+size_t FriendGraph::Csr::bytes() const {
+    return users.capacity() * sizeof(int32_t) + offsets.capacity() * sizeof(uint32_t) +
+           neighbors.capacity() * sizeof(int32_t);
+}
+
+/**
+ * @brief 获取FriendGraph单例实例
+ * 使用局部静态变量实现线程安全的单例模式
+ * @return FriendGraph实例的引用
+ */
+FriendGraph& FriendGraph::getInstance() {
+    static FriendGraph instance;
+    return instance;
+}
+
+FriendGraph::FriendGraph() : deltaEdges_(0), lastEdgeId_(0), loaded_(false), running_(false) {
+}
+
+FriendGraph::~FriendGraph() {
+    stop();
+}
+
+bool FriendGraph::start(std::chrono::milliseconds syncInterval) {
+    if (running_) {
+        LOG_WARN("FriendGraph already started");
+        return loaded_;
+    }
+
+    bool loaded = load();
+    if (!loaded) {
+        LOG_WARN("Friend graph not loaded, friend queries fall back to the database until it is");
+    }
+
+    running_ = true;
+    thread_ = std::thread(&FriendGraph::syncLoop, this, syncInterval);
+    return loaded;
+}
+
+void FriendGraph::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+    }
+    stopCondition_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    Stats s = stats();
+    LOG_INFO("FriendGraph stopped: {} users, {} edges, {} pending edges", s.users, s.edges, s.deltaEdges);
+}
+
+bool FriendGraph::getFriends(int32_t userId, std::vector<int32_t>& friends) const {
+    if (!loaded_) {
+        return false;
+    }
+
+    friends.clear();
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    const int32_t* begin = nullptr;
+    const int32_t* end = nullptr;
+    base_->find(userId, begin, end);
+
+    auto it = delta_.find(userId);
+    if (it == delta_.end()) {
+        friends.assign(begin, end);
+    } else {
+        friends.reserve((end - begin) + it->second.size());
+        std::set_union(begin, end, it->second.begin(), it->second.end(), std::back_inserter(friends));
+    }
+    return true;
+}
+
+bool FriendGraph::isFriend(int32_t userId, int32_t friendId) const {
+    if (!loaded_) {
+        return false;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    const int32_t* begin = nullptr;
+    const int32_t* end = nullptr;
+    if (base_->find(userId, begin, end) && std::binary_search(begin, end, friendId)) {
+        return true;
+    }
+
+    auto it = delta_.find(userId);
+    return it != delta_.end() && std::binary_search(it->second.begin(), it->second.end(), friendId);
+}
+
+void FriendGraph::addEdge(int32_t userId, int32_t friendId) {
+    // 未加载时加载过程会直接从数据库读到这条边
+    if (!loaded_) {
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    addEdge_impl(userId, friendId);
+}
+
+FriendGraph::Stats FriendGraph::stats() const {
+    Stats s;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (base_) {
+        s.users = base_->users.size();
+        s.edges = base_->neighbors.size();
+        s.bytes = base_->bytes();
+        s.bytesPerEdge = s.edges > 0 ? (double)s.bytes / s.edges : 0;
+    }
+    s.deltaEdges = deltaEdges_;
+    return s;
+}
+
+/**
+ * @brief 全量加载
+ * 按 (user_id, friend_id) 键集分页读取，行序即 CSR 的存储顺序，边读边追加；
+ * 每页单独取连接租约，页与页之间不占用数据库连接
+ */
+bool FriendGraph::load() {
+    auto csr = std::make_shared<Csr>();
+    int64_t maxId = 0;
+    auto startTime = std::chrono::steady_clock::now();
+    DatabaseManager& db = DatabaseManager::getInstance();
+
+    {
+        // 加载开始时的最大自增ID：加载期间写入的行可能落在已读过的页之前，由之后的增量同步补上
+        DatabaseManager::ReadConnection read = db.acquireReadConnection();
+        MYSQL* connection = static_cast<MYSQL*>(read.get());
+        if (!connection) {
+            return false;
+        }
+
+        if (mysql_query(connection, "SELECT COALESCE(MAX(id), 0) FROM user_friends")) {
+            LOG_ERROR("Failed to load friend graph: {}", mysql_error(connection));
+            return false;
+        }
+
+        MYSQL_RES* result = mysql_store_result(connection);
+        if (!result) {
+            return false;
+        }
+        MYSQL_ROW row = mysql_fetch_row(result);
+        if (row && row[0]) {
+            maxId = std::strtoll(row[0], nullptr, 10);
+        }
+        mysql_free_result(result);
+    }
+
+    size_t pageRows = LOAD_PAGE_SIZE;
+    while (pageRows == LOAD_PAGE_SIZE) {
+        std::string query = "SELECT id, user_id, friend_id FROM user_friends";
+        if (!csr->users.empty()) {
+            query += " WHERE (user_id, friend_id) > (" + std::to_string(csr->users.back()) + ", " +
+                     std::to_string(csr->neighbors.back()) + ")";
+        }
+        query += " ORDER BY user_id, friend_id LIMIT " + std::to_string(LOAD_PAGE_SIZE);
+
+        DatabaseManager::ReadConnection read = db.acquireReadConnection();
+        MYSQL* connection = static_cast<MYSQL*>(read.get());
+        if (!connection) {
+            return false;
+        }
+
+        if (mysql_query(connection, query.c_str())) {
+            LOG_ERROR("Failed to load friend graph: {}", mysql_error(connection));
+            return false;
+        }
+
+        MYSQL_RES* result = mysql_store_result(connection);
+        if (!result) {
+            LOG_ERROR("Failed to load friend graph: {}", mysql_error(connection));
+            return false;
+        }
+
+        pageRows = mysql_num_rows(result);
+        MYSQL_ROW row;
+        FriendRow edge;
+        while ((row = mysql_fetch_row(result))) {
+            if (!parseFriendRow(row, edge)) {
+                continue;
+            }
+
+            if (csr->users.empty() || csr->users.back() != edge.userId) {
+                csr->users.push_back(edge.userId);
+                csr->offsets.push_back(static_cast<uint32_t>(csr->neighbors.size()));
+            } else if (csr->neighbors.back() == edge.friendId) {
+                continue;
+            }
+            csr->neighbors.push_back(edge.friendId);
+        }
+        mysql_free_result(result);
+    }
+
+    csr->offsets.push_back(static_cast<uint32_t>(csr->neighbors.size()));
+    csr->users.shrink_to_fit();
+    csr->offsets.shrink_to_fit();
+    csr->neighbors.shrink_to_fit();
+
+    size_t bytes = csr->bytes();
+    size_t users = csr->users.size();
+    size_t edges = csr->neighbors.size();
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        base_ = std::move(csr);
+        delta_.clear();
+        deltaEdges_ = 0;
+        lastEdgeId_ = maxId;
+    }
+    loaded_ = true;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+    LOG_INFO("Friend graph loaded: {} users, {} edges, {} bytes ({:.1f} bytes/edge) in {} ms",
+             users, edges, bytes, edges > 0 ? (double)bytes / edges : 0.0, elapsed.count());
+    return true;
+}
+
+/**
+ * @brief 增量同步其他实例写入的好友关系
+ * 按自增ID拉取新行，并向前回看一段以覆盖提交顺序与ID顺序不一致的事务
+ */
+bool FriendGraph::sync() {
+    int64_t since;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        since = std::max<int64_t>(0, lastEdgeId_ - SYNC_OVERLAP_IDS);
+    }
+
+    std::vector<FriendRow> edges;
+    {
+        DatabaseManager& db = DatabaseManager::getInstance();
+        DatabaseManager::ReadConnection read = db.acquireReadConnection();
+        MYSQL* connection = static_cast<MYSQL*>(read.get());
+        if (!connection) {
+            return false;
+        }
+
+        std::string query = "SELECT id, user_id, friend_id FROM user_friends WHERE id > " + std::to_string(since) +
+                            " ORDER BY id";
+        if (mysql_query(connection, query.c_str())) {
+            LOG_ERROR("Failed to sync friend graph: {}", mysql_error(connection));
+            return false;
+        }
+
+        MYSQL_RES* result = mysql_store_result(connection);
+        if (!result) {
+            return false;
+        }
+
+        MYSQL_ROW row;
+        FriendRow edge;
+        while ((row = mysql_fetch_row(result))) {
+            if (parseFriendRow(row, edge)) {
+                edges.push_back(edge);
+            }
+        }
+        mysql_free_result(result);
+    }
+
+    size_t added = 0;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        for (const auto& edge : edges) {
+            if (addEdge_impl(edge.userId, edge.friendId)) {
+                ++added;
+            }
+            lastEdgeId_ = std::max(lastEdgeId_, edge.id);
+        }
+    }
+
+    if (added > 0) {
+        LOG_DEBUG("Friend graph synced {} new edges", added);
+    }
+    return true;
+}
+
+/**
+ * @brief 把增量层合并成新的基础图
+ * 合并在锁外进行，只在替换时短暂持有写锁；合并期间新增的边继续留在增量层
+ */
+void FriendGraph::compact() {
+    std::shared_ptr<const Csr> base;
+    Delta delta;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (!base_) {
+            return;
+        }
+        size_t threshold = base_->neighbors.size() / COMPACT_RATIO;
+        if (deltaEdges_ < threshold || deltaEdges_ < MIN_COMPACT_EDGES) {
+            return;
+        }
+        base = base_;
+        delta = delta_;
+    }
+
+    std::vector<int32_t> deltaUsers;
+    size_t deltaEdges = 0;
+    deltaUsers.reserve(delta.size());
+    for (const auto& entry : delta) {
+        deltaUsers.push_back(entry.first);
+        deltaEdges += entry.second.size();
+    }
+    std::sort(deltaUsers.begin(), deltaUsers.end());
+
+    auto merged = std::make_shared<Csr>();
+    merged->users.reserve(base->users.size() + deltaUsers.size());
+    merged->offsets.reserve(base->users.size() + deltaUsers.size() + 1);
+    merged->neighbors.reserve(base->neighbors.size() + deltaEdges);
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i < base->users.size() || j < deltaUsers.size()) {
+        int32_t userId;
+        const int32_t* begin = nullptr;
+        const int32_t* end = nullptr;
+        const std::vector<int32_t>* added = nullptr;
+
+        if (j == deltaUsers.size() || (i < base->users.size() && base->users[i] < deltaUsers[j])) {
+            userId = base->users[i];
+        } else {
+            userId = deltaUsers[j++];
+            added = &delta[userId];
+        }
+        if (i < base->users.size() && base->users[i] == userId) {
+            begin = base->neighbors.data() + base->offsets[i];
+            end = base->neighbors.data() + base->offsets[i + 1];
+            ++i;
+        }
+
+        merged->users.push_back(userId);
+        merged->offsets.push_back(static_cast<uint32_t>(merged->neighbors.size()));
+        if (added) {
+            std::set_union(begin, end, added->begin(), added->end(), std::back_inserter(merged->neighbors));
+        } else {
+            merged->neighbors.insert(merged->neighbors.end(), begin, end);
+        }
+    }
+    merged->offsets.push_back(static_cast<uint32_t>(merged->neighbors.size()));
+
+    size_t bytes = merged->bytes();
+    size_t edges = merged->neighbors.size();
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (base_ != base) {
+            return;
+        }
+        base_ = std::move(merged);
+
+        for (const auto& entry : delta) {
+            auto it = delta_.find(entry.first);
+            if (it == delta_.end()) {
+                continue;
+            }
+            std::vector<int32_t> remaining;
+            std::set_difference(it->second.begin(), it->second.end(), entry.second.begin(), entry.second.end(),
+                                std::back_inserter(remaining));
+            deltaEdges_ -= it->second.size() - remaining.size();
+            if (remaining.empty()) {
+                delta_.erase(it);
+            } else {
+                it->second.swap(remaining);
+            }
+        }
+    }
+
+    LOG_INFO("Friend graph compacted {} pending edges: {} edges, {:.1f} bytes/edge",
+             deltaEdges, edges, edges > 0 ? (double)bytes / edges : 0.0);
+}
+
+void FriendGraph::syncLoop(std::chrono::milliseconds interval) {
+    while (sleepFor(interval)) {
+        if (!loaded_) {
+            load();
+            continue;
+        }
+        sync();
+        compact();
+    }
+}
+
+/**
+ * @brief 把一条有向边加入增量层（调用者需持有写锁）
+ * @return 边已存在时返回false
+ */
+bool FriendGraph::addEdge_impl(int32_t userId, int32_t friendId) {
+    const int32_t* begin = nullptr;
+    const int32_t* end = nullptr;
+    if (base_ && base_->find(userId, begin, end) && std::binary_search(begin, end, friendId)) {
+        return false;
+    }
+
+    auto& added = delta_[userId];
+    auto it = std::lower_bound(added.begin(), added.end(), friendId);
+    if (it != added.end() && *it == friendId) {
+        return false;
+    }
+    added.insert(it, friendId);
+    ++deltaEdges_;
+    return true;
+}
+
+/**
+ * @brief 可被 stop() 打断的等待
+ * @return 等待结束后仍在运行返回true
+ */
+bool FriendGraph::sleepFor(std::chrono::milliseconds duration) {
+    std::unique_lock<std::mutex> lock(stopMutex_);
+    return !stopCondition_.wait_for(lock, duration, [this] { return !running_; });
+}
@@ -0,0 +1,140 @@
+#ifndef FRIEND_GRAPH_H
+#define FRIEND_GRAPH_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 进程内的好友关系图（单例模式）
+ *
+ * 整张 user_friends 表以压缩稀疏行（CSR）格式常驻内存，好友查询不再访问数据库：
+ * 1. 基础图不可变：按用户ID排序的顶点数组 + 偏移数组 + 有序的 int32 邻接数组，
+ *    启动时按 (user_id, friend_id) 键集分页加载，每页之间释放数据库连接，不阻塞其他查询
+ * 2. 新增的关系先进入增量层（每个用户一个有序小数组），读取时与基础图归并
+ * 3. 增量层超过阈值后在后台合并成新的基础图，整体替换，读者不受影响
+ * 4. 其他 StatusServer 实例写入的关系通过按自增ID的增量查询同步
+ *
+ * 未加载成功之前 isLoaded() 返回false，调用者应回退到数据库查询。
+ */
+class FriendGraph {
+public:
+    /**
+     * @brief 内存统计
+     */
+    struct Stats {
+        size_t users = 0;          // 有好友的用户数
+        size_t edges = 0;          // 基础图中的有向边数
+        size_t deltaEdges = 0;     // 增量层中的有向边数
+        size_t bytes = 0;          // 基础图占用的字节数
+        double bytesPerEdge = 0;
+    };
+
+    /**
+     * @brief 获取FriendGraph单例实例
+     * @return FriendGraph实例的引用
+     */
+    static FriendGraph& getInstance();
+
+    FriendGraph(const FriendGraph&) = delete;
+    FriendGraph& operator=(const FriendGraph&) = delete;
+
+    /**
+     * @brief 加载好友关系图并启动后台同步线程
+     * 需在 DatabaseManager 配置好实例之后调用；首次加载失败时由后台线程重试
+     * @param syncInterval 增量同步间隔
+     * @return 首次加载成功返回true
+     */
+    bool start(std::chrono::milliseconds syncInterval = std::chrono::milliseconds(2000));
+
+    /**
+     * @brief 停止后台同步线程
+     */
+    void stop();
+
+    /**
+     * @brief 好友关系图是否已加载
+     */
+    bool isLoaded() const { return loaded_; }
+
+    /**
+     * @brief 获取用户的好友列表（按ID升序）
+     * @param userId 用户ID
+     * @param friends 输出参数，好友ID列表
+     * @return 未加载时返回false
+     */
+    bool getFriends(int32_t userId, std::vector<int32_t>& friends) const;
+
+    /**
+     * @brief 检查好友关系是否存在
+     * @return 未加载或不存在时返回false
+     */
+    bool isFriend(int32_t userId, int32_t friendId) const;
+
+    /**
+     * @brief 写入数据库后把一条有向边加入增量层（保证本实例读己之写）
+     * @param userId 用户ID
+     * @param friendId 好友ID
+     */
+    void addEdge(int32_t userId, int32_t friendId);
+
+    /**
+     * @brief 获取内存统计
+     */
+    Stats stats() const;
+
+private:
+    FriendGraph();
+    ~FriendGraph();
+
+    // 不可变的 CSR 基础图：users[i] 的好友为 neighbors[offsets[i], offsets[i + 1])
+    struct Csr {
+        std::vector<int32_t> users;
+        std::vector<uint32_t> offsets;
+        std::vector<int32_t> neighbors;
+
+        bool find(int32_t userId, const int32_t*& begin, const int32_t*& end) const;
+        size_t bytes() const;
+    };
+
+    // 增量层：用户ID -> 有序的新增好友ID
+    using Delta = std::unordered_map<int32_t, std::vector<int32_t>>;
+
+    bool load();
+    bool sync();
+    void compact();
+    void syncLoop(std::chrono::milliseconds interval);
+    bool addEdge_impl(int32_t userId, int32_t friendId);
+    bool sleepFor(std::chrono::milliseconds duration);
+
+    // 增量层达到基础图的 1/COMPACT_RATIO（且不少于 MIN_COMPACT_EDGES）时合并
+    static const size_t MIN_COMPACT_EDGES = 4096;
+    static const size_t COMPACT_RATIO = 16;
+
+    // 增量同步向前回看的自增ID数，覆盖乱序提交的事务
+    static const int64_t SYNC_OVERLAP_IDS = 256;
+
+    // 全量加载每页读取的行数
+    static const size_t LOAD_PAGE_SIZE = 50000;
+
+    mutable std::shared_mutex mutex_;
+    std::shared_ptr<const Csr> base_;
+    Delta delta_;
+    size_t deltaEdges_;
+    int64_t lastEdgeId_;                  // 已同步的 user_friends 最大自增ID
+    std::atomic<bool> loaded_;
+
+    std::atomic<bool> running_;
+    std::thread thread_;
+    std::mutex stopMutex_;
+    std::condition_variable stopCondition_;
+};
+
+#endif // FRIEND_GRAPH_H
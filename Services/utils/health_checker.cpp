@@ -1,100 +1,487 @@
 #include "health_checker.h"
-#include <iostream>
-#include <sstream>
-#include <cstring>
-#include <sys/socket.h>
-#include <netdb.h>
-#include <unistd.h>
+#include <algorithm>
+#include <functional>
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/generic/generic_stub.h>
+
+using tcp = net::ip::tcp;
+
+namespace {
+
+const char* const HEALTH_CHECK_METHOD = "/grpc.health.v1.Health/Check";
+
+// HealthCheckResponse 只有一个字段 status = 1（varint），SERVING 的编码为 08 01
+bool isServing(const grpc::ByteBuffer& response) {
+    std::vector<grpc::Slice> slices;
+    if (!response.Dump(&slices).ok()) {
+        return false;
+    }
+    std::string bytes;
+    for (const auto& slice : slices) {
+        bytes.append(reinterpret_cast<const char*>(slice.begin()), slice.size());
+    }
+    return bytes.size() == 2 && bytes[0] == 0x08 && bytes[1] == 0x01;
+}
+
+const char* probeName(HealthProbe probe) {
+    switch (probe) {
+        case HealthProbe::MySQL: return "mysql";
+        case HealthProbe::Redis: return "redis";
+        case HealthProbe::Grpc: return "grpc";
+        default: return "tcp";
+    }
+}
+
+} // namespace
+
+// 探测目标：一个已注册的服务实例及其连续计数
+struct HealthChecker::Target {
+    std::string serviceName;
+    std::string host;
+    int port;
+    HealthProbe protocol;
+    net::steady_timer timer;
+    std::shared_ptr<grpc::Channel> channel;   // gRPC 探测复用的连接
+    std::weak_ptr<Probe> inFlight;
+    int successes = 0;                        // 连续成功次数
+    int failures = 0;                         // 连续失败次数
+    bool healthy = true;                      // 已上报给负载均衡器的状态，实例注册时默认健康
+    bool removed = false;
+
+    Target(net::io_context& ioContext, const std::string& name, const std::string& h, int p, HealthProbe probe)
+        : serviceName(name), host(h), port(p), protocol(probe), timer(ioContext) {}
+};
+
+// 一次探测：解析、连接和协议交互都是异步的，由截止时间定时器兜底。
+// 除 gRPC 回调外所有操作都在 io_context 的线程上执行
+struct HealthChecker::Probe : std::enable_shared_from_this<HealthChecker::Probe> {
+    using Callback = std::function<void(bool healthy, const std::string& reason)>;
+
+    // gRPC 调用的状态，回调在 gRPC 的线程上执行，这里不持有任何 asio 对象，
+    // 只用 work guard 让 io_context 在结果投递回来之前不退出
+    struct GrpcCall {
+        net::executor_work_guard<net::io_context::executor_type> guard;
+        grpc::ClientContext context;
+        grpc::GenericStub stub;
+        grpc::ByteBuffer request;
+        grpc::ByteBuffer response;
+
+        GrpcCall(net::io_context& ioContext, std::shared_ptr<grpc::Channel> channel)
+            : guard(net::make_work_guard(ioContext)), stub(std::move(channel)) {}
+    };
+
+    Probe(net::io_context& ioContext, HealthProbe protocol, std::chrono::milliseconds timeout, Callback done)
+        : ioContext(ioContext), resolver(ioContext), socket(ioContext), deadline(ioContext),
+          protocol(protocol), timeout(timeout), done(std::move(done)) {}
+
+    void start(const std::string& host, int port, const std::shared_ptr<grpc::Channel>& channel) {
+        auto self = shared_from_this();
+        deadline.expires_after(timeout);
+        deadline.async_wait([self](const boost::system::error_code& ec) {
+            if (!ec) {
+                self->finish(false, "timed out");
+            }
+        });
+
+        if (protocol == HealthProbe::Grpc) {
+            startGrpc(channel);
+            return;
+        }
+
+        resolver.async_resolve(host, std::to_string(port),
+            [self](const boost::system::error_code& ec, tcp::resolver::results_type results) {
+                if (ec) {
+                    return self->finish(false, "resolve: " + ec.message());
+                }
+                net::async_connect(self->socket, results,
+                    [self](const boost::system::error_code& ec, const tcp::endpoint&) {
+                        if (ec) {
+                            return self->finish(false, "connect: " + ec.message());
+                        }
+                        self->exchange();
+                    });
+            });
+    }
+
+    // 连接建立后的协议交互
+    void exchange() {
+        auto self = shared_from_this();
+        switch (protocol) {
+            case HealthProbe::MySQL:
+                // 包头 3 字节长度 + 1 字节序号，负载的第一个字节是协议版本（10），
+                // 服务端拒绝连接（连接数已满、主机被封禁）时直接发送 0xff 错误包
+                buffer.resize(5);
+                net::async_read(socket, net::buffer(buffer),
+                    [self](const boost::system::error_code& ec, std::size_t) {
+                        if (ec) {
+                            return self->finish(false, "mysql greeting: " + ec.message());
+                        }
+                        uint8_t marker = static_cast<uint8_t>(self->buffer[4]);
+                        if (marker == 0x0a) {
+                            self->finish(true, "");
+                        } else if (marker == 0xff) {
+                            self->finish(false, "mysql refused connection");
+                        } else {
+                            self->finish(false, "unexpected mysql protocol version " + std::to_string(marker));
+                        }
+                    });
+                break;
+
+            case HealthProbe::Redis:
+                net::async_write(socket, net::buffer("PING\r\n", 6),
+                    [self](const boost::system::error_code& ec, std::size_t) {
+                        if (ec) {
+                            return self->finish(false, "redis write: " + ec.message());
+                        }
+                        net::async_read_until(self->socket, net::dynamic_buffer(self->buffer, 512), "\r\n",
+                            [self](const boost::system::error_code& ec, std::size_t length) {
+                                if (ec) {
+                                    return self->finish(false, "redis read: " + ec.message());
+                                }
+                                std::string reply = self->buffer.substr(0, length - 2);
+                                // 需要认证说明服务端在正常处理命令；-LOADING、-MASTERDOWN 等视为不可用
+                                if (reply == "+PONG" || reply.compare(0, 7, "-NOAUTH") == 0) {
+                                    self->finish(true, "");
+                                } else {
+                                    self->finish(false, "redis replied " + reply);
+                                }
+                            });
+                    });
+                break;
+
+            default:
+                finish(true, "");
+                break;
+        }
+    }
+
+    void startGrpc(const std::shared_ptr<grpc::Channel>& channel) {
+        auto call = std::make_shared<GrpcCall>(ioContext, channel);
+        call->context.set_deadline(std::chrono::system_clock::now() + timeout);
+        // HealthCheckRequest{service = ""} 序列化后为空
+        grpc::Slice empty;
+        call->request = grpc::ByteBuffer(&empty, 1);
+        grpcCall = call;
+
+        // 只持有弱引用，Probe 只在 io_context 的线程上析构；截止时间定时器持有强引用直到探测结束
+        std::weak_ptr<Probe> weak = shared_from_this();
+        call->stub.UnaryCall(&call->context, HEALTH_CHECK_METHOD, grpc::StubOptions(), &call->request, &call->response,
+            [weak, call](grpc::Status status) {
+                bool healthy = false;
+                std::string reason;
+                if (status.ok()) {
+                    healthy = isServing(call->response);
+                    if (!healthy) {
+                        reason = "not serving";
+                    }
+                } else if (status.error_code() == grpc::StatusCode::UNIMPLEMENTED) {
+                    // 没有注册健康检查服务：能完成一次 RPC 就视为健康
+                    healthy = true;
+                } else {
+                    reason = "grpc: " + status.error_message();
+                }
+                net::post(call->guard.get_executor(), [weak, healthy, reason]() {
+                    if (auto self = weak.lock()) {
+                        self->finish(healthy, reason);
+                    }
+                });
+            });
+    }
+
+    // 结束探测并回报结果，只生效一次
+    void finish(bool healthy, const std::string& reason) {
+        if (finished) {
+            return;
+        }
+        finished = true;
+
+        boost::system::error_code ignored;
+        deadline.cancel();
+        resolver.cancel();
+        socket.close(ignored);
+        if (grpcCall) {
+            grpcCall->context.TryCancel();
+        }
+
+        Callback callback = std::move(done);
+        done = nullptr;
+        if (callback) {
+            callback(healthy, reason);
+        }
+    }
+
+    // 放弃探测，不回报结果
+    void abort() {
+        done = nullptr;
+        finish(false, "");
+    }
+
+    net::io_context& ioContext;
+    tcp::resolver resolver;
+    tcp::socket socket;
+    net::steady_timer deadline;
+    std::string buffer;
+    std::shared_ptr<GrpcCall> grpcCall;
+    HealthProbe protocol;
+    std::chrono::milliseconds timeout;
+    Callback done;
+    bool finished = false;
+};
 
 HealthChecker::HealthChecker(std::shared_ptr<LoadBalancer> loadBalancer, std::shared_ptr<ServiceRegistry> serviceRegistry)
-    : loadBalancer_(loadBalancer), serviceRegistry_(serviceRegistry), shouldStop_(false) {}
+    : loadBalancer_(loadBalancer), serviceRegistry_(serviceRegistry), running_(false),
+      refreshTimer_(ioContext_), random_(std::random_device{}()),
+      interval_(std::chrono::seconds(30)), timeout_(MAX_PROBE_TIMEOUT),
+      rise_(DEFAULT_RISE), fall_(DEFAULT_FALL) {}
 
 HealthChecker::~HealthChecker() {
     stopHealthChecking();
 }
 
 void HealthChecker::startHealthChecking(int intervalSeconds) {
-    if (healthCheckThread_ && healthCheckThread_->joinable()) {
+    if (running_.exchange(true)) {
         return; // 已经在运行中
     }
-    
-    shouldStop_ = false;
-    healthCheckThread_ = std::make_unique<std::thread>([this, intervalSeconds]() {
-        while (!shouldStop_) {
-            // 获取所有注册的服务
-            auto allServices = serviceRegistry_->getAllRegisteredServices();
-            
-            // 对每个服务实例执行健康检查
-            for (const auto& servicePair : allServices) {
-                const std::string& serviceName = servicePair.first;
-                const auto& instances = servicePair.second;
-                
-                for (const auto& instance : instances) {
-                    performHealthCheck(serviceName, instance.host, instance.port);
-                }
+
+    interval_ = std::chrono::seconds(std::max(intervalSeconds, 1));
+    timeout_ = std::min<std::chrono::milliseconds>(MAX_PROBE_TIMEOUT, interval_ / 2);
+
+    ioContext_.restart();
+    workGuard_ = std::make_unique<net::executor_work_guard<net::io_context::executor_type>>(ioContext_.get_executor());
+    net::post(ioContext_, [this]() { refreshTargets(); });
+    healthCheckThread_ = std::make_unique<std::thread>([this]() { ioContext_.run(); });
+
+    LOG_INFO("Started health checking with interval {} seconds", intervalSeconds);
+}
+
+void HealthChecker::stopHealthChecking() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    // 取消所有定时器并放弃在途探测，io_context 在没有待执行的操作后自行退出
+    net::post(ioContext_, [this]() {
+        refreshTimer_.cancel();
+        for (auto& entry : targets_) {
+            entry.second->removed = true;
+            entry.second->timer.cancel();
+            if (auto probe = entry.second->inFlight.lock()) {
+                probe->abort();
             }
-            
-            // 等待指定的时间间隔
-            std::this_thread::sleep_for(std::chrono::seconds(intervalSeconds));
         }
+        targets_.clear();
     });
-    
-    std::cout << "Started health checking with interval " << intervalSeconds << " seconds" << std::endl;
-}
+    workGuard_.reset();
 
-void HealthChecker::stopHealthChecking() {
-    shouldStop_ = true;
-    
     if (healthCheckThread_ && healthCheckThread_->joinable()) {
         healthCheckThread_->join();
-        healthCheckThread_.reset();
     }
-    
-    std::cout << "Stopped health checking" << std::endl;
+    healthCheckThread_.reset();
+
+    LOG_INFO("Stopped health checking");
 }
 
 void HealthChecker::performHealthCheck(const std::string& serviceName, const std::string& host, int port) {
-    bool isHealthy = checkServiceHealth(host, port);
+    std::string metadata;
+    for (const auto& registration : serviceRegistry_->getRegisteredServices(serviceName)) {
+        if (registration.host == host && registration.port == port) {
+            metadata = registration.metadata;
+            break;
+        }
+    }
+    HealthProbe protocol = probeFor(serviceName, metadata);
+
+    std::shared_ptr<grpc::Channel> channel;
+    if (protocol == HealthProbe::Grpc) {
+        channel = grpc::CreateChannel(host + ":" + std::to_string(port), grpc::InsecureChannelCredentials());
+    }
+
+    net::io_context ioContext;
+    bool isHealthy = false;
+    std::string reason;
+    auto probe = std::make_shared<Probe>(ioContext, protocol, MAX_PROBE_TIMEOUT,
+        [&isHealthy, &reason](bool healthy, const std::string& why) {
+            isHealthy = healthy;
+            reason = why;
+        });
+    probe->start(host, port, channel);
+    probe.reset();
+    ioContext.run();
+
     loadBalancer_->updateHealthStatus(serviceName, host, port, isHealthy);
-    
+
     if (isHealthy) {
-        std::cout << "Health check passed for " << serviceName << " at " << host << ":" << port << std::endl;
+        LOG_DEBUG("Health check passed for {} at {}:{}", serviceName, host, port);
     } else {
-        std::cout << "Health check failed for " << serviceName << " at " << host << ":" << port << std::endl;
+        LOG_WARN("Health check failed for {} at {}:{} ({})", serviceName, host, port, reason);
     }
 }
 
-bool HealthChecker::checkServiceHealth(const std::string& host, int port) {
-    // 创建socket
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        return false;
+void HealthChecker::setProbe(const std::string& serviceName, HealthProbe probe) {
+    std::lock_guard<std::mutex> lock(configMutex_);
+    probes_[serviceName] = probe;
+}
+
+void HealthChecker::setThresholds(int rise, int fall) {
+    std::lock_guard<std::mutex> lock(configMutex_);
+    rise_ = std::max(rise, 1);
+    fall_ = std::max(fall, 1);
+}
+
+void HealthChecker::refreshTargets() {
+    if (!running_) {
+        return;
     }
-    
-    // 设置超时
-    struct timeval timeout;
-    timeout.tv_sec = 5;  // 5秒超时
-    timeout.tv_usec = 0;
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
-    
-    // 解析主机地址
-    struct hostent* he = gethostbyname(host.c_str());
-    if (!he) {
-        close(sock);
-        return false;
+
+    auto allServices = serviceRegistry_->getAllRegisteredServices();
+
+    std::map<std::string, std::shared_ptr<Target>> targets;
+    for (const auto& servicePair : allServices) {
+        const std::string& serviceName = servicePair.first;
+        for (const auto& registration : servicePair.second) {
+            std::string key = serviceName + "/" + registration.host + ":" + std::to_string(registration.port);
+            HealthProbe protocol = probeFor(serviceName, registration.metadata);
+
+            auto existing = targets_.find(key);
+            if (existing != targets_.end()) {
+                auto target = existing->second;
+                if (target->protocol != protocol) {
+                    target->protocol = protocol;
+                    target->channel.reset();
+                }
+                targets.emplace(key, target);
+                targets_.erase(existing);
+                continue;
+            }
+
+            // 新目标在间隔开头的一小段时间内随机错开首次探测
+            auto target = std::make_shared<Target>(ioContext_, serviceName, registration.host, registration.port, protocol);
+            std::uniform_int_distribution<int64_t> offset(0, static_cast<int64_t>(interval_.count() * JITTER_RATIO));
+            schedule(target, std::chrono::milliseconds(offset(random_)));
+            targets.emplace(key, target);
+        }
+    }
+
+    // 剩下的是已经取消注册的实例
+    for (auto& entry : targets_) {
+        entry.second->removed = true;
+        entry.second->timer.cancel();
+        if (auto probe = entry.second->inFlight.lock()) {
+            probe->abort();
+        }
+    }
+    targets_.swap(targets);
+
+    refreshTimer_.expires_after(interval_);
+    refreshTimer_.async_wait([this](const boost::system::error_code& ec) {
+        if (!ec) {
+            refreshTargets();
+        }
+    });
+}
+
+void HealthChecker::schedule(const std::shared_ptr<Target>& target, std::chrono::milliseconds delay) {
+    target->timer.expires_after(delay);
+    target->timer.async_wait([this, target](const boost::system::error_code& ec) {
+        if (ec || !running_ || target->removed) {
+            return;
+        }
+        launchProbe(target);
+    });
+}
+
+void HealthChecker::launchProbe(const std::shared_ptr<Target>& target) {
+    if (target->protocol == HealthProbe::Grpc && !target->channel) {
+        target->channel = grpc::CreateChannel(target->host + ":" + std::to_string(target->port),
+                                              grpc::InsecureChannelCredentials());
     }
-    
-    // 设置地址信息
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    memcpy(&addr.sin_addr, he->h_addr_list[0], he->h_length);
-    
-    // 尝试连接
-    int result = connect(sock, (struct sockaddr*)&addr, sizeof(addr));
-    close(sock);
-    
-    return (result == 0);
-}
\ No newline at end of file
+
+    auto probe = std::make_shared<Probe>(ioContext_, target->protocol, timeout_,
+        [this, target](bool healthy, const std::string& reason) {
+            if (target->removed) {
+                return;
+            }
+            if (!healthy) {
+                LOG_DEBUG("Health probe ({}) failed for {} at {}:{}: {}", probeName(target->protocol),
+                          target->serviceName, target->host, target->port, reason);
+            }
+            record(*target, healthy);
+            if (running_) {
+                schedule(target, nextDelay(*target));
+            }
+        });
+    target->inFlight = probe;
+    probe->start(target->host, target->port, target->channel);
+}
+
+void HealthChecker::record(Target& target, bool healthy) {
+    int rise, fall;
+    {
+        std::lock_guard<std::mutex> lock(configMutex_);
+        rise = rise_;
+        fall = fall_;
+    }
+
+    if (healthy) {
+        ++target.successes;
+        target.failures = 0;
+    } else {
+        ++target.failures;
+        target.successes = 0;
+    }
+
+    if (!target.healthy && target.successes >= rise) {
+        target.healthy = true;
+        loadBalancer_->updateHealthStatus(target.serviceName, target.host, target.port, true);
+        LOG_INFO("Health check recovered for {} at {}:{} after {} successful probes",
+                 target.serviceName, target.host, target.port, target.successes);
+    } else if (target.healthy && target.failures >= fall) {
+        target.healthy = false;
+        loadBalancer_->updateHealthStatus(target.serviceName, target.host, target.port, false);
+        LOG_WARN("Health check failed for {} at {}:{} after {} consecutive failures",
+                 target.serviceName, target.host, target.port, target.failures);
+    }
+}
+
+std::chrono::milliseconds HealthChecker::nextDelay(const Target& target) {
+    // 结果与已上报的状态相反时尽快确认：剩余的几次探测在半个间隔内完成
+    bool confirming = target.healthy ? target.failures > 0 : target.successes > 0;
+    if (confirming) {
+        int threshold;
+        {
+            std::lock_guard<std::mutex> lock(configMutex_);
+            threshold = target.healthy ? fall_ : rise_;
+        }
+        return std::max<std::chrono::milliseconds>(MIN_RETRY_DELAY, interval_ / (2 * threshold));
+    }
+
+    // 间隔随机缩短至多 JITTER_RATIO，相邻两次探测的间隔不会超过设定值
+    std::uniform_real_distribution<double> jitter(1.0 - JITTER_RATIO, 1.0);
+    return std::chrono::milliseconds(static_cast<int64_t>(interval_.count() * jitter(random_)));
+}
+
+HealthProbe HealthChecker::probeFor(const std::string& serviceName, const std::string& metadata) {
+    {
+        std::lock_guard<std::mutex> lock(configMutex_);
+        auto it = probes_.find(serviceName);
+        if (it != probes_.end()) {
+            return it->second;
+        }
+    }
+
+    // 元数据中形如 "version=1.0;probe=mysql" 的探测协议声明
+    auto pos = metadata.find("probe=");
+    if (pos != std::string::npos) {
+        std::string name = metadata.substr(pos + 6, metadata.find_first_of(";, ", pos) - pos - 6);
+        if (name == "mysql") {
+            return HealthProbe::MySQL;
+        }
+        if (name == "redis") {
+            return HealthProbe::Redis;
+        }
+        if (name == "grpc") {
+            return HealthProbe::Grpc;
+        }
+    }
+    return HealthProbe::Tcp;
+}
@@ -4,11 +4,30 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <random>
 #include <thread>
 #include <chrono>
+#include <boost/asio.hpp>
 #include "load_balancer.h"
 #include "service_registry.h"
 
+namespace net = boost::asio;
+
+// 健康检查的探测协议
+enum class HealthProbe {
+    Tcp,      // 只建立 TCP 连接
+    MySQL,    // 读取 MySQL 握手包，检查协议版本
+    Redis,    // 发送 PING，期望 +PONG
+    Grpc      // 调用 grpc.health.v1.Health/Check
+};
+
+// 所有实例的探测在同一个 io_context 上异步并发执行，每次探测有独立的截止时间，
+// 不可达的主机只占用自己的那次探测，不会拖慢其他实例。
+// 每个实例按抖动后的间隔单独调度；连续失败 fall 次才标记为不健康，连续成功 rise 次才恢复。
+// 出现与当前状态相反的结果后改用较短的重试间隔，使确认状态变化所需的几次探测在一个检查间隔内完成。
 class HealthChecker {
 public:
     HealthChecker(std::shared_ptr<LoadBalancer> loadBalancer, std::shared_ptr<ServiceRegistry> serviceRegistry);
@@ -16,21 +35,69 @@ public:
 
     // 启动健康检查
     void startHealthChecking(int intervalSeconds = 30);
-    
-    // 停止健康检查
+
+    // 停止健康检查，正在进行的探测被放弃
     void stopHealthChecking();
-    
-    // 执行单次健康检查
+
+    // 执行单次健康检查（同步等待结果，不经过阈值直接更新健康状态）
     void performHealthCheck(const std::string& serviceName, const std::string& host, int port);
 
+    // 设置服务的探测协议；未设置时读取注册元数据中的 "probe=tcp|mysql|redis|grpc"，默认 TCP
+    void setProbe(const std::string& serviceName, HealthProbe probe);
+
+    // 设置状态翻转阈值：连续成功 rise 次恢复健康，连续失败 fall 次标记为不健康
+    void setThresholds(int rise, int fall);
+
 private:
+    struct Target;
+    struct Probe;
+
+    // 从注册中心同步探测目标，并安排下一次同步（在检查线程上执行）
+    void refreshTargets();
+
+    // 安排目标的下一次探测
+    void schedule(const std::shared_ptr<Target>& target, std::chrono::milliseconds delay);
+
+    // 对目标发起一次探测
+    void launchProbe(const std::shared_ptr<Target>& target);
+
+    // 记录探测结果，连续次数达到阈值时更新负载均衡器
+    void record(Target& target, bool healthy);
+
+    // 根据目标当前的连续计数决定下一次探测的延迟
+    std::chrono::milliseconds nextDelay(const Target& target);
+
+    // 解析服务的探测协议
+    HealthProbe probeFor(const std::string& serviceName, const std::string& metadata);
+
     std::shared_ptr<LoadBalancer> loadBalancer_;
     std::shared_ptr<ServiceRegistry> serviceRegistry_;
+
+    net::io_context ioContext_;
+    std::unique_ptr<net::executor_work_guard<net::io_context::executor_type>> workGuard_;
     std::unique_ptr<std::thread> healthCheckThread_;
-    bool shouldStop_;
-    
-    // 实际的健康检查实现
-    bool checkServiceHealth(const std::string& host, int port);
+    std::atomic<bool> running_;
+
+    // 以下成员只在检查线程上访问
+    net::steady_timer refreshTimer_;
+    std::map<std::string, std::shared_ptr<Target>> targets_;   // "服务名/主机:端口" -> 探测目标
+    std::mt19937 random_;
+    std::chrono::milliseconds interval_;
+    std::chrono::milliseconds timeout_;
+
+    std::mutex configMutex_;
+    std::map<std::string, HealthProbe> probes_;   // 服务名 -> 显式指定的探测协议
+    int rise_;
+    int fall_;
+
+    static constexpr int DEFAULT_RISE = 2;
+    static constexpr int DEFAULT_FALL = 3;
+    // 单次探测的截止时间上限，检查间隔较短时取间隔的一半
+    static constexpr std::chrono::milliseconds MAX_PROBE_TIMEOUT{2000};
+    // 确认状态变化时重试间隔的下限
+    static constexpr std::chrono::milliseconds MIN_RETRY_DELAY{200};
+    // 每次间隔随机缩短的最大比例，避免所有实例在同一时刻被探测
+    static constexpr double JITTER_RATIO = 0.2;
 };
 
-#endif // HEALTH_CHECKER_H
\ No newline at end of file
+#endif // HEALTH_CHECKER_H
@@ -1,202 +1,616 @@
 #include "load_balancer.h"
 #include <algorithm>
+#include <cmath>
+#include <functional>
 #include <iostream>
+#include <numeric>
 #include <random>
 
-// 静态实例指针
-static LoadBalancer* instance = nullptr;
-static std::mutex instanceMutex;
+// 某个服务在某一时刻的实例列表，发布后只读
+struct LoadBalancer::Snapshot {
+    std::vector<std::shared_ptr<ServiceInstance>> instances;  // 全部实例
+    std::vector<std::shared_ptr<ServiceInstance>> healthy;    // 其中健康的实例
+    std::vector<uint32_t> schedule;                           // 平滑加权轮询的一个完整周期（healthy 下标）
+};
 
-LoadBalancer& LoadBalancer::getInstance() {
-    std::lock_guard<std::mutex> lock(instanceMutex);
-    if (instance == nullptr) {
-        instance = new LoadBalancer();
+struct LoadBalancer::Service {
+    explicit Service(const std::string& n) : name(n), version(0), cursor(0), weightedCursor(0) {}
+
+    std::string name;
+    std::shared_ptr<const Snapshot> snapshot;  // 只通过 std::atomic_load / std::atomic_store 访问
+    std::atomic<uint64_t> version;           // 每发布一次快照加一，读者据此判断线程缓存是否过期
+    std::atomic<uint64_t> cursor;            // 轮询游标
+    std::atomic<uint64_t> weightedCursor;    // 加权轮询调度表游标
+};
+
+namespace {
+
+// 线程私有的随机数，选择实例时不争用共享的生成器
+uint32_t nextRandom() {
+    static thread_local std::mt19937 gen(std::random_device{}());
+    return static_cast<uint32_t>(gen());
+}
+
+// 64 位整数混合（splitmix64 的终结步骤），相近的输入得到分布均匀的输出
+uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief 按 nginx 的平滑加权轮询生成一个完整周期
+ * 每轮所有实例的当前值加上各自权重，取最大者并减去总权重；高权重实例被均匀地穿插在周期中
+ */
+std::vector<uint32_t> buildSmoothSchedule(std::vector<int> weights, int maxLength) {
+    int divisor = 0;
+    for (int& weight : weights) {
+        weight = std::max(weight, 0);
+        divisor = std::gcd(divisor, weight);
+    }
+    if (divisor == 0) {
+        // 全部为 0 时按等权处理
+        std::fill(weights.begin(), weights.end(), 1);
+        divisor = 1;
     }
+
+    long long total = 0;
+    for (int& weight : weights) {
+        weight /= divisor;
+        total += weight;
+    }
+    if (total > maxLength) {
+        total = 0;
+        long long original = std::accumulate(weights.begin(), weights.end(), 0LL);
+        for (int& weight : weights) {
+            if (weight > 0) {
+                weight = static_cast<int>(std::max(1LL, weight * maxLength / original));
+            }
+            total += weight;
+        }
+    }
+
+    std::vector<uint32_t> schedule;
+    schedule.reserve(static_cast<size_t>(total));
+    std::vector<long long> current(weights.size(), 0);
+    for (long long round = 0; round < total; ++round) {
+        size_t best = 0;
+        for (size_t i = 0; i < weights.size(); ++i) {
+            current[i] += weights[i];
+            if (current[i] > current[best]) {
+                best = i;
+            }
+        }
+        current[best] -= total;
+        schedule.push_back(static_cast<uint32_t>(best));
+    }
+    return schedule;
+}
+
+} // namespace
+
+// ==================== InstanceLoad ====================
+
+void InstanceLoad::record(std::chrono::nanoseconds latency, bool success) {
+    int64_t now = steadyNowNs();
+    double sample = std::chrono::duration<double, std::micro>(latency).count();
+    if (!success) {
+        sample = std::max(sample, FAILURE_PENALTY_US);
+    }
+
+    // 比均值慢的样本立即生效，尾延迟一变差就减少分到的流量；更快的样本按时间衰减逐步拉低均值
+    double elapsed = (now - sampledAtNs.exchange(now, std::memory_order_relaxed)) / 1e9;
+    double keep = std::exp(-std::max(elapsed, 0.0) / DECAY_SECONDS);
+    double current = latencyUs.load(std::memory_order_relaxed);
+    double updated;
+    do {
+        updated = (current <= 0 || sample > current) ? sample : current * keep + sample * (1 - keep);
+    } while (!latencyUs.compare_exchange_weak(current, updated, std::memory_order_relaxed));
+}
+
+double InstanceLoad::cost() const {
+    double latency = latencyUs.load(std::memory_order_relaxed);
+    if (latency > 0) {
+        // 长时间没有样本的实例逐渐回落，慢过的实例之后仍有机会被重新探测
+        double idle = (steadyNowNs() - sampledAtNs.load(std::memory_order_relaxed)) / 1e9;
+        latency *= std::exp(-std::max(idle, 0.0) / DECAY_SECONDS);
+    }
+    // 没有样本时按 1 微秒计，新实例先分到少量流量拿到样本
+    return std::max(latency, 1.0) * (inFlight.load(std::memory_order_relaxed) + 1);
+}
+
+// ==================== CircuitBreaker ====================
+
+CircuitBreaker::CircuitBreaker(const std::string& name)
+    : name_(name), state_(State::Closed), openUntilNs_(0), halfOpenSinceNs_(0),
+      trialsLeft_(0), trialSuccesses_(0), consecutiveOpens_(0) {}
+
+bool CircuitBreaker::allowRequest() {
+    State state = state_.load(std::memory_order_acquire);
+    if (state == State::Closed) {
+        return true;
+    }
+
+    int64_t now = steadyNowNs();
+    if (state == State::Open) {
+        if (now < openUntilNs_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        // 冷却结束：先准备好试探名额再切换状态，只有一个线程切换成功
+        trialsLeft_.store(TRIAL_REQUESTS, std::memory_order_relaxed);
+        trialSuccesses_.store(0, std::memory_order_relaxed);
+        halfOpenSinceNs_.store(now, std::memory_order_relaxed);
+        if (state_.compare_exchange_strong(state, State::HalfOpen, std::memory_order_acq_rel)) {
+            LOG_INFO("Circuit breaker for {} half-open, allowing {} trial requests", name_, TRIAL_REQUESTS);
+        } else if (state != State::HalfOpen) {
+            return state == State::Closed;
+        }
+    }
+
+    // 试探请求迟迟没有结果（例如选中后没有发出）时重新发放名额，避免一直停在半开
+    int64_t since = halfOpenSinceNs_.load(std::memory_order_relaxed);
+    if (now - since > std::chrono::duration_cast<std::chrono::nanoseconds>(BASE_OPEN_DURATION).count() &&
+        halfOpenSinceNs_.compare_exchange_strong(since, now, std::memory_order_relaxed)) {
+        trialsLeft_.store(TRIAL_REQUESTS, std::memory_order_relaxed);
+    }
+    return trialsLeft_.fetch_sub(1, std::memory_order_acq_rel) > 0;
+}
+
+bool CircuitBreaker::isAvailable() const {
+    switch (state_.load(std::memory_order_acquire)) {
+    case State::Closed:
+        return true;
+    case State::Open:
+        return steadyNowNs() >= openUntilNs_.load(std::memory_order_acquire);
+    default:
+        return trialsLeft_.load(std::memory_order_relaxed) > 0;
+    }
+}
+
+void CircuitBreaker::record(std::chrono::nanoseconds latency, bool success) {
+    int64_t now = steadyNowNs();
+    bool slow = latency >= SLOW_CALL_DURATION;
+    State state = state_.load(std::memory_order_acquire);
+
+    if (state == State::HalfOpen) {
+        if (!success || slow) {
+            trip(State::HalfOpen, now);
+        } else if (trialSuccesses_.fetch_add(1, std::memory_order_acq_rel) + 1 >= TRIAL_REQUESTS) {
+            // 试探全部成功：清空窗口，旧的失败不再计入
+            for (Bucket& bucket : buckets_) {
+                bucket.epoch.store(-1, std::memory_order_relaxed);
+            }
+            if (state_.compare_exchange_strong(state, State::Closed, std::memory_order_acq_rel)) {
+                consecutiveOpens_.store(0, std::memory_order_relaxed);
+                LOG_INFO("Circuit breaker for {} closed after {} successful trial requests", name_, TRIAL_REQUESTS);
+            }
+        }
+        return;
+    }
+    if (state == State::Open) {
+        // 打开之前发出的请求，结果不再影响状态
+        return;
+    }
+
+    // 写入当前时间片的桶，桶属于更早的时间片时先清零（并发下可能丢失少量计数，不影响比例判断）
+    int64_t bucketNs = std::chrono::duration_cast<std::chrono::nanoseconds>(BUCKET_DURATION).count();
+    int64_t epoch = now / bucketNs;
+    Bucket& bucket = buckets_[epoch % WINDOW_BUCKETS];
+    int64_t seen = bucket.epoch.load(std::memory_order_acquire);
+    if (seen != epoch && bucket.epoch.compare_exchange_strong(seen, epoch, std::memory_order_acq_rel)) {
+        bucket.total.store(0, std::memory_order_relaxed);
+        bucket.failures.store(0, std::memory_order_relaxed);
+        bucket.slow.store(0, std::memory_order_relaxed);
+    }
+    bucket.total.fetch_add(1, std::memory_order_relaxed);
+    if (!success) {
+        bucket.failures.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (slow) {
+        bucket.slow.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // 成功且不慢的调用不可能让比例越过阈值
+    if (success && !slow) {
+        return;
+    }
+
+    uint32_t total = 0, failures = 0, slowCalls = 0;
+    for (const Bucket& b : buckets_) {
+        int64_t e = b.epoch.load(std::memory_order_acquire);
+        if (e > epoch - WINDOW_BUCKETS && e <= epoch) {
+            total += b.total.load(std::memory_order_relaxed);
+            failures += b.failures.load(std::memory_order_relaxed);
+            slowCalls += b.slow.load(std::memory_order_relaxed);
+        }
+    }
+    if (total >= MIN_REQUESTS &&
+        (failures >= total * FAILURE_RATE_THRESHOLD || slowCalls >= total * SLOW_RATE_THRESHOLD)) {
+        LOG_WARN("Circuit breaker for {} opening: {} of {} calls failed, {} slow in the last {} s",
+                 name_, failures, total, slowCalls, WINDOW_BUCKETS * BUCKET_DURATION.count() / 1000);
+        trip(State::Closed, now);
+    }
+}
+
+void CircuitBreaker::trip(State from, int64_t nowNs) {
+    int opens = consecutiveOpens_.load(std::memory_order_relaxed);
+    auto duration = std::min<std::chrono::milliseconds>(BASE_OPEN_DURATION * (1LL << std::min(opens, 16)),
+                                                         MAX_OPEN_DURATION);
+    openUntilNs_.store(nowNs + std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(),
+                       std::memory_order_release);
+    if (state_.compare_exchange_strong(from, State::Open, std::memory_order_acq_rel)) {
+        consecutiveOpens_.fetch_add(1, std::memory_order_relaxed);
+        LOG_WARN("Circuit breaker for {} open for {} ms", name_, duration.count());
+    }
+}
+
+// ==================== InstanceCall ====================
+
+InstanceCall::InstanceCall(const std::shared_ptr<ServiceInstance>& instance)
+    : load_(instance ? instance->load.get() : nullptr), breaker_(instance ? instance->breaker.get() : nullptr),
+      start_(std::chrono::steady_clock::now()), success_(true), cancelled_(false) {
+    if (load_) {
+        load_->inFlight.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+InstanceCall::~InstanceCall() {
+    auto latency = std::chrono::steady_clock::now() - start_;
+    if (load_) {
+        if (!cancelled_) {
+            load_->record(latency, success_);
+        }
+        load_->inFlight.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (breaker_ && !cancelled_) {
+        breaker_->record(latency, success_);
+    }
+}
+
+// ==================== LoadBalancer ====================
+
+// 使用局部静态变量实现线程安全的单例模式
+// 实例有意不析构，进程退出时仍在运行的后台线程可以安全访问
+LoadBalancer& LoadBalancer::getInstance() {
+    static LoadBalancer* instance = new LoadBalancer();
     return *instance;
 }
 
-LoadBalancer::LoadBalancer() {}
+LoadBalancer::LoadBalancer() : serviceMap_(new ServiceMap()) {}
+
+LoadBalancer::~LoadBalancer() {
+    delete serviceMap_.load();
+}
+
+LoadBalancer::ServiceHandle LoadBalancer::getServiceHandle(const std::string& serviceName) {
+    if (Service* service = findService(serviceName)) {
+        return service;
+    }
 
-LoadBalancer::~LoadBalancer() {}
+    std::lock_guard<std::mutex> lock(mutex_);
+    return getOrCreateService_impl(serviceName);
+}
 
 void LoadBalancer::addServiceInstance(const std::string& serviceName, const std::string& host, int port, int weight) {
     std::lock_guard<std::mutex> lock(mutex_);
-    
+
     auto instance = std::make_shared<ServiceInstance>(serviceName, host, port);
     instance->weight = weight;
-    
-    serviceInstances_[serviceName].push_back(instance);
-    currentIndices_[serviceName] = 0;
-    
+
+    Service* service = getOrCreateService_impl(serviceName);
+    std::vector<std::shared_ptr<ServiceInstance>> instances = std::atomic_load(&service->snapshot)->instances;
+    instances.push_back(instance);
+    publish_impl(service, std::move(instances));
+
     LOG_INFO("Added service instance: {} at {}:{} with weight {}", serviceName, host, port, weight);
 }
 
 void LoadBalancer::removeServiceInstance(const std::string& serviceName, const std::string& host, int port) {
     std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto& instances = serviceInstances_[serviceName];
+
+    Service* service = findService(serviceName);
+    if (!service) {
+        LOG_WARN("Attempted to remove non-existent service instance: {} at {}:{}", serviceName, host, port);
+        return;
+    }
+
+    std::vector<std::shared_ptr<ServiceInstance>> instances = std::atomic_load(&service->snapshot)->instances;
     auto it = std::find_if(instances.begin(), instances.end(),
         [&host, &port](const std::shared_ptr<ServiceInstance>& instance) {
             return instance->host == host && instance->port == port;
         });
-        
+
     if (it != instances.end()) {
         instances.erase(it);
+        publish_impl(service, std::move(instances));
         LOG_INFO("Removed service instance: {} at {}:{}", serviceName, host, port);
     } else {
         LOG_WARN("Attempted to remove non-existent service instance: {} at {}:{}", serviceName, host, port);
     }
 }
 
+std::shared_ptr<ServiceInstance> LoadBalancer::getNextHealthyInstance(ServiceHandle service, LoadBalanceAlgorithm algorithm) {
+    const Snapshot* snapshot = service ? currentSnapshot(service) : nullptr;
+    if (!snapshot || snapshot->instances.empty()) {
+        LOG_WARN("No service instances found for service: {}", service ? service->name : std::string());
+        return nullptr;
+    }
+
+    // 根据算法选择实例
+    switch (algorithm) {
+    case LoadBalanceAlgorithm::WeightedRoundRobin:
+        return getNextInstanceWeightedRoundRobin(service, *snapshot);
+    case LoadBalanceAlgorithm::LeastConnections:
+        return getNextInstanceLeastConnections(service, *snapshot);
+    case LoadBalanceAlgorithm::PowerOfTwoChoices:
+        return getNextInstancePowerOfTwoChoices(service, *snapshot);
+    default:
+        return getNextInstanceRoundRobin(service, *snapshot);
+    }
+}
+
+std::shared_ptr<ServiceInstance> LoadBalancer::getInstanceForKey(ServiceHandle service, uint64_t key,
+                                                                 const std::shared_ptr<ServiceInstance>& avoid) {
+    const Snapshot* snapshot = service ? currentSnapshot(service) : nullptr;
+    if (!snapshot || snapshot->healthy.empty()) {
+        LOG_WARN("No healthy instances available for service: {}", service ? service->name : std::string());
+        return nullptr;
+    }
+
+    // 每个实例按 (键, 地址) 的哈希打分，按分数从高到低找第一个熔断器放行的实例
+    std::vector<std::pair<uint64_t, size_t>> ranked;
+    ranked.reserve(snapshot->healthy.size());
+    for (size_t i = 0; i < snapshot->healthy.size(); ++i) {
+        const auto& instance = snapshot->healthy[i];
+        uint64_t score = mix64(key ^ std::hash<std::string>()(instance->host) ^
+                               (static_cast<uint64_t>(instance->port) << 32));
+        ranked.emplace_back(score, i);
+    }
+    std::sort(ranked.begin(), ranked.end(), std::greater<std::pair<uint64_t, size_t>>());
+
+    for (const auto& entry : ranked) {
+        const auto& instance = snapshot->healthy[entry.second];
+        // 健康状态变化时实例对象会被替换，按地址判断
+        if (avoid && instance->host == avoid->host && instance->port == avoid->port) {
+            continue;
+        }
+        if (instance->breaker->allowRequest()) {
+            return instance;
+        }
+    }
+    LOG_WARN("All healthy instances of {} are rejected by circuit breakers", service->name);
+    return nullptr;
+}
+
 std::shared_ptr<ServiceInstance> LoadBalancer::getNextHealthyInstance(const std::string& serviceName, const std::string& algorithm) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = serviceInstances_.find(serviceName);
-    if (it == serviceInstances_.end() || it->second.empty()) {
+    Service* service = findService(serviceName);
+    if (!service) {
         LOG_WARN("No service instances found for service: {}", serviceName);
         return nullptr;
     }
-    
-    const auto& instances = it->second;
-    
-    // 根据算法选择实例
+
+    LoadBalanceAlgorithm parsed = LoadBalanceAlgorithm::RoundRobin;
     if (algorithm == "weighted_round_robin") {
-        return getNextInstanceWeightedRoundRobin(instances);
+        parsed = LoadBalanceAlgorithm::WeightedRoundRobin;
     } else if (algorithm == "least_connections") {
-        return getNextInstanceLeastConnections(instances);
-    } else {
-        return getNextInstanceRoundRobin(instances);
+        parsed = LoadBalanceAlgorithm::LeastConnections;
+    } else if (algorithm == "p2c") {
+        parsed = LoadBalanceAlgorithm::PowerOfTwoChoices;
     }
+    return getNextHealthyInstance(service, parsed);
 }
 
 void LoadBalancer::updateHealthStatus(const std::string& serviceName, const std::string& host, int port, bool isHealthy) {
     std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = serviceInstances_.find(serviceName);
-    if (it == serviceInstances_.end()) {
+
+    Service* service = findService(serviceName);
+    if (!service) {
         LOG_WARN("Service not found when updating health status: {}", serviceName);
         return;
     }
-    
-    auto& instances = it->second;
+
+    std::vector<std::shared_ptr<ServiceInstance>> instances = std::atomic_load(&service->snapshot)->instances;
     auto instanceIt = std::find_if(instances.begin(), instances.end(),
         [&host, &port](const std::shared_ptr<ServiceInstance>& instance) {
             return instance->host == host && instance->port == port;
         });
-        
-    if (instanceIt != instances.end()) {
-        (*instanceIt)->isHealthy = isHealthy;
-        LOG_INFO("Updated health status for {} at {}:{} to {}", serviceName, host, port, 
-                 isHealthy ? "healthy" : "unhealthy");
-    } else {
+
+    if (instanceIt == instances.end()) {
         LOG_WARN("Service instance not found when updating health status: {} at {}:{}", serviceName, host, port);
+        return;
     }
+
+    // 状态没有变化时不发布新快照
+    if ((*instanceIt)->isHealthy == isHealthy) {
+        return;
+    }
+
+    auto updated = std::make_shared<ServiceInstance>(**instanceIt);
+    updated->isHealthy = isHealthy;
+    *instanceIt = updated;
+    publish_impl(service, std::move(instances));
+    LOG_INFO("Updated health status for {} at {}:{} to {}", serviceName, host, port,
+             isHealthy ? "healthy" : "unhealthy");
 }
 
 std::vector<std::shared_ptr<ServiceInstance>> LoadBalancer::getServiceInstances(const std::string& serviceName) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = serviceInstances_.find(serviceName);
-    if (it == serviceInstances_.end()) {
+    Service* service = findService(serviceName);
+    if (!service) {
         LOG_WARN("No service instances found for service: {}", serviceName);
         return {};
     }
-    
-    return it->second;
+
+    return currentSnapshot(service)->instances;
+}
+
+LoadBalancer::Service* LoadBalancer::findService(const std::string& serviceName) const {
+    const ServiceMap* services = serviceMap_.load(std::memory_order_acquire);
+    auto it = services->find(serviceName);
+    return it != services->end() ? it->second : nullptr;
 }
 
-std::shared_ptr<ServiceInstance> LoadBalancer::getNextInstanceRoundRobin(const std::vector<std::shared_ptr<ServiceInstance>>& instances) {
-    // 过滤出健康的实例
-    std::vector<std::shared_ptr<ServiceInstance>> healthyInstances;
-    for (const auto& instance : instances) {
+LoadBalancer::Service* LoadBalancer::getOrCreateService_impl(const std::string& serviceName) {
+    if (Service* service = findService(serviceName)) {
+        return service;
+    }
+
+    services_.push_back(std::make_unique<Service>(serviceName));
+    Service* service = services_.back().get();
+    std::atomic_store(&service->snapshot, std::shared_ptr<const Snapshot>(std::make_shared<Snapshot>()));
+
+    const ServiceMap* old = serviceMap_.load();
+    auto* updated = new ServiceMap(*old);
+    (*updated)[serviceName] = service;
+    serviceMap_.store(updated, std::memory_order_release);
+    oldServiceMaps_.emplace_back(old);
+    return service;
+}
+
+void LoadBalancer::publish_impl(Service* service, std::vector<std::shared_ptr<ServiceInstance>> instances) {
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->instances = std::move(instances);
+    std::vector<int> weights;
+    for (const auto& instance : snapshot->instances) {
         if (instance->isHealthy) {
-            healthyInstances.push_back(instance);
+            snapshot->healthy.push_back(instance);
+            weights.push_back(instance->weight);
         }
     }
-    
-    if (healthyInstances.empty()) {
+    snapshot->schedule = buildSmoothSchedule(std::move(weights), MAX_SCHEDULE_LENGTH);
+
+    // 先换快照再加版本号：读者看到新版本号时一定能取到新快照；
+    // 旧快照由引用计数回收，仍被某个线程缓存时不会释放
+    std::atomic_store(&service->snapshot, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+    service->version.fetch_add(1, std::memory_order_release);
+}
+
+const LoadBalancer::Snapshot* LoadBalancer::currentSnapshot(const Service* service) {
+    // 每个线程为每个服务缓存一份快照的引用，版本号未变时直接使用，不触碰共享的引用计数
+    struct CachedSnapshot {
+        const Service* service;
+        uint64_t version;
+        std::shared_ptr<const Snapshot> snapshot;
+    };
+    static thread_local std::vector<CachedSnapshot> cache;
+
+    uint64_t version = service->version.load(std::memory_order_acquire);
+    auto it = std::find_if(cache.begin(), cache.end(),
+                           [service](const CachedSnapshot& entry) { return entry.service == service; });
+    if (it == cache.end()) {
+        cache.push_back(CachedSnapshot{service, version, std::atomic_load(&service->snapshot)});
+        return cache.back().snapshot.get();
+    }
+    if (it->version != version) {
+        it->version = version;
+        it->snapshot = std::atomic_load(&service->snapshot);
+    }
+    return it->snapshot.get();
+}
+
+std::shared_ptr<ServiceInstance> LoadBalancer::getNextInstanceRoundRobin(Service* service, const Snapshot& snapshot) {
+    if (snapshot.healthy.empty()) {
         LOG_WARN("No healthy instances available for round-robin selection");
         return nullptr;
     }
-    
-    // 使用轮询算法选择实例
-    std::string serviceName = healthyInstances[0]->serviceName;
-    size_t& currentIndex = currentIndices_[serviceName];
-    currentIndex = (currentIndex + 1) % healthyInstances.size();
-    
-    auto selectedInstance = healthyInstances[currentIndex];
-    LOG_DEBUG("Selected instance via round-robin: {} at {}:{}", 
-              selectedInstance->serviceName, selectedInstance->host, selectedInstance->port);
-    
-    return selectedInstance;
-}
-
-std::shared_ptr<ServiceInstance> LoadBalancer::getNextInstanceWeightedRoundRobin(const std::vector<std::shared_ptr<ServiceInstance>>& instances) {
-    // 过滤出健康的实例
-    std::vector<std::shared_ptr<ServiceInstance>> healthyInstances;
-    for (const auto& instance : instances) {
-        if (instance->isHealthy) {
-            healthyInstances.push_back(instance);
-        }
-    }
-    
-    if (healthyInstances.empty()) {
+
+    // 使用轮询算法选择实例，熔断的实例跳过
+    uint64_t cursor = service->cursor.fetch_add(1, std::memory_order_relaxed);
+    return admitFrom(service, snapshot, cursor % snapshot.healthy.size());
+}
+
+std::shared_ptr<ServiceInstance> LoadBalancer::getNextInstanceWeightedRoundRobin(Service* service, const Snapshot& snapshot) {
+    if (snapshot.healthy.empty()) {
         LOG_WARN("No healthy instances available for weighted round-robin selection");
         return nullptr;
     }
-    
-    // 简化的加权轮询算法
-    // 实际应用中可以使用更复杂的算法，如平滑加权轮询
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    
-    int totalWeight = 0;
-    for (const auto& instance : healthyInstances) {
-        totalWeight += instance->weight;
-    }
-    
-    std::uniform_int_distribution<> dis(1, totalWeight);
-    int randomWeight = dis(gen);
-    
-    int currentWeight = 0;
-    for (const auto& instance : healthyInstances) {
-        currentWeight += instance->weight;
-        if (randomWeight <= currentWeight) {
-            LOG_DEBUG("Selected instance via weighted round-robin: {} at {}:{} with weight {}", 
-                      instance->serviceName, instance->host, instance->port, instance->weight);
-            return instance;
-        }
+
+    // 调度表在发布快照时已经生成，这里只需按游标取下一项
+    uint64_t cursor = service->weightedCursor.fetch_add(1, std::memory_order_relaxed);
+    uint32_t index = snapshot.schedule[cursor % snapshot.schedule.size()];
+    if (snapshot.healthy[index]->breaker->allowRequest()) {
+        return snapshot.healthy[index];
     }
-    
-    auto selectedInstance = healthyInstances.back();
-    LOG_DEBUG("Selected instance via weighted round-robin (fallback): {} at {}:{} with weight {}", 
-              selectedInstance->serviceName, selectedInstance->host, selectedInstance->port, selectedInstance->weight);
-    return selectedInstance;
+    // 熔断实例的份额依次顺延给其他实例
+    return admitFrom(service, snapshot, index + 1);
 }
 
-std::shared_ptr<ServiceInstance> LoadBalancer::getNextInstanceLeastConnections(const std::vector<std::shared_ptr<ServiceInstance>>& instances) {
-    // 过滤出健康的实例
-    std::vector<std::shared_ptr<ServiceInstance>> healthyInstances;
-    for (const auto& instance : instances) {
-        if (instance->isHealthy) {
-            healthyInstances.push_back(instance);
+std::shared_ptr<ServiceInstance> LoadBalancer::getNextInstanceLeastConnections(Service* service, const Snapshot& snapshot) {
+    if (snapshot.healthy.empty()) {
+        LOG_WARN("No healthy instances available for least connections selection");
+        return nullptr;
+    }
+
+    // 从随机位置开始扫描，在途请求数相同时不会总落到同一个实例
+    size_t count = snapshot.healthy.size();
+    size_t start = nextRandom() % count;
+    size_t best = count;
+    int bestInFlight = 0;
+    for (size_t step = 0; step < count; ++step) {
+        size_t index = (start + step) % count;
+        if (!snapshot.healthy[index]->breaker->isAvailable()) {
+            continue;
+        }
+        int inFlight = snapshot.healthy[index]->load->inFlight.load(std::memory_order_relaxed);
+        if (best == count || inFlight < bestInFlight) {
+            best = index;
+            bestInFlight = inFlight;
         }
     }
-    
-    if (healthyInstances.empty()) {
-        LOG_WARN("No healthy instances available for least connections selection");
+    if (best != count && snapshot.healthy[best]->breaker->allowRequest()) {
+        return snapshot.healthy[best];
+    }
+    return admitFrom(service, snapshot, start);
+}
+
+std::shared_ptr<ServiceInstance> LoadBalancer::getNextInstancePowerOfTwoChoices(Service* service, const Snapshot& snapshot) {
+    if (snapshot.healthy.empty()) {
+        LOG_WARN("No healthy instances available for power-of-two-choices selection");
         return nullptr;
     }
-    
-    // 简化的最少连接数算法：随机选择一个健康的实例
-    // 实际应用中应该跟踪每个实例的连接数
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, healthyInstances.size() - 1);
-    
-    auto selectedInstance = healthyInstances[dis(gen)];
-    LOG_DEBUG("Selected instance via least connections (random): {} at {}:{}", 
-              selectedInstance->serviceName, selectedInstance->host, selectedInstance->port);
-    
-    return selectedInstance;
-}
\ No newline at end of file
+
+    size_t count = snapshot.healthy.size();
+    if (count == 1) {
+        return admitFrom(service, snapshot, 0);
+    }
+
+    // 随机取两个不同的实例，按权重折算后的代价取较低者
+    size_t first = nextRandom() % count;
+    size_t second = nextRandom() % (count - 1);
+    if (second >= first) {
+        ++second;
+    }
+    const auto& a = snapshot.healthy[first];
+    const auto& b = snapshot.healthy[second];
+    bool availableA = a->breaker->isAvailable();
+    bool availableB = b->breaker->isAvailable();
+    if (availableA || availableB) {
+        double costA = a->load->cost() / std::max(a->weight, 1);
+        double costB = b->load->cost() / std::max(b->weight, 1);
+        const auto& chosen = (availableA && (!availableB || costA <= costB)) ? a : b;
+        if (chosen->breaker->allowRequest()) {
+            return chosen;
+        }
+    }
+    // 两个都被熔断：顺序找一个放行的实例
+    return admitFrom(service, snapshot, first);
+}
+
+std::shared_ptr<ServiceInstance> LoadBalancer::admitFrom(Service* service, const Snapshot& snapshot, size_t start) {
+    size_t count = snapshot.healthy.size();
+    for (size_t step = 0; step < count; ++step) {
+        const auto& instance = snapshot.healthy[(start + step) % count];
+        if (instance->breaker->allowRequest()) {
+            return instance;
+        }
+    }
+    LOG_WARN("All healthy instances of {} are rejected by circuit breakers", service->name);
+    return nullptr;
+}
@@ -5,42 +5,182 @@
 #include <string>
 #include <memory>
 #include <mutex>
-#include <map>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
 #include "logger.h"
 
+// 实例的实时负载：在途请求数和延迟的峰值指数加权移动平均（peak EWMA）
+// 由调用方通过 InstanceCall 更新；健康状态变化替换 ServiceInstance 时新旧对象共享同一份
+struct InstanceLoad {
+    std::atomic<int> inFlight{0};           // 在途请求数
+    std::atomic<double> latencyUs{0};       // 延迟均值（微秒），0 表示还没有样本
+    std::atomic<int64_t> sampledAtNs{0};    // 最近一次样本的时间（steady_clock）
+
+    // 记录一次调用的耗时，失败按惩罚延迟计入
+    void record(std::chrono::nanoseconds latency, bool success);
+
+    // 选择代价：按空闲时长衰减后的延迟 ×（在途请求数 + 1）
+    double cost() const;
+
+    // 样本的衰减时间常数：较慢的样本立即生效，之后按这个时间常数回落
+    static constexpr double DECAY_SECONDS = 10.0;
+    // 失败调用至少按这个延迟计入
+    static constexpr double FAILURE_PENALTY_US = 1000000.0;
+};
+
+// 实例的熔断器，按滚动时间窗口统计失败率和慢调用率
+// 关闭：正常放行；窗口内请求足够多且失败率或慢调用率超限时打开
+// 打开：拒绝请求，冷却时间到后转为半开；连续打开时冷却时间翻倍
+// 半开：只放行少量试探请求，全部成功才关闭，任何一次失败或慢调用立即重新打开
+// 与健康状态相互独立：健康检查剔除不可达的实例，熔断器剔除还能连上但在报错或超时的实例
+class CircuitBreaker {
+public:
+    enum class State { Closed, Open, HalfOpen };
+
+    // name 用于日志，例如 "StatusServer localhost:50051"
+    explicit CircuitBreaker(const std::string& name);
+
+    // 选中实例后调用：是否允许发送请求，半开状态下占用一个试探名额
+    bool allowRequest();
+
+    // 选择阶段的预先过滤，不占用试探名额
+    bool isAvailable() const;
+
+    // 记录一次调用的耗时和结果
+    void record(std::chrono::nanoseconds latency, bool success);
+
+    State state() const { return state_.load(std::memory_order_acquire); }
+
+    // 滚动窗口的桶数和每个桶的时长
+    static constexpr int WINDOW_BUCKETS = 10;
+    static constexpr std::chrono::milliseconds BUCKET_DURATION{1000};
+    // 窗口内至少这么多请求才计算比例，避免少量请求误判
+    static constexpr uint32_t MIN_REQUESTS = 20;
+    // 打开熔断的失败率和慢调用率
+    static constexpr double FAILURE_RATE_THRESHOLD = 0.5;
+    static constexpr double SLOW_RATE_THRESHOLD = 0.8;
+    // 超过这个耗时算作慢调用
+    static constexpr std::chrono::milliseconds SLOW_CALL_DURATION{1000};
+    // 首次打开的冷却时间和上限
+    static constexpr std::chrono::milliseconds BASE_OPEN_DURATION{5000};
+    static constexpr std::chrono::milliseconds MAX_OPEN_DURATION{60000};
+    // 半开状态放行的试探请求数，全部成功后关闭
+    static constexpr int TRIAL_REQUESTS = 3;
+
+private:
+    // 一个时间桶；epoch 是桶对应的时间片编号，过期的桶在下次写入时清零
+    struct Bucket {
+        std::atomic<int64_t> epoch{-1};
+        std::atomic<uint32_t> total{0};
+        std::atomic<uint32_t> failures{0};
+        std::atomic<uint32_t> slow{0};
+    };
+
+    // 从 from 状态打开熔断，冷却时间按连续打开次数翻倍
+    void trip(State from, int64_t nowNs);
+
+    std::string name_;
+    std::atomic<State> state_;
+    std::atomic<int64_t> openUntilNs_;       // 打开状态的冷却结束时间
+    std::atomic<int64_t> halfOpenSinceNs_;   // 进入半开状态的时间
+    std::atomic<int> trialsLeft_;            // 半开状态剩余的试探名额
+    std::atomic<int> trialSuccesses_;        // 半开状态已成功的试探数
+    std::atomic<int> consecutiveOpens_;      // 关闭前连续打开的次数
+    Bucket buckets_[WINDOW_BUCKETS];
+};
+
 // 服务实例信息
+// 发布后不再修改：健康状态变化时用新的实例对象替换，持有旧指针的调用方不会看到并发写
 struct ServiceInstance {
     std::string serviceName;  // 服务名称
     std::string host;         // 主机地址
     int port;                 // 端口号
     bool isHealthy;           // 健康状态
     int weight;               // 权重（用于加权负载均衡算法）
-    
+    std::shared_ptr<InstanceLoad> load;        // 实时负载
+    std::shared_ptr<CircuitBreaker> breaker;   // 熔断器，与 load 一样在替换实例对象时共享
+
     ServiceInstance(const std::string& name, const std::string& h, int p)
-        : serviceName(name), host(h), port(p), isHealthy(true), weight(1) {}
+        : serviceName(name), host(h), port(p), isHealthy(true), weight(1),
+          load(std::make_shared<InstanceLoad>()),
+          breaker(std::make_shared<CircuitBreaker>(name + " " + h + ":" + std::to_string(p))) {}
+};
+
+// 一次对实例的调用：构造时计入在途请求，析构时向负载统计和熔断器回报耗时与结果
+class InstanceCall {
+public:
+    explicit InstanceCall(const std::shared_ptr<ServiceInstance>& instance);
+    ~InstanceCall();
+
+    InstanceCall(const InstanceCall&) = delete;
+    InstanceCall& operator=(const InstanceCall&) = delete;
+
+    // 标记本次调用失败（连接错误、超时等），按惩罚延迟计入
+    void fail() { success_ = false; }
+
+    // 调用被调用方主动取消（例如对冲请求中落后的一个），只归还在途计数，不计入延迟和熔断统计
+    void cancel() { cancelled_ = true; }
+
+private:
+    InstanceLoad* load_;
+    CircuitBreaker* breaker_;
+    std::chrono::steady_clock::time_point start_;
+    bool success_;
+    bool cancelled_;
+};
+
+// 负载均衡算法
+enum class LoadBalanceAlgorithm {
+    RoundRobin,
+    WeightedRoundRobin,    // 平滑加权轮询
+    LeastConnections,      // 在途请求最少
+    PowerOfTwoChoices      // 随机取两个，选延迟与在途请求综合代价较低的
 };
 
+// 每个服务的实例列表保存为不可变快照，成员或健康状态变化时构建新快照并原子替换（RCU 方式）。
+// 快照由引用计数管理，每个线程缓存一份引用并用版本号判断是否过期：
+// 选择实例通常只需读取版本号和一次原子自增，不加锁、不分配内存；旧快照在最后一个持有它的线程换掉缓存后才释放。
+// 熔断器打开的实例不会被选中，它的流量转给同一快照中的其他健康实例；全部熔断时返回 nullptr，调用方立即失败。
 class LoadBalancer {
 public:
+    // 驻留的服务，地址在进程生命周期内不变
+    struct Service;
+    using ServiceHandle = Service*;
+
     // 单例模式：获取实例
     static LoadBalancer& getInstance();
-    
+
     // 删除拷贝构造函数和赋值操作符，确保单例唯一性
     LoadBalancer(const LoadBalancer&) = delete;
     LoadBalancer& operator=(const LoadBalancer&) = delete;
 
+    // 获取服务句柄（不存在时创建），热路径应缓存句柄代替服务名
+    ServiceHandle getServiceHandle(const std::string& serviceName);
+
     // 添加服务实例
     void addServiceInstance(const std::string& serviceName, const std::string& host, int port, int weight = 1);
-    
+
     // 移除服务实例
     void removeServiceInstance(const std::string& serviceName, const std::string& host, int port);
-    
-    // 获取下一个健康的服务实例（支持多种算法）
+
+    // 获取下一个健康的服务实例（无锁）
+    std::shared_ptr<ServiceInstance> getNextHealthyInstance(ServiceHandle service,
+                                                            LoadBalanceAlgorithm algorithm = LoadBalanceAlgorithm::RoundRobin);
+
+    // 按键选择实例（最高随机权重哈希，无锁）：同一个键总是落在同一个实例上，
+    // 实例不健康或被熔断时只有它的键转移到其他实例，其余键的归属不变；
+    // avoid 非空时跳过该地址的实例，返回排名下一位的实例（调用方在该实例上失败后重试）
+    std::shared_ptr<ServiceInstance> getInstanceForKey(ServiceHandle service, uint64_t key,
+                                                       const std::shared_ptr<ServiceInstance>& avoid = nullptr);
+
+    // 获取下一个健康的服务实例（按服务名和算法名，兼容旧接口）
     std::shared_ptr<ServiceInstance> getNextHealthyInstance(const std::string& serviceName, const std::string& algorithm = "round_robin");
-    
+
     // 更新服务实例的健康状态
     void updateHealthStatus(const std::string& serviceName, const std::string& host, int port, bool isHealthy);
-    
+
     // 获取指定服务的所有实例
     std::vector<std::shared_ptr<ServiceInstance>> getServiceInstances(const std::string& serviceName);
 
@@ -48,23 +188,50 @@ private:
     LoadBalancer();  // 私有化构造函数
     ~LoadBalancer(); // 私有化析构函数
 
+    struct Snapshot;
+    using ServiceMap = std::unordered_map<std::string, Service*>;
+
+    // 查找已驻留的服务（无锁），不存在返回nullptr
+    Service* findService(const std::string& serviceName) const;
+
+    // 获取或创建服务（调用者需持有 mutex_）
+    Service* getOrCreateService_impl(const std::string& serviceName);
+
+    // 用新的实例列表构建快照并发布（调用者需持有 mutex_）
+    void publish_impl(Service* service, std::vector<std::shared_ptr<ServiceInstance>> instances);
+
+    // 当前线程看到的最新快照（无锁），指针在本线程下次对同一服务调用前有效
+    static const Snapshot* currentSnapshot(const Service* service);
+
     // 轮询算法
-    std::shared_ptr<ServiceInstance> getNextInstanceRoundRobin(const std::vector<std::shared_ptr<ServiceInstance>>& instances);
-    
-    // 加权轮询算法
-    std::shared_ptr<ServiceInstance> getNextInstanceWeightedRoundRobin(const std::vector<std::shared_ptr<ServiceInstance>>& instances);
-    
-    // 最少连接数算法（简化实现）
-    std::shared_ptr<ServiceInstance> getNextInstanceLeastConnections(const std::vector<std::shared_ptr<ServiceInstance>>& instances);
-    
-    // 存储所有服务实例
-    std::map<std::string, std::vector<std::shared_ptr<ServiceInstance>>> serviceInstances_;
-    
-    // 用于轮询算法的索引
-    std::map<std::string, size_t> currentIndices_;
-    
-    // 线程安全的互斥锁
+    std::shared_ptr<ServiceInstance> getNextInstanceRoundRobin(Service* service, const Snapshot& snapshot);
+
+    // 平滑加权轮询算法
+    std::shared_ptr<ServiceInstance> getNextInstanceWeightedRoundRobin(Service* service, const Snapshot& snapshot);
+
+    // 最少连接数算法
+    std::shared_ptr<ServiceInstance> getNextInstanceLeastConnections(Service* service, const Snapshot& snapshot);
+
+    // 两次随机选择算法
+    std::shared_ptr<ServiceInstance> getNextInstancePowerOfTwoChoices(Service* service, const Snapshot& snapshot);
+
+    // 从 start 开始依次找第一个熔断器放行的健康实例
+    std::shared_ptr<ServiceInstance> admitFrom(Service* service, const Snapshot& snapshot, size_t start);
+
+    // 所有驻留的服务，只增不减
+    std::vector<std::unique_ptr<Service>> services_;
+
+    // 服务名 -> 服务的只读表，新增服务时整体替换
+    std::atomic<const ServiceMap*> serviceMap_;
+
+    // 被替换的旧服务表，读者可能仍持有其指针，不释放（服务只增不减，数量与服务数相同）
+    std::vector<std::unique_ptr<const ServiceMap>> oldServiceMaps_;
+
+    // 平滑加权轮询调度表的最大长度，权重和超过时按比例缩小
+    static const int MAX_SCHEDULE_LENGTH = 4096;
+
+    // 串行化所有写操作，读路径不使用
     std::mutex mutex_;
 };
 
-#endif // LOAD_BALANCER_H
\ No newline at end of file
+#endif // LOAD_BALANCER_H
@@ -0,0 +1,339 @@
+#include "online_users.h"
+#include <algorithm>
+#include <cstdlib>
+#include "redis_manager.h"
+#include "logger.h"
+
+namespace {
+
+// 与 StatusServer 状态更新脚本维护的集合一致
+const char* const ONLINE_SET_KEY = "users:online";
+
+} // namespace
+
+// ==================== OnlineBitmap ====================
+
+bool OnlineBitmap::add(uint32_t value) {
+    uint16_t key = static_cast<uint16_t>(value >> 16);
+    uint16_t low = static_cast<uint16_t>(value & 0xffff);
+
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    if (it == containers_.end() || it->key != key) {
+        it = containers_.insert(it, Container(key));
+    }
+    Container& container = *it;
+
+    if (container.isBitset()) {
+        uint64_t& word = container.bits[low >> 6];
+        uint64_t mask = 1ULL << (low & 63);
+        if (word & mask) {
+            return false;
+        }
+        word |= mask;
+    } else {
+        auto pos = std::lower_bound(container.array.begin(), container.array.end(), low);
+        if (pos != container.array.end() && *pos == low) {
+            return false;
+        }
+        container.array.insert(pos, low);
+        if (container.array.size() > ARRAY_MAX) {
+            toBitset(container);
+        }
+    }
+
+    ++container.cardinality;
+    ++cardinality_;
+    return true;
+}
+
+bool OnlineBitmap::remove(uint32_t value) {
+    uint16_t key = static_cast<uint16_t>(value >> 16);
+    uint16_t low = static_cast<uint16_t>(value & 0xffff);
+
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    if (it == containers_.end() || it->key != key) {
+        return false;
+    }
+    Container& container = *it;
+
+    if (container.isBitset()) {
+        uint64_t& word = container.bits[low >> 6];
+        uint64_t mask = 1ULL << (low & 63);
+        if (!(word & mask)) {
+            return false;
+        }
+        word &= ~mask;
+    } else {
+        auto pos = std::lower_bound(container.array.begin(), container.array.end(), low);
+        if (pos == container.array.end() || *pos != low) {
+            return false;
+        }
+        container.array.erase(pos);
+    }
+
+    --container.cardinality;
+    --cardinality_;
+    if (container.cardinality == 0) {
+        containers_.erase(it);
+    } else if (container.isBitset() && container.cardinality < ARRAY_MIN) {
+        toArray(container);
+    }
+    return true;
+}
+
+bool OnlineBitmap::contains(uint32_t value) const {
+    const Container* container = find(static_cast<uint16_t>(value >> 16));
+    if (!container) {
+        return false;
+    }
+
+    uint16_t low = static_cast<uint16_t>(value & 0xffff);
+    if (container->isBitset()) {
+        return (container->bits[low >> 6] >> (low & 63)) & 1;
+    }
+    return std::binary_search(container->array.begin(), container->array.end(), low);
+}
+
+size_t OnlineBitmap::bytes() const {
+    size_t total = containers_.capacity() * sizeof(Container);
+    for (const auto& container : containers_) {
+        total += container.array.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t);
+    }
+    return total;
+}
+
+void OnlineBitmap::clear() {
+    containers_.clear();
+    cardinality_ = 0;
+}
+
+void OnlineBitmap::intersect(const int32_t* begin, const int32_t* end, std::vector<int32_t>& out) const {
+    out.resize(end - begin);
+    size_t count = 0;
+
+    const int32_t* run = begin;
+    while (run != end) {
+        uint16_t key = static_cast<uint16_t>(static_cast<uint32_t>(*run) >> 16);
+        const int32_t* runEnd = run;
+        while (runEnd != end && static_cast<uint16_t>(static_cast<uint32_t>(*runEnd) >> 16) == key) {
+            ++runEnd;
+        }
+
+        const Container* container = find(key);
+        if (container && container->isBitset()) {
+            // 无论是否命中都先写入，再按位累加下标
+            const uint64_t* words = container->bits.data();
+            for (const int32_t* id = run; id != runEnd; ++id) {
+                uint16_t low = static_cast<uint16_t>(*id & 0xffff);
+                out[count] = *id;
+                count += (words[low >> 6] >> (low & 63)) & 1;
+            }
+        } else if (container) {
+            // 两个有序序列归并，容器内的查找位置只前进不后退
+            auto pos = container->array.begin();
+            auto arrayEnd = container->array.end();
+            for (const int32_t* id = run; id != runEnd && pos != arrayEnd; ++id) {
+                uint16_t low = static_cast<uint16_t>(*id & 0xffff);
+                pos = std::lower_bound(pos, arrayEnd, low);
+                if (pos != arrayEnd && *pos == low) {
+                    out[count++] = *id;
+                }
+            }
+        }
+        run = runEnd;
+    }
+
+    out.resize(count);
+}
+
+const OnlineBitmap::Container* OnlineBitmap::find(uint16_t key) const {
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    return (it != containers_.end() && it->key == key) ? &*it : nullptr;
+}
+
+void OnlineBitmap::toBitset(Container& container) {
+    container.bits.assign(BITSET_WORDS, 0);
+    for (uint16_t low : container.array) {
+        container.bits[low >> 6] |= 1ULL << (low & 63);
+    }
+    std::vector<uint16_t>().swap(container.array);
+}
+
+void OnlineBitmap::toArray(Container& container) {
+    container.array.reserve(container.cardinality);
+    for (size_t word = 0; word < BITSET_WORDS; ++word) {
+        uint64_t bits = container.bits[word];
+        while (bits) {
+            int bit = __builtin_ctzll(bits);
+            container.array.push_back(static_cast<uint16_t>(word * 64 + bit));
+            bits &= bits - 1;
+        }
+    }
+    std::vector<uint64_t>().swap(container.bits);
+}
+
+// ==================== OnlineUsers ====================
+
+/**
+ * @brief 获取OnlineUsers单例实例
+ * 使用局部静态变量实现线程安全的单例模式
+ * @return OnlineUsers实例的引用
+ */
+OnlineUsers& OnlineUsers::getInstance() {
+    static OnlineUsers instance;
+    return instance;
+}
+
+OnlineUsers::OnlineUsers() : refreshing_(false), loaded_(false), running_(false) {
+}
+
+OnlineUsers::~OnlineUsers() {
+    stop();
+}
+
+bool OnlineUsers::start(std::chrono::milliseconds refreshInterval) {
+    if (running_) {
+        LOG_WARN("OnlineUsers already started");
+        return loaded_;
+    }
+
+    running_ = true;
+    bool loaded = refresh();
+    if (!loaded) {
+        LOG_WARN("Online user bitmap not loaded, online checks fall back to status lookups until it is");
+    }
+    thread_ = std::thread(&OnlineUsers::refreshLoop, this, refreshInterval);
+    return loaded;
+}
+
+void OnlineUsers::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+    }
+    stopCondition_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    LOG_INFO("OnlineUsers stopped with {} users online", count());
+}
+
+void OnlineUsers::setOnline(int32_t userId, bool online) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (online) {
+        bitmap_.add(static_cast<uint32_t>(userId));
+    } else {
+        bitmap_.remove(static_cast<uint32_t>(userId));
+    }
+    if (refreshing_) {
+        journal_.emplace_back(userId, online);
+    }
+}
+
+bool OnlineUsers::isOnline(int32_t userId) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return bitmap_.contains(static_cast<uint32_t>(userId));
+}
+
+bool OnlineUsers::filterOnline(const std::vector<int32_t>& ids, std::vector<int32_t>& online) const {
+    if (!loaded_) {
+        return false;
+    }
+
+    if (std::is_sorted(ids.begin(), ids.end())) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        bitmap_.intersect(ids.data(), ids.data() + ids.size(), online);
+        return true;
+    }
+
+    std::vector<int32_t> sorted(ids);
+    std::sort(sorted.begin(), sorted.end());
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    bitmap_.intersect(sorted.data(), sorted.data() + sorted.size(), online);
+    return true;
+}
+
+size_t OnlineUsers::count() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return bitmap_.cardinality();
+}
+
+/**
+ * @brief 用 SSCAN 分批重建在线集合快照
+ * 快照在锁外构建，只在重放本地日志和替换时持有写锁
+ */
+bool OnlineUsers::refresh() {
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        refreshing_ = true;
+        journal_.clear();
+    }
+
+    RedisManager& redis = RedisManager::getInstance();
+    OnlineBitmap snapshot;
+    std::string cursor = "0";
+    bool ok = true;
+    do {
+        RedisPipeline pipeline;
+        pipeline.add({"SSCAN", ONLINE_SET_KEY, cursor, "COUNT", std::to_string(SCAN_BATCH)});
+
+        std::vector<RedisValue> replies;
+        if (!redis.execute(pipeline, replies) || replies[0].type != REDIS_REPLY_ARRAY ||
+            replies[0].elements.size() != 2) {
+            ok = false;
+            break;
+        }
+
+        cursor = replies[0].elements[0].str;
+        for (const auto& member : replies[0].elements[1].elements) {
+            snapshot.add(static_cast<uint32_t>(std::strtol(member.str.c_str(), nullptr, 10)));
+        }
+    } while (cursor != "0" && running_);
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    refreshing_ = false;
+    if (!ok || cursor != "0") {
+        journal_.clear();
+        return false;
+    }
+
+    for (const auto& update : journal_) {
+        if (update.second) {
+            snapshot.add(static_cast<uint32_t>(update.first));
+        } else {
+            snapshot.remove(static_cast<uint32_t>(update.first));
+        }
+    }
+    journal_.clear();
+
+    bool firstLoad = !loaded_;
+    bitmap_ = std::move(snapshot);
+    loaded_ = true;
+    if (firstLoad) {
+        LOG_INFO("Online user bitmap loaded: {} users, {} bytes", bitmap_.cardinality(), bitmap_.bytes());
+    }
+    return true;
+}
+
+void OnlineUsers::refreshLoop(std::chrono::milliseconds interval) {
+    while (sleepFor(interval)) {
+        if (!refresh()) {
+            LOG_WARN("Failed to refresh online user bitmap from Redis");
+        }
+    }
+}
+
+/**
+ * @brief 可被 stop() 打断的等待
+ * @return 等待结束后仍在运行返回true
+ */
+bool OnlineUsers::sleepFor(std::chrono::milliseconds duration) {
+    std::unique_lock<std::mutex> lock(stopMutex_);
+    return !stopCondition_.wait_for(lock, duration, [this] { return !running_; });
+}
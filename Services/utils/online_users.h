@@ -0,0 +1,163 @@
+#ifndef ONLINE_USERS_H
+#define ONLINE_USERS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 压缩位图（Roaring 风格）
+ *
+ * 32位整数按高16位分到容器，容器内只存低16位：
+ * 1. 稀疏容器为有序 uint16 数组，超过 ARRAY_MAX 个元素后转为 65536 位的位图容器
+ * 2. 位图容器低于 ARRAY_MIN 个元素时转回数组（两个阈值错开，避免在边界反复转换）
+ *
+ * 非线程安全，由使用者加锁。
+ */
+class OnlineBitmap {
+public:
+    /**
+     * @brief 添加元素
+     * @return 元素原本不存在返回true
+     */
+    bool add(uint32_t value);
+
+    /**
+     * @brief 删除元素
+     * @return 元素原本存在返回true
+     */
+    bool remove(uint32_t value);
+
+    bool contains(uint32_t value) const;
+
+    size_t cardinality() const { return cardinality_; }
+
+    /**
+     * @brief 占用的字节数（不含容器对象本身）
+     */
+    size_t bytes() const;
+
+    void clear();
+
+    /**
+     * @brief 与升序ID列表求交，结果保持输入顺序
+     * 相同高16位的连续ID共用一次容器查找；位图容器上逐个写入并按位累加下标，循环内没有分支
+     * @param begin 升序ID列表起始
+     * @param end 升序ID列表结尾
+     * @param out 输出参数，同时出现在位图中的ID
+     */
+    void intersect(const int32_t* begin, const int32_t* end, std::vector<int32_t>& out) const;
+
+private:
+    struct Container {
+        uint16_t key;
+        uint32_t cardinality;
+        std::vector<uint16_t> array;   // 数组容器：有序的低16位
+        std::vector<uint64_t> bits;    // 位图容器：1024 个字，非空表示位图容器
+
+        explicit Container(uint16_t k) : key(k), cardinality(0) {}
+        bool isBitset() const { return !bits.empty(); }
+    };
+
+    const Container* find(uint16_t key) const;
+    static void toBitset(Container& container);
+    static void toArray(Container& container);
+
+    static const uint32_t ARRAY_MAX = 4096;
+    static const uint32_t ARRAY_MIN = 2048;
+    static const size_t BITSET_WORDS = 65536 / 64;
+
+    std::vector<Container> containers_;   // 按 key 升序
+    size_t cardinality_ = 0;
+};
+
+/**
+ * @brief 在线用户集合（单例模式）
+ *
+ * Redis 中的 users:online 集合在本进程的位图镜像：
+ * 1. 本实例处理的状态更新立即写入位图
+ * 2. 后台线程定期用 SSCAN 重建快照，同步其他实例写入的状态；
+ *    重建期间本地的更新记入日志，换入新快照前重放，不会被旧快照覆盖
+ *
+ * 好友在线判断变成好友 CSR 邻接数组与位图的求交，不再逐个好友查询。
+ */
+class OnlineUsers {
+public:
+    /**
+     * @brief 获取OnlineUsers单例实例
+     * @return OnlineUsers实例的引用
+     */
+    static OnlineUsers& getInstance();
+
+    OnlineUsers(const OnlineUsers&) = delete;
+    OnlineUsers& operator=(const OnlineUsers&) = delete;
+
+    /**
+     * @brief 从 Redis 加载在线集合并启动后台刷新线程（需在 RedisManager 初始化之后调用）
+     * @param refreshInterval 快照重建间隔
+     * @return 首次加载成功返回true
+     */
+    bool start(std::chrono::milliseconds refreshInterval = std::chrono::milliseconds(5000));
+
+    /**
+     * @brief 停止后台刷新线程
+     */
+    void stop();
+
+    /**
+     * @brief 位图是否已加载
+     */
+    bool isLoaded() const { return loaded_; }
+
+    /**
+     * @brief 记录本实例处理的状态变化
+     * @param userId 用户ID
+     * @param online AWAY/BUSY 也算在线
+     */
+    void setOnline(int32_t userId, bool online);
+
+    bool isOnline(int32_t userId) const;
+
+    /**
+     * @brief 从ID列表中筛选在线用户
+     * @param ids ID列表（升序时直接求交，否则先排序副本）
+     * @param online 输出参数，在线的ID（升序）
+     * @return 位图未加载时返回false
+     */
+    bool filterOnline(const std::vector<int32_t>& ids, std::vector<int32_t>& online) const;
+
+    /**
+     * @brief 在线用户数
+     */
+    size_t count() const;
+
+private:
+    OnlineUsers();
+    ~OnlineUsers();
+
+    bool refresh();
+    void refreshLoop(std::chrono::milliseconds interval);
+    bool sleepFor(std::chrono::milliseconds duration);
+
+    // SSCAN 每批返回的元素数提示
+    static const int SCAN_BATCH = 1000;
+
+    mutable std::shared_mutex mutex_;
+    OnlineBitmap bitmap_;
+    bool refreshing_;
+    std::vector<std::pair<int32_t, bool>> journal_;   // 重建快照期间的本地更新
+
+    std::atomic<bool> loaded_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+    std::mutex stopMutex_;
+    std::condition_variable stopCondition_;
+};
+
+#endif // ONLINE_USERS_H
@@ -0,0 +1,151 @@
+#include "prepared_statement_cache.h"
+#include <cstring>
+#include <algorithm>
+#include "logger.h"
+
+// ==================== PreparedStatement ====================
+
+void PreparedStatement::setIntParam(size_t index, int* value) {
+    MYSQL_BIND& bind = params[index];
+    bind.buffer_type = MYSQL_TYPE_LONG;
+    bind.buffer = value;
+    bind.buffer_length = 0;
+    bind.length = nullptr;
+}
+
+void PreparedStatement::setStringParam(size_t index, const std::string& value) {
+    MYSQL_BIND& bind = params[index];
+    bind.buffer_type = MYSQL_TYPE_STRING;
+    bind.buffer = const_cast<char*>(value.data());
+    bind.buffer_length = value.length();
+    bind.length = nullptr;
+}
+
+void PreparedStatement::bindIntResult(size_t index) {
+    MYSQL_BIND& bind = results[index];
+    bind.buffer_type = MYSQL_TYPE_LONGLONG;
+    bind.buffer = &intBuffers[index];
+    bind.length = &lengths[index];
+}
+
+void PreparedStatement::bindStringResult(size_t index, size_t capacity) {
+    strBuffers[index].resize(capacity);
+    MYSQL_BIND& bind = results[index];
+    bind.buffer_type = MYSQL_TYPE_STRING;
+    bind.buffer = strBuffers[index].data();
+    bind.buffer_length = capacity;
+    bind.length = &lengths[index];
+}
+
+std::string PreparedStatement::stringResult(size_t index) const {
+    // 被截断时长度会超过缓冲区容量，只返回实际拿到的部分
+    size_t len = std::min<size_t>(lengths[index], strBuffers[index].size());
+    return std::string(strBuffers[index].data(), len);
+}
+
+// ==================== PreparedStatementCache ====================
+
+PreparedStatementCache::PreparedStatementCache(size_t maxStatements)
+    : connection_(nullptr), maxStatements_(maxStatements > 0 ? maxStatements : 1),
+      hits_(0), misses_(0), evictions_(0) {}
+
+PreparedStatementCache::~PreparedStatementCache() {
+    closeAll();
+}
+
+void PreparedStatementCache::reset(MYSQL* connection) {
+    closeAll();
+    connection_ = connection;
+}
+
+void PreparedStatementCache::closeAll() {
+    if (!statements_.empty()) {
+        LOG_DEBUG("Closing {} cached prepared statements", statements_.size());
+    }
+    for (auto& pair : statements_) {
+        mysql_stmt_close(pair.second->stmt);
+    }
+    statements_.clear();
+    lru_.clear();
+}
+
+PreparedStatement* PreparedStatementCache::acquire(const std::string& sql) {
+    if (!connection_) {
+        return nullptr;
+    }
+
+    auto it = statements_.find(sql);
+    if (it != statements_.end()) {
+        // 命中：移动到LRU表头
+        PreparedStatement* ps = it->second.get();
+        lru_.splice(lru_.begin(), lru_, ps->lruPos);
+        ++hits_;
+        return ps;
+    }
+
+    ++misses_;
+
+    MYSQL_STMT* stmt = mysql_stmt_init(connection_);
+    if (!stmt) {
+        LOG_ERROR("mysql_stmt_init() failed: {}", mysql_error(connection_));
+        return nullptr;
+    }
+
+    if (mysql_stmt_prepare(stmt, sql.c_str(), sql.length())) {
+        LOG_ERROR("mysql_stmt_prepare() failed: {}", mysql_stmt_error(stmt));
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+
+    // 按占位符数量和结果列数一次性分配绑定数组
+    auto ps = std::make_unique<PreparedStatement>();
+    ps->stmt = stmt;
+    ps->sql = sql;
+
+    size_t paramCount = mysql_stmt_param_count(stmt);
+    size_t fieldCount = mysql_stmt_field_count(stmt);
+    ps->params.resize(paramCount);
+    ps->results.resize(fieldCount);
+    std::memset(ps->params.data(), 0, sizeof(MYSQL_BIND) * paramCount);
+    std::memset(ps->results.data(), 0, sizeof(MYSQL_BIND) * fieldCount);
+    ps->intBuffers.assign(fieldCount, 0);
+    ps->strBuffers.resize(fieldCount);
+    ps->lengths.assign(fieldCount, 0);
+
+    evictIfNeeded();
+
+    lru_.push_front(sql);
+    ps->lruPos = lru_.begin();
+
+    PreparedStatement* raw = ps.get();
+    statements_.emplace(sql, std::move(ps));
+
+    LOG_DEBUG("Prepared and cached statement ({} cached): {}", statements_.size(), sql);
+    return raw;
+}
+
+void PreparedStatementCache::invalidate(const std::string& sql) {
+    auto it = statements_.find(sql);
+    if (it == statements_.end()) {
+        return;
+    }
+
+    lru_.erase(it->second->lruPos);
+    mysql_stmt_close(it->second->stmt);
+    statements_.erase(it);
+    LOG_DEBUG("Invalidated cached statement: {}", sql);
+}
+
+void PreparedStatementCache::evictIfNeeded() {
+    while (statements_.size() >= maxStatements_ && !lru_.empty()) {
+        // 淘汰最久未使用的语句
+        const std::string& victim = lru_.back();
+        auto it = statements_.find(victim);
+        if (it != statements_.end()) {
+            mysql_stmt_close(it->second->stmt);
+            statements_.erase(it);
+        }
+        lru_.pop_back();
+        ++evictions_;
+    }
+}
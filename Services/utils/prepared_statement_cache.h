@@ -0,0 +1,108 @@
+#ifndef PREPARED_STATEMENT_CACHE_H
+#define PREPARED_STATEMENT_CACHE_H
+
+#include <mysql/mysql.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+
+/**
+ * @brief 缓存的预处理语句
+ *
+ * 语句句柄与参数/结果绑定数组在首次准备时一次性分配，之后每次执行
+ * 只需改写参数指针即可。结果缓冲区归语句所有，mysql_stmt_bind_result
+ * 在整个生命周期内只调用一次。
+ */
+struct PreparedStatement {
+    MYSQL_STMT* stmt = nullptr;                  // 语句句柄
+    std::string sql;                             // SQL文本（缓存键）
+    std::vector<MYSQL_BIND> params;              // 参数绑定数组（按占位符数量预分配）
+    std::vector<MYSQL_BIND> results;             // 结果绑定数组（按结果列数预分配）
+    std::vector<long long> intBuffers;           // 整数结果列缓冲区
+    std::vector<std::vector<char>> strBuffers;   // 字符串结果列缓冲区
+    std::vector<unsigned long> lengths;          // 每个结果列的实际长度
+    bool resultsBound = false;                   // 结果缓冲区是否已绑定
+    std::list<std::string>::iterator lruPos;     // 在LRU链表中的位置
+
+    // ---------- 参数设置（每次执行前调用，不产生内存分配） ----------
+    void setIntParam(size_t index, int* value);
+    void setStringParam(size_t index, const std::string& value);
+
+    // ---------- 结果列布局（仅在语句首次准备后调用一次） ----------
+    void bindIntResult(size_t index);
+    void bindStringResult(size_t index, size_t capacity);
+
+    // ---------- 结果读取（mysql_stmt_fetch 成功后调用） ----------
+    int intResult(size_t index) const { return static_cast<int>(intBuffers[index]); }
+    std::string stringResult(size_t index) const;
+};
+
+/**
+ * @brief 单个MySQL连接上的预处理语句缓存
+ *
+ * 以SQL文本为键缓存 MYSQL_STMT，避免每次查询都经历
+ * init + prepare + close 三次往返带来的服务端解析开销。
+ *
+ * 主要特性：
+ * 1. 与连接绑定：连接重建时通过 reset() 丢弃旧句柄，下次使用时自动重新准备
+ * 2. LRU淘汰：超过 maxStatements 时关闭最久未使用的语句，限制服务端语句数
+ * 3. 出错失效：执行失败的语句通过 invalidate() 移除，避免复用损坏的句柄
+ *
+ * 注意：本类不加锁，调用者必须持有保护该连接的互斥锁。
+ */
+class PreparedStatementCache {
+public:
+    explicit PreparedStatementCache(size_t maxStatements = 32);
+    ~PreparedStatementCache();
+
+    PreparedStatementCache(const PreparedStatementCache&) = delete;
+    PreparedStatementCache& operator=(const PreparedStatementCache&) = delete;
+
+    /**
+     * @brief 绑定到新的连接，关闭所有旧语句
+     * 必须在旧连接 mysql_close 之前调用
+     * @param connection 新连接（可为nullptr，表示仅清空）
+     */
+    void reset(MYSQL* connection);
+
+    /**
+     * @brief 获取SQL对应的预处理语句，未命中时准备并缓存
+     * @param sql SQL文本
+     * @return 语句指针，失败返回nullptr（错误信息已记录日志）
+     */
+    PreparedStatement* acquire(const std::string& sql);
+
+    /**
+     * @brief 移除并关闭指定SQL的语句（执行出错后调用）
+     * @param sql SQL文本
+     */
+    void invalidate(const std::string& sql);
+
+    // 统计信息
+    size_t size() const { return statements_.size(); }
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+    uint64_t evictions() const { return evictions_; }
+
+private:
+    void evictIfNeeded();
+    void closeAll();
+
+    MYSQL* connection_;
+    size_t maxStatements_;
+
+    // SQL文本 -> 语句
+    std::unordered_map<std::string, std::unique_ptr<PreparedStatement>> statements_;
+
+    // LRU链表，表头为最近使用
+    std::list<std::string> lru_;
+
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t evictions_;
+};
+
+#endif // PREPARED_STATEMENT_CACHE_H
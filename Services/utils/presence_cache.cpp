@@ -0,0 +1,446 @@
+#include "presence_cache.h"
+#include <algorithm>
+#include <functional>
+#include <hiredis/hiredis.h>
+#include <sys/socket.h>
+#include "redis_manager.h"
+#include "logger.h"
+
+namespace {
+
+// 填充占位符的存活时间，读 Redis 的线程异常退出时占位符最终也会被清理
+const int PLACEHOLDER_TTL_SECONDS = 5;
+
+const int64_t MIN_RECONNECT_BACKOFF_MS = 100;
+const int64_t MAX_RECONNECT_BACKOFF_MS = 5000;
+
+std::string replyString(const redisReply* reply) {
+    return std::string(reply->str, reply->len);
+}
+
+} // namespace
+
+/**
+ * @brief 获取PresenceCache单例实例
+ * 使用局部静态变量实现线程安全的单例模式
+ * @return PresenceCache实例的引用
+ */
+PresenceCache& PresenceCache::getInstance() {
+    static PresenceCache instance;
+    return instance;
+}
+
+PresenceCache::PresenceCache()
+    : shardCapacity_(1), running_(false), trackingUnsupported_(false), nodeCount_(0), readyNodes_(0),
+      nextFillToken_(1), hits_(0), negativeHits_(0), misses_(0), invalidations_(0), evictions_(0) {
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+}
+
+PresenceCache::~PresenceCache() {
+    stop();
+}
+
+/**
+ * @brief 启动缓存：为每个持有槽位的节点启动一个失效通知线程
+ * 所有节点订阅成功之前缓存处于旁路状态
+ */
+bool PresenceCache::start(const std::string& prefix, size_t capacity) {
+    if (running_) {
+        LOG_WARN("PresenceCache already started");
+        return true;
+    }
+
+    std::vector<RedisNodeAddress> nodes = RedisManager::getInstance().nodeAddresses();
+    if (nodes.empty()) {
+        LOG_ERROR("PresenceCache requires an initialized RedisManager, cache disabled");
+        return false;
+    }
+
+    prefix_ = prefix;
+    shardCapacity_ = std::max<size_t>(1, capacity / SHARD_COUNT);
+    nodeCount_ = nodes.size();
+    readyNodes_ = 0;
+    trackingUnsupported_ = false;
+    running_ = true;
+
+    for (const auto& node : nodes) {
+        threads_.emplace_back(&PresenceCache::invalidationLoop, this, node);
+    }
+
+    LOG_INFO("PresenceCache started for prefix {} ({} entries, {} nodes)", prefix_, capacity, nodes.size());
+    return true;
+}
+
+/**
+ * @brief 停止失效通知线程
+ * 关闭套接字唤醒阻塞在 redisGetReply 上的线程
+ */
+void PresenceCache::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+    }
+    stopCondition_.notify_all();
+
+    {
+        std::lock_guard<std::mutex> lock(socketsMutex_);
+        for (int fd : sockets_) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+    }
+
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads_.clear();
+
+    Stats s = stats();
+    LOG_INFO("PresenceCache stopped: {} hits, {} negative hits, {} misses, {} invalidations, {} evictions",
+             s.hits, s.negativeHits, s.misses, s.invalidations, s.evictions);
+    clear();
+}
+
+bool PresenceCache::isEnabled() const {
+    size_t nodes = nodeCount_;
+    return running_ && !trackingUnsupported_ && nodes > 0 && readyNodes_ == nodes;
+}
+
+bool PresenceCache::hgetall(const std::vector<std::string>& keys, std::vector<Fields>& results) {
+    results.assign(keys.size(), Fields());
+    if (keys.empty()) {
+        return true;
+    }
+
+    if (!isEnabled()) {
+        misses_ += keys.size();
+        return RedisManager::getInstance().hgetallMulti(keys, results);
+    }
+
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (lookup(keys[i], results[i]) == Lookup::Miss) {
+            missing.push_back(i);
+        }
+    }
+    if (missing.empty()) {
+        return true;
+    }
+
+    // 先放占位符再读 Redis，读取期间到达的失效会删除占位符
+    std::vector<std::string> missingKeys;
+    std::vector<uint64_t> tokens;
+    missingKeys.reserve(missing.size());
+    tokens.reserve(missing.size());
+    for (size_t index : missing) {
+        missingKeys.push_back(keys[index]);
+        tokens.push_back(beginFill(keys[index]));
+    }
+
+    std::vector<Fields> fetched;
+    if (!RedisManager::getInstance().hgetallMulti(missingKeys, fetched)) {
+        for (size_t j = 0; j < missingKeys.size(); ++j) {
+            completeFill(missingKeys[j], tokens[j], nullptr);
+        }
+        return false;
+    }
+
+    for (size_t j = 0; j < missingKeys.size(); ++j) {
+        completeFill(missingKeys[j], tokens[j], &fetched[j]);
+        results[missing[j]] = std::move(fetched[j]);
+    }
+    return true;
+}
+
+bool PresenceCache::hgetall(const std::string& key, Fields& fields) {
+    std::vector<Fields> results;
+    if (!hgetall(std::vector<std::string>{key}, results)) {
+        return false;
+    }
+    fields = std::move(results[0]);
+    return true;
+}
+
+bool PresenceCache::peek(const std::string& key, Fields& fields) {
+    // 未命中不计数，随后的 hgetall 会再查一次
+    return isEnabled() && lookup(key, fields, false) != Lookup::Miss;
+}
+
+void PresenceCache::invalidate(const std::string& key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+}
+
+void PresenceCache::clear() {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->lru.clear();
+        shard->index.clear();
+    }
+}
+
+PresenceCache::Stats PresenceCache::stats() const {
+    Stats s;
+    s.hits = hits_;
+    s.negativeHits = negativeHits_;
+    s.misses = misses_;
+    s.invalidations = invalidations_;
+    s.evictions = evictions_;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        s.size += shard->index.size();
+    }
+    return s;
+}
+
+PresenceCache::Shard& PresenceCache::shardFor(const std::string& key) {
+    return *shards_[std::hash<std::string>()(key) % SHARD_COUNT];
+}
+
+PresenceCache::Lookup PresenceCache::lookup(const std::string& key, Fields& fields, bool countMiss) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end() || it->second->fillToken != 0) {
+        if (countMiss) {
+            ++misses_;
+        }
+        return Lookup::Miss;
+    }
+
+    auto entry = it->second;
+    if (entry->expiresAt <= std::chrono::steady_clock::now()) {
+        shard.lru.erase(entry);
+        shard.index.erase(it);
+        if (countMiss) {
+            ++misses_;
+        }
+        return Lookup::Miss;
+    }
+
+    shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+    if (!entry->fields) {
+        fields.clear();
+        ++negativeHits_;
+        return Lookup::NegativeHit;
+    }
+    fields = *entry->fields;
+    ++hits_;
+    return Lookup::Hit;
+}
+
+/**
+ * @brief 放置填充占位符
+ * @return 占位符令牌，缓存不可用时返回0
+ */
+uint64_t PresenceCache::beginFill(const std::string& key) {
+    if (!isEnabled()) {
+        return 0;
+    }
+
+    uint64_t token = nextFillToken_++;
+    auto expiresAt = std::chrono::steady_clock::now() + std::chrono::seconds(PLACEHOLDER_TTL_SECONDS);
+
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        auto entry = it->second;
+        entry->fields.reset();
+        entry->fillToken = token;
+        entry->expiresAt = expiresAt;
+        shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+        return token;
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.fillToken = token;
+    entry.expiresAt = expiresAt;
+    shard.lru.push_front(std::move(entry));
+    shard.index[key] = shard.lru.begin();
+    evict_impl(shard);
+    return token;
+}
+
+/**
+ * @brief 用读到的值替换占位符
+ * 占位符已被失效删除或被更新的填充替换时丢弃该值；fields 为空表示读取失败，只删除占位符
+ */
+void PresenceCache::completeFill(const std::string& key, uint64_t token, const Fields* fields) {
+    if (token == 0) {
+        return;
+    }
+
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end() || it->second->fillToken != token) {
+        return;
+    }
+
+    auto entry = it->second;
+    if (!fields || !isEnabled()) {
+        shard.lru.erase(entry);
+        shard.index.erase(it);
+        return;
+    }
+
+    entry->fillToken = 0;
+    if (fields->empty()) {
+        entry->fields.reset();
+        entry->expiresAt = std::chrono::steady_clock::now() + std::chrono::seconds(NEGATIVE_TTL_SECONDS);
+    } else {
+        entry->fields = std::make_shared<const Fields>(*fields);
+        entry->expiresAt = std::chrono::steady_clock::now() + std::chrono::seconds(POSITIVE_TTL_SECONDS);
+    }
+}
+
+void PresenceCache::evict_impl(Shard& shard) {
+    while (shard.index.size() > shardCapacity_) {
+        shard.index.erase(shard.lru.back().key);
+        shard.lru.pop_back();
+        ++evictions_;
+    }
+}
+
+/**
+ * @brief 单个节点的失效通知循环
+ * 通知连接先用 CLIENT ID 取得自身ID，再把 BCAST 跟踪重定向到自己并订阅 __redis__:invalidate
+ */
+void PresenceCache::invalidationLoop(RedisNodeAddress address) {
+    int64_t backoffMs = MIN_RECONNECT_BACKOFF_MS;
+
+    while (running_) {
+        struct timeval timeout = { 2, 500000 }; // 2.5 seconds
+        redisContext* ctx = redisConnectWithTimeout(address.host.c_str(), address.port, timeout);
+        bool subscribed = false;
+
+        if (ctx && !ctx->err) {
+            redisReply* reply = (redisReply*)redisCommand(ctx, "CLIENT ID");
+            long long clientId = (reply && reply->type == REDIS_REPLY_INTEGER) ? reply->integer : -1;
+            if (reply) {
+                freeReplyObject(reply);
+            }
+
+            if (clientId >= 0) {
+                reply = (redisReply*)redisCommand(ctx, "CLIENT TRACKING on REDIRECT %lld BCAST PREFIX %s",
+                                                  clientId, prefix_.c_str());
+                if (reply && reply->type == REDIS_REPLY_ERROR) {
+                    // 服务端早于 Redis 6，缓存永久旁路
+                    LOG_WARN("Redis {} does not support client tracking ({}), presence cache bypassed",
+                             address.toString(), replyString(reply));
+                    trackingUnsupported_ = true;
+                    freeReplyObject(reply);
+                    redisFree(ctx);
+                    clear();
+                    return;
+                }
+                bool tracking = reply && reply->type == REDIS_REPLY_STATUS;
+                if (reply) {
+                    freeReplyObject(reply);
+                }
+
+                if (tracking) {
+                    reply = (redisReply*)redisCommand(ctx, "SUBSCRIBE __redis__:invalidate");
+                    subscribed = reply && reply->type == REDIS_REPLY_ARRAY;
+                    if (reply) {
+                        freeReplyObject(reply);
+                    }
+                }
+            }
+        }
+
+        if (!subscribed) {
+            LOG_WARN("Presence invalidation connection to {} failed: {}", address.toString(),
+                     ctx ? ctx->errstr : "can't allocate redis context");
+            if (ctx) {
+                redisFree(ctx);
+            }
+            if (!sleepFor(std::chrono::milliseconds(backoffMs))) {
+                break;
+            }
+            backoffMs = std::min(backoffMs * 2, MAX_RECONNECT_BACKOFF_MS);
+            continue;
+        }
+
+        {
+            // 与 stop() 互斥：要么 stop() 能看到该套接字，要么这里看到 running_ 已清除
+            std::lock_guard<std::mutex> lock(socketsMutex_);
+            if (!running_) {
+                redisFree(ctx);
+                break;
+            }
+            sockets_.push_back(ctx->fd);
+        }
+
+        // 订阅建立之前的修改没有通知，清空后再启用
+        clear();
+        ++readyNodes_;
+        backoffMs = MIN_RECONNECT_BACKOFF_MS;
+        LOG_INFO("Presence cache tracking {}* on {}", prefix_, address.toString());
+
+        redisReply* reply = nullptr;
+        while (running_) {
+            if (redisGetReply(ctx, (void**)&reply) != REDIS_OK) {
+                if (running_) {
+                    LOG_WARN("Presence invalidation connection to {} lost: {}", address.toString(), ctx->errstr);
+                }
+                break;
+            }
+
+            // ["message", "__redis__:invalidate", [key, ...] | nil]
+            if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 3 &&
+                replyString(reply->element[0]) == "message") {
+                const redisReply* keys = reply->element[2];
+                if (keys->type == REDIS_REPLY_ARRAY) {
+                    for (size_t i = 0; i < keys->elements; ++i) {
+                        invalidate(replyString(keys->element[i]));
+                    }
+                    invalidations_ += keys->elements;
+                } else {
+                    // nil 表示服务端执行了 FLUSHALL/FLUSHDB
+                    clear();
+                    ++invalidations_;
+                }
+            }
+            freeReplyObject(reply);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(socketsMutex_);
+            sockets_.erase(std::remove(sockets_.begin(), sockets_.end(), ctx->fd), sockets_.end());
+        }
+        redisFree(ctx);
+        onDisconnected();
+    }
+}
+
+/**
+ * @brief 失效连接断开：断开期间的通知已丢失，旁路缓存并清空
+ */
+void PresenceCache::onDisconnected() {
+    --readyNodes_;
+    clear();
+}
+
+/**
+ * @brief 可被 stop() 打断的等待
+ * @return 等待结束后仍在运行返回true
+ */
+bool PresenceCache::sleepFor(std::chrono::milliseconds duration) {
+    std::unique_lock<std::mutex> lock(stopMutex_);
+    return !stopCondition_.wait_for(lock, duration, [this] { return !running_; });
+}
@@ -0,0 +1,178 @@
+#ifndef PRESENCE_CACHE_H
+#define PRESENCE_CACHE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "redis_topology.h"
+
+/**
+ * @brief 进程内的用户状态一级缓存（单例模式）
+ *
+ * 缓存 user:status:<id> 哈希，热点用户的状态查询直接命中内存：
+ * 1. 容量有界，按分片 LRU 淘汰，分片之间互不加锁
+ * 2. 一致性依赖 Redis 6 的 CLIENT TRACKING（BCAST 模式，按键前缀）：
+ *    每个节点一条专用连接订阅 __redis__:invalidate，任何客户端修改匹配前缀的键都会收到失效通知
+ * 3. 不存在的键也会缓存（负缓存），有效期更短
+ * 4. 填充采用占位符：读 Redis 之前先放占位符，期间到达的失效会删除占位符，
+ *    读到的旧值不会再写入缓存
+ * 5. 失效连接断开期间缓存整体旁路并在恢复后清空，服务端不支持 CLIENT TRACKING 时始终旁路
+ *
+ * 每个条目另有过期时间作为兜底，集群拓扑变化后新节点上的键最多陈旧这么久。
+ */
+class PresenceCache {
+public:
+    using Fields = std::unordered_map<std::string, std::string>;
+
+    /**
+     * @brief 查找结果
+     */
+    enum class Lookup {
+        Miss,          // 未缓存，需要读 Redis
+        Hit,           // 命中
+        NegativeHit    // 命中负缓存：Redis 中没有该键
+    };
+
+    /**
+     * @brief 缓存统计
+     */
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t negativeHits = 0;
+        uint64_t misses = 0;
+        uint64_t invalidations = 0;
+        uint64_t evictions = 0;
+        size_t size = 0;
+    };
+
+    /**
+     * @brief 获取PresenceCache单例实例
+     * @return PresenceCache实例的引用
+     */
+    static PresenceCache& getInstance();
+
+    PresenceCache(const PresenceCache&) = delete;
+    PresenceCache& operator=(const PresenceCache&) = delete;
+
+    /**
+     * @brief 启动缓存：为 RedisManager 的每个节点建立失效通知连接
+     * 需在 RedisManager 初始化之后调用
+     * @param prefix 缓存的键前缀
+     * @param capacity 最大条目数
+     * @return 启动成功返回true
+     */
+    bool start(const std::string& prefix = "user:status:", size_t capacity = 100000);
+
+    /**
+     * @brief 停止失效通知线程并清空缓存
+     */
+    void stop();
+
+    /**
+     * @brief 缓存当前是否可用（所有节点的失效连接都已就绪）
+     */
+    bool isEnabled() const;
+
+    /**
+     * @brief 读取多个哈希：命中的直接返回，未命中的一次流水线读 Redis 并填充缓存
+     * @param keys 哈希键列表
+     * @param results 输出参数，与keys一一对应，键不存在时为空映射
+     * @return Redis 读取失败返回false
+     */
+    bool hgetall(const std::vector<std::string>& keys, std::vector<Fields>& results);
+
+    /**
+     * @brief 读取单个哈希，见 hgetall
+     */
+    bool hgetall(const std::string& key, Fields& fields);
+
+    /**
+     * @brief 只查进程内缓存，不访问 Redis（可在不允许阻塞的线程上调用）
+     * @param key 哈希键
+     * @param fields 输出参数，命中负缓存时为空映射
+     * @return 命中（包括负缓存）返回true
+     */
+    bool peek(const std::string& key, Fields& fields);
+
+    /**
+     * @brief 本进程写入后立即失效（不等待服务端通知，保证读己之写）
+     * @param key 键
+     */
+    void invalidate(const std::string& key);
+
+    /**
+     * @brief 清空缓存
+     */
+    void clear();
+
+    /**
+     * @brief 获取统计数据
+     */
+    Stats stats() const;
+
+private:
+    PresenceCache();
+    ~PresenceCache();
+
+    // 缓存条目
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const Fields> fields;   // 为空表示负缓存
+        uint64_t fillToken = 0;                 // 非零表示填充中的占位符
+        std::chrono::steady_clock::time_point expiresAt;
+    };
+
+    // 分片：LRU 链表（表头最新）+ 索引
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> lru;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    };
+
+    Shard& shardFor(const std::string& key);
+    Lookup lookup(const std::string& key, Fields& fields, bool countMiss = true);
+    uint64_t beginFill(const std::string& key);
+    void completeFill(const std::string& key, uint64_t token, const Fields* fields);
+    void evict_impl(Shard& shard);
+    void invalidationLoop(RedisNodeAddress address);
+    void onDisconnected();
+    bool sleepFor(std::chrono::milliseconds duration);
+
+    static const size_t SHARD_COUNT = 16;
+
+    // 兜底过期时间
+    static constexpr int POSITIVE_TTL_SECONDS = 60;
+    static constexpr int NEGATIVE_TTL_SECONDS = 5;
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    size_t shardCapacity_;
+    std::string prefix_;
+
+    std::atomic<bool> running_;
+    std::atomic<bool> trackingUnsupported_;
+    std::atomic<size_t> nodeCount_;
+    std::atomic<size_t> readyNodes_;              // 已订阅失效通知的节点数
+    std::atomic<uint64_t> nextFillToken_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> negativeHits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> invalidations_;
+    std::atomic<uint64_t> evictions_;
+
+    std::vector<std::thread> threads_;
+    std::mutex socketsMutex_;
+    std::vector<int> sockets_;                    // 各失效连接的套接字，stop() 时关闭以唤醒阻塞读
+    std::mutex stopMutex_;
+    std::condition_variable stopCondition_;
+};
+
+#endif // PRESENCE_CACHE_H
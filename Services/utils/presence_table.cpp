@@ -0,0 +1,734 @@
+#include "presence_table.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "logger.h"
+
+namespace {
+
+// 日志记录：uint32 负载长度 | uint32 负载的 FNV-1a 校验 | 负载（本机字节序，日志只在本机重放）
+// 负载的第一个字节为记录类型：
+//   STATE      uint8 标志, int32 用户ID, uint8 状态, int64 时间, uint64 序号, uint8 会话数, 会话令牌..., 最近令牌
+//   CHECKPOINT uint64 已同步到的序号
+// 字符串为 uint16 长度 + 内容
+const uint8_t RECORD_STATE = 1;
+const uint8_t RECORD_CHECKPOINT = 2;
+const size_t RECORD_HEADER_SIZE = 8;
+
+// STATE 记录的标志：状态采用自 Redis（其他实例写入），不需要同步回去
+const uint8_t FLAG_ADOPTED = 1;
+
+// 与 status::UserStatus 一致
+const int STATUS_OFFLINE = 0;
+const int STATUS_ONLINE = 1;
+
+uint32_t fnv1a(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+template <typename T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putString(std::string& out, const std::string& value) {
+    uint16_t length = static_cast<uint16_t>(std::min<size_t>(value.size(), UINT16_MAX));
+    put(out, length);
+    out.append(value.data(), length);
+}
+
+// 记录头先占位，负载写完后回填长度和校验
+size_t beginRecord(std::string& out) {
+    size_t start = out.size();
+    out.append(RECORD_HEADER_SIZE, '\0');
+    return start;
+}
+
+void endRecord(std::string& out, size_t start) {
+    const char* payload = out.data() + start + RECORD_HEADER_SIZE;
+    uint32_t length = static_cast<uint32_t>(out.size() - start - RECORD_HEADER_SIZE);
+    uint32_t checksum = fnv1a(payload, length);
+    std::memcpy(&out[start], &length, sizeof(length));
+    std::memcpy(&out[start + sizeof(length)], &checksum, sizeof(checksum));
+}
+
+void appendCheckpoint(std::string& out, uint64_t seq) {
+    size_t start = beginRecord(out);
+    put(out, RECORD_CHECKPOINT);
+    put(out, seq);
+    endRecord(out, start);
+}
+
+// 按顺序读取负载字段，越界时 ok 置为false
+struct PayloadReader {
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+    bool ok = true;
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (pos + sizeof(T) > size) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    std::string getString() {
+        uint16_t length = get<uint16_t>();
+        if (!ok || pos + length > size) {
+            ok = false;
+            return std::string();
+        }
+        std::string value(data + pos, length);
+        pos += length;
+        return value;
+    }
+};
+
+bool writeAll(int fd, const std::string& data) {
+    const char* cursor = data.data();
+    size_t remaining = data.size();
+    while (remaining > 0) {
+        ssize_t written = ::write(fd, cursor, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        cursor += written;
+        remaining -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// rename 之后同步所在目录，保证重写后的日志在掉电后仍然可见
+void syncDirectory(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+/**
+ * @brief 获取PresenceTable单例实例
+ * 使用局部静态变量实现线程安全的单例模式
+ * @return PresenceTable实例的引用
+ */
+PresenceTable& PresenceTable::getInstance() {
+    static PresenceTable instance;
+    return instance;
+}
+
+PresenceTable::PresenceTable()
+    : shards_(new Shard[SHARD_COUNT]), epoch_(std::chrono::steady_clock::now()), seq_(0), checkpointSeq_(0),
+      fd_(-1), fileBytes_(0), compactedBytes_(0), running_(false) {
+}
+
+PresenceTable::~PresenceTable() {
+    stop();
+}
+
+bool PresenceTable::start(const std::string& logPath, Sink sink) {
+    if (running_) {
+        LOG_WARN("PresenceTable already started");
+        return true;
+    }
+
+    uint64_t validBytes = 0;
+    if (!replay(logPath, validBytes)) {
+        LOG_ERROR("Failed to read presence log {}: {}", logPath, std::strerror(errno));
+        return false;
+    }
+
+    fd_ = ::open(logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    // 丢弃重放时发现的残缺尾部，新记录紧接在最后一条完整记录之后
+    if (fd_ < 0 || ::ftruncate(fd_, static_cast<off_t>(validBytes)) != 0) {
+        LOG_ERROR("Failed to open presence log {}: {}", logPath, std::strerror(errno));
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        return false;
+    }
+
+    logPath_ = logPath;
+    sink_ = std::move(sink);
+    fileBytes_ = validBytes;
+    compactedBytes_ = 0;
+
+    running_ = true;
+    logThread_ = std::thread(&PresenceTable::logLoop, this);
+    syncThread_ = std::thread(&PresenceTable::syncLoop, this);
+    LOG_INFO("PresenceTable started with {} users from {}", size(), logPath);
+    return true;
+}
+
+void PresenceTable::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+    }
+    stopCondition_.notify_all();
+    if (logThread_.joinable()) {
+        logThread_.join();
+    }
+    if (syncThread_.joinable()) {
+        syncThread_.join();
+    }
+
+    // 后台线程已退出：同步剩余的变化，失败的和 MySQL 尚未确认的在下次启动重放日志时重新同步
+    if (!sync()) {
+        LOG_WARN("Failed to sync pending presence changes on shutdown, they will be resynced from the log");
+    }
+    flush();
+    ::close(fd_);
+    fd_ = -1;
+    LOG_INFO("PresenceTable stopped with {} users", size());
+}
+
+bool PresenceTable::get(int32_t userId, PresenceEntry& entry) const {
+    if (userId <= 0) {
+        return false;
+    }
+
+    const Table* table = shardFor(userId).table.load(std::memory_order_acquire);
+    if (!table) {
+        return false;
+    }
+
+    // 装载率不超过一半，探测总会遇到目标或空槽
+    for (size_t i = (hashOf(userId) >> 6) & table->mask;; i = (i + 1) & table->mask) {
+        const Slot& slot = table->slots[i];
+        int32_t id = slot.userId.load(std::memory_order_acquire);
+        if (id == userId) {
+            entry = unpack(slot.value.load(std::memory_order_acquire));
+            uint32_t verifiedAt = slot.verifiedAt.load(std::memory_order_acquire);
+            entry.verified = verifiedAt != 0 && clockSeconds() - verifiedAt < TRUST_WINDOW;
+            return true;
+        }
+        if (id == 0) {
+            return false;
+        }
+    }
+}
+
+PresenceEntry PresenceTable::update(int32_t userId, int status, const std::string& sessionToken) {
+    PresenceEntry entry;
+    if (userId <= 0) {
+        return entry;
+    }
+
+    Shard& shard = shardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    UserState& user = shard.users[userId];
+
+    auto it = std::find(user.sessions.begin(), user.sessions.end(), sessionToken);
+    if (status == STATUS_OFFLINE) {
+        if (it != user.sessions.end()) {
+            user.sessions.erase(it);
+        }
+    } else if (it == user.sessions.end()) {
+        if (user.sessions.size() >= MAX_SESSIONS) {
+            user.sessions.erase(user.sessions.begin());
+        }
+        user.sessions.push_back(sessionToken);
+    }
+    user.lastToken = sessionToken;
+    user.adopted = false;
+
+    Slot* slot = find_impl(shard, userId);
+    int previous = slot ? unpack(slot->value.load(std::memory_order_relaxed)).status : STATUS_OFFLINE;
+    if (user.sessions.empty()) {
+        entry.status = STATUS_OFFLINE;
+    } else if (status != STATUS_OFFLINE) {
+        entry.status = status;
+    } else {
+        // 一个会话下线而其他会话仍在线，保持原来的状态
+        entry.status = previous != STATUS_OFFLINE ? previous : STATUS_ONLINE;
+    }
+    entry.sessions = static_cast<int>(user.sessions.size());
+    entry.lastSeenMs = nowMs();
+    entry.verified = true;
+
+    store_impl(shard, userId, pack(entry.status, entry.sessions, entry.lastSeenMs), clockSeconds());
+    record_impl(userId, user, entry);
+    return entry;
+}
+
+PresenceEntry PresenceTable::reconcile(int32_t userId, int status, int64_t lastUpdatedMs) {
+    PresenceEntry entry;
+    if (userId <= 0) {
+        return entry;
+    }
+
+    Shard& shard = shardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Slot* slot = find_impl(shard, userId);
+    if (slot) {
+        entry = unpack(slot->value.load(std::memory_order_relaxed));
+    }
+
+    if (slot && lastUpdatedMs <= entry.lastSeenMs) {
+        // 本表的状态不比 Redis 旧
+        slot->verifiedAt.store(clockSeconds(), std::memory_order_release);
+        entry.verified = true;
+        return entry;
+    }
+    if (!slot && lastUpdatedMs == 0) {
+        return entry;
+    }
+
+    // Redis 中的状态更新：其他实例处理过该用户。其他实例上的会话不可知，
+    // 会话集合清空，之后任一会话下线都使用户离线（与逐次覆盖状态的行为一致）
+    UserState& user = shard.users[userId];
+    user.sessions.clear();
+    user.adopted = true;
+
+    entry.status = status;
+    entry.sessions = status != STATUS_OFFLINE ? 1 : 0;
+    entry.lastSeenMs = lastUpdatedMs;
+    entry.verified = true;
+
+    store_impl(shard, userId, pack(entry.status, entry.sessions, entry.lastSeenMs), clockSeconds());
+    record_impl(userId, user, entry);
+    LOG_DEBUG("Adopted newer presence of user {} from Redis", userId);
+    return entry;
+}
+
+size_t PresenceTable::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total += shards_[i].users.size();
+    }
+    return total;
+}
+
+// murmur3 的 32 位终结函数：低位决定分片，其余位决定槽位
+uint32_t PresenceTable::hashOf(int32_t userId) {
+    uint32_t h = static_cast<uint32_t>(userId);
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// 时间 44 位 | 会话数 12 位 | 状态 8 位
+uint64_t PresenceTable::pack(int status, int sessions, int64_t lastSeenMs) {
+    return (static_cast<uint64_t>(lastSeenMs) << 20) |
+           (static_cast<uint64_t>(std::min(sessions, 0xfff)) << 8) |
+           static_cast<uint64_t>(status & 0xff);
+}
+
+PresenceEntry PresenceTable::unpack(uint64_t value) {
+    PresenceEntry entry;
+    entry.status = static_cast<int>(value & 0xff);
+    entry.sessions = static_cast<int>((value >> 8) & 0xfff);
+    entry.lastSeenMs = static_cast<int64_t>(value >> 20);
+    return entry;
+}
+
+uint32_t PresenceTable::clockSeconds() const {
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - epoch_).count()) + 1;
+}
+
+PresenceTable::Slot* PresenceTable::find_impl(Shard& shard, int32_t userId) {
+    Table* table = shard.table.load(std::memory_order_relaxed);
+    if (!table) {
+        return nullptr;
+    }
+
+    for (size_t i = (hashOf(userId) >> 6) & table->mask;; i = (i + 1) & table->mask) {
+        int32_t id = table->slots[i].userId.load(std::memory_order_relaxed);
+        if (id == userId) {
+            return &table->slots[i];
+        }
+        if (id == 0) {
+            return nullptr;
+        }
+    }
+}
+
+void PresenceTable::store_impl(Shard& shard, int32_t userId, uint64_t value, uint32_t verifiedAt) {
+    Slot* slot = find_impl(shard, userId);
+    if (slot) {
+        slot->value.store(value, std::memory_order_release);
+        slot->verifiedAt.store(verifiedAt, std::memory_order_release);
+        return;
+    }
+
+    Table* table = shard.table.load(std::memory_order_relaxed);
+    if (!table || (shard.used + 1) * 2 > table->mask + 1) {
+        // 装载率超过一半时换一张两倍大的表，填好后再发布，读者只会看到完整的新表
+        auto grown = std::make_unique<Table>(table ? (table->mask + 1) * 2 : INITIAL_CAPACITY);
+        if (table) {
+            for (size_t i = 0; i <= table->mask; ++i) {
+                const Slot& old = table->slots[i];
+                int32_t id = old.userId.load(std::memory_order_relaxed);
+                if (id == 0) {
+                    continue;
+                }
+                size_t j = (hashOf(id) >> 6) & grown->mask;
+                while (grown->slots[j].userId.load(std::memory_order_relaxed) != 0) {
+                    j = (j + 1) & grown->mask;
+                }
+                grown->slots[j].value.store(old.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                grown->slots[j].verifiedAt.store(old.verifiedAt.load(std::memory_order_relaxed),
+                                                 std::memory_order_relaxed);
+                grown->slots[j].userId.store(id, std::memory_order_relaxed);
+            }
+        }
+        table = grown.get();
+        shard.tables.push_back(std::move(grown));
+        shard.table.store(table, std::memory_order_release);
+    }
+
+    size_t i = (hashOf(userId) >> 6) & table->mask;
+    while (table->slots[i].userId.load(std::memory_order_relaxed) != 0) {
+        i = (i + 1) & table->mask;
+    }
+    table->slots[i].value.store(value, std::memory_order_relaxed);
+    table->slots[i].verifiedAt.store(verifiedAt, std::memory_order_relaxed);
+    table->slots[i].userId.store(userId, std::memory_order_release);
+    ++shard.used;
+}
+
+void PresenceTable::record_impl(int32_t userId, UserState& user, const PresenceEntry& entry) {
+    std::lock_guard<std::mutex> lock(logMutex_);
+    user.seq = ++seq_;
+
+    size_t start = beginRecord(logBuffer_);
+    put(logBuffer_, RECORD_STATE);
+    put(logBuffer_, static_cast<uint8_t>(user.adopted ? FLAG_ADOPTED : 0));
+    put(logBuffer_, userId);
+    put(logBuffer_, static_cast<uint8_t>(entry.status));
+    put(logBuffer_, entry.lastSeenMs);
+    put(logBuffer_, user.seq);
+    put(logBuffer_, static_cast<uint8_t>(user.sessions.size()));
+    for (const auto& token : user.sessions) {
+        putString(logBuffer_, token);
+    }
+    putString(logBuffer_, user.lastToken);
+    endRecord(logBuffer_, start);
+
+    if (user.adopted) {
+        // 采用的状态来自 Redis，尚未同步的旧变化不能再覆盖它
+        dirty_.erase(userId);
+    } else {
+        dirty_[userId] = PresenceChange{userId, entry.status, entry.lastSeenMs, user.lastToken};
+    }
+}
+
+/**
+ * @brief 重放变更日志，遇到残缺或校验失败的记录即停止（崩溃时最后一批写入可能不完整）
+ * @param validBytes 输出参数，完整记录的总长度
+ * @return 读取失败返回false，文件不存在视为空日志
+ */
+bool PresenceTable::replay(const std::string& path, uint64_t& validBytes) {
+    validBytes = 0;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT;
+    }
+
+    std::string data;
+    char buffer[65536];
+    ssize_t count;
+    while ((count = ::read(fd, buffer, sizeof(buffer))) != 0) {
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ::close(fd);
+            return false;
+        }
+        data.append(buffer, static_cast<size_t>(count));
+    }
+    ::close(fd);
+
+    // 每个用户最后一条本实例产生的变化，检查点之后的需要重新同步
+    std::unordered_map<int32_t, std::pair<uint64_t, PresenceChange>> latest;
+    uint64_t checkpoint = 0;
+    uint64_t maxSeq = 0;
+    size_t records = 0;
+    size_t pos = 0;
+    while (pos + RECORD_HEADER_SIZE <= data.size()) {
+        uint32_t length;
+        uint32_t checksum;
+        std::memcpy(&length, data.data() + pos, sizeof(length));
+        std::memcpy(&checksum, data.data() + pos + sizeof(length), sizeof(checksum));
+        const char* payload = data.data() + pos + RECORD_HEADER_SIZE;
+        if (length > data.size() - pos - RECORD_HEADER_SIZE || fnv1a(payload, length) != checksum) {
+            break;
+        }
+
+        PayloadReader reader{payload, length};
+        uint8_t type = reader.get<uint8_t>();
+        if (type == RECORD_CHECKPOINT) {
+            checkpoint = std::max(checkpoint, reader.get<uint64_t>());
+        } else if (type == RECORD_STATE) {
+            uint8_t flags = reader.get<uint8_t>();
+            int32_t userId = reader.get<int32_t>();
+            int status = reader.get<uint8_t>();
+            int64_t lastSeenMs = reader.get<int64_t>();
+            UserState user;
+            user.seq = reader.get<uint64_t>();
+            uint8_t sessions = reader.get<uint8_t>();
+            for (uint8_t i = 0; i < sessions && reader.ok; ++i) {
+                user.sessions.push_back(reader.getString());
+            }
+            user.lastToken = reader.getString();
+            user.adopted = (flags & FLAG_ADOPTED) != 0;
+            if (!reader.ok || userId <= 0) {
+                break;
+            }
+
+            maxSeq = std::max(maxSeq, user.seq);
+            if (user.adopted) {
+                latest.erase(userId);
+            } else {
+                latest[userId] = {user.seq, PresenceChange{userId, status, lastSeenMs, user.lastToken}};
+            }
+
+            // 重放得到的状态在核对前不可信
+            Shard& shard = shardFor(userId);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            int sessionCount = user.adopted && status != STATUS_OFFLINE ? 1 : static_cast<int>(user.sessions.size());
+            store_impl(shard, userId, pack(status, sessionCount, lastSeenMs), 0);
+            shard.users[userId] = std::move(user);
+        } else {
+            break;
+        }
+
+        pos += RECORD_HEADER_SIZE + length;
+        ++records;
+    }
+
+    if (pos < data.size()) {
+        LOG_WARN("Presence log {} has a torn or corrupt record at offset {}, discarding {} trailing bytes",
+                 path, pos, data.size() - pos);
+    }
+
+    std::lock_guard<std::mutex> lock(logMutex_);
+    seq_ = maxSeq;
+    checkpointSeq_ = checkpoint;
+    for (auto& entry : latest) {
+        if (entry.second.first > checkpoint) {
+            dirty_[entry.first] = std::move(entry.second.second);
+        }
+    }
+    validBytes = pos;
+    LOG_INFO("Replayed {} presence log records, {} changes to resync", records, dirty_.size());
+    return true;
+}
+
+/**
+ * @brief 把缓冲的日志记录写入文件并 fdatasync（组提交）
+ */
+void PresenceTable::flush() {
+    std::string pending;
+    {
+        std::lock_guard<std::mutex> lock(logMutex_);
+        pending.swap(logBuffer_);
+    }
+    if (pending.empty() || fd_ < 0) {
+        return;
+    }
+
+    if (!writeAll(fd_, pending) || ::fdatasync(fd_) != 0) {
+        LOG_ERROR("Failed to write presence log {}: {}", logPath_, std::strerror(errno));
+        // 截掉写了一半的记录，否则之后的记录在重放时无法到达
+        if (::ftruncate(fd_, static_cast<off_t>(fileBytes_)) != 0) {
+            LOG_ERROR("Failed to truncate presence log {}: {}", logPath_, std::strerror(errno));
+        }
+        return;
+    }
+    fileBytes_ += pending.size();
+}
+
+/**
+ * @brief 用当前状态重写日志：快照写入临时文件，接上快照期间产生的记录后替换原文件
+ * 快照之后追加的记录包含上次刷盘以来的全部变化，重放时按顺序覆盖，结果与当前状态一致
+ */
+void PresenceTable::compact() {
+    std::string tmpPath = logPath_ + ".tmp";
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Failed to create {}: {}", tmpPath, std::strerror(errno));
+        compactedBytes_ = fileBytes_;
+        return;
+    }
+
+    std::string snapshot;
+    {
+        std::lock_guard<std::mutex> lock(logMutex_);
+        appendCheckpoint(snapshot, checkpointSeq_);
+    }
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        Shard& shard = shards_[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& user : shard.users) {
+            const Slot* slot = find_impl(shard, user.first);
+            if (!slot) {
+                continue;
+            }
+            PresenceEntry entry = unpack(slot->value.load(std::memory_order_relaxed));
+            size_t start = beginRecord(snapshot);
+            put(snapshot, RECORD_STATE);
+            put(snapshot, static_cast<uint8_t>(user.second.adopted ? FLAG_ADOPTED : 0));
+            put(snapshot, user.first);
+            put(snapshot, static_cast<uint8_t>(entry.status));
+            put(snapshot, entry.lastSeenMs);
+            put(snapshot, user.second.seq);
+            put(snapshot, static_cast<uint8_t>(user.second.sessions.size()));
+            for (const auto& token : user.second.sessions) {
+                putString(snapshot, token);
+            }
+            putString(snapshot, user.second.lastToken);
+            endRecord(snapshot, start);
+        }
+    }
+
+    std::string pending;
+    {
+        std::lock_guard<std::mutex> lock(logMutex_);
+        pending.swap(logBuffer_);
+    }
+
+    if (!writeAll(fd, snapshot) || !writeAll(fd, pending) || ::fdatasync(fd) != 0 ||
+        ::rename(tmpPath.c_str(), logPath_.c_str()) != 0) {
+        LOG_ERROR("Failed to compact presence log {}: {}", logPath_, std::strerror(errno));
+        ::close(fd);
+        ::unlink(tmpPath.c_str());
+        // 取出的记录放回缓冲区最前面，由下次刷盘写入原文件
+        {
+            std::lock_guard<std::mutex> lock(logMutex_);
+            logBuffer_.insert(0, pending);
+        }
+        compactedBytes_ = fileBytes_;
+        return;
+    }
+
+    syncDirectory(logPath_);
+    ::close(fd_);
+    fd_ = fd;
+    LOG_INFO("Compacted presence log {} from {} to {} bytes", logPath_, fileBytes_, snapshot.size() + pending.size());
+    fileBytes_ = snapshot.size() + pending.size();
+    compactedBytes_ = fileBytes_;
+}
+
+/**
+ * @brief 把合并后的变化交给同步回调，成功后等待 MySQL 确认再写入检查点，失败的放回待同步集合
+ * @return 同步成功（或没有变化）返回true
+ */
+bool PresenceTable::sync() {
+    std::vector<PresenceChange> batch;
+    uint64_t upTo;
+    {
+        std::lock_guard<std::mutex> lock(logMutex_);
+        if (dirty_.empty()) {
+            return true;
+        }
+        batch.reserve(dirty_.size());
+        for (auto& entry : dirty_) {
+            batch.push_back(std::move(entry.second));
+        }
+        dirty_.clear();
+        upTo = seq_;
+    }
+
+    uint64_t ticket = 0;
+    bool synced = !sink_ || sink_(batch, ticket);
+
+    std::lock_guard<std::mutex> lock(logMutex_);
+    if (synced) {
+        if (!sink_) {
+            if (upTo > checkpointSeq_) {
+                checkpointSeq_ = upTo;
+                appendCheckpoint(logBuffer_, upTo);
+            }
+        } else {
+            unconfirmed_.emplace_back(upTo, ticket);
+        }
+        return true;
+    }
+
+    // 同步期间又有变化的用户以新变化为准
+    for (auto& change : batch) {
+        dirty_.emplace(change.userId, std::move(change));
+    }
+    return false;
+}
+
+void PresenceTable::markDurable(uint64_t ticket) {
+    std::lock_guard<std::mutex> lock(logMutex_);
+    uint64_t upTo = checkpointSeq_;
+    while (!unconfirmed_.empty() && unconfirmed_.front().second <= ticket) {
+        upTo = std::max(upTo, unconfirmed_.front().first);
+        unconfirmed_.pop_front();
+    }
+    if (upTo > checkpointSeq_) {
+        checkpointSeq_ = upTo;
+        appendCheckpoint(logBuffer_, upTo);
+    }
+}
+
+void PresenceTable::logLoop() {
+    while (sleepFor(FLUSH_INTERVAL)) {
+        flush();
+        if (fileBytes_ > COMPACT_BYTES && fileBytes_ > compactedBytes_ * 2) {
+            compact();
+        }
+    }
+}
+
+void PresenceTable::syncLoop() {
+    std::chrono::milliseconds interval = SYNC_INTERVAL;
+    while (sleepFor(interval)) {
+        if (sync()) {
+            interval = SYNC_INTERVAL;
+        } else {
+            // Redis 或 MySQL 不可用时逐步拉长重试间隔，变化在待同步集合中继续合并
+            interval = std::min(interval * 2, MAX_SYNC_BACKOFF);
+            LOG_WARN("Failed to sync presence changes, retrying in {} ms", interval.count());
+        }
+    }
+}
+
+/**
+ * @brief 可被 stop() 打断的等待
+ * @return 等待结束后仍在运行返回true
+ */
+bool PresenceTable::sleepFor(std::chrono::milliseconds duration) {
+    std::unique_lock<std::mutex> lock(stopMutex_);
+    return !stopCondition_.wait_for(lock, duration, [this] { return !running_; });
+}
@@ -0,0 +1,223 @@
+#ifndef PRESENCE_TABLE_H
+#define PRESENCE_TABLE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 一个用户的在线状态
+ */
+struct PresenceEntry {
+    int status = 0;            // 取值与 status::UserStatus 相同：0 离线，1 在线，2 离开，3 忙碌
+    int64_t lastSeenMs = 0;    // 最近一次状态变化的时间（毫秒）
+    int sessions = 0;          // 在线会话数
+    bool verified = false;     // 在可信窗口内由本实例写入或与 Redis 核对过，可以直接使用
+};
+
+/**
+ * @brief 待同步到 Redis 和 MySQL 的状态（同一用户的多次变化只保留最新一次）
+ */
+struct PresenceChange {
+    int32_t userId;
+    int status;
+    int64_t lastSeenMs;
+    std::string sessionToken;  // 最近一次更新携带的会话令牌
+};
+
+/**
+ * @brief 进程内的权威在线状态表（单例模式）
+ *
+ * 用户在线状态以本表为准，Redis 和 MySQL 由后台线程异步更新：
+ * 1. 按用户ID分成 SHARD_COUNT 个分片（各占独立的缓存行），每个分片一张开放寻址表；
+ *    槽位 16 字节，状态、会话数和时间打包在一个 64 位原子量里，读取不加锁，一次原子读得到一致的值
+ * 2. 写入按分片加锁，分片在写者侧记录每个用户的会话令牌集合：
+ *    会话上线加入集合、下线移出集合，集合为空才算离线，重复的下线不会把会话数减成负数
+ * 3. 每次变化追加一条记录到变更日志，日志线程每 FLUSH_INTERVAL 批量写入并 fdatasync，
+ *    进程崩溃最多丢失最近一个刷盘间隔的变化；启动时重放日志恢复状态，日志过大时按当前状态重写
+ * 4. 同步线程每 SYNC_INTERVAL 把合并后的变化交给同步回调写入 Redis 和 MySQL，失败的留到下一轮；
+ *    MySQL 由调用方异步批量写入，确认落库（markDurable）后才把同步到的位置以检查点记录写入日志，
+ *    重放时检查点之后的变化重新同步
+ *
+ * 网关按用户ID把状态读写固定路由到一个实例，但实例不可用期间它的用户会由其他实例处理，
+ * 所以条目只在本实例写入或核对后的 TRUST_WINDOW 内可信，过期的（以及重放得到的）条目需先与 Redis 核对。
+ */
+class PresenceTable {
+public:
+    /**
+     * @brief 同步回调：把一批变化写入 Redis，并交给 MySQL 的异步写入
+     * @param ticket 输出参数，这批变化的落库凭据，markDurable 收到不小于它的值后检查点才会越过这批变化
+     * @return 返回false时整批留到下一轮重试（回调需保证重复写入无害）
+     */
+    using Sink = std::function<bool(const std::vector<PresenceChange>&, uint64_t& ticket)>;
+
+    /**
+     * @brief 获取PresenceTable单例实例
+     * @return PresenceTable实例的引用
+     */
+    static PresenceTable& getInstance();
+
+    PresenceTable(const PresenceTable&) = delete;
+    PresenceTable& operator=(const PresenceTable&) = delete;
+
+    /**
+     * @brief 重放变更日志并启动刷盘和同步线程
+     * @param logPath 变更日志路径
+     * @param sink 同步回调
+     * @return 日志无法打开时返回false，状态表保持停用
+     */
+    bool start(const std::string& logPath, Sink sink);
+
+    /**
+     * @brief 停止后台线程，同步剩余的变化并刷盘
+     */
+    void stop();
+
+    /**
+     * @brief 状态表是否启用（停用时调用方走 Redis/MySQL）
+     */
+    bool isEnabled() const { return running_; }
+
+    /**
+     * @brief 确认凭据不大于 ticket 的批次已写入 MySQL，检查点随之前进
+     * @param ticket 已落库的凭据（由 Sink 给出）
+     */
+    void markDurable(uint64_t ticket);
+
+    /**
+     * @brief 读取用户状态（无锁）
+     * @param entry 输出参数，用户状态
+     * @return 表中没有该用户返回false
+     */
+    bool get(int32_t userId, PresenceEntry& entry) const;
+
+    /**
+     * @brief 应用一个会话的状态变化
+     * @param status 新状态，OFFLINE 表示该会话下线
+     * @param sessionToken 会话令牌
+     * @return 变化后的状态
+     */
+    PresenceEntry update(int32_t userId, int status, const std::string& sessionToken);
+
+    /**
+     * @brief 与 Redis 中的状态核对：Redis 中的记录更新（其他实例处理过该用户）时采用它，否则把条目标记为可信
+     * @param status Redis 中的状态
+     * @param lastUpdatedMs Redis 中的更新时间（毫秒），没有记录时为0
+     * @return 核对后的状态
+     */
+    PresenceEntry reconcile(int32_t userId, int status, int64_t lastUpdatedMs);
+
+    /**
+     * @brief 表中的用户数
+     */
+    size_t size() const;
+
+private:
+    PresenceTable();
+    ~PresenceTable();
+
+    // 槽位，四个占满一个缓存行；写者先写 value 和 verifiedAt 再以 release 发布 userId
+    struct alignas(16) Slot {
+        std::atomic<int32_t> userId{0};         // 0 表示空槽
+        std::atomic<uint32_t> verifiedAt{0};    // 最近写入或核对的时间（clockSeconds()），0 表示未核对
+        std::atomic<uint64_t> value{0};         // pack() 打包的状态
+    };
+
+    struct Table {
+        explicit Table(size_t capacity) : mask(capacity - 1), slots(new Slot[capacity]) {}
+        size_t mask;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    // 写者侧的用户状态，分片锁保护
+    struct UserState {
+        std::vector<std::string> sessions;     // 在线会话的令牌
+        std::string lastToken;                 // 最近一次更新的令牌
+        uint64_t seq = 0;                      // 最近一条日志记录的序号
+        bool adopted = false;                  // 当前状态采用自 Redis，不需要同步回去
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::atomic<Table*> table{nullptr};
+        size_t used = 0;
+        // 扩容后读者可能仍在访问旧表，旧表保留到进程退出
+        std::vector<std::unique_ptr<Table>> tables;
+        std::unordered_map<int32_t, UserState> users;
+    };
+
+    Shard& shardFor(int32_t userId) { return shards_[hashOf(userId) % SHARD_COUNT]; }
+    const Shard& shardFor(int32_t userId) const { return shards_[hashOf(userId) % SHARD_COUNT]; }
+    static uint32_t hashOf(int32_t userId);
+
+    static uint64_t pack(int status, int sessions, int64_t lastSeenMs);
+    static PresenceEntry unpack(uint64_t value);
+
+    // 自 epoch_ 起的秒数 + 1，0 留作"未核对"
+    uint32_t clockSeconds() const;
+
+    // 写入或插入槽位（调用者持有分片锁）
+    void store_impl(Shard& shard, int32_t userId, uint64_t value, uint32_t verifiedAt);
+    Slot* find_impl(Shard& shard, int32_t userId);
+
+    // 为用户的当前状态生成一条日志记录，本实例产生的变化标记为待同步（调用者持有分片锁）
+    void record_impl(int32_t userId, UserState& user, const PresenceEntry& entry);
+
+    bool replay(const std::string& path, uint64_t& validBytes);
+    void flush();
+    void compact();
+    bool sync();
+    void logLoop();
+    void syncLoop();
+    bool sleepFor(std::chrono::milliseconds duration);
+
+    static const size_t SHARD_COUNT = 64;
+    static const size_t INITIAL_CAPACITY = 64;
+    // 一个用户最多记录的会话数，超出时丢弃最早的会话
+    static const size_t MAX_SESSIONS = 16;
+    // 条目在写入或核对后的可信时间（秒）
+    static const uint32_t TRUST_WINDOW = 10;
+    // 变更日志的刷盘间隔和同步间隔
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL{20};
+    static constexpr std::chrono::milliseconds SYNC_INTERVAL{100};
+    // 同步失败后的最长重试间隔
+    static constexpr std::chrono::milliseconds MAX_SYNC_BACKOFF{5000};
+    // 日志超过该大小且是上次重写后的两倍时重写
+    static const uint64_t COMPACT_BYTES = 64ULL * 1024 * 1024;
+
+    std::unique_ptr<Shard[]> shards_;
+    std::chrono::steady_clock::time_point epoch_;
+    Sink sink_;
+
+    // 日志缓冲、待同步集合和序号，锁顺序：分片锁 -> logMutex_
+    std::mutex logMutex_;
+    std::string logBuffer_;
+    std::unordered_map<int32_t, PresenceChange> dirty_;
+    uint64_t seq_;
+    uint64_t checkpointSeq_;
+    // 已写入 Redis、等待 MySQL 确认的批次：(批次的最大序号, 落库凭据)，按同步顺序排列
+    std::deque<std::pair<uint64_t, uint64_t>> unconfirmed_;
+
+    // 日志文件只由日志线程（以及停止后的调用者）访问
+    std::string logPath_;
+    int fd_;
+    uint64_t fileBytes_;
+    uint64_t compactedBytes_;
+
+    std::atomic<bool> running_;
+    std::thread logThread_;
+    std::thread syncThread_;
+    std::mutex stopMutex_;
+    std::condition_variable stopCondition_;
+};
+
+#endif // PRESENCE_TABLE_H
@@ -2,6 +2,245 @@
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <algorithm>
+#include <strings.h>
+
+/**
+ * @brief 把 hiredis 回复复制为 RedisValue
+ */
+RedisValue toRedisValue(const redisReply* reply) {
+    RedisValue value;
+    if (!reply) return value;
+    
+    value.type = reply->type;
+    switch (reply->type) {
+        case REDIS_REPLY_INTEGER:
+            value.integer = reply->integer;
+            break;
+        case REDIS_REPLY_STRING:
+        case REDIS_REPLY_STATUS:
+        case REDIS_REPLY_ERROR:
+            value.str.assign(reply->str, reply->len);
+            break;
+        case REDIS_REPLY_ARRAY:
+            value.elements.reserve(reply->elements);
+            for (size_t i = 0; i < reply->elements; ++i) {
+                value.elements.push_back(toRedisValue(reply->element[i]));
+            }
+            break;
+        default:
+            break;
+    }
+    return value;
+}
+
+namespace {
+
+/**
+ * @brief 命令是否可以在连接出错后重发
+ * 连接出错时无法确定命令是否已在服务端执行，只重发重复执行结果相同的命令（INCR、PUBLISH 等不在其中）
+ * @param name 命令名（不必以 '\0' 结尾）
+ * @param length 命令名长度
+ */
+bool isIdempotentCommand(const char* name, size_t length) {
+    static const char* const IDEMPOTENT_COMMANDS[] = {
+        "GET", "HGET", "HGETALL", "ZRANGE", "SET", "HSET", "HDEL", "DEL", "ZADD"
+    };
+    for (const char* command : IDEMPOTENT_COMMANDS) {
+        if (std::strlen(command) == length && strncasecmp(name, command, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 同上，参数为 hiredis 格式化字符串，以命令名开头
+ */
+bool isIdempotentCommand(const char* format) {
+    return isIdempotentCommand(format, std::strcspn(format, " "));
+}
+
+/**
+ * @brief 同上，参数为 argv 形式的命令
+ */
+bool isIdempotentCommand(const std::vector<std::string>& args) {
+    return !args.empty() && isIdempotentCommand(args[0].data(), args[0].size());
+}
+
+/**
+ * @brief 有序集合分数转为字符串（保留完整精度）
+ */
+std::string formatScore(double score) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.17g", score);
+    return buf;
+}
+
+/**
+ * @brief 线程独占的Redis连接
+ * 每个线程在每个节点上优先使用自己的连接，取用和归还都不需要加锁
+ */
+struct ThreadRedisConnection {
+    redisContext* ctx = nullptr;
+    uint64_t generation = 0;                          // 建立连接时 RedisManager 的代数
+    std::chrono::steady_clock::time_point lastUsed;
+    bool inUse = false;                               // 同一线程嵌套取用时走溢出池
+    
+    ThreadRedisConnection() = default;
+    ThreadRedisConnection(const ThreadRedisConnection&) = delete;
+    ThreadRedisConnection& operator=(const ThreadRedisConnection&) = delete;
+    
+    ~ThreadRedisConnection() {
+        if (ctx) redisFree(ctx);
+    }
+};
+
+/**
+ * @brief 当前线程在各节点上的独占连接，按节点ID索引
+ */
+struct ThreadRedisConnections {
+    uint64_t generation = 0;
+    std::unordered_map<uint64_t, ThreadRedisConnection> byNode;
+};
+
+thread_local ThreadRedisConnections t_redisConnections;
+
+int64_t steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+/**
+ * @brief 单个Redis节点
+ * 持有该节点的溢出连接池、健康状态和重连退避；
+ * 线程独占连接按节点ID存放在线程局部表中，由 RedisManager 管理
+ */
+class RedisNode {
+public:
+    RedisNode(const RedisNodeAddress& address, int poolSize)
+        : address_(address), id_(nextId_++), pool_(poolSize > 0 ? poolSize : 1),
+          healthy_(false), reconnectBackoffMs_(0), nextReconnectAtMs_(0) {
+    }
+    
+    ~RedisNode() {
+        drain();
+    }
+    
+    RedisNode(const RedisNode&) = delete;
+    RedisNode& operator=(const RedisNode&) = delete;
+    
+    uint64_t id() const { return id_; }
+    const RedisNodeAddress& address() const { return address_; }
+    bool isHealthy() const { return healthy_; }
+    void markUnhealthy() { healthy_ = false; }
+    
+    /**
+     * @brief 创建到该节点的连接
+     * @return Redis连接上下文指针，失败返回nullptr
+     */
+    redisContext* createConnection() {
+        struct timeval timeout = { 2, 500000 }; // 2.5 seconds
+        redisContext* ctx = redisConnectWithTimeout(address_.host.c_str(), address_.port, timeout);
+        
+        if (ctx == nullptr || ctx->err) {
+            if (ctx) {
+                LOG_ERROR("Redis connection error ({}): {}", address_.toString(), ctx->errstr);
+                redisFree(ctx);
+            } else {
+                LOG_ERROR("Redis connection error: can't allocate redis context");
+            }
+            return nullptr;
+        }
+        
+        LOG_INFO("Redis connection created to {}", address_.toString());
+        return ctx;
+    }
+    
+    /**
+     * @brief 带退避的重连
+     * 连续失败时等待时间从 RECONNECT_BACKOFF_MIN_MS 倍增到 RECONNECT_BACKOFF_MAX_MS，
+     * 退避期间直接返回失败，避免每个请求都卡在连接超时上
+     * @return Redis连接上下文指针，失败或退避中返回nullptr
+     */
+    redisContext* reconnect() {
+        if (steadyNowMs() < nextReconnectAtMs_.load(std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        
+        redisContext* ctx = createConnection();
+        if (ctx) {
+            reconnectBackoffMs_ = 0;
+            healthy_ = true;
+            return ctx;
+        }
+        
+        int64_t backoff = std::min<int64_t>(std::max<int64_t>(reconnectBackoffMs_.load() * 2, RECONNECT_BACKOFF_MIN_MS),
+                                            RECONNECT_BACKOFF_MAX_MS);
+        reconnectBackoffMs_ = backoff;
+        nextReconnectAtMs_ = steadyNowMs() + backoff;
+        healthy_ = false;
+        LOG_WARN("Redis reconnect to {} failed, retrying in {} ms", address_.toString(), backoff);
+        return nullptr;
+    }
+    
+    bool popIdle(redisContext*& ctx) {
+        return pool_.pop(ctx);
+    }
+    
+    /**
+     * @brief 放回溢出池，池满时释放连接
+     */
+    void pushIdle(redisContext* ctx) {
+        if (!pool_.push(ctx)) {
+            redisFree(ctx);
+        }
+    }
+    
+    /**
+     * @brief 释放溢出池中的全部连接
+     */
+    void drain() {
+        redisContext* ctx = nullptr;
+        while (pool_.pop(ctx)) {
+            redisFree(ctx);
+        }
+    }
+
+private:
+    // 重连退避范围
+    static constexpr int64_t RECONNECT_BACKOFF_MIN_MS = 100;
+    static constexpr int64_t RECONNECT_BACKOFF_MAX_MS = 5000;
+    
+    static std::atomic<uint64_t> nextId_;
+    
+    RedisNodeAddress address_;
+    uint64_t id_;                                 // 全局唯一，线程连接表的索引
+    BoundedMpmcQueue<redisContext*> pool_;        // 线程连接之外的溢出连接池
+    std::atomic<bool> healthy_;                   // 最近一次连接或命令是否成功
+    std::atomic<int64_t> reconnectBackoffMs_;
+    std::atomic<int64_t> nextReconnectAtMs_;
+};
+
+std::atomic<uint64_t> RedisNode::nextId_{1};
+
+/**
+ * @brief 节点列表和槽位分配
+ * 创建后不再修改，拓扑变化时由 RedisManager 整体替换
+ */
+struct RedisTopology {
+    std::vector<std::shared_ptr<RedisNode>> nodes;
+    std::vector<uint16_t> slots;                  // 槽位 -> nodes 下标
+    
+    const std::shared_ptr<RedisNode>& nodeForSlot(uint16_t slot) const {
+        return nodes[slots[slot]];
+    }
+};
 
 /**
  * @brief 获取RedisManager单例实例
@@ -16,9 +255,8 @@ RedisManager& RedisManager::getInstance() {
 /**
  * @brief RedisManager构造函数
  */
-RedisManager::RedisManager() : initialized_(false) {
-    // 初始化连接池为空
-    connectionPool_.clear();
+RedisManager::RedisManager() : topologyVersion_(0), poolSize_(0), clusterMode_(false), initialized_(false),
+                               generation_(1), lastClusterRefreshMs_(0) {
 }
 
 /**
@@ -30,98 +268,325 @@ RedisManager::~RedisManager() {
 }
 
 /**
- * @brief 初始化Redis连接
+ * @brief 初始化单节点Redis连接
  * @param host Redis服务器主机地址
  * @param port Redis服务器端口
- * @param poolSize 连接池大小
+ * @param poolSize 溢出连接池大小
  * @return 初始化成功返回true，否则返回false
  */
 bool RedisManager::initialize(const std::string& host, int port, int poolSize) {
+    return initialize(std::vector<RedisNodeAddress>{RedisNodeAddress{host, port}}, poolSize, false);
+}
+
+/**
+ * @brief 初始化多节点Redis连接
+ * 每个节点先建立一个连接确认可用，其余连接在各线程首次使用时按需建立；
+ * 暂时不可用的节点按退避间隔重连，其槽位上的操作在恢复前失败
+ * @param nodes 节点列表（集群模式下为种子节点）
+ * @param poolSize 每个节点的溢出连接池大小
+ * @param clusterMode 是否按 Redis Cluster 协议路由
+ * @return 至少一个节点可用返回true，否则返回false
+ */
+bool RedisManager::initialize(const std::vector<RedisNodeAddress>& nodes, int poolSize, bool clusterMode) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        
+        if (initialized_) {
+            LOG_WARN("RedisManager already initialized");
+            return true;
+        }
+        
+        if (nodes.empty()) {
+            LOG_ERROR("RedisManager requires at least one node");
+            return false;
+        }
+        
+        auto topology = std::make_unique<RedisTopology>();
+        size_t reachable = 0;
+        for (const auto& address : nodes) {
+            auto node = std::make_shared<RedisNode>(address, poolSize);
+            redisContext* ctx = node->reconnect();
+            if (ctx) {
+                node->pushIdle(ctx);
+                ++reachable;
+            } else {
+                LOG_ERROR("Failed to create Redis connection to {}", address.toString());
+            }
+            topology->nodes.push_back(std::move(node));
+        }
+        
+        if (reachable == 0) {
+            return false;
+        }
+        
+        // 集群模式下先把所有槽位指向第一个种子节点，随后由 CLUSTER SLOTS 修正
+        topology->slots = clusterMode ? std::vector<uint16_t>(REDIS_SLOT_COUNT, 0)
+                                      : buildConsistentHashSlots(nodes);
+        
+        poolSize_ = poolSize;
+        clusterMode_ = clusterMode;
+        publish_impl(std::move(topology));
+        initialized_ = true;
+    }
+    
+    if (clusterMode && !refreshClusterSlots(true)) {
+        LOG_WARN("Redis cluster slots not loaded yet, relying on MOVED redirects");
+    }
+    
+    LOG_INFO("RedisManager initialized with {} node(s){} (per-thread connections, overflow pool {} per node)",
+             nodes.size(), clusterMode ? " in cluster mode" : "", poolSize);
+    return true;
+}
+
+/**
+ * @brief 断开所有Redis连接
+ * 溢出池中的连接立即释放；各线程独占的连接在其下次使用或线程退出时释放
+ */
+void RedisManager::disconnect() {
     std::lock_guard<std::mutex> lock(mutex_);
     
-    if (initialized_) {
-        LOG_WARN("RedisManager already initialized");
-        return true;
+    initialized_ = false;
+    ++generation_;
+    
+    if (auto topology = this->topology()) {
+        for (const auto& node : topology->nodes) {
+            node->drain();
+        }
     }
+    publish_impl(nullptr);
     
-    host_ = host;
-    port_ = port;
-    poolSize_ = poolSize;
+    LOG_INFO("RedisManager disconnected");
+}
+
+/**
+ * @brief 检查Redis连接状态
+ * 不发送PING，只反映各节点最近一次建立连接或执行命令的结果；
+ * 任一持有槽位的节点不可用即视为未连接
+ * @return 连接有效返回true，否则返回false
+ */
+bool RedisManager::isConnected() const {
+    auto topology = this->topology();
+    if (!initialized_ || !topology) {
+        return false;
+    }
     
-    // 创建连接池
-    for (int i = 0; i < poolSize_; ++i) {
-        redisContext* ctx = createConnection(host, port);
-        if (ctx) {
-            connectionPool_.push_back(ctx);
-        } else {
-            LOG_ERROR("Failed to create Redis connection {}/{}", i + 1, poolSize_);
-            // 清理已创建的连接
-            disconnect();
+    std::vector<bool> ownsSlots(topology->nodes.size(), false);
+    for (uint16_t index : topology->slots) {
+        ownsSlots[index] = true;
+    }
+    for (size_t i = 0; i < topology->nodes.size(); ++i) {
+        if (ownsSlots[i] && !topology->nodes[i]->isHealthy()) {
             return false;
         }
     }
-    
-    initialized_ = true;
-    LOG_INFO("RedisManager initialized with {} connections to {}:{}",
-             poolSize_, host_, port_);
     return true;
 }
 
 /**
- * @brief 创建Redis连接
- * @param host Redis服务器主机地址
- * @param port Redis服务器端口
- * @return Redis连接上下文指针
+ * @brief 发布新的拓扑快照
+ * 先换快照再加版本号：读者看到新版本号时一定能取到新快照
  */
-redisContext* RedisManager::createConnection(const std::string& host, int port) {
-    struct timeval timeout = { 2, 500000 }; // 2.5 seconds
-    redisContext* ctx = redisConnectWithTimeout(host.c_str(), port, timeout);
+void RedisManager::publish_impl(std::unique_ptr<const RedisTopology> topology) {
+    std::atomic_store(&topology_, std::shared_ptr<const RedisTopology>(std::move(topology)));
+    topologyVersion_.fetch_add(1, std::memory_order_release);
+}
+
+/**
+ * @brief 获取当前拓扑快照
+ * 命令路径每次都要读取拓扑：每个线程缓存一份快照引用，版本号未变时直接复制，
+ * 只读一次原子变量，不进入 std::atomic_load 的锁
+ */
+std::shared_ptr<const RedisTopology> RedisManager::topology() const {
+    struct CachedTopology {
+        const RedisManager* owner = nullptr;
+        uint64_t version = 0;
+        std::shared_ptr<const RedisTopology> topology;
+    };
+    static thread_local CachedTopology cache;
     
-    if (ctx == nullptr || ctx->err) {
-        if (ctx) {
-            LOG_ERROR("Redis connection error: {}", ctx->errstr);
-            redisFree(ctx);
-        } else {
-            LOG_ERROR("Redis connection error: can't allocate redis context");
-        }
+    uint64_t version = topologyVersion_.load(std::memory_order_acquire);
+    if (cache.owner != this || cache.version != version) {
+        cache.owner = this;
+        cache.version = version;
+        cache.topology = std::atomic_load(&topology_);
+    }
+    return cache.topology;
+}
+
+std::shared_ptr<RedisNode> RedisManager::nodeForKey(const std::string& key) const {
+    auto topology = this->topology();
+    if (!topology) {
         return nullptr;
     }
+    return topology->nodeForSlot(redisKeySlot(key));
+}
+
+bool RedisManager::nodeAddressForKey(const std::string& key, RedisNodeAddress& address) const {
+    std::shared_ptr<RedisNode> node = nodeForKey(key);
+    if (!node) {
+        return false;
+    }
+    address = node->address();
+    return true;
+}
+
+std::vector<RedisNodeAddress> RedisManager::nodeAddresses() const {
+    std::vector<RedisNodeAddress> addresses;
+    auto topology = this->topology();
+    if (!topology) {
+        return addresses;
+    }
     
-    LOG_INFO("Redis connection created to {}:{}", host, port);
-    return ctx;
+    std::vector<bool> ownsSlots(topology->nodes.size(), false);
+    for (uint16_t index : topology->slots) {
+        ownsSlots[index] = true;
+    }
+    for (size_t i = 0; i < topology->nodes.size(); ++i) {
+        if (ownsSlots[i]) {
+            addresses.push_back(topology->nodes[i]->address());
+        }
+    }
+    return addresses;
 }
 
 /**
- * @brief 断开所有Redis连接
+ * @brief 检查多个键是否位于同一节点
+ * 集群模式下服务端要求多键命令位于同一槽位，这里按槽位比较
  */
-void RedisManager::disconnect() {
-    std::lock_guard<std::mutex> lock(mutex_);
+bool RedisManager::sameShard(const std::vector<std::string>& keys) const {
+    auto topology = this->topology();
+    if (!topology || keys.empty()) {
+        return topology != nullptr;
+    }
     
-    for (redisContext* ctx : connectionPool_) {
-        if (ctx) {
-            redisFree(ctx);
+    uint16_t firstSlot = redisKeySlot(keys[0]);
+    for (size_t i = 1; i < keys.size(); ++i) {
+        uint16_t slot = redisKeySlot(keys[i]);
+        if (clusterMode_ ? slot != firstSlot : topology->slots[slot] != topology->slots[firstSlot]) {
+            return false;
         }
     }
-    
-    connectionPool_.clear();
-    initialized_ = false;
-    LOG_INFO("RedisManager disconnected");
+    return true;
 }
 
 /**
- * @brief 检查Redis连接状态
- * @return 连接有效返回true，否则返回false
+ * @brief 按地址查找节点
+ * 集群模式下 MOVED/ASK 可能指向拓扑中还没有的节点，此时复制拓扑并加入新节点
  */
-bool RedisManager::isConnected() const {
+std::shared_ptr<RedisNode> RedisManager::nodeForAddress(const RedisNodeAddress& address) {
+    auto topology = this->topology();
+    if (!topology) {
+        return nullptr;
+    }
+    for (const auto& node : topology->nodes) {
+        if (node->address() == address) {
+            return node;
+        }
+    }
+    
     std::lock_guard<std::mutex> lock(mutex_);
+    topology = this->topology();
+    if (!topology) {
+        return nullptr;
+    }
+    for (const auto& node : topology->nodes) {
+        if (node->address() == address) {
+            return node;
+        }
+    }
     
-    if (!initialized_ || connectionPool_.empty()) {
+    auto updated = std::make_unique<RedisTopology>(*topology);
+    auto node = std::make_shared<RedisNode>(address, poolSize_);
+    updated->nodes.push_back(node);
+    publish_impl(std::move(updated));
+    LOG_INFO("Redis cluster node {} added to topology", address.toString());
+    return node;
+}
+
+/**
+ * @brief 从 CLUSTER SLOTS 重新加载槽位分配
+ * 回复格式: [[start, end, [host, port, id], replica...], ...]，只使用主节点
+ */
+bool RedisManager::refreshClusterSlots(bool force) {
+    if (!clusterMode_) {
+        return false;
+    }
+    
+    // 重新分片期间会收到大量 MOVED，限流避免每条命令都刷新拓扑
+    int64_t now = steadyNowMs();
+    int64_t last = lastClusterRefreshMs_.load();
+    if (!force) {
+        if (now - last < CLUSTER_REFRESH_INTERVAL_MS || !lastClusterRefreshMs_.compare_exchange_strong(last, now)) {
+            return false;
+        }
+    } else {
+        lastClusterRefreshMs_ = now;
+    }
+    
+    auto topology = this->topology();
+    if (!topology) {
+        return false;
+    }
+    
+    RedisValue slotsReply;
+    for (const auto& node : topology->nodes) {
+        redisContext* ctx = getConnection(*node);
+        if (!ctx) continue;
+        
+        redisReply* reply = (redisReply*)redisCommand(ctx, "CLUSTER SLOTS");
+        returnConnection(*node, ctx);
+        if (reply) {
+            slotsReply = toRedisValue(reply);
+            freeReplyObject(reply);
+        }
+        if (slotsReply.type == REDIS_REPLY_ARRAY && !slotsReply.elements.empty()) {
+            break;
+        }
+    }
+    
+    if (slotsReply.type != REDIS_REPLY_ARRAY || slotsReply.elements.empty()) {
+        LOG_WARN("Failed to load Redis cluster slots from any node");
         return false;
     }
     
-    // 检查第一个连接是否有效
-    redisContext* ctx = connectionPool_[0];
-    return isConnectionValid(ctx);
+    std::lock_guard<std::mutex> lock(mutex_);
+    topology = this->topology();
+    if (!topology) {
+        return false;
+    }
+    
+    auto updated = std::make_unique<RedisTopology>(*topology);
+    size_t assigned = 0;
+    for (const auto& range : slotsReply.elements) {
+        if (range.type != REDIS_REPLY_ARRAY || range.elements.size() < 3 ||
+            range.elements[0].type != REDIS_REPLY_INTEGER || range.elements[1].type != REDIS_REPLY_INTEGER) {
+            continue;
+        }
+        const RedisValue& master = range.elements[2];
+        if (master.type != REDIS_REPLY_ARRAY || master.elements.size() < 2 || master.elements[0].str.empty()) {
+            continue;
+        }
+        
+        RedisNodeAddress address{master.elements[0].str, (int)master.elements[1].integer};
+        size_t index = 0;
+        while (index < updated->nodes.size() && !(updated->nodes[index]->address() == address)) {
+            ++index;
+        }
+        if (index == updated->nodes.size()) {
+            updated->nodes.push_back(std::make_shared<RedisNode>(address, poolSize_));
+        }
+        
+        long long start = std::max<long long>(range.elements[0].integer, 0);
+        long long end = std::min<long long>(range.elements[1].integer, REDIS_SLOT_COUNT - 1);
+        for (long long slot = start; slot <= end; ++slot) {
+            updated->slots[slot] = (uint16_t)index;
+            ++assigned;
+        }
+    }
+    
+    LOG_INFO("Redis cluster topology refreshed: {} nodes, {} slots assigned", updated->nodes.size(), assigned);
+    publish_impl(std::move(updated));
+    return true;
 }
 
 /**
@@ -145,70 +610,178 @@ bool RedisManager::isConnectionValid(redisContext* ctx) const {
 }
 
 /**
- * @brief 从连接池获取连接
+ * @brief 获取节点的连接
+ * 优先使用当前线程在该节点上独占的连接（无锁、不发送PING），
+ * 只有空闲超过 IDLE_VALIDATE_MS 的连接才在使用前校验；
+ * 同一线程嵌套取用时从节点的无锁溢出池获取
+ * @param node 节点
  * @return Redis连接上下文指针
  */
-redisContext* RedisManager::getConnection() {
-    std::lock_guard<std::mutex> lock(poolMutex_);
-    
-    if (connectionPool_.empty()) {
-        // 如果连接池为空，创建新连接
-        redisContext* ctx = createConnection(host_, port_);
-        return ctx;
+redisContext* RedisManager::getConnection(RedisNode& node) {
+    if (!initialized_) {
+        return nullptr;
     }
     
-    // 从连接池取出一个连接
-    redisContext* ctx = connectionPool_.back();
-    connectionPool_.pop_back();
+    ThreadRedisConnections& locals = t_redisConnections;
+    uint64_t generation = generation_.load();
+    if (locals.generation != generation) {
+        // disconnect() 之后旧节点不会再被使用，释放其中未在使用的连接
+        for (auto it = locals.byNode.begin(); it != locals.byNode.end();) {
+            if (it->second.inUse) {
+                ++it;
+            } else {
+                it = locals.byNode.erase(it);
+            }
+        }
+        locals.generation = generation;
+    }
     
-    // 检查连接是否仍然有效
-    if (!isConnectionValid(ctx)) {
-        redisFree(ctx);
-        ctx = createConnection(host_, port_);
+    ThreadRedisConnection& local = locals.byNode[node.id()];
+    if (!local.inUse) {
+        if (local.ctx && local.generation != generation) {
+            redisFree(local.ctx);
+            local.ctx = nullptr;
+        }
+        
+        if (local.ctx && std::chrono::steady_clock::now() - local.lastUsed > std::chrono::milliseconds(IDLE_VALIDATE_MS)
+            && !isConnectionValid(local.ctx)) {
+            redisFree(local.ctx);
+            local.ctx = nullptr;
+        }
+        
+        if (!local.ctx) {
+            // 优先接管溢出池中的连接
+            if (!node.popIdle(local.ctx)) {
+                local.ctx = node.reconnect();
+            }
+            if (!local.ctx) {
+                return nullptr;
+            }
+            local.generation = generation;
+        }
+        
+        local.inUse = true;
+        return local.ctx;
     }
     
-    return ctx;
+    redisContext* ctx = nullptr;
+    if (node.popIdle(ctx)) {
+        return ctx;
+    }
+    return node.reconnect();
 }
 
 /**
- * @brief 将连接归还到连接池
+ * @brief 归还连接
+ * 出错的连接（ctx->err 非零）直接释放，下次取用时重连
+ * @param node 连接所属节点
  * @param ctx Redis连接上下文指针
  */
-void RedisManager::returnConnection(redisContext* ctx) {
+void RedisManager::returnConnection(RedisNode& node, redisContext* ctx) {
     if (!ctx) return;
     
-    std::lock_guard<std::mutex> lock(poolMutex_);
+    ThreadRedisConnections& locals = t_redisConnections;
+    auto it = locals.byNode.find(node.id());
+    if (it != locals.byNode.end() && it->second.ctx == ctx) {
+        ThreadRedisConnection& local = it->second;
+        local.inUse = false;
+        if (ctx->err) {
+            node.markUnhealthy();
+            redisFree(ctx);
+            local.ctx = nullptr;
+        } else {
+            local.lastUsed = std::chrono::steady_clock::now();
+        }
+        return;
+    }
     
-    // 如果连接池已满，释放连接
-    if (connectionPool_.size() >= (size_t)poolSize_) {
+    if (ctx->err) {
+        node.markUnhealthy();
         redisFree(ctx);
         return;
     }
     
-    connectionPool_.push_back(ctx);
+    // 已断开时释放连接，否则放回溢出池（池满时释放）
+    if (!initialized_) {
+        redisFree(ctx);
+        return;
+    }
+    node.pushIdle(ctx);
+}
+
+/**
+ * @brief 在键所在的节点上执行单条命令
+ * 连接在空闲期间被服务端关闭时，错误只会在发送命令时暴露，
+ * 此时换一个新连接重试一次；命令可能已经执行，所以只重试幂等命令。
+ * 集群模式下收到 MOVED/ASK 时转到目标节点重新执行
+ * @param key 路由键
+ * @param format hiredis 格式化字符串
+ * @return 回复对象，调用方负责释放；失败返回nullptr
+ */
+redisReply* RedisManager::command(const std::string& key, const char* format, ...) {
+    std::shared_ptr<RedisNode> node = nodeForKey(key);
+    bool retryable = isIdempotentCommand(format);
+    bool asking = false;
+    int attempt = 0;
+    int redirects = 0;
+    
+    while (node && attempt < 2) {
+        redisContext* ctx = getConnection(*node);
+        if (!ctx) return nullptr;
+        
+        if (asking) {
+            redisReply* askingReply = (redisReply*)redisCommand(ctx, "ASKING");
+            if (askingReply) freeReplyObject(askingReply);
+        }
+        
+        va_list ap;
+        va_start(ap, format);
+        redisReply* reply = (redisReply*)redisvCommand(ctx, format, ap);
+        va_end(ap);
+        
+        if (!reply) {
+            LOG_WARN("Redis command to {} failed ({}), attempt {}", node->address().toString(), ctx->errstr, attempt + 1);
+            returnConnection(*node, ctx);
+            if (!retryable) {
+                return nullptr;
+            }
+            ++attempt;
+            continue;
+        }
+        returnConnection(*node, ctx);
+        
+        bool moved = false;
+        RedisNodeAddress target;
+        if (clusterMode_ && reply->type == REDIS_REPLY_ERROR && redirects < MAX_REDIRECTS &&
+            parseRedisRedirect(std::string(reply->str, reply->len), moved, target)) {
+            freeReplyObject(reply);
+            if (moved) {
+                refreshClusterSlots(false);
+            }
+            node = nodeForAddress(target);
+            asking = !moved;
+            ++redirects;
+            continue;
+        }
+        return reply;
+    }
+    return nullptr;
 }
 
 // ==================== 字符串操作 ====================
 
 bool RedisManager::set(const std::string& key, const std::string& value) {
-    redisContext* ctx = getConnection();
-    if (!ctx) return false;
-    
-    redisReply* reply = (redisReply*)redisCommand(ctx, "SET %s %s", 
-                                                   key.c_str(), value.c_str());
+    redisReply* reply = command(key, "SET %s %s", 
+                                 key.c_str(), value.c_str());
     
     bool success = (reply != nullptr && reply->type == REDIS_REPLY_STATUS);
     
     if (reply) freeReplyObject(reply);
-    returnConnection(ctx);
     return success;
 }
 
 bool RedisManager::get(const std::string& key, std::string& value) {
-    redisContext* ctx = getConnection();
-    if (!ctx) return false;
-    
-    redisReply* reply = (redisReply*)redisCommand(ctx, "GET %s", key.c_str());
+    redisReply* reply = command(key, "GET %s", key.c_str());
     
     bool success = false;
     if (reply && reply->type == REDIS_REPLY_STRING) {
@@ -217,15 +790,11 @@ bool RedisManager::get(const std::string& key, std::string& value) {
     }
     
     if (reply) freeReplyObject(reply);
-    returnConnection(ctx);
     return success;
 }
 
 bool RedisManager::incr(const std::string& key, long long& result) {
-    redisContext* ctx = getConnection();
-    if (!ctx) return false;
-    
-    redisReply* reply = (redisReply*)redisCommand(ctx, "INCR %s", key.c_str());
+    redisReply* reply = command(key, "INCR %s", key.c_str());
     
     bool success = false;
     if (reply && reply->type == REDIS_REPLY_INTEGER) {
@@ -234,46 +803,34 @@ bool RedisManager::incr(const std::string& key, long long& result) {
     }
     
     if (reply) freeReplyObject(reply);
-    returnConnection(ctx);
     return success;
 }
 
 bool RedisManager::del(const std::string& key) {
-    redisContext* ctx = getConnection();
-    if (!ctx) return false;
-    
-    redisReply* reply = (redisReply*)redisCommand(ctx, "DEL %s", key.c_str());
+    redisReply* reply = command(key, "DEL %s", key.c_str());
     
     bool success = (reply != nullptr && reply->type == REDIS_REPLY_INTEGER);
     
     if (reply) freeReplyObject(reply);
-    returnConnection(ctx);
     return success;
 }
 
 // ==================== 哈希操作 ====================
 
 bool RedisManager::hset(const std::string& key, const std::string& field, const std::string& value) {
-    redisContext* ctx = getConnection();
-    if (!ctx) return false;
-    
-    redisReply* reply = (redisReply*)redisCommand(ctx, "HSET %s %s %s", 
-                                                   key.c_str(), field.c_str(), value.c_str());
+    redisReply* reply = command(key, "HSET %s %s %s", 
+                                 key.c_str(), field.c_str(), value.c_str());
     
     bool success = (reply != nullptr && 
                    (reply->type == REDIS_REPLY_INTEGER || reply->type == REDIS_REPLY_STATUS));
     
     if (reply) freeReplyObject(reply);
-    returnConnection(ctx);
     return success;
 }
 
 bool RedisManager::hget(const std::string& key, const std::string& field, std::string& value) {
-    redisContext* ctx = getConnection();
-    if (!ctx) return false;
-    
-    redisReply* reply = (redisReply*)redisCommand(ctx, "HGET %s %s", 
-                                                   key.c_str(), field.c_str());
+    redisReply* reply = command(key, "HGET %s %s", 
+                                 key.c_str(), field.c_str());
     
     bool success = false;
     if (reply && reply->type == REDIS_REPLY_STRING) {
@@ -282,29 +839,21 @@ bool RedisManager::hget(const std::string& key, const std::string& field, std::s
     }
     
     if (reply) freeReplyObject(reply);
-    returnConnection(ctx);
     return success;
 }
 
 bool RedisManager::hdel(const std::string& key, const std::string& field) {
-    redisContext* ctx = getConnection();
-    if (!ctx) return false;
-    
-    redisReply* reply = (redisReply*)redisCommand(ctx, "HDEL %s %s", 
-                                                   key.c_str(), field.c_str());
+    redisReply* reply = command(key, "HDEL %s %s", 
+                                 key.c_str(), field.c_str());
     
     bool success = (reply != nullptr && reply->type == REDIS_REPLY_INTEGER);
     
     if (reply) freeReplyObject(reply);
-    returnConnection(ctx);
     return success;
 }
 
 bool RedisManager::hgetall(const std::string& key, std::unordered_map<std::string, std::string>& result) {
-    redisContext* ctx = getConnection();
-    if (!ctx) return false;
-    
-    redisReply* reply = (redisReply*)redisCommand(ctx, "HGETALL %s", key.c_str());
+    redisReply* reply = command(key, "HGETALL %s", key.c_str());
     
     bool success = false;
     if (reply && reply->type == REDIS_REPLY_ARRAY && reply->elements % 2 == 0) {
@@ -321,32 +870,112 @@ bool RedisManager::hgetall(const std::string& key, std::unordered_map<std::strin
     }
     
     if (reply) freeReplyObject(reply);
-    returnConnection(ctx);
+    return success;
+}
+
+bool RedisManager::hset(const std::string& key, const std::vector<std::pair<std::string, std::string>>& fields) {
+    if (fields.empty()) return true;
+    
+    RedisPipeline pipeline;
+    std::vector<std::string> args{"HSET", key};
+    args.reserve(2 + fields.size() * 2);
+    for (const auto& field : fields) {
+        args.push_back(field.first);
+        args.push_back(field.second);
+    }
+    pipeline.add(std::move(args));
+    
+    std::vector<RedisValue> replies;
+    return execute(pipeline, replies) && replies[0].type == REDIS_REPLY_INTEGER;
+}
+
+bool RedisManager::hgetallMulti(const std::vector<std::string>& keys,
+                                std::vector<std::unordered_map<std::string, std::string>>& results) {
+    results.assign(keys.size(), {});
+    if (keys.empty()) return true;
+    
+    RedisPipeline pipeline;
+    for (const auto& key : keys) {
+        pipeline.add({"HGETALL", key});
+    }
+    
+    std::vector<RedisValue> replies;
+    if (!execute(pipeline, replies)) {
+        return false;
+    }
+    
+    for (size_t i = 0; i < keys.size(); ++i) {
+        const RedisValue& reply = replies[i];
+        if (reply.type != REDIS_REPLY_ARRAY || reply.elements.size() % 2 != 0) continue;
+        for (size_t j = 0; j < reply.elements.size(); j += 2) {
+            if (reply.elements[j].type == REDIS_REPLY_STRING &&
+                reply.elements[j+1].type == REDIS_REPLY_STRING) {
+                results[i].emplace(reply.elements[j].str, reply.elements[j+1].str);
+            }
+        }
+    }
+    return true;
+}
+
+bool RedisManager::hsetMulti(const std::vector<std::pair<std::string, std::vector<std::pair<std::string, std::string>>>>& entries) {
+    RedisPipeline pipeline;
+    for (const auto& entry : entries) {
+        if (entry.second.empty()) continue;
+        
+        // HSET key field value [field value ...]
+        std::vector<std::string> args{"HSET", entry.first};
+        args.reserve(2 + entry.second.size() * 2);
+        for (const auto& field : entry.second) {
+            args.push_back(field.first);
+            args.push_back(field.second);
+        }
+        pipeline.add(std::move(args));
+    }
+    if (pipeline.empty()) return true;
+    
+    std::vector<RedisValue> replies;
+    if (!execute(pipeline, replies)) {
+        return false;
+    }
+    
+    bool success = true;
+    for (const auto& reply : replies) {
+        success &= (reply.type == REDIS_REPLY_INTEGER);
+    }
     return success;
 }
 
 // ==================== 有序集合操作 ====================
 
 bool RedisManager::zadd(const std::string& key, double score, const std::string& member) {
-    redisContext* ctx = getConnection();
-    if (!ctx) return false;
-    
-    redisReply* reply = (redisReply*)redisCommand(ctx, "ZADD %s %f %s", 
-                                                   key.c_str(), score, member.c_str());
+    redisReply* reply = command(key, "ZADD %s %f %s", 
+                                 key.c_str(), score, member.c_str());
     
     bool success = (reply != nullptr && reply->type == REDIS_REPLY_INTEGER);
     
     if (reply) freeReplyObject(reply);
-    returnConnection(ctx);
     return success;
 }
 
-bool RedisManager::zrange(const std::string& key, int start, int stop, std::vector<std::string>& result) {
-    redisContext* ctx = getConnection();
-    if (!ctx) return false;
+bool RedisManager::zadd(const std::string& key, const std::vector<std::pair<double, std::string>>& members) {
+    if (members.empty()) return true;
     
-    redisReply* reply = (redisReply*)redisCommand(ctx, "ZRANGE %s %d %d", 
-                                                   key.c_str(), start, stop);
+    RedisPipeline pipeline;
+    std::vector<std::string> args{"ZADD", key};
+    args.reserve(2 + members.size() * 2);
+    for (const auto& member : members) {
+        args.push_back(formatScore(member.first));
+        args.push_back(member.second);
+    }
+    pipeline.add(std::move(args));
+    
+    std::vector<RedisValue> replies;
+    return execute(pipeline, replies) && replies[0].type == REDIS_REPLY_INTEGER;
+}
+
+bool RedisManager::zrange(const std::string& key, int start, int stop, std::vector<std::string>& result) {
+    redisReply* reply = command(key, "ZRANGE %s %d %d", 
+                                 key.c_str(), start, stop);
     
     bool success = false;
     if (reply && reply->type == REDIS_REPLY_ARRAY) {
@@ -360,23 +989,306 @@ bool RedisManager::zrange(const std::string& key, int start, int stop, std::vect
     }
     
     if (reply) freeReplyObject(reply);
-    returnConnection(ctx);
     return success;
 }
 
+// ==================== 流水线与脚本 ====================
+
+bool RedisManager::execute(const RedisPipeline& pipeline, std::vector<RedisValue>& replies) {
+    replies.clear();
+    if (pipeline.empty()) return true;
+    
+    auto topology = this->topology();
+    if (!topology) return false;
+    
+    // 每条命令按自己的键路由；没有键的命令（MULTI/EXEC 等）跟随第一条带键命令的节点
+    std::vector<std::shared_ptr<RedisNode>> targets(pipeline.size());
+    std::shared_ptr<RedisNode> anchor;
+    bool transactional = false;
+    for (size_t i = 0; i < pipeline.size(); ++i) {
+        const auto& args = pipeline.commands_[i];
+        if (const std::string* key = redisCommandKey(args)) {
+            targets[i] = topology->nodeForSlot(redisKeySlot(*key));
+            if (!anchor) anchor = targets[i];
+        } else if (!args.empty() && strcasecmp(args[0].c_str(), "MULTI") == 0) {
+            transactional = true;
+        }
+    }
+    if (!anchor) anchor = topology->nodes.front();
+    
+    for (auto& target : targets) {
+        if (!target) {
+            target = anchor;
+        } else if (transactional && target != anchor) {
+            LOG_ERROR("Redis transaction keys span multiple nodes, use a hash tag to keep them together");
+            return false;
+        }
+    }
+    
+    return dispatch(pipeline.commands_, targets, replies);
+}
+
+bool RedisManager::dispatch(const std::vector<std::vector<std::string>>& commands,
+                            const std::vector<std::shared_ptr<RedisNode>>& targets,
+                            std::vector<RedisValue>& replies, bool followRedirects) {
+    replies.assign(commands.size(), RedisValue());
+    if (commands.empty()) return true;
+    
+    // 按目标节点分组，组内保持命令顺序
+    struct Batch {
+        RedisNode* node = nullptr;
+        std::vector<size_t> indices;
+        redisContext* ctx = nullptr;
+        size_t received = 0;
+        bool ok = true;
+    };
+    std::vector<Batch> batches;
+    for (size_t i = 0; i < commands.size(); ++i) {
+        if (!targets[i]) return false;
+        auto it = std::find_if(batches.begin(), batches.end(),
+                               [&](const Batch& batch) { return batch.node == targets[i].get(); });
+        if (it == batches.end()) {
+            batches.emplace_back();
+            batches.back().node = targets[i].get();
+            it = batches.end() - 1;
+        }
+        it->indices.push_back(i);
+    }
+    
+    // 把一组命令写入输出缓冲区并立即刷出，不等待回复
+    std::vector<const char*> argv;
+    std::vector<size_t> argvlen;
+    auto send = [&](Batch& batch) {
+        batch.ctx = getConnection(*batch.node);
+        if (!batch.ctx) {
+            batch.ok = false;
+            return;
+        }
+        for (size_t index : batch.indices) {
+            argv.clear();
+            argvlen.clear();
+            for (const auto& arg : commands[index]) {
+                argv.push_back(arg.data());
+                argvlen.push_back(arg.size());
+            }
+            if (redisAppendCommandArgv(batch.ctx, (int)argv.size(), argv.data(), argvlen.data()) != REDIS_OK) {
+                LOG_ERROR("Failed to queue Redis command {}: {}",
+                          commands[index].empty() ? "" : commands[index][0], batch.ctx->errstr);
+                batch.ok = false;
+                return;
+            }
+        }
+        int done = 0;
+        while (!done) {
+            if (redisBufferWrite(batch.ctx, &done) != REDIS_OK) {
+                batch.ok = false;
+                return;
+            }
+        }
+    };
+    
+    auto receive = [&](Batch& batch) {
+        if (!batch.ok) return;
+        for (size_t index : batch.indices) {
+            redisReply* reply = nullptr;
+            if (redisGetReply(batch.ctx, (void**)&reply) != REDIS_OK) {
+                // ctx->err 已置位，归还时会被释放，不会带着未读回复回到池中
+                LOG_ERROR("Redis pipeline to {} failed after {}/{} replies: {}", batch.node->address().toString(),
+                          batch.received, batch.indices.size(), batch.ctx->errstr);
+                if (reply) freeReplyObject(reply);
+                batch.ok = false;
+                return;
+            }
+            replies[index] = toRedisValue(reply);
+            freeReplyObject(reply);
+            ++batch.received;
+        }
+    };
+    
+    // 先向所有节点写出命令，再依次读取回复：各节点并行处理，总耗时取决于最慢的节点而不是节点数
+    for (auto& batch : batches) {
+        send(batch);
+    }
+    for (auto& batch : batches) {
+        receive(batch);
+    }
+    for (auto& batch : batches) {
+        returnConnection(*batch.node, batch.ctx);
+    }
+    
+    bool success = true;
+    for (auto& batch : batches) {
+        if (batch.ok) continue;
+        
+        // 一个回复都没收到说明连接在空闲期间已失效，换新连接重试该节点的命令一次；
+        // 但命令可能已在服务端执行，组内只要有一条不可重发（PUBLISH、INCR、EVAL、MULTI 等）就不重试
+        bool resendable = std::all_of(batch.indices.begin(), batch.indices.end(),
+                                      [&](size_t index) { return isIdempotentCommand(commands[index]); });
+        if (batch.ctx && batch.received == 0 && resendable) {
+            batch.ok = true;
+            send(batch);
+            receive(batch);
+            returnConnection(*batch.node, batch.ctx);
+        }
+        success &= batch.ok;
+    }
+    
+    if (clusterMode_ && followRedirects) {
+        // 事务中的命令不能单独重发，只刷新拓扑，由调用方重试整个事务
+        bool transactional = std::any_of(commands.begin(), commands.end(), [](const std::vector<std::string>& args) {
+            return !args.empty() && strcasecmp(args[0].c_str(), "MULTI") == 0;
+        });
+        
+        bool moved = false;
+        RedisNodeAddress target;
+        for (size_t i = 0; i < replies.size(); ++i) {
+            if (!replies[i].isError() || !parseRedisRedirect(replies[i].str, moved, target)) continue;
+            if (transactional) {
+                refreshClusterSlots(false);
+                break;
+            }
+            success &= followRedirect(commands[i], replies[i]);
+        }
+    }
+    return success;
+}
+
+bool RedisManager::followRedirect(const std::vector<std::string>& args, RedisValue& reply) {
+    for (int redirect = 0; redirect < MAX_REDIRECTS; ++redirect) {
+        bool moved = false;
+        RedisNodeAddress target;
+        if (!reply.isError() || !parseRedisRedirect(reply.str, moved, target)) {
+            return true;
+        }
+        
+        // MOVED 表示槽位已迁移，刷新拓扑；ASK 只针对本次请求，需要先发 ASKING
+        if (moved) {
+            refreshClusterSlots(false);
+        }
+        std::shared_ptr<RedisNode> node = nodeForAddress(target);
+        if (!node) return false;
+        
+        std::vector<std::vector<std::string>> commands;
+        if (!moved) {
+            commands.push_back({"ASKING"});
+        }
+        commands.push_back(args);
+        
+        std::vector<RedisValue> replies;
+        if (!dispatch(commands, std::vector<std::shared_ptr<RedisNode>>(commands.size(), node), replies, false)) {
+            return false;
+        }
+        reply = std::move(replies.back());
+    }
+    
+    LOG_ERROR("Too many Redis cluster redirects for {}", args.empty() ? "" : args[0]);
+    return false;
+}
+
+bool RedisManager::loadScript(const std::string& name, const std::string& source) {
+    auto topology = this->topology();
+    if (!topology) return false;
+    
+    // 脚本缓存是每个节点独立的，向所有节点并行加载；SHA1 只取决于源码
+    const auto& nodes = topology->nodes;
+    std::vector<std::vector<std::string>> commands(nodes.size(), {"SCRIPT", "LOAD", source});
+    std::vector<RedisValue> replies;
+    bool loadedEverywhere = dispatch(commands, nodes, replies, false);
+    
+    std::string sha;
+    for (const auto& reply : replies) {
+        if (reply.type == REDIS_REPLY_STRING) {
+            sha = reply.str;
+        } else {
+            loadedEverywhere = false;
+        }
+    }
+    
+    if (sha.empty()) {
+        LOG_ERROR("Failed to load Redis script {}: {}", name,
+                  replies.empty() || replies[0].str.empty() ? std::string("connection error") : replies[0].str);
+        return false;
+    }
+    if (!loadedEverywhere) {
+        // 未加载的节点在第一次执行时收到 NOSCRIPT，回退到 EVAL
+        LOG_WARN("Redis script {} not loaded on every node", name);
+    }
+    
+    std::lock_guard<std::mutex> lock(scriptsMutex_);
+    scripts_[name] = {sha, source};
+    LOG_INFO("Loaded Redis script {} ({})", name, sha);
+    return true;
+}
+
+bool RedisManager::hasScript(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(scriptsMutex_);
+    return scripts_.count(name) > 0;
+}
+
+bool RedisManager::evalScript(const std::string& name, const std::vector<std::string>& keys,
+                              const std::vector<std::string>& args, RedisValue* result) {
+    std::string sha, source;
+    {
+        std::lock_guard<std::mutex> lock(scriptsMutex_);
+        auto it = scripts_.find(name);
+        if (it == scripts_.end()) {
+            LOG_ERROR("Redis script {} is not loaded", name);
+            return false;
+        }
+        sha = it->second.first;
+        source = it->second.second;
+    }
+    
+    // 脚本只能访问所在节点上的键
+    if (!sameShard(keys)) {
+        LOG_ERROR("Redis script {} keys span multiple nodes", name);
+        return false;
+    }
+    
+    auto buildCommand = [&](const std::string& command, const std::string& body) {
+        std::vector<std::string> argv{command, body, std::to_string(keys.size())};
+        argv.insert(argv.end(), keys.begin(), keys.end());
+        argv.insert(argv.end(), args.begin(), args.end());
+        return argv;
+    };
+    
+    RedisPipeline pipeline;
+    pipeline.add(buildCommand("EVALSHA", sha));
+    
+    std::vector<RedisValue> replies;
+    if (!execute(pipeline, replies)) {
+        return false;
+    }
+    
+    // 服务端重启或 SCRIPT FLUSH 后脚本缓存丢失，用 EVAL 执行一次即可重新缓存
+    if (replies[0].isError() && replies[0].str.compare(0, 8, "NOSCRIPT") == 0) {
+        pipeline.clear();
+        pipeline.add(buildCommand("EVAL", source));
+        if (!execute(pipeline, replies)) {
+            return false;
+        }
+    }
+    
+    if (replies[0].isError()) {
+        LOG_ERROR("Redis script {} failed: {}", name, replies[0].str);
+        return false;
+    }
+    
+    if (result) {
+        *result = std::move(replies[0]);
+    }
+    return true;
+}
+
 // ==================== 发布/订阅操作 ====================
 
 bool RedisManager::publish(const std::string& channel, const std::string& message) {
-    redisContext* ctx = getConnection();
-    if (!ctx) return false;
-    
-    redisReply* reply = (redisReply*)redisCommand(ctx, "PUBLISH %s %s", 
-                                                   channel.c_str(), message.c_str());
+    redisReply* reply = command(channel, "PUBLISH %s %s", 
+                                 channel.c_str(), message.c_str());
     
     bool success = (reply != nullptr && reply->type == REDIS_REPLY_INTEGER);
     
     if (reply) freeReplyObject(reply);
-    returnConnection(ctx);
     return success;
 }
 
@@ -384,7 +1296,16 @@ bool RedisManager::subscribe(const std::vector<std::string>& channels,
                              std::function<void(const std::string&, const std::string&)> messageCallback) {
     if (channels.empty()) return false;
     
-    redisContext* ctx = getConnection();
+    // 分片模式下发布按频道名路由，订阅必须连到同一个节点；集群模式下消息在节点间广播
+    if (!clusterMode_ && !sameShard(channels)) {
+        LOG_ERROR("Redis subscribe channels span multiple nodes");
+        return false;
+    }
+    std::shared_ptr<RedisNode> node = nodeForKey(channels[0]);
+    if (!node) return false;
+    
+    // 订阅会永久占用连接，使用独立连接而不是线程连接或溢出池
+    redisContext* ctx = node->createConnection();
     if (!ctx) return false;
     
     // 构建SUBSCRIBE命令
@@ -398,7 +1319,7 @@ bool RedisManager::subscribe(const std::vector<std::string>& channels,
     redisReply* reply;
     int status = redisAppendCommand(ctx, command.c_str());
     if (status != REDIS_OK) {
-        returnConnection(ctx);
+        redisFree(ctx);
         return false;
     }
     
@@ -407,7 +1328,7 @@ bool RedisManager::subscribe(const std::vector<std::string>& channels,
         status = redisGetReply(ctx, (void**)&reply);
         if (status != REDIS_OK) {
             if (reply) freeReplyObject(reply);
-            returnConnection(ctx);
+            redisFree(ctx);
             return false;
         }
         
@@ -432,6 +1353,6 @@ bool RedisManager::subscribe(const std::vector<std::string>& channels,
         freeReplyObject(reply);
     }
     
-    returnConnection(ctx);
+    redisFree(ctx);
     return true;
 }
\ No newline at end of file
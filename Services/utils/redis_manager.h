@@ -7,8 +7,71 @@
 #include <mutex>
 #include <vector>
 #include <unordered_map>
+#include <initializer_list>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include "bounded_mpmc_queue.h"
+#include "redis_topology.h"
 #include "logger.h"
 
+/**
+ * @brief Redis回复的值类型副本
+ * 与 hiredis 的 redisReply 不同，不需要手动释放，可以安全地跨越连接生命周期
+ */
+struct RedisValue {
+    int type = REDIS_REPLY_NIL;          // REDIS_REPLY_* 类型
+    long long integer = 0;               // INTEGER 回复
+    std::string str;                     // STRING/STATUS/ERROR 回复
+    std::vector<RedisValue> elements;    // ARRAY 回复
+    
+    bool isError() const { return type == REDIS_REPLY_ERROR; }
+    bool isNil() const { return type == REDIS_REPLY_NIL; }
+};
+
+/**
+ * @brief 把 hiredis 回复复制为 RedisValue
+ * @param reply hiredis 回复，可为空
+ * @return 回复的副本（reply 为空时为 NIL）
+ */
+RedisValue toRedisValue(const redisReply* reply);
+
+/**
+ * @brief Redis命令流水线
+ * 
+ * 先在本地排队多条命令，由 RedisManager::execute() 一次性写出，
+ * 再依次读取全部回复，整批命令只需要一次网络往返。
+ * 参数以二进制安全的方式发送，不经过格式化字符串。
+ */
+class RedisPipeline {
+public:
+    /**
+     * @brief 追加一条命令
+     * @param args 命令及参数，例如 {"HSET", key, field, value}
+     * @return 自身引用，便于链式调用
+     */
+    RedisPipeline& add(std::initializer_list<std::string> args) {
+        commands_.emplace_back(args);
+        return *this;
+    }
+    
+    RedisPipeline& add(std::vector<std::string> args) {
+        commands_.push_back(std::move(args));
+        return *this;
+    }
+    
+    size_t size() const { return commands_.size(); }
+    bool empty() const { return commands_.empty(); }
+    void clear() { commands_.clear(); }
+
+private:
+    friend class RedisManager;
+    std::vector<std::vector<std::string>> commands_;
+};
+
+class RedisNode;
+struct RedisTopology;
+
 /**
  * @brief Redis管理器类（单例模式）
  * 
@@ -18,11 +81,14 @@
  * 主要特性：
  * 1. 单例模式确保全局唯一实例
  * 2. 线程安全的操作（使用互斥锁保护）
- * 3. 连接池管理
- * 4. 发布/订阅功能
- * 5. 哈希操作（HSET/HGET/HDEL等）
- * 6. 字符串操作（SET/GET/INCR等）
- * 7. 有序集合操作（ZADD/ZRANGE等）
+ * 3. 线程独占连接 + 无锁溢出连接池，按需校验与退避重连
+ * 4. 多节点分片：按槽位路由键（支持 hash tag），跨节点批量操作并行执行，
+ *    可选 Redis Cluster 模式（CLUSTER SLOTS 拓扑，跟随 MOVED/ASK 重定向）
+ * 5. 发布/订阅功能
+ * 6. 哈希操作（HSET/HGET/HDEL等）
+ * 7. 字符串操作（SET/GET/INCR等）
+ * 8. 有序集合操作（ZADD/ZRANGE等）
+ * 9. 命令流水线与 Lua 脚本（EVALSHA）
  */
 class RedisManager {
 public:
@@ -41,6 +107,16 @@ public:
      */
     bool initialize(const std::string& host, int port, int poolSize = 10);
     
+    /**
+     * @brief 初始化多节点Redis连接
+     * 分片模式下槽位按一致性哈希分配到各节点；集群模式下从 CLUSTER SLOTS 读取拓扑
+     * @param nodes 节点列表（集群模式下为种子节点）
+     * @param poolSize 每个节点的溢出连接池大小
+     * @param clusterMode 是否按 Redis Cluster 协议路由
+     * @return 至少一个节点可用返回true，否则返回false
+     */
+    bool initialize(const std::vector<RedisNodeAddress>& nodes, int poolSize = 10, bool clusterMode = false);
+    
     /**
      * @brief 断开所有Redis连接
      */
@@ -58,6 +134,27 @@ public:
      */
     std::mutex& mutex() const { return mutex_; }
     
+    /**
+     * @brief 查询键所在的节点
+     * @param key 键
+     * @param address 输出参数，节点地址
+     * @return 未初始化时返回false
+     */
+    bool nodeAddressForKey(const std::string& key, RedisNodeAddress& address) const;
+    
+    /**
+     * @brief 获取当前持有槽位的所有节点
+     * @return 节点地址列表，未初始化时为空
+     */
+    std::vector<RedisNodeAddress> nodeAddresses() const;
+    
+    /**
+     * @brief 检查多个键是否位于同一节点（多键脚本和事务要求如此）
+     * @param keys 键列表
+     * @return 全部位于同一节点返回true
+     */
+    bool sameShard(const std::vector<std::string>& keys) const;
+    
     // ==================== 字符串操作 ====================
     /**
      * @brief 设置字符串键值
@@ -100,6 +197,14 @@ public:
      */
     bool hset(const std::string& key, const std::string& field, const std::string& value);
     
+    /**
+     * @brief 一次设置哈希的多个字段（HSET key f1 v1 f2 v2 ...）
+     * @param key 哈希键
+     * @param fields 字段值列表
+     * @return 操作成功返回true，否则返回false
+     */
+    bool hset(const std::string& key, const std::vector<std::pair<std::string, std::string>>& fields);
+    
     /**
      * @brief 获取哈希字段值
      * @param key 哈希键
@@ -125,6 +230,22 @@ public:
      */
     bool hgetall(const std::string& key, std::unordered_map<std::string, std::string>& result);
     
+    /**
+     * @brief 批量获取多个哈希的所有字段（流水线，一次往返）
+     * @param keys 哈希键列表
+     * @param results 输出参数，与keys一一对应，键不存在时为空映射
+     * @return 操作成功返回true，否则返回false
+     */
+    bool hgetallMulti(const std::vector<std::string>& keys,
+                      std::vector<std::unordered_map<std::string, std::string>>& results);
+    
+    /**
+     * @brief 批量写入多个哈希的多个字段（流水线，一次往返）
+     * @param entries 哈希键及其字段值列表
+     * @return 全部写入成功返回true，否则返回false
+     */
+    bool hsetMulti(const std::vector<std::pair<std::string, std::vector<std::pair<std::string, std::string>>>>& entries);
+    
     // ==================== 有序集合操作 ====================
     /**
      * @brief 向有序集合添加成员
@@ -135,6 +256,14 @@ public:
      */
     bool zadd(const std::string& key, double score, const std::string& member);
     
+    /**
+     * @brief 一次向有序集合添加多个成员（ZADD key s1 m1 s2 m2 ...）
+     * @param key 有序集键
+     * @param members 分数和成员列表
+     * @return 操作成功返回true，否则返回false
+     */
+    bool zadd(const std::string& key, const std::vector<std::pair<double, std::string>>& members);
+    
     /**
      * @brief 获取有序集合指定范围的成员
      * @param key 有序集键
@@ -145,6 +274,44 @@ public:
      */
     bool zrange(const std::string& key, int start, int stop, std::vector<std::string>& result);
     
+    // ==================== 流水线与脚本 ====================
+    /**
+     * @brief 执行流水线中的全部命令
+     * 每条命令按自己的键路由，发往不同节点的命令并行执行；
+     * 包含 MULTI 的流水线要求所有键位于同一节点
+     * @param pipeline 已排队的命令
+     * @param replies 输出参数，与命令一一对应的回复（单条命令出错时为 ERROR 类型）
+     * @return 所有命令均已发送且读到回复返回true，网络错误返回false
+     */
+    bool execute(const RedisPipeline& pipeline, std::vector<RedisValue>& replies);
+    
+    /**
+     * @brief 在所有节点上预加载 Lua 脚本（SCRIPT LOAD），之后通过名称以 EVALSHA 调用
+     * @param name 脚本名称
+     * @param source 脚本源码
+     * @return 加载成功返回true，否则返回false
+     */
+    bool loadScript(const std::string& name, const std::string& source);
+    
+    /**
+     * @brief 检查脚本是否已注册
+     * @param name 脚本名称
+     * @return 已注册返回true
+     */
+    bool hasScript(const std::string& name) const;
+    
+    /**
+     * @brief 通过 EVALSHA 执行已加载的脚本
+     * 服务端脚本缓存被清空（NOSCRIPT）时自动回退到 EVAL 并重新缓存
+     * @param name 脚本名称
+     * @param keys 脚本的 KEYS，必须位于同一节点
+     * @param args 脚本的 ARGV
+     * @param result 输出参数，可为空
+     * @return 执行成功返回true，否则返回false
+     */
+    bool evalScript(const std::string& name, const std::vector<std::string>& keys,
+                    const std::vector<std::string>& args, RedisValue* result = nullptr);
+    
     // ==================== 发布/订阅操作 ====================
     /**
      * @brief 发布消息到频道
@@ -156,6 +323,7 @@ public:
     
     /**
      * @brief 订阅频道（需要在单独线程中调用）
+     * 分片模式下频道按名称路由，同一次订阅的频道必须位于同一节点
      * @param channels 频道列表
      * @param messageCallback 消息回调函数
      * @return 操作成功返回true，否则返回false
@@ -175,24 +343,82 @@ private:
     ~RedisManager();
     
     /**
-     * @brief 创建Redis连接
-     * @param host Redis服务器主机地址
-     * @param port Redis服务器端口
-     * @return Redis连接上下文指针
+     * @brief 获取当前拓扑快照（无锁）
+     * 持有返回值期间快照不会被释放
+     * @return 拓扑，未初始化时为空
+     */
+    std::shared_ptr<const RedisTopology> topology() const;
+    
+    /**
+     * @brief 发布新的拓扑快照，被替换的快照在最后一个引用释放时回收（调用者持有mutex_）
+     * @param topology 新拓扑，可以为空
      */
-    redisContext* createConnection(const std::string& host, int port);
+    void publish_impl(std::unique_ptr<const RedisTopology> topology);
     
     /**
-     * @brief 从连接池获取连接
+     * @brief 查找键所在的节点
+     * @param key 键
+     * @return 节点，未初始化时为空
+     */
+    std::shared_ptr<RedisNode> nodeForKey(const std::string& key) const;
+    
+    /**
+     * @brief 按地址查找节点，集群重定向到未知节点时加入拓扑
+     * @param address 节点地址
+     * @return 节点，未初始化时为空
+     */
+    std::shared_ptr<RedisNode> nodeForAddress(const RedisNodeAddress& address);
+    
+    /**
+     * @brief 从 CLUSTER SLOTS 重新加载槽位分配（集群模式）
+     * @param force 为false时按 CLUSTER_REFRESH_INTERVAL_MS 限流
+     * @return 拓扑已更新返回true
+     */
+    bool refreshClusterSlots(bool force);
+    
+    /**
+     * @brief 获取节点的连接（优先使用当前线程独占的连接）
+     * @param node 节点
      * @return Redis连接上下文指针
      */
-    redisContext* getConnection();
+    redisContext* getConnection(RedisNode& node);
     
     /**
-     * @brief 将连接归还到连接池
+     * @brief 归还连接，出错的连接会被释放
+     * @param node 连接所属节点
      * @param ctx Redis连接上下文指针
      */
-    void returnConnection(redisContext* ctx);
+    void returnConnection(RedisNode& node, redisContext* ctx);
+    
+    /**
+     * @brief 在键所在的节点上执行单条命令，连接失效时重连并重试一次（只重试幂等命令），
+     * 集群模式下跟随 MOVED/ASK 重定向
+     * @param key 路由键
+     * @param format hiredis 格式化字符串
+     * @return 回复对象，调用方负责释放；失败返回nullptr
+     */
+    redisReply* command(const std::string& key, const char* format, ...);
+    
+    /**
+     * @brief 把命令分发到各自的节点执行
+     * 先向所有节点写出命令再依次读取回复，各节点并行处理
+     * @param commands 命令列表
+     * @param targets 与命令一一对应的目标节点
+     * @param replies 输出参数，与命令一一对应的回复
+     * @param followRedirects 集群模式下是否跟随 MOVED/ASK
+     * @return 所有命令都读到回复返回true
+     */
+    bool dispatch(const std::vector<std::vector<std::string>>& commands,
+                  const std::vector<std::shared_ptr<RedisNode>>& targets,
+                  std::vector<RedisValue>& replies, bool followRedirects = true);
+    
+    /**
+     * @brief 跟随集群重定向重新执行命令（集群模式）
+     * @param args 命令及参数
+     * @param reply 输入为 MOVED/ASK 错误回复，输出为最终回复
+     * @return 执行成功（含 Redis 错误回复）返回true，网络错误返回false
+     */
+    bool followRedirect(const std::vector<std::string>& args, RedisValue& reply);
     
     /**
      * @brief 检查连接是否有效
@@ -201,14 +427,29 @@ private:
      */
     bool isConnectionValid(redisContext* ctx) const;
     
-    // 连接池相关
-    std::vector<redisContext*> connectionPool_;
-    mutable std::mutex poolMutex_;
-    std::string host_;
-    int port_;
+    // 拓扑快照（节点列表 + 槽位表），变更时在 mutex_ 下整体替换，只通过 std::atomic_load / std::atomic_store 访问
+    std::shared_ptr<const RedisTopology> topology_;
+    // 每发布一次拓扑加一，读者据此判断线程缓存的快照是否过期
+    std::atomic<uint64_t> topologyVersion_;
     int poolSize_;
-    bool initialized_;
+    bool clusterMode_;
+    std::atomic<bool> initialized_;
+    std::atomic<uint64_t> generation_;           // 每次 disconnect() 递增，使线程连接失效
+    std::atomic<int64_t> lastClusterRefreshMs_;
     mutable std::mutex mutex_;
+    
+    // 线程连接空闲超过该时长后，使用前先PING校验
+    static constexpr int IDLE_VALIDATE_MS = 30000;
+    
+    // 集群模式下两次拓扑刷新的最小间隔
+    static const int64_t CLUSTER_REFRESH_INTERVAL_MS = 1000;
+    
+    // 单条命令最多跟随的重定向次数
+    static const int MAX_REDIRECTS = 5;
+    
+    // 已加载的脚本：名称 -> (SHA1, 源码)
+    std::unordered_map<std::string, std::pair<std::string, std::string>> scripts_;
+    mutable std::mutex scriptsMutex_;
 };
 
 #endif // REDIS_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "redis_topology.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdlib>
+#include <strings.h>
+
+namespace {
+
+/**
+ * @brief CRC16-CCITT (XMODEM) 查找表，Redis Cluster 使用的键哈希
+ */
+std::array<uint16_t, 256> makeCrc16Table() {
+    std::array<uint16_t, 256> table{};
+    for (int i = 0; i < 256; ++i) {
+        uint16_t crc = (uint16_t)(i << 8);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+const std::array<uint16_t, 256> CRC16_TABLE = makeCrc16Table();
+
+uint16_t crc16(const char* data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; ++i) {
+        crc = (uint16_t)((crc << 8) ^ CRC16_TABLE[((crc >> 8) ^ (uint8_t)data[i]) & 0xff]);
+    }
+    return crc;
+}
+
+/**
+ * @brief 64位哈希（FNV-1a 加 splitmix64 收尾），用于哈希环上的位置
+ */
+uint64_t ringHash(const std::string& value) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : value) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+} // namespace
+
+uint16_t redisKeySlot(const std::string& key) {
+    // 只有第一个 '{' 之后存在 '}' 且两者之间非空时才使用 hash tag
+    size_t open = key.find('{');
+    if (open != std::string::npos) {
+        size_t close = key.find('}', open + 1);
+        if (close != std::string::npos && close > open + 1) {
+            return crc16(key.data() + open + 1, close - open - 1) % REDIS_SLOT_COUNT;
+        }
+    }
+    return crc16(key.data(), key.size()) % REDIS_SLOT_COUNT;
+}
+
+std::vector<uint16_t> buildConsistentHashSlots(const std::vector<RedisNodeAddress>& nodes, int virtualNodes) {
+    std::vector<uint16_t> slots(REDIS_SLOT_COUNT, 0);
+    if (nodes.size() <= 1) {
+        return slots;
+    }
+
+    // 虚拟节点位置只取决于节点地址，与节点在列表中的顺序无关
+    std::vector<std::pair<uint64_t, uint16_t>> ring;
+    ring.reserve(nodes.size() * virtualNodes);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        std::string name = nodes[i].toString();
+        for (int v = 0; v < virtualNodes; ++v) {
+            ring.emplace_back(ringHash(name + "#" + std::to_string(v)), (uint16_t)i);
+        }
+    }
+    std::sort(ring.begin(), ring.end());
+
+    for (int slot = 0; slot < REDIS_SLOT_COUNT; ++slot) {
+        uint64_t point = ringHash("slot:" + std::to_string(slot));
+        auto it = std::lower_bound(ring.begin(), ring.end(), std::make_pair(point, (uint16_t)0));
+        if (it == ring.end()) {
+            it = ring.begin();
+        }
+        slots[slot] = it->second;
+    }
+    return slots;
+}
+
+std::vector<RedisNodeAddress> parseRedisNodes(const std::string& spec) {
+    std::vector<RedisNodeAddress> nodes;
+    size_t start = 0;
+    while (start <= spec.size()) {
+        size_t end = spec.find(',', start);
+        if (end == std::string::npos) {
+            end = spec.size();
+        }
+
+        std::string entry = spec.substr(start, end - start);
+        entry.erase(std::remove_if(entry.begin(), entry.end(), [](unsigned char c) { return std::isspace(c); }),
+                    entry.end());
+        if (!entry.empty()) {
+            RedisNodeAddress address;
+            size_t colon = entry.rfind(':');
+            if (colon == std::string::npos) {
+                address.host = entry;
+            } else {
+                address.host = entry.substr(0, colon);
+                address.port = std::atoi(entry.c_str() + colon + 1);
+            }
+            if (!address.host.empty() && address.port > 0) {
+                nodes.push_back(address);
+            }
+        }
+        start = end + 1;
+    }
+    return nodes;
+}
+
+const std::string* redisCommandKey(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        return nullptr;
+    }
+
+    const std::string& name = args[0];
+    if (strcasecmp(name.c_str(), "EVAL") == 0 || strcasecmp(name.c_str(), "EVALSHA") == 0) {
+        // EVAL script numkeys key [key ...] arg [arg ...]
+        if (args.size() >= 4 && std::atoi(args[2].c_str()) > 0) {
+            return &args[3];
+        }
+        return nullptr;
+    }
+
+    static const char* const KEYLESS_COMMANDS[] = {
+        "MULTI", "EXEC", "DISCARD", "PING", "SCRIPT", "ASKING", "CLUSTER", "INFO", "AUTH", "SELECT"
+    };
+    for (const char* keyless : KEYLESS_COMMANDS) {
+        if (strcasecmp(name.c_str(), keyless) == 0) {
+            return nullptr;
+        }
+    }
+    return &args[1];
+}
+
+bool parseRedisRedirect(const std::string& error, bool& moved, RedisNodeAddress& address) {
+    if (error.compare(0, 6, "MOVED ") == 0) {
+        moved = true;
+    } else if (error.compare(0, 4, "ASK ") == 0) {
+        moved = false;
+    } else {
+        return false;
+    }
+
+    size_t space = error.rfind(' ');
+    size_t colon = error.rfind(':');
+    if (space == std::string::npos || colon == std::string::npos || colon < space) {
+        return false;
+    }
+    address.host = error.substr(space + 1, colon - space - 1);
+    address.port = std::atoi(error.c_str() + colon + 1);
+    return !address.host.empty() && address.port > 0;
+}
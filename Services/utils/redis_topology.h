@@ -0,0 +1,67 @@
+#ifndef REDIS_TOPOLOGY_H
+#define REDIS_TOPOLOGY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Redis节点地址
+ */
+struct RedisNodeAddress {
+    std::string host;
+    int port = 6379;
+
+    std::string toString() const { return host + ":" + std::to_string(port); }
+    bool operator==(const RedisNodeAddress& other) const { return host == other.host && port == other.port; }
+};
+
+// 与 Redis Cluster 相同的槽位数，分片模式和集群模式共用同一套槽位计算
+const int REDIS_SLOT_COUNT = 16384;
+
+/**
+ * @brief 计算键所在的槽位（CRC16 % 16384，与 Redis Cluster 一致）
+ * 键中包含非空的 {hash tag} 时只对花括号内的部分计算，
+ * 例如 user:{42}:status 和 user:{42}:friends 总是落在同一个槽位
+ * @param key 键
+ * @return 槽位号
+ */
+uint16_t redisKeySlot(const std::string& key);
+
+/**
+ * @brief 用一致性哈希把全部槽位分配到各节点
+ * 每个节点在哈希环上放置 virtualNodes 个虚拟节点，槽位归属环上顺时针方向的第一个虚拟节点。
+ * 增删一个节点只会迁移约 1/N 的槽位
+ * @param nodes 节点列表
+ * @param virtualNodes 每个节点的虚拟节点数
+ * @return 槽位 -> 节点下标
+ */
+std::vector<uint16_t> buildConsistentHashSlots(const std::vector<RedisNodeAddress>& nodes, int virtualNodes = 160);
+
+/**
+ * @brief 解析节点列表，例如 "10.0.0.1:6379,10.0.0.2:6379"
+ * 省略端口时使用 6379
+ * @param spec 逗号分隔的 host:port 列表
+ * @return 节点列表，格式错误的条目被忽略
+ */
+std::vector<RedisNodeAddress> parseRedisNodes(const std::string& spec);
+
+/**
+ * @brief 取出命令的路由键
+ * 大多数命令的第一个参数就是键；EVAL/EVALSHA 取第一个 KEYS；
+ * MULTI/EXEC/PING/SCRIPT 等没有键的命令返回空指针
+ * @param args 命令及参数
+ * @return 路由键，没有键时返回nullptr
+ */
+const std::string* redisCommandKey(const std::vector<std::string>& args);
+
+/**
+ * @brief 解析集群重定向错误，例如 "MOVED 3999 10.0.0.2:6379" 或 "ASK 3999 10.0.0.2:6379"
+ * @param error 错误回复内容
+ * @param moved 输出参数，MOVED 为true，ASK 为false
+ * @param address 输出参数，目标节点
+ * @return 是重定向错误返回true
+ */
+bool parseRedisRedirect(const std::string& error, bool& moved, RedisNodeAddress& address);
+
+#endif // REDIS_TOPOLOGY_H
@@ -0,0 +1,219 @@
+#include "user_profile_cache.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mysql/mysql.h>
+#include "database_manager.h"
+#include "logger.h"
+
+/**
+ * @brief 获取UserProfileCache单例实例
+ * 使用局部静态变量实现线程安全的单例模式
+ * @return UserProfileCache实例的引用
+ */
+UserProfileCache& UserProfileCache::getInstance() {
+    static UserProfileCache instance;
+    return instance;
+}
+
+UserProfileCache::UserProfileCache() : chunkUsed_(0), arenaBytes_(0), liveBytes_(0), hits_(0), misses_(0) {
+}
+
+bool UserProfileCache::getUsernames(const std::vector<int32_t>& ids, std::unordered_map<int32_t, std::string>& names,
+                                    bool loadMissing) {
+    std::vector<int32_t> missing;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto now = std::chrono::steady_clock::now();
+        for (int32_t id : ids) {
+            auto it = entries_.find(id);
+            if (it != entries_.end() && it->second.expiresAt > now) {
+                names.emplace(id, std::string(it->second.username));
+            } else {
+                missing.push_back(id);
+            }
+        }
+    }
+
+    hits_ += ids.size() - missing.size();
+    misses_ += missing.size();
+    if (missing.empty() || !loadMissing) {
+        return true;
+    }
+
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+    std::vector<std::pair<int32_t, std::string>> rows;
+    bool ok = loadFromDB(missing, rows);
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (auto& row : rows) {
+        put_impl(row.first, row.second);
+        names[row.first] = std::move(row.second);
+    }
+    return ok;
+}
+
+void UserProfileCache::put(int32_t userId, const std::string& username) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    put_impl(userId, username);
+}
+
+void UserProfileCache::invalidate(int32_t userId) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = entries_.find(userId);
+    if (it == entries_.end()) {
+        return;
+    }
+    liveBytes_ -= it->second.username.size();
+    entries_.erase(it);
+    compact_impl();
+}
+
+void UserProfileCache::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    reset_impl();
+}
+
+UserProfileCache::Stats UserProfileCache::stats() const {
+    Stats s;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    s.entries = entries_.size();
+    s.arenaBytes = arenaBytes_;
+    s.liveBytes = liveBytes_;
+    s.hits = hits_;
+    s.misses = misses_;
+    return s;
+}
+
+/**
+ * @brief 分批从数据库加载用户名
+ */
+bool UserProfileCache::loadFromDB(const std::vector<int32_t>& ids,
+                                  std::vector<std::pair<int32_t, std::string>>& rows) {
+    DatabaseManager& db = DatabaseManager::getInstance();
+    DatabaseManager::ReadConnection read = db.acquireReadConnection();
+    MYSQL* connection = static_cast<MYSQL*>(read.get());
+    if (!connection) {
+        return false;
+    }
+
+    for (size_t start = 0; start < ids.size(); start += MAX_BATCH_SIZE) {
+        size_t end = std::min(ids.size(), start + MAX_BATCH_SIZE);
+        std::string query = "SELECT id, username FROM users WHERE id IN (";
+        for (size_t i = start; i < end; ++i) {
+            if (i > start) query += ",";
+            query += std::to_string(ids[i]);
+        }
+        query += ")";
+
+        if (mysql_query(connection, query.c_str())) {
+            LOG_ERROR("MySQL query error: {}", mysql_error(connection));
+            return false;
+        }
+
+        MYSQL_RES* result = mysql_store_result(connection);
+        if (!result) {
+            return false;
+        }
+
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(result))) {
+            if (row[0] && row[1]) {
+                rows.emplace_back(static_cast<int32_t>(std::strtol(row[0], nullptr, 10)), row[1]);
+            }
+        }
+        mysql_free_result(result);
+    }
+    return true;
+}
+
+/**
+ * @brief 写入一个用户名（调用者需持有写锁）
+ * 用户名未变化时只续期，不占用新的池空间
+ */
+void UserProfileCache::put_impl(int32_t userId, const std::string& username) {
+    auto expiresAt = std::chrono::steady_clock::now() + std::chrono::seconds(ENTRY_TTL_SECONDS);
+
+    auto it = entries_.find(userId);
+    if (it != entries_.end()) {
+        if (it->second.username == username) {
+            it->second.expiresAt = expiresAt;
+            return;
+        }
+        liveBytes_ -= it->second.username.size();
+        entries_.erase(it);
+    } else if (entries_.size() >= MAX_ENTRIES) {
+        LOG_INFO("User profile cache reached {} entries, resetting", MAX_ENTRIES);
+        reset_impl();
+    }
+
+    Entry entry;
+    entry.username = store_impl(username);
+    entry.expiresAt = expiresAt;
+    entries_.emplace(userId, entry);
+    liveBytes_ += username.size();
+    compact_impl();
+}
+
+/**
+ * @brief 把字符串拷贝进字符串池（调用者需持有写锁）
+ * 超过块大小的字符串单独分配一块
+ */
+std::string_view UserProfileCache::store_impl(std::string_view value) {
+    if (value.empty()) {
+        return std::string_view();
+    }
+
+    if (value.size() > CHUNK_SIZE) {
+        // 单独的一块视为已满，下一个字符串从新块开始
+        chunks_.emplace_back(new char[value.size()]);
+        chunkUsed_ = CHUNK_SIZE;
+        arenaBytes_ += value.size();
+        std::memcpy(chunks_.back().get(), value.data(), value.size());
+        return std::string_view(chunks_.back().get(), value.size());
+    }
+
+    if (chunks_.empty() || chunkUsed_ + value.size() > CHUNK_SIZE) {
+        chunks_.emplace_back(new char[CHUNK_SIZE]);
+        chunkUsed_ = 0;
+        arenaBytes_ += CHUNK_SIZE;
+    }
+
+    char* dest = chunks_.back().get() + chunkUsed_;
+    std::memcpy(dest, value.data(), value.size());
+    chunkUsed_ += value.size();
+    return std::string_view(dest, value.size());
+}
+
+/**
+ * @brief 失效留下的空洞超过一半时，把仍被引用的字符串搬到新池（调用者需持有写锁）
+ * 读者只在持有读锁期间访问 string_view，搬迁期间不会有读者
+ */
+void UserProfileCache::compact_impl() {
+    if (arenaBytes_ < 4 * CHUNK_SIZE || liveBytes_ * 2 >= arenaBytes_) {
+        return;
+    }
+
+    size_t before = arenaBytes_;
+    std::vector<std::unique_ptr<char[]>> old;
+    old.swap(chunks_);
+    chunkUsed_ = 0;
+    arenaBytes_ = 0;
+    for (auto& entry : entries_) {
+        entry.second.username = store_impl(entry.second.username);
+    }
+    LOG_DEBUG("User profile cache compacted from {} to {} bytes", before, arenaBytes_);
+}
+
+/**
+ * @brief 清空条目并释放字符串池（调用者需持有写锁）
+ */
+void UserProfileCache::reset_impl() {
+    entries_.clear();
+    chunks_.clear();
+    chunkUsed_ = 0;
+    arenaBytes_ = 0;
+    liveBytes_ = 0;
+}
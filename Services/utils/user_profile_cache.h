@@ -0,0 +1,110 @@
+#ifndef USER_PROFILE_CACHE_H
+#define USER_PROFILE_CACHE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 用户资料（用户名）缓存（单例模式）
+ *
+ * 好友列表需要为每个好友填充用户名，逐个查询的代价太高：
+ * 1. 读穿透：未命中的ID合并成 SELECT id, username FROM users WHERE id IN (...) 分批加载
+ * 2. 用户名紧凑存放在按块分配的字符串池中，索引只保存指向池内的 string_view，
+ *    避免每个用户名一次堆分配；失效留下的空洞超过一半时整体搬迁压缩
+ * 3. 资料变更时调用 invalidate()；条目另有过期时间，绕过服务直接改库的变更最终也会生效
+ */
+class UserProfileCache {
+public:
+    /**
+     * @brief 缓存统计
+     */
+    struct Stats {
+        size_t entries = 0;
+        size_t arenaBytes = 0;    // 字符串池已分配的字节数
+        size_t liveBytes = 0;     // 其中仍被引用的字节数
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    /**
+     * @brief 获取UserProfileCache单例实例
+     * @return UserProfileCache实例的引用
+     */
+    static UserProfileCache& getInstance();
+
+    UserProfileCache(const UserProfileCache&) = delete;
+    UserProfileCache& operator=(const UserProfileCache&) = delete;
+
+    /**
+     * @brief 批量解析用户名
+     * @param ids 用户ID列表
+     * @param names 输出参数，找到的用户ID -> 用户名（不存在的用户不出现）
+     * @param loadMissing 是否从数据库加载未命中的用户
+     * @return 数据库加载失败返回false（已命中的结果仍然有效）
+     */
+    bool getUsernames(const std::vector<int32_t>& ids, std::unordered_map<int32_t, std::string>& names,
+                      bool loadMissing = true);
+
+    /**
+     * @brief 写入其他查询顺带取到的用户名
+     * @param userId 用户ID
+     * @param username 用户名
+     */
+    void put(int32_t userId, const std::string& username);
+
+    /**
+     * @brief 用户资料变更后失效
+     * @param userId 用户ID
+     */
+    void invalidate(int32_t userId);
+
+    /**
+     * @brief 清空缓存
+     */
+    void clear();
+
+    /**
+     * @brief 获取统计数据
+     */
+    Stats stats() const;
+
+private:
+    UserProfileCache();
+    ~UserProfileCache() = default;
+
+    struct Entry {
+        std::string_view username;                      // 指向 chunks_ 中的字符
+        std::chrono::steady_clock::time_point expiresAt;
+    };
+
+    bool loadFromDB(const std::vector<int32_t>& ids, std::vector<std::pair<int32_t, std::string>>& rows);
+    void put_impl(int32_t userId, const std::string& username);
+    std::string_view store_impl(std::string_view value);
+    void compact_impl();
+    void reset_impl();
+
+    static const size_t CHUNK_SIZE = 64 * 1024;
+    static constexpr size_t MAX_ENTRIES = 1000000;
+    static const size_t MAX_BATCH_SIZE = 500;         // 单条 IN 查询的最大ID数
+    static constexpr int ENTRY_TTL_SECONDS = 600;
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<int32_t, Entry> entries_;
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    size_t chunkUsed_;                                // 最后一块已用的字节数
+    size_t arenaBytes_;
+    size_t liveBytes_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+};
+
+#endif // USER_PROFILE_CACHE_H
@@ -0,0 +1,908 @@
+#include "user_search_index.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iconv.h>
+#include <numeric>
+#include <mysql/mysql.h>
+#include "database_manager.h"
+#include "logger.h"
+
+namespace {
+
+// 倒排表键的高位区分 n-gram 的种类，低 42 位放两个码点
+const uint64_t NAME_BIGRAM = 0;
+const uint64_t NAME_UNIGRAM = 1;
+const uint64_t INITIALS_BIGRAM = 2;
+const uint64_t INITIALS_UNIGRAM = 3;
+
+inline uint64_t gramKey(uint64_t kind, uint32_t first, uint32_t second = 0) {
+    return (kind << 42) | (static_cast<uint64_t>(first) << 21) | second;
+}
+
+inline unsigned char foldAscii(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + ('a' - 'A')) : c;
+}
+
+inline bool isAsciiAlnum(uint32_t c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+/**
+ * @brief 不区分 ASCII 大小写的字典序比较
+ */
+int compareFolded(std::string_view a, std::string_view b) {
+    size_t n = std::min(a.size(), b.size());
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char ca = foldAscii(static_cast<unsigned char>(a[i]));
+        unsigned char cb = foldAscii(static_cast<unsigned char>(b[i]));
+        if (ca != cb) {
+            return ca < cb ? -1 : 1;
+        }
+    }
+    return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+}
+
+bool startsWithFolded(std::string_view name, std::string_view prefix) {
+    return name.size() >= prefix.size() && compareFolded(name.substr(0, prefix.size()), prefix) == 0;
+}
+
+std::string foldedCopy(std::string_view value) {
+    std::string folded(value);
+    for (char& c : folded) {
+        c = static_cast<char>(foldAscii(static_cast<unsigned char>(c)));
+    }
+    return folded;
+}
+
+/**
+ * @brief 把 UTF-8 解码成码点序列并折叠 ASCII 大小写，非法字节按 U+FFFD 处理
+ */
+void decodeFolded(std::string_view value, std::vector<uint32_t>& chars) {
+    chars.clear();
+    size_t i = 0;
+    while (i < value.size()) {
+        unsigned char lead = static_cast<unsigned char>(value[i]);
+        uint32_t cp;
+        size_t length;
+        if (lead < 0x80) {
+            cp = foldAscii(lead);
+            length = 1;
+        } else if ((lead >> 5) == 0x6) {
+            cp = lead & 0x1f;
+            length = 2;
+        } else if ((lead >> 4) == 0xe) {
+            cp = lead & 0x0f;
+            length = 3;
+        } else if ((lead >> 3) == 0x1e) {
+            cp = lead & 0x07;
+            length = 4;
+        } else {
+            cp = 0xfffd;
+            length = 1;
+        }
+
+        for (size_t k = 1; k < length; ++k) {
+            unsigned char next = i + k < value.size() ? static_cast<unsigned char>(value[i + k]) : 0;
+            if ((next >> 6) != 0x2) {
+                cp = 0xfffd;
+                length = k;
+                break;
+            }
+            cp = (cp << 6) | (next & 0x3f);
+        }
+
+        chars.push_back(cp > 0x10ffff ? 0xfffd : cp);
+        i += length;
+    }
+}
+
+/**
+ * @brief 查询串各 n-gram 的键（去重），单字查询用单字键
+ */
+std::vector<uint64_t> queryGrams(const std::vector<uint32_t>& chars, uint64_t unigramKind, uint64_t bigramKind) {
+    std::vector<uint64_t> grams;
+    if (chars.size() == 1) {
+        grams.push_back(gramKey(unigramKind, chars[0]));
+    }
+    for (size_t i = 0; i + 1 < chars.size(); ++i) {
+        grams.push_back(gramKey(bigramKind, chars[i], chars[i + 1]));
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+}
+
+/**
+ * @brief 多个倒排表求交，按文档号升序逐个交给 visit，visit 返回false时停止
+ * 每个游标轮流跳到当前最大的文档号，短表在前决定了大部分跳转的步长
+ */
+template <typename Visitor>
+void intersectPostings(std::vector<const PostingList*> lists, Visitor visit) {
+    if (lists.empty()) {
+        return;
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const PostingList* a, const PostingList* b) { return a->size() < b->size(); });
+
+    std::vector<PostingList::Cursor> cursors;
+    cursors.reserve(lists.size());
+    for (const PostingList* list : lists) {
+        cursors.emplace_back(*list);
+    }
+
+    uint32_t target = 0;
+    size_t agreed = 0;
+    for (size_t i = 0;; i = (i + 1) % cursors.size()) {
+        if (!cursors[i].seek(target)) {
+            return;
+        }
+        if (cursors[i].value() == target) {
+            ++agreed;
+        } else {
+            target = cursors[i].value();
+            agreed = 1;
+        }
+
+        if (agreed == cursors.size()) {
+            if (!visit(target) || target == UINT32_MAX) {
+                return;
+            }
+            ++target;
+            agreed = 0;
+        }
+    }
+}
+
+/**
+ * @brief 模式串与文本任意子串之间的最小编辑距离
+ * 相邻两字对调算一处编辑（受限 Damerau-Levenshtein），这是输入时最常见的错误
+ */
+int substringDistance(const std::vector<uint32_t>& pattern, const std::vector<uint32_t>& text) {
+    size_t rows = pattern.size() + 1;
+    std::vector<int> previous2(rows);
+    std::vector<int> previous(rows);
+    std::vector<int> current(rows);
+    std::iota(previous.begin(), previous.end(), 0);
+    int best = previous.back();
+
+    // 第 0 行恒为 0：匹配可以从文本的任意位置开始
+    for (size_t j = 0; j < text.size(); ++j) {
+        current[0] = 0;
+        for (size_t i = 1; i < rows; ++i) {
+            int value = std::min(std::min(previous[i], current[i - 1]) + 1,
+                                 previous[i - 1] + (pattern[i - 1] != text[j] ? 1 : 0));
+            if (i > 1 && j > 0 && pattern[i - 1] == text[j - 1] && pattern[i - 2] == text[j]) {
+                value = std::min(value, previous2[i - 2] + 1);
+            }
+            current[i] = value;
+        }
+        best = std::min(best, current.back());
+        previous2.swap(previous);
+        previous.swap(current);
+    }
+    return best;
+}
+
+/**
+ * @brief 汉字的拼音首字母
+ * GB2312 一级汉字按拼音排序，转换成 GB2312 编码后按各声母的起始编码区间即可得到首字母；
+ * 二级汉字按部首排列，无法这样取首字母，不参与首字母索引。
+ * 构造时一次性算出整个 CJK 基本区的表，之后查表无需加锁。
+ */
+class PinyinInitials {
+public:
+    static const PinyinInitials& getInstance() {
+        static PinyinInitials instance;
+        return instance;
+    }
+
+    char initialOf(uint32_t cp) const {
+        return (cp >= CJK_FIRST && cp <= CJK_LAST) ? table_[cp - CJK_FIRST] : 0;
+    }
+
+private:
+    PinyinInitials() : table_(CJK_LAST - CJK_FIRST + 1, 0) {
+        iconv_t cd = iconv_open("GB2312", "UTF-8");
+        if (cd == reinterpret_cast<iconv_t>(-1)) {
+            LOG_WARN("GB2312 conversion unavailable, pinyin initials search disabled");
+            return;
+        }
+
+        for (uint32_t cp = CJK_FIRST; cp <= CJK_LAST; ++cp) {
+            char utf8[3] = {static_cast<char>(0xe0 | (cp >> 12)), static_cast<char>(0x80 | ((cp >> 6) & 0x3f)),
+                            static_cast<char>(0x80 | (cp & 0x3f))};
+            char gb[2];
+            char* in = utf8;
+            char* out = gb;
+            size_t inLeft = sizeof(utf8);
+            size_t outLeft = sizeof(gb);
+            if (iconv(cd, &in, &inLeft, &out, &outLeft) == static_cast<size_t>(-1) || outLeft != 0) {
+                continue;
+            }
+
+            unsigned code = (static_cast<unsigned char>(gb[0]) << 8) | static_cast<unsigned char>(gb[1]);
+            const unsigned* end = LEVEL1_STARTS + sizeof(LEVEL1_STARTS) / sizeof(LEVEL1_STARTS[0]);
+            const unsigned* bound = std::upper_bound(LEVEL1_STARTS, end, code);
+            if (bound != LEVEL1_STARTS && bound != end) {
+                table_[cp - CJK_FIRST] = LEVEL1_LETTERS[bound - LEVEL1_STARTS - 1];
+            }
+        }
+        iconv_close(cd);
+    }
+
+    static const uint32_t CJK_FIRST = 0x4e00;
+    static const uint32_t CJK_LAST = 0x9fa5;
+    // 一级汉字中各声母的起始编码，最后一项是一级汉字区的结束位置；没有以 i、u、v 开头的拼音
+    static constexpr unsigned LEVEL1_STARTS[] = {
+        0xb0a1, 0xb0c5, 0xb2c1, 0xb4ee, 0xb6ea, 0xb7a2, 0xb8c1, 0xb9fe, 0xbbf7, 0xbfa6, 0xc0ac, 0xc2e8,
+        0xc4c3, 0xc5b6, 0xc5be, 0xc6da, 0xc8bb, 0xc8f6, 0xcbfa, 0xcdda, 0xcef4, 0xd1b9, 0xd4d1, 0xd7fa};
+    static constexpr char LEVEL1_LETTERS[] = "abcdefghjklmnopqrstwxyz";
+
+    std::vector<char> table_;
+};
+
+constexpr unsigned PinyinInitials::LEVEL1_STARTS[];
+constexpr char PinyinInitials::LEVEL1_LETTERS[];
+
+} // namespace
+
+// ==================== PostingList ====================
+
+void PostingList::append(uint32_t doc) {
+    if (count_ > 0 && doc <= last_) {
+        return;
+    }
+    if (count_ % SKIP_INTERVAL == 0) {
+        skips_.push_back(Skip{last_, static_cast<uint32_t>(bytes_.size())});
+    }
+
+    uint32_t delta = doc - last_;
+    while (delta >= 0x80) {
+        bytes_.push_back(static_cast<uint8_t>(delta | 0x80));
+        delta >>= 7;
+    }
+    bytes_.push_back(static_cast<uint8_t>(delta));
+    last_ = doc;
+    ++count_;
+}
+
+void PostingList::shrink() {
+    bytes_.shrink_to_fit();
+    skips_.shrink_to_fit();
+}
+
+bool PostingList::Cursor::next() {
+    if (index_ >= list_->count_) {
+        return false;
+    }
+
+    uint32_t delta = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = list_->bytes_[offset_++];
+        delta |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    value_ += delta;
+    ++index_;
+    return true;
+}
+
+bool PostingList::Cursor::seek(uint32_t target) {
+    if (index_ > 0 && value_ >= target) {
+        return true;
+    }
+
+    // 找最后一个起点之前的文档号小于 target 的块，它之前的块整块跳过
+    const std::vector<Skip>& skips = list_->skips_;
+    size_t block = index_ / SKIP_INTERVAL;
+    if (block + 1 < skips.size()) {
+        auto it = std::lower_bound(skips.begin() + block + 1, skips.end(), target,
+                                   [](const Skip& skip, uint32_t value) { return skip.base < value; });
+        size_t found = static_cast<size_t>(it - skips.begin()) - 1;
+        if (found > block) {
+            offset_ = skips[found].offset;
+            value_ = skips[found].base;
+            index_ = static_cast<uint32_t>(found * SKIP_INTERVAL);
+        }
+    }
+
+    while (next()) {
+        if (value_ >= target) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ==================== UserSearchIndex ====================
+
+/**
+ * @brief 获取UserSearchIndex单例实例
+ * 使用局部静态变量实现线程安全的单例模式
+ * @return UserSearchIndex实例的引用
+ */
+UserSearchIndex& UserSearchIndex::getInstance() {
+    static UserSearchIndex instance;
+    return instance;
+}
+
+UserSearchIndex::UserSearchIndex() : lastUserId_(0), loaded_(false), running_(false) {
+}
+
+UserSearchIndex::~UserSearchIndex() {
+    stop();
+}
+
+bool UserSearchIndex::start(std::chrono::milliseconds syncInterval) {
+    if (running_) {
+        LOG_WARN("UserSearchIndex already started");
+        return loaded_;
+    }
+
+    bool loaded = load();
+    if (!loaded) {
+        LOG_WARN("User search index not built, searches fall back to the database until it is");
+    }
+
+    running_ = true;
+    thread_ = std::thread(&UserSearchIndex::syncLoop, this, syncInterval);
+    return loaded;
+}
+
+void UserSearchIndex::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+    }
+    stopCondition_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    LOG_INFO("UserSearchIndex stopped with {} users", size());
+}
+
+bool UserSearchIndex::search(const std::string& query, size_t limit,
+                             std::vector<std::pair<int, std::string>>& results) const {
+    if (!loaded_) {
+        return false;
+    }
+
+    results.clear();
+    if (limit == 0) {
+        return true;
+    }
+
+    std::string folded = foldedCopy(query);
+    std::vector<uint32_t> chars;
+    decodeFolded(query, chars);
+    bool asciiAlnum = !folded.empty() && std::all_of(folded.begin(), folded.end(),
+        [](char c) { return isAsciiAlnum(static_cast<unsigned char>(c)); });
+
+    std::vector<Match> matches;
+    std::unordered_set<uint32_t> seen;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    // 每一档都排在后一档之前，前面的档凑满了就不用再往下找
+    collectPrefix_impl(folded, limit, matches, seen);
+    if (matches.size() < limit && !chars.empty()) {
+        collectSubstring_impl(folded, chars, limit, matches, seen);
+    }
+    if (matches.size() < limit && asciiAlnum) {
+        collectInitials_impl(folded, limit, matches, seen);
+    }
+    if (matches.size() < limit && chars.size() >= FUZZY_MIN_CHARS) {
+        collectFuzzy_impl(chars, limit, matches, seen);
+    }
+
+    std::sort(matches.begin(), matches.end(), [this](const Match& a, const Match& b) {
+        if (a.tier != b.tier) {
+            return a.tier < b.tier;
+        }
+        if (a.distance != b.distance) {
+            return a.distance < b.distance;
+        }
+        const Doc& docA = data_.docs[a.doc];
+        const Doc& docB = data_.docs[b.doc];
+        if (docA.nameLength != docB.nameLength) {
+            return docA.nameLength < docB.nameLength;
+        }
+        int order = compareFolded(data_.nameOf(a.doc), data_.nameOf(b.doc));
+        return order != 0 ? order < 0 : docA.userId < docB.userId;
+    });
+
+    for (size_t i = 0; i < matches.size() && results.size() < limit; ++i) {
+        results.emplace_back(data_.docs[matches[i].doc].userId, std::string(data_.nameOf(matches[i].doc)));
+    }
+    return true;
+}
+
+bool UserSearchIndex::searchPrefix(const std::string& prefix, size_t limit,
+                                   std::vector<std::pair<int, std::string>>& results) const {
+    if (!loaded_) {
+        return false;
+    }
+
+    results.clear();
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    auto it = std::lower_bound(data_.sorted.begin(), data_.sorted.end(), prefix,
+        [this](uint32_t doc, const std::string& value) { return compareFolded(data_.nameOf(doc), value) < 0; });
+    for (; it != data_.sorted.end() && results.size() < limit; ++it) {
+        std::string_view name = data_.nameOf(*it);
+        if (!startsWithFolded(name, prefix)) {
+            break;
+        }
+        results.emplace_back(data_.docs[*it].userId, std::string(name));
+    }
+    return true;
+}
+
+void UserSearchIndex::addUser(int userId, const std::string& username) {
+    // 未构建时构建过程会直接从数据库读到该用户
+    if (!loaded_) {
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    addUser_impl(userId, username);
+}
+
+size_t UserSearchIndex::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return data_.docs.size();
+}
+
+/**
+ * @brief 全量构建
+ * 流式读取 users 表，逐行追加到字符池和倒排表，读完后一次排序
+ */
+bool UserSearchIndex::load() {
+    Data data;
+    int64_t maxId = 0;
+    auto startTime = std::chrono::steady_clock::now();
+
+    {
+        DatabaseManager& db = DatabaseManager::getInstance();
+        DatabaseManager::ReadConnection read = db.acquireReadConnection();
+        MYSQL* connection = static_cast<MYSQL*>(read.get());
+        if (!connection) {
+            return false;
+        }
+
+        if (mysql_query(connection, "SELECT id, username FROM users")) {
+            LOG_ERROR("Failed to build user search index: {}", mysql_error(connection));
+            return false;
+        }
+
+        // 逐行从服务端读取，不在客户端缓存整个结果集
+        MYSQL_RES* result = mysql_use_result(connection);
+        if (!result) {
+            LOG_ERROR("Failed to build user search index: {}", mysql_error(connection));
+            return false;
+        }
+
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(result))) {
+            if (!row[0] || !row[1]) {
+                continue;
+            }
+            unsigned long* lengths = mysql_fetch_lengths(result);
+            int32_t userId = static_cast<int32_t>(std::strtol(row[0], nullptr, 10));
+            data.append(userId, std::string_view(row[1], lengths[1]));
+            maxId = std::max<int64_t>(maxId, userId);
+        }
+
+        bool failed = mysql_errno(connection) != 0;
+        if (failed) {
+            LOG_ERROR("User search index build interrupted: {}", mysql_error(connection));
+        }
+        mysql_free_result(result);
+        if (failed) {
+            return false;
+        }
+    }
+
+    install(data, maxId, startTime);
+    return true;
+}
+
+/**
+ * @brief 用给定的用户全量构建索引
+ */
+void UserSearchIndex::build(const std::function<bool(int32_t& userId, std::string& username)>& next) {
+    Data data;
+    int64_t maxId = 0;
+    auto startTime = std::chrono::steady_clock::now();
+
+    int32_t userId = 0;
+    std::string username;
+    while (next(userId, username)) {
+        data.append(userId, username);
+        maxId = std::max<int64_t>(maxId, userId);
+    }
+    install(data, maxId, startTime);
+}
+
+/**
+ * @brief 排序、收缩并换入新构建的索引数据
+ */
+void UserSearchIndex::install(Data& data, int64_t maxId, std::chrono::steady_clock::time_point startTime) {
+    data.sorted.resize(data.docs.size());
+    std::iota(data.sorted.begin(), data.sorted.end(), 0);
+    std::sort(data.sorted.begin(), data.sorted.end(), [&data](uint32_t a, uint32_t b) {
+        return compareFolded(data.nameOf(a), data.nameOf(b)) < 0;
+    });
+    data.names.shrink_to_fit();
+    data.initials.shrink_to_fit();
+    data.docs.shrink_to_fit();
+    for (auto& posting : data.postings) {
+        posting.second.shrink();
+    }
+
+    size_t count = data.docs.size();
+    size_t grams = data.postings.size();
+    size_t bytes = data.bytes();
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        std::swap(data_, data);
+        lastUserId_ = maxId;
+    }
+    loaded_ = true;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+    LOG_INFO("User search index built: {} users, {} n-grams, {} bytes in {} ms",
+             count, grams, bytes, elapsed.count());
+}
+
+/**
+ * @brief 增量同步其他网关注册的用户
+ */
+bool UserSearchIndex::sync() {
+    int64_t since;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        since = std::max<int64_t>(0, lastUserId_ - SYNC_OVERLAP_IDS);
+    }
+
+    std::vector<std::pair<int, std::string>> users;
+    {
+        DatabaseManager& db = DatabaseManager::getInstance();
+        DatabaseManager::ReadConnection read = db.acquireReadConnection();
+        MYSQL* connection = static_cast<MYSQL*>(read.get());
+        if (!connection) {
+            return false;
+        }
+
+        std::string query = "SELECT id, username FROM users WHERE id > " + std::to_string(since) + " ORDER BY id";
+        if (mysql_query(connection, query.c_str())) {
+            LOG_ERROR("Failed to sync user search index: {}", mysql_error(connection));
+            return false;
+        }
+
+        MYSQL_RES* result = mysql_store_result(connection);
+        if (!result) {
+            return false;
+        }
+
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(result))) {
+            if (row[0] && row[1]) {
+                unsigned long* lengths = mysql_fetch_lengths(result);
+                users.emplace_back(std::atoi(row[0]), std::string(row[1], lengths[1]));
+            }
+        }
+        mysql_free_result(result);
+    }
+
+    size_t added = 0;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        for (const auto& user : users) {
+            if (addUser_impl(user.first, user.second)) {
+                ++added;
+            }
+            lastUserId_ = std::max<int64_t>(lastUserId_, user.first);
+        }
+    }
+
+    if (added > 0) {
+        LOG_DEBUG("User search index synced {} new users", added);
+    }
+    return true;
+}
+
+void UserSearchIndex::syncLoop(std::chrono::milliseconds interval) {
+    while (sleepFor(interval)) {
+        if (!loaded_) {
+            load();
+            continue;
+        }
+        sync();
+    }
+}
+
+/**
+ * @brief 插入一个用户（调用者需持有写锁）
+ * 用户名唯一，同名条目已存在时视为重复
+ * @return 新插入返回true
+ */
+bool UserSearchIndex::addUser_impl(int userId, const std::string& username) {
+    auto it = std::lower_bound(data_.sorted.begin(), data_.sorted.end(), username,
+        [this](uint32_t doc, const std::string& value) { return compareFolded(data_.nameOf(doc), value) < 0; });
+    for (auto same = it; same != data_.sorted.end() && compareFolded(data_.nameOf(*same), username) == 0; ++same) {
+        if (data_.docs[*same].userId == userId) {
+            return false;
+        }
+    }
+
+    uint32_t doc = static_cast<uint32_t>(data_.docs.size());
+    if (!data_.append(userId, username)) {
+        return false;
+    }
+    data_.sorted.insert(it, doc);
+    return true;
+}
+
+/**
+ * @brief 前缀匹配（调用者需持有读锁）
+ */
+void UserSearchIndex::collectPrefix_impl(std::string_view folded, size_t limit, std::vector<Match>& matches,
+                                         std::unordered_set<uint32_t>& seen) const {
+    auto it = std::lower_bound(data_.sorted.begin(), data_.sorted.end(), folded,
+        [this](uint32_t doc, std::string_view value) { return compareFolded(data_.nameOf(doc), value) < 0; });
+    for (; it != data_.sorted.end() && matches.size() < limit; ++it) {
+        std::string_view name = data_.nameOf(*it);
+        if (!startsWithFolded(name, folded)) {
+            break;
+        }
+        matches.push_back(Match{*it, name.size() == folded.size() ? 0 : 1, 0});
+        seen.insert(*it);
+    }
+}
+
+/**
+ * @brief 子串匹配（调用者需持有读锁）
+ * n-gram 求交只保证每个片段都出现过，还要校验查询串连续出现
+ */
+void UserSearchIndex::collectSubstring_impl(std::string_view folded, const std::vector<uint32_t>& chars, size_t limit,
+                                            std::vector<Match>& matches, std::unordered_set<uint32_t>& seen) const {
+    std::vector<const PostingList*> lists;
+    for (uint64_t gram : queryGrams(chars, NAME_UNIGRAM, NAME_BIGRAM)) {
+        const PostingList* list = data_.find(gram);
+        if (!list) {
+            return;
+        }
+        lists.push_back(list);
+    }
+
+    intersectPostings(lists, [&](uint32_t doc) {
+        if (!seen.count(doc) && foldedCopy(data_.nameOf(doc)).find(folded) != std::string::npos) {
+            matches.push_back(Match{doc, 2, 0});
+            seen.insert(doc);
+        }
+        return matches.size() < limit;
+    });
+}
+
+/**
+ * @brief 拼音首字母匹配（调用者需持有读锁）
+ */
+void UserSearchIndex::collectInitials_impl(std::string_view folded, size_t limit, std::vector<Match>& matches,
+                                           std::unordered_set<uint32_t>& seen) const {
+    std::vector<uint32_t> letters(folded.begin(), folded.end());
+    std::vector<const PostingList*> lists;
+    for (uint64_t gram : queryGrams(letters, INITIALS_UNIGRAM, INITIALS_BIGRAM)) {
+        const PostingList* list = data_.find(gram);
+        if (!list) {
+            return;
+        }
+        lists.push_back(list);
+    }
+
+    intersectPostings(lists, [&](uint32_t doc) {
+        if (!seen.count(doc)) {
+            size_t pos = data_.initialsOf(doc).find(folded);
+            if (pos != std::string_view::npos) {
+                matches.push_back(Match{doc, pos == 0 ? 3 : 4, 0});
+                seen.insert(doc);
+            }
+        }
+        return matches.size() < limit;
+    });
+}
+
+/**
+ * @brief 错字匹配（调用者需持有读锁）
+ * 每处编辑最多破坏查询串的三个二元组（对调），包含 k 处错字的子串至少命中 (二元组数 - 3k) 个。
+ * 用户量大时常见二元组的倒排表很长，不能全部展开：从最短的表开始展开到 FUZZY_MAX_SCANNED 为止，
+ * 按在这些表中的命中数从高到低挑选候选，再计算编辑距离
+ */
+void UserSearchIndex::collectFuzzy_impl(const std::vector<uint32_t>& chars, size_t limit, std::vector<Match>& matches,
+                                        std::unordered_set<uint32_t>& seen) const {
+    int maxEdits = chars.size() >= FUZZY_TWO_EDITS_MIN_CHARS ? 2 : 1;
+
+    // 索引中不存在的二元组一个都命中不了，但仍计入二元组数
+    std::vector<uint64_t> grams = queryGrams(chars, NAME_UNIGRAM, NAME_BIGRAM);
+    std::vector<const PostingList*> lists;
+    for (uint64_t gram : grams) {
+        if (const PostingList* list = data_.find(gram)) {
+            lists.push_back(list);
+        }
+    }
+    if (lists.empty()) {
+        return;
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const PostingList* a, const PostingList* b) { return a->size() < b->size(); });
+
+    // 至少展开最短的表
+    size_t expanded = 0;
+    size_t scanned = 0;
+    while (expanded < lists.size() &&
+           (expanded == 0 || scanned + lists[expanded]->size() <= FUZZY_MAX_SCANNED)) {
+        scanned += lists[expanded]->size();
+        ++expanded;
+    }
+
+    // 未展开的表全部命中也补不上的候选可以直接排除
+    int required = static_cast<int>(grams.size()) - 3 * maxEdits - static_cast<int>(lists.size() - expanded);
+    required = std::max(required, 1);
+    if (required > static_cast<int>(expanded)) {
+        return;
+    }
+
+    // 按文档号分段计数：每段把各表落在段内的文档号累加到计数数组，再按命中数分桶，每桶最多保留 FUZZY_MAX_CANDIDATES 个
+    std::vector<PostingList::Cursor> cursors;
+    std::vector<char> alive(expanded);
+    cursors.reserve(expanded);
+    for (size_t i = 0; i < expanded; ++i) {
+        cursors.emplace_back(*lists[i]);
+        alive[i] = cursors[i].next();
+    }
+    std::vector<uint8_t> counts(FUZZY_WINDOW);
+    std::vector<uint32_t> touched;
+    std::vector<std::vector<uint32_t>> byHits(expanded + 1);
+    for (uint64_t base = 0;; base += FUZZY_WINDOW) {
+        uint64_t end = base + FUZZY_WINDOW;
+        bool any = false;
+        touched.clear();
+        for (size_t i = 0; i < expanded; ++i) {
+            while (alive[i] && cursors[i].value() < end) {
+                uint32_t offset = static_cast<uint32_t>(cursors[i].value() - base);
+                if (counts[offset]++ == 0) {
+                    touched.push_back(offset);
+                }
+                alive[i] = cursors[i].next();
+            }
+            any |= alive[i] != 0;
+        }
+        for (uint32_t offset : touched) {
+            uint8_t hits = counts[offset];
+            counts[offset] = 0;
+            uint32_t doc = static_cast<uint32_t>(base + offset);
+            if (hits >= required && byHits[hits].size() < FUZZY_MAX_CANDIDATES && !seen.count(doc)) {
+                byHits[hits].push_back(doc);
+            }
+        }
+        // 命中全部展开表的候选已经够校验了，后面的段不会再有更好的候选
+        if (!any || byHits[expanded].size() >= FUZZY_MAX_CANDIDATES) {
+            break;
+        }
+    }
+
+    std::vector<Match> found;
+    std::vector<uint32_t> text;
+    size_t checked = 0;
+    for (size_t hits = expanded; hits >= static_cast<size_t>(required); --hits) {
+        for (uint32_t doc : byHits[hits]) {
+            if (checked == FUZZY_MAX_CANDIDATES || matches.size() + found.size() >= limit) {
+                break;
+            }
+            ++checked;
+            decodeFolded(data_.nameOf(doc), text);
+            int distance = substringDistance(chars, text);
+            if (distance <= maxEdits) {
+                found.push_back(Match{doc, 5, distance});
+            }
+        }
+    }
+
+    for (const Match& match : found) {
+        matches.push_back(match);
+        seen.insert(match.doc);
+    }
+}
+
+/**
+ * @brief 可被 stop() 打断的等待
+ * @return 等待结束后仍在运行返回true
+ */
+bool UserSearchIndex::sleepFor(std::chrono::milliseconds duration) {
+    std::unique_lock<std::mutex> lock(stopMutex_);
+    return !stopCondition_.wait_for(lock, duration, [this] { return !running_; });
+}
+
+// ==================== UserSearchIndex::Data ====================
+
+/**
+ * @brief 追加一个文档并写入倒排表（不维护 sorted）
+ * @return 用户名过长时返回false
+ */
+bool UserSearchIndex::Data::append(int32_t userId, std::string_view username) {
+    if (username.size() > UINT16_MAX) {
+        return false;
+    }
+
+    std::vector<uint32_t> chars;
+    decodeFolded(username, chars);
+
+    // 字母数字原样保留，汉字换成拼音首字母；不含可转写汉字的用户名不记录首字母串
+    std::string letters;
+    bool transliterated = false;
+    const PinyinInitials& pinyin = PinyinInitials::getInstance();
+    for (uint32_t cp : chars) {
+        if (isAsciiAlnum(cp)) {
+            letters.push_back(static_cast<char>(cp));
+        } else if (char initial = pinyin.initialOf(cp)) {
+            letters.push_back(initial);
+            transliterated = true;
+        }
+    }
+    if (!transliterated) {
+        letters.clear();
+    }
+
+    uint32_t doc = static_cast<uint32_t>(docs.size());
+    Doc entry;
+    entry.nameOffset = static_cast<uint32_t>(names.size());
+    entry.initialsOffset = static_cast<uint32_t>(initials.size());
+    entry.nameLength = static_cast<uint16_t>(username.size());
+    entry.initialsLength = static_cast<uint16_t>(letters.size());
+    entry.userId = userId;
+    names.append(username.data(), username.size());
+    initials.append(letters);
+    docs.push_back(entry);
+
+    for (size_t i = 0; i < chars.size(); ++i) {
+        postings[gramKey(NAME_UNIGRAM, chars[i])].append(doc);
+        if (i + 1 < chars.size()) {
+            postings[gramKey(NAME_BIGRAM, chars[i], chars[i + 1])].append(doc);
+        }
+    }
+    for (size_t i = 0; i < letters.size(); ++i) {
+        postings[gramKey(INITIALS_UNIGRAM, static_cast<unsigned char>(letters[i]))].append(doc);
+        if (i + 1 < letters.size()) {
+            postings[gramKey(INITIALS_BIGRAM, static_cast<unsigned char>(letters[i]),
+                             static_cast<unsigned char>(letters[i + 1]))].append(doc);
+        }
+    }
+    return true;
+}
+
+std::string_view UserSearchIndex::Data::nameOf(uint32_t doc) const {
+    return std::string_view(names.data() + docs[doc].nameOffset, docs[doc].nameLength);
+}
+
+std::string_view UserSearchIndex::Data::initialsOf(uint32_t doc) const {
+    return std::string_view(initials.data() + docs[doc].initialsOffset, docs[doc].initialsLength);
+}
+
+const PostingList* UserSearchIndex::Data::find(uint64_t gram) const {
+    auto it = postings.find(gram);
+    return it != postings.end() ? &it->second : nullptr;
+}
+
+size_t UserSearchIndex::Data::bytes() const {
+    size_t total = names.capacity() + initials.capacity() + docs.capacity() * sizeof(Doc) +
+                   sorted.capacity() * sizeof(uint32_t) + postings.bucket_count() * sizeof(void*);
+    for (const auto& posting : postings) {
+        total += sizeof(posting) + posting.second.bytes();
+    }
+    return total;
+}
@@ -0,0 +1,246 @@
+#ifndef USER_SEARCH_INDEX_H
+#define USER_SEARCH_INDEX_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 压缩倒排表
+ *
+ * 文档号只追加且严格递增，按与前一项的差值做 varint 编码，常见的 n-gram 每项只占一个字节。
+ * 每 SKIP_INTERVAL 项记录一个跳表点，求交时可以整块跳过不可能命中的区间，不必逐项解码。
+ */
+class PostingList {
+public:
+    /**
+     * @brief 顺序读取游标
+     */
+    class Cursor {
+    public:
+        explicit Cursor(const PostingList& list) : list_(&list), offset_(0), index_(0), value_(0) {}
+
+        /**
+         * @brief 前进一项
+         * @return 已读完返回false
+         */
+        bool next();
+
+        /**
+         * @brief 前进到第一个不小于 target 的文档号（已经不小于时不移动）
+         * @return 不存在这样的文档号返回false
+         */
+        bool seek(uint32_t target);
+
+        /**
+         * @brief 当前文档号
+         */
+        uint32_t value() const { return value_; }
+
+    private:
+        const PostingList* list_;
+        size_t offset_;     // 下一项在 bytes_ 中的位置
+        uint32_t index_;    // 已读的项数
+        uint32_t value_;
+    };
+
+    /**
+     * @brief 追加文档号，不大于最后一项时忽略
+     */
+    void append(uint32_t doc);
+
+    /**
+     * @brief 项数
+     */
+    uint32_t size() const { return count_; }
+
+    /**
+     * @brief 占用的内存字节数
+     */
+    size_t bytes() const { return bytes_.capacity() + skips_.capacity() * sizeof(Skip); }
+
+    /**
+     * @brief 释放多余容量（批量构建结束后调用）
+     */
+    void shrink();
+
+private:
+    // 跳表点：一块的第一项之前的文档号和该块在 bytes_ 中的起始位置
+    struct Skip {
+        uint32_t base;
+        uint32_t offset;
+    };
+
+    static const uint32_t SKIP_INTERVAL = 64;
+
+    std::vector<uint8_t> bytes_;
+    std::vector<Skip> skips_;
+    uint32_t last_ = 0;
+    uint32_t count_ = 0;
+};
+
+/**
+ * @brief 用户名搜索索引（单例模式）
+ *
+ * 客户端每输入一个字符都会发出 search_user，原来每次都要在数据库锁下执行 LIKE 'q%'：
+ * 1. 所有用户名连续存放在一个字符池中，按不区分大小写的字典序排好的文档号数组支持前缀查询
+ * 2. 用户名按码点切分的单字和相邻二元组建立倒排表，子串查询对查询串的各个 n-gram 求交后逐个校验
+ * 3. 含汉字的用户名另外记录拼音首字母串（"张三" -> "zs"）并同样建立倒排表
+ * 4. 前三类结果不足时按 n-gram 命中数筛选候选，用编辑距离容忍少量错字
+ * 5. 启动时流式读取 users 表批量构建，本网关注册的用户立即插入，
+ *    其他网关注册的用户由后台线程按自增ID增量同步
+ *
+ * 结果依次按 完全匹配 > 前缀 > 子串 > 首字母前缀 > 首字母子串 > 错字 排序，同一档内短名在前。
+ * 查询串按字面匹配，% 和 _ 不再是通配符；大小写只折叠 ASCII 字母。
+ */
+class UserSearchIndex {
+public:
+    /**
+     * @brief 获取UserSearchIndex单例实例
+     * @return UserSearchIndex实例的引用
+     */
+    static UserSearchIndex& getInstance();
+
+    UserSearchIndex(const UserSearchIndex&) = delete;
+    UserSearchIndex& operator=(const UserSearchIndex&) = delete;
+
+    /**
+     * @brief 构建索引并启动后台同步线程（需在 DatabaseManager 连接之后调用）
+     * 首次构建失败时由后台线程重试
+     * @param syncInterval 增量同步间隔
+     * @return 首次构建成功返回true
+     */
+    bool start(std::chrono::milliseconds syncInterval = std::chrono::milliseconds(5000));
+
+    /**
+     * @brief 停止后台同步线程
+     */
+    void stop();
+
+    /**
+     * @brief 索引是否已构建
+     */
+    bool isLoaded() const { return loaded_; }
+
+    /**
+     * @brief 搜索用户名：前缀、子串、拼音首字母和错字容忍
+     * @param query 查询串
+     * @param limit 最多返回的条数
+     * @param results 输出参数，(用户ID, 用户名) 按相关度排序
+     * @return 索引未构建时返回false，调用者应回退到数据库查询
+     */
+    bool search(const std::string& query, size_t limit, std::vector<std::pair<int, std::string>>& results) const;
+
+    /**
+     * @brief 按前缀搜索用户名（不区分大小写）
+     * @param prefix 前缀
+     * @param limit 最多返回的条数
+     * @param results 输出参数，(用户ID, 用户名) 按用户名排序
+     * @return 索引未构建时返回false，调用者应回退到数据库查询
+     */
+    bool searchPrefix(const std::string& prefix, size_t limit, std::vector<std::pair<int, std::string>>& results) const;
+
+    /**
+     * @brief 加入新注册的用户
+     * @param userId 用户ID
+     * @param username 用户名
+     */
+    void addUser(int userId, const std::string& username);
+
+    /**
+     * @brief 用给定的用户全量构建索引，不读数据库（基准测试使用）
+     * @param next 每次产出一个用户，没有更多用户时返回false
+     */
+    void build(const std::function<bool(int32_t& userId, std::string& username)>& next);
+
+    /**
+     * @brief 索引中的用户数
+     */
+    size_t size() const;
+
+private:
+    UserSearchIndex();
+    ~UserSearchIndex();
+
+    // 文档：用户名和首字母串在字符池中的位置以及用户ID，下标即文档号
+    struct Doc {
+        uint32_t nameOffset;
+        uint32_t initialsOffset;
+        uint16_t nameLength;
+        uint16_t initialsLength;
+        int32_t userId;
+    };
+
+    // 索引数据，全量构建时在锁外另建一份再整体替换
+    struct Data {
+        std::string names;                                  // 所有用户名首尾相接
+        std::string initials;                               // 所有首字母串首尾相接
+        std::vector<Doc> docs;
+        std::vector<uint32_t> sorted;                       // 按折叠后的用户名排序的文档号
+        std::unordered_map<uint64_t, PostingList> postings; // n-gram -> 文档号
+
+        bool append(int32_t userId, std::string_view username);
+        std::string_view nameOf(uint32_t doc) const;
+        std::string_view initialsOf(uint32_t doc) const;
+        const PostingList* find(uint64_t gram) const;
+        size_t bytes() const;
+    };
+
+    // 候选结果：文档号、档位和编辑距离
+    struct Match {
+        uint32_t doc;
+        int tier;
+        int distance;
+    };
+
+    bool load();
+    void install(Data& data, int64_t maxId, std::chrono::steady_clock::time_point startTime);
+    bool sync();
+    void syncLoop(std::chrono::milliseconds interval);
+    bool addUser_impl(int userId, const std::string& username);
+    void collectPrefix_impl(std::string_view folded, size_t limit, std::vector<Match>& matches,
+                            std::unordered_set<uint32_t>& seen) const;
+    void collectSubstring_impl(std::string_view folded, const std::vector<uint32_t>& chars, size_t limit,
+                               std::vector<Match>& matches, std::unordered_set<uint32_t>& seen) const;
+    void collectInitials_impl(std::string_view folded, size_t limit, std::vector<Match>& matches,
+                              std::unordered_set<uint32_t>& seen) const;
+    void collectFuzzy_impl(const std::vector<uint32_t>& chars, size_t limit, std::vector<Match>& matches,
+                           std::unordered_set<uint32_t>& seen) const;
+    bool sleepFor(std::chrono::milliseconds duration);
+
+    // 增量同步向前回看的自增ID数，覆盖乱序提交的事务
+    static const int SYNC_OVERLAP_IDS = 256;
+    // 查询串至少这么多个字才做错字匹配，再短的候选集太大
+    static const size_t FUZZY_MIN_CHARS = 5;
+    // 查询串达到这么多个字时允许两处错字
+    static const size_t FUZZY_TWO_EDITS_MIN_CHARS = 8;
+    // 错字匹配最多展开的倒排表项数（最短的表总会展开）
+    static const size_t FUZZY_MAX_SCANNED = 200000;
+    // 错字匹配按文档号分段计数命中数，每段的文档数
+    static const uint32_t FUZZY_WINDOW = 65536;
+    // 错字匹配最多校验的候选数
+    static const size_t FUZZY_MAX_CANDIDATES = 2000;
+
+    mutable std::shared_mutex mutex_;
+    Data data_;
+    int64_t lastUserId_;                // 已同步的 users 最大自增ID
+    std::atomic<bool> loaded_;
+
+    std::atomic<bool> running_;
+    std::thread thread_;
+    std::mutex stopMutex_;
+    std::condition_variable stopCondition_;
+};
+
+#endif // USER_SEARCH_INDEX_H
@@ -0,0 +1,233 @@
+#include "user_status_flusher.h"
+#include <algorithm>
+#include <mysql/mysql.h>
+#include "database_manager.h"
+#include "logger.h"
+
+namespace {
+
+// mysql_errno 不小于该值的是客户端错误（连接断开等），整批留待重试
+const unsigned int CLIENT_ERROR_MIN = 2000;
+
+// 只有不比表中旧的变化才更新状态和令牌；last_seen 最后赋值（MySQL 按顺序求值，前面的条件看到的是旧值）
+const char* const UPSERT_SUFFIX =
+    " ON DUPLICATE KEY UPDATE"
+    " status = IF(VALUES(last_seen) >= last_seen, VALUES(status), status),"
+    " session_token = IF(VALUES(last_seen) >= last_seen, VALUES(session_token), session_token),"
+    " last_seen = GREATEST(last_seen, VALUES(last_seen))";
+
+} // namespace
+
+/**
+ * @brief 获取UserStatusFlusher单例实例
+ * 使用局部静态变量实现线程安全的单例模式
+ * @return UserStatusFlusher实例的引用
+ */
+UserStatusFlusher& UserStatusFlusher::getInstance() {
+    static UserStatusFlusher instance;
+    return instance;
+}
+
+UserStatusFlusher::UserStatusFlusher() : enqueued_(0), nextSeq_(1), reportedSeq_(0), running_(false) {
+}
+
+UserStatusFlusher::~UserStatusFlusher() {
+    stop();
+}
+
+void UserStatusFlusher::start(std::chrono::milliseconds flushInterval) {
+    if (running_) {
+        LOG_WARN("UserStatusFlusher already started");
+        return;
+    }
+
+    running_ = true;
+    thread_ = std::thread(&UserStatusFlusher::flushLoop, this, flushInterval);
+    LOG_INFO("UserStatusFlusher started, flushing every {} ms", flushInterval.count());
+}
+
+void UserStatusFlusher::setFlushedCallback(FlushedCallback callback) {
+    flushedCallback_ = std::move(callback);
+}
+
+void UserStatusFlusher::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+    }
+    stopCondition_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    if (!flush()) {
+        LOG_ERROR("UserStatusFlusher stopped with {} user status rows not written", pending());
+    } else {
+        LOG_INFO("UserStatusFlusher stopped");
+    }
+}
+
+uint64_t UserStatusFlusher::enqueue(int32_t userId, const std::string& status, int64_t lastSeenMs,
+                                    const std::string& sessionToken) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t seq = nextSeq_++;
+    auto inserted = dirty_.emplace(userId, Row{status, lastSeenMs, sessionToken, seq});
+    Row& row = inserted.first->second;
+    // 同一用户已有更新的变化时保留它（调用方的时钟可能不严格递增）；序号保留最早的，这一行写入前都不算落库
+    if (!inserted.second && lastSeenMs >= row.lastSeenMs) {
+        row.status = status;
+        row.lastSeenMs = lastSeenMs;
+        row.sessionToken = sessionToken;
+    }
+    ++enqueued_;
+    return seq;
+}
+
+size_t UserStatusFlusher::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dirty_.size();
+}
+
+uint64_t UserStatusFlusher::flushedSeq_impl() const {
+    uint64_t earliest = nextSeq_;
+    for (const auto& entry : dirty_) {
+        earliest = std::min(earliest, entry.second.seq);
+    }
+    return earliest - 1;
+}
+
+bool UserStatusFlusher::flush() {
+    Rows rows;
+    uint64_t enqueued;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (dirty_.empty()) {
+            return true;
+        }
+        rows.reserve(dirty_.size());
+        for (auto& entry : dirty_) {
+            rows.emplace_back(entry.first, std::move(entry.second));
+        }
+        dirty_.clear();
+        enqueued = enqueued_;
+        enqueued_ = 0;
+    }
+
+    Rows failed;
+    size_t written = 0;
+    size_t dropped = 0;
+    DatabaseManager& db = DatabaseManager::getInstance();
+    for (auto begin = rows.cbegin(); begin != rows.cend();) {
+        auto end = begin + std::min<size_t>(MAX_ROWS_PER_STATEMENT, rows.cend() - begin);
+
+        // 每条语句单独加锁，批量写入期间其他查询仍可穿插执行
+        std::lock_guard<std::mutex> lock(db.mutex());
+        MYSQL* connection = nullptr;
+        if (db.isConnected_impl() || db.connect_impl()) {
+            connection = static_cast<MYSQL*>(db.getConnection());
+        }
+
+        unsigned int error = connection ? write_impl(connection, begin, end) : CLIENT_ERROR_MIN;
+        if (error != 0 && error < CLIENT_ERROR_MIN) {
+            // 数据错误只影响个别行：逐行重写，仍然失败的行丢弃
+            LOG_WARN("Batched user_status upsert failed ({}), retrying {} rows one by one", error, end - begin);
+            for (auto row = begin; row != end; ++row) {
+                unsigned int rowError = write_impl(connection, row, row + 1);
+                if (rowError == 0) {
+                    ++written;
+                    db.pinSessionToPrimary(DatabaseManager::userSessionKey(row->first));
+                } else if (rowError < CLIENT_ERROR_MIN) {
+                    LOG_ERROR("Dropping user_status row of user {}: {}", row->first, mysql_error(connection));
+                    ++dropped;
+                } else {
+                    failed.push_back(*row);
+                }
+            }
+        } else if (error != 0) {
+            failed.insert(failed.end(), begin, end);
+        } else {
+            written += end - begin;
+            // 写后读：刚写入状态的用户在固定窗口内从主库读取
+            for (auto row = begin; row != end; ++row) {
+                db.pinSessionToPrimary(DatabaseManager::userSessionKey(row->first));
+            }
+        }
+        begin = end;
+    }
+
+    LOG_DEBUG("Flushed {} user_status rows for {} status changes ({} dropped, {} to retry)",
+              written, enqueued, dropped, failed.size());
+
+    uint64_t flushed;
+    {
+        // 未写入的行放回集合，期间又有变化的用户以新变化为准，但序号取两者中较早的
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& row : failed) {
+            uint64_t seq = row.second.seq;
+            auto inserted = dirty_.emplace(row.first, std::move(row.second));
+            if (!inserted.second) {
+                inserted.first->second.seq = std::min(inserted.first->second.seq, seq);
+            }
+        }
+        flushed = flushedSeq_impl();
+    }
+
+    // 回调在锁外执行，回调中可以再次 enqueue
+    if (flushedCallback_ && flushed > reportedSeq_) {
+        reportedSeq_ = flushed;
+        flushedCallback_(flushed);
+    }
+    return failed.empty();
+}
+
+unsigned int UserStatusFlusher::write_impl(void* connection, Rows::const_iterator begin, Rows::const_iterator end) {
+    MYSQL* mysql = static_cast<MYSQL*>(connection);
+
+    std::string query = "INSERT INTO user_status (user_id, status, last_seen, session_token) VALUES ";
+    std::string escaped;
+    for (auto row = begin; row != end; ++row) {
+        const std::string& token = row->second.sessionToken;
+        escaped.resize(token.size() * 2 + 1);
+        unsigned long length = mysql_real_escape_string(mysql, &escaped[0], token.data(), token.size());
+
+        if (row != begin) {
+            query += ',';
+        }
+        query += '(';
+        query += std::to_string(row->first);
+        query += ", '";
+        query += row->second.status;
+        query += "', FROM_UNIXTIME(";
+        query += std::to_string(row->second.lastSeenMs / 1000);
+        query += "), '";
+        query.append(escaped.data(), length);
+        query += "')";
+    }
+    query += UPSERT_SUFFIX;
+
+    if (mysql_real_query(mysql, query.data(), query.size())) {
+        LOG_ERROR("MySQL query error: {}", mysql_error(mysql));
+        return std::max(mysql_errno(mysql), 1u);
+    }
+    return 0;
+}
+
+void UserStatusFlusher::flushLoop(std::chrono::milliseconds interval) {
+    while (sleepFor(interval)) {
+        if (!flush()) {
+            LOG_WARN("Failed to flush user_status, {} rows will be retried", pending());
+        }
+    }
+}
+
+/**
+ * @brief 可被 stop() 打断的等待
+ * @return 等待结束后仍在运行返回true
+ */
+bool UserStatusFlusher::sleepFor(std::chrono::milliseconds duration) {
+    std::unique_lock<std::mutex> lock(stopMutex_);
+    return !stopCondition_.wait_for(lock, duration, [this] { return !running_; });
+}
@@ -0,0 +1,124 @@
+#ifndef USER_STATUS_FLUSHER_H
+#define USER_STATUS_FLUSHER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief user_status 表的延迟批量写入（单例模式）
+ *
+ * 状态变化先记入内存中的待写集合（按用户合并，只保留最新一次），
+ * 后台线程每个刷新间隔把集合换出，用多行 INSERT ... ON DUPLICATE KEY UPDATE 写入：
+ * 1. 同一用户在一个刷新窗口内的多次变化（移动端频繁断线重连）只写一行
+ * 2. 连接错误时整批放回集合（期间已有更新变化的用户以新的为准），下一轮重试；
+ *    数据错误（如用户已被删除）时逐行重写，只丢弃出错的行
+ * 3. last_seen 只会前进，较旧的变化晚到时不会覆盖较新的状态
+ * 4. 每次变化分配一个递增的序号，每轮刷新后通过回调报告已落库的序号，调用方据此推进自己的检查点
+ *
+ * 进程崩溃最多丢失最近一个刷新窗口内尚未写入的变化，用户的下一次状态变化会写入最新状态。
+ */
+class UserStatusFlusher {
+public:
+    /**
+     * @brief 落库回调：序号不大于 seq 的变化都已写入（或因数据错误被丢弃）
+     */
+    using FlushedCallback = std::function<void(uint64_t seq)>;
+
+    /**
+     * @brief 获取UserStatusFlusher单例实例
+     * @return UserStatusFlusher实例的引用
+     */
+    static UserStatusFlusher& getInstance();
+
+    UserStatusFlusher(const UserStatusFlusher&) = delete;
+    UserStatusFlusher& operator=(const UserStatusFlusher&) = delete;
+
+    /**
+     * @brief 启动后台刷新线程
+     * @param flushInterval 刷新间隔
+     */
+    void start(std::chrono::milliseconds flushInterval = std::chrono::milliseconds(2000));
+
+    /**
+     * @brief 设置落库回调（需在 start 之前调用），回调在刷新线程中执行
+     */
+    void setFlushedCallback(FlushedCallback callback);
+
+    /**
+     * @brief 停止后台刷新线程并写入剩余的变化
+     */
+    void stop();
+
+    /**
+     * @brief 记录一次状态变化
+     * @param userId 用户ID
+     * @param status user_status.status 的取值（OFFLINE/ONLINE/AWAY/BUSY）
+     * @param lastSeenMs 变化发生的时间（毫秒）
+     * @param sessionToken 会话令牌
+     * @return 这次变化的序号
+     */
+    uint64_t enqueue(int32_t userId, const std::string& status, int64_t lastSeenMs, const std::string& sessionToken);
+
+    /**
+     * @brief 等待写入的用户数
+     */
+    size_t pending() const;
+
+private:
+    UserStatusFlusher();
+    ~UserStatusFlusher();
+
+    struct Row {
+        std::string status;
+        int64_t lastSeenMs;
+        std::string sessionToken;
+        uint64_t seq;                      // 合并进这一行的最早一次变化的序号
+    };
+    using Rows = std::vector<std::pair<int32_t, Row>>;
+
+    /**
+     * @brief 写入当前待写集合
+     * @return 全部写入（或没有待写的行）返回true
+     */
+    bool flush();
+
+    /**
+     * @brief 已落库的序号：待写集合中最早的序号之前的变化都已写入（调用者持有 mutex_）
+     */
+    uint64_t flushedSeq_impl() const;
+
+    /**
+     * @brief 写入 [begin, end) 的行（调用者持有数据库锁）
+     * @return 写入失败时返回 mysql_errno，成功返回0
+     */
+    unsigned int write_impl(void* connection, Rows::const_iterator begin, Rows::const_iterator end);
+
+    void flushLoop(std::chrono::milliseconds interval);
+    bool sleepFor(std::chrono::milliseconds duration);
+
+    // 每条语句最多写入的行数，避免语句超过 max_allowed_packet
+    static constexpr size_t MAX_ROWS_PER_STATEMENT = 500;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<int32_t, Row> dirty_;
+    uint64_t enqueued_;                    // 自上次刷新以来记录的变化数（含被合并的）
+    uint64_t nextSeq_;                     // 下一次变化的序号
+    uint64_t reportedSeq_;                 // 最近一次通过回调报告的序号（只由刷新的线程访问）
+    FlushedCallback flushedCallback_;
+
+    std::atomic<bool> running_;
+    std::thread thread_;
+    std::mutex stopMutex_;
+    std::condition_variable stopCondition_;
+};
+
+#endif // USER_STATUS_FLUSHER_H